@@ -1,2 +1,9 @@
 #define VOLK_IMPLEMENTATION
 #include <Volk/volk.h>
+
+#define TINY_TTF_IMPLEMENTATION
+#include <TinyTTF/tiny_ttf.h>
+
+#define XXH_STATIC_LINKING_ONLY
+#define XXH_IMPLEMENTATION
+#include <xxHash/xxhash.h>
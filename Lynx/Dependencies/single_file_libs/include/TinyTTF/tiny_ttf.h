@@ -0,0 +1,839 @@
+/*
+  tiny_ttf.h - minimal TrueType outline reader and signed distance field rasterizer
+
+  Reads the cmap (formats 4 and 12), hmtx, kern (format 0), loca and glyf tables, including
+  compound glyphs, and renders glyphs straight from their outlines into single channel signed
+  distance fields. No hinting, no CFF outlines and no GPOS kerning.
+
+  Define TINY_TTF_IMPLEMENTATION in exactly one translation unit before including this file.
+
+  Fonts are not trusted: ttf_init checks every table it uses against the size of the data,
+  including every loca entry, and the glyph outlines are checked as they are read, so a
+  malformed font makes the functions fail instead of reading out of bounds.
+
+  Distances are measured in pixels of the output bitmap. A texel holds
+  on_edge + distance * pixel_dist_scale clamped to [0, 255], positive inside the glyph.
+
+  This file is in the public domain.
+*/
+
+#ifndef TINY_TTF_H
+#define TINY_TTF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ttf_font
+{
+  const uint8_t* data;
+  size_t size;
+
+  /* offsets into data, cmap is the chosen subtable and kern is 0 when there is none */
+  uint32_t cmap;
+  uint32_t glyf;
+  uint32_t head;
+  uint32_t hhea;
+  uint32_t hmtx;
+  uint32_t kern;
+  uint32_t loca;
+  uint32_t cmap_length;
+  uint32_t glyf_length;
+  uint32_t kern_length;
+
+  int num_glyphs;
+  int num_hmetrics;
+  int index_to_loc_format;
+  int units_per_em;
+  int ascent;
+  int descent;
+  int line_gap;
+} ttf_font;
+
+/* returns 1 on success and 0 for malformed or unsupported fonts, data has to outlive the font */
+int ttf_init(ttf_font* font, const uint8_t* data, size_t size);
+
+/* 0 is the missing glyph */
+int ttf_find_glyph(const ttf_font* font, uint32_t codepoint);
+
+/* scale that maps ascent - descent to the given pixel height */
+float ttf_scale_for_pixel_height(const ttf_font* font, float pixels);
+
+/* in font units */
+void ttf_get_glyph_hmetrics(const ttf_font* font, int glyph, int* advance, int* left_bearing);
+int ttf_get_kerning(const ttf_font* font, int left_glyph, int right_glyph);
+
+/* returns 0 for glyphs without an outline like the space */
+int ttf_get_glyph_box(const ttf_font* font, int glyph, int* x0, int* y0, int* x1, int* y1);
+
+/*
+  Size of the distance field of a glyph and its offset from the pen position on the baseline to
+  its top left corner, y pointing down. Returns 0 for empty glyphs.
+*/
+int ttf_get_glyph_sdf_size(const ttf_font* font, int glyph, float scale, int padding, int* width,
+                           int* height, int* x_offset, int* y_offset);
+
+/*
+  Renders into a bitmap of the size returned by ttf_get_glyph_sdf_size. Returns 0 on failure,
+  a malformed outline or running out of memory.
+*/
+int ttf_render_glyph_sdf(const ttf_font* font, int glyph, float scale, int padding,
+                         uint8_t on_edge, float pixel_dist_scale, uint8_t* out, int stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINY_TTF_H */
+
+#ifdef TINY_TTF_IMPLEMENTATION
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TTF_MAX_COMPOUND_DEPTH 8
+#define TTF_CURVE_STEPS 6
+/* bounds the work compound glyphs referencing each other many times can cause */
+#define TTF_MAX_EDGES (1 << 20)
+
+static uint16_t ttf__u16(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static int16_t ttf__i16(const uint8_t* p) { return (int16_t)(p[0] << 8 | p[1]); }
+static uint32_t ttf__u32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* returns 0 when the table is missing or does not lie within the data */
+static int ttf__find_table(const uint8_t* data, size_t size, const char* tag, uint32_t* offset,
+                           uint32_t* length)
+{
+  *offset = *length = 0;
+  if (size < 12)
+    return 0;
+
+  int num_tables = ttf__u16(data + 4);
+  for (int i = 0; i < num_tables; i++)
+  {
+    const uint32_t record = 12 + 16 * i;
+    if (record + 16 > size)
+      return 0;
+    if (memcmp(data + record, tag, 4) == 0)
+    {
+      uint32_t table = ttf__u32(data + record + 8);
+      uint32_t table_length = ttf__u32(data + record + 12);
+      if (table < 12 || table_length == 0 || (uint64_t)table + table_length > size)
+        return 0;
+      *offset = table;
+      *length = table_length;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void ttf__loca(const ttf_font* font, int glyph, uint32_t* start, uint32_t* end)
+{
+  const uint8_t* loca = font->data + font->loca;
+  if (font->index_to_loc_format == 0)
+  {
+    *start = ttf__u16(loca + glyph * 2) * 2u;
+    *end = ttf__u16(loca + glyph * 2 + 2) * 2u;
+  }
+  else
+  {
+    *start = ttf__u32(loca + glyph * 4);
+    *end = ttf__u32(loca + glyph * 4 + 4);
+  }
+}
+
+/* length of the cmap subtable at offset in the cmap table, 0 if it is not usable */
+static uint32_t ttf__cmap_subtable_length(const uint8_t* cmap, uint32_t cmap_length,
+                                          uint32_t offset, int format)
+{
+  if ((uint64_t)offset + 16 > cmap_length)
+    return 0;
+
+  const uint8_t* table = cmap + offset;
+  uint64_t length, needed;
+  if (format == 4)
+  {
+    int seg_count = ttf__u16(table + 6) / 2;
+    length = ttf__u16(table + 2);
+    needed = 16 + 8ull * seg_count;
+    if (seg_count == 0)
+      return 0;
+  }
+  else
+  {
+    length = ttf__u32(table + 4);
+    needed = 16 + 12ull * ttf__u32(table + 12);
+  }
+
+  if (length < needed || offset + length > cmap_length)
+    return 0;
+  return (uint32_t)length;
+}
+
+int ttf_init(ttf_font* font, const uint8_t* data, size_t size)
+{
+  memset(font, 0, sizeof(*font));
+  font->data = data;
+  font->size = size;
+
+  uint32_t cmap_length, head_length, hhea_length, hmtx_length, loca_length, maxp, maxp_length;
+  if (!ttf__find_table(data, size, "cmap", &font->cmap, &cmap_length) ||
+      !ttf__find_table(data, size, "glyf", &font->glyf, &font->glyf_length) ||
+      !ttf__find_table(data, size, "head", &font->head, &head_length) ||
+      !ttf__find_table(data, size, "hhea", &font->hhea, &hhea_length) ||
+      !ttf__find_table(data, size, "hmtx", &font->hmtx, &hmtx_length) ||
+      !ttf__find_table(data, size, "loca", &font->loca, &loca_length) ||
+      !ttf__find_table(data, size, "maxp", &maxp, &maxp_length))
+    return 0;
+  ttf__find_table(data, size, "kern", &font->kern, &font->kern_length);
+
+  if (maxp_length < 6 || head_length < 54 || hhea_length < 36)
+    return 0;
+
+  font->num_glyphs = ttf__u16(data + maxp + 4);
+  font->units_per_em = ttf__u16(data + font->head + 18);
+  font->index_to_loc_format = ttf__i16(data + font->head + 50);
+  font->ascent = ttf__i16(data + font->hhea + 4);
+  font->descent = ttf__i16(data + font->hhea + 6);
+  font->line_gap = ttf__i16(data + font->hhea + 8);
+  font->num_hmetrics = ttf__u16(data + font->hhea + 34);
+
+  if (font->num_glyphs == 0 || font->num_hmetrics == 0 || font->units_per_em == 0 ||
+      font->ascent <= font->descent ||
+      (font->index_to_loc_format != 0 && font->index_to_loc_format != 1))
+    return 0;
+
+  /* an advance for every long metric and a left side bearing for every other glyph */
+  uint64_t hmtx_needed = 4ull * font->num_hmetrics;
+  if (font->num_glyphs > font->num_hmetrics)
+    hmtx_needed += 2ull * (font->num_glyphs - font->num_hmetrics);
+  if (hmtx_needed > hmtx_length)
+    return 0;
+
+  /* every glyph lies in the glyf table and holds at least its header when it is not empty */
+  if ((uint64_t)(font->num_glyphs + 1) * (font->index_to_loc_format ? 4 : 2) > loca_length)
+    return 0;
+  for (int i = 0; i < font->num_glyphs; i++)
+  {
+    uint32_t start, end;
+    ttf__loca(font, i, &start, &end);
+    if (end < start || end > font->glyf_length || (end > start && end - start < 10))
+      return 0;
+  }
+
+  /* prefer the full unicode subtable, then the BMP one */
+  const uint8_t* cmap = data + font->cmap;
+  if (cmap_length < 4)
+    return 0;
+  int num_subtables = ttf__u16(cmap + 2);
+  if (4 + 8ull * num_subtables > cmap_length)
+    return 0;
+
+  uint32_t best = 0, best_length = 0;
+  int best_score = 0;
+  for (int i = 0; i < num_subtables; i++)
+  {
+    const uint8_t* record = cmap + 4 + 8 * i;
+    int platform = ttf__u16(record);
+    int encoding = ttf__u16(record + 2);
+    uint32_t offset = ttf__u32(record + 4);
+    if ((uint64_t)offset + 2 > cmap_length)
+      continue;
+    int format = ttf__u16(cmap + offset);
+
+    int score = 0;
+    if (format == 12 && (platform == 0 || (platform == 3 && encoding == 10)))
+      score = 3;
+    else if (format == 4 && (platform == 0 || (platform == 3 && encoding == 1)))
+      score = 2;
+
+    if (score > best_score)
+    {
+      uint32_t length = ttf__cmap_subtable_length(cmap, cmap_length, offset, format);
+      if (!length)
+        continue;
+      best_score = score;
+      best = font->cmap + offset;
+      best_length = length;
+    }
+  }
+  if (!best)
+    return 0;
+
+  font->cmap = best;
+  font->cmap_length = best_length;
+  return 1;
+}
+
+/* glyph indices past the glyph count map to the missing glyph */
+static int ttf__checked_glyph(const ttf_font* font, uint64_t glyph)
+{
+  return glyph < (uint64_t)font->num_glyphs ? (int)glyph : 0;
+}
+
+int ttf_find_glyph(const ttf_font* font, uint32_t codepoint)
+{
+  const uint8_t* table = font->data + font->cmap;
+  int format = ttf__u16(table);
+
+  if (format == 4)
+  {
+    if (codepoint > 0xffff)
+      return 0;
+
+    int seg_count = ttf__u16(table + 6) / 2;
+    const uint8_t* end_codes = table + 14;
+    const uint8_t* start_codes = end_codes + seg_count * 2 + 2;
+    const uint8_t* id_deltas = start_codes + seg_count * 2;
+    const uint8_t* id_range_offsets = id_deltas + seg_count * 2;
+
+    /* binary search for the first segment ending at or after the codepoint */
+    int lo = 0, hi = seg_count - 1;
+    while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      if (ttf__u16(end_codes + mid * 2) < codepoint)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    uint32_t start = ttf__u16(start_codes + lo * 2);
+    if (codepoint < start || codepoint > ttf__u16(end_codes + lo * 2))
+      return 0;
+
+    uint16_t delta = ttf__u16(id_deltas + lo * 2);
+    uint16_t range_offset = ttf__u16(id_range_offsets + lo * 2);
+    if (range_offset == 0)
+      return ttf__checked_glyph(font, (uint16_t)(codepoint + delta));
+
+    uint64_t glyph =
+      (uint64_t)(id_range_offsets - table) + lo * 2 + range_offset + (codepoint - start) * 2;
+    if (glyph + 2 > font->cmap_length)
+      return 0;
+    uint16_t index = ttf__u16(table + glyph);
+    return index ? ttf__checked_glyph(font, (uint16_t)(index + delta)) : 0;
+  }
+
+  if (format == 12)
+  {
+    uint32_t num_groups = ttf__u32(table + 12);
+    const uint8_t* groups = table + 16;
+
+    uint32_t lo = 0, hi = num_groups;
+    while (lo < hi)
+    {
+      uint32_t mid = (lo + hi) / 2;
+      const uint8_t* group = groups + mid * 12;
+      uint32_t start = ttf__u32(group);
+      uint32_t end = ttf__u32(group + 4);
+      if (codepoint < start)
+        hi = mid;
+      else if (codepoint > end)
+        lo = mid + 1;
+      else
+        return ttf__checked_glyph(font, (uint64_t)ttf__u32(group + 8) + codepoint - start);
+    }
+  }
+
+  return 0;
+}
+
+float ttf_scale_for_pixel_height(const ttf_font* font, float pixels)
+{
+  return pixels / (float)(font->ascent - font->descent);
+}
+
+void ttf_get_glyph_hmetrics(const ttf_font* font, int glyph, int* advance, int* left_bearing)
+{
+  const uint8_t* hmtx = font->data + font->hmtx;
+  if (glyph < 0 || glyph >= font->num_glyphs)
+  {
+    if (advance)
+      *advance = 0;
+    if (left_bearing)
+      *left_bearing = 0;
+  }
+  else if (glyph < font->num_hmetrics)
+  {
+    if (advance)
+      *advance = ttf__u16(hmtx + 4 * glyph);
+    if (left_bearing)
+      *left_bearing = ttf__i16(hmtx + 4 * glyph + 2);
+  }
+  else
+  {
+    /* monospaced tail shares the last advance */
+    if (advance)
+      *advance = ttf__u16(hmtx + 4 * (font->num_hmetrics - 1));
+    if (left_bearing)
+      *left_bearing =
+        ttf__i16(hmtx + 4 * font->num_hmetrics + 2 * (glyph - font->num_hmetrics));
+  }
+}
+
+int ttf_get_kerning(const ttf_font* font, int left_glyph, int right_glyph)
+{
+  if (!font->kern || font->kern_length < 18)
+    return 0;
+
+  const uint8_t* kern = font->data + font->kern;
+  if (ttf__u16(kern) != 0 || ttf__u16(kern + 2) < 1)
+    return 0;
+
+  /* first subtable only, horizontal format 0 */
+  const uint8_t* subtable = kern + 4;
+  if ((ttf__u16(subtable + 4) & 0xff03) != 0x0001)
+    return 0;
+
+  int num_pairs = ttf__u16(subtable + 6);
+  const uint8_t* pairs = subtable + 14;
+  if (18 + 6ull * num_pairs > font->kern_length)
+    return 0;
+  uint32_t key = ((uint32_t)left_glyph << 16) | (uint32_t)right_glyph;
+
+  int lo = 0, hi = num_pairs - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    uint32_t pair = ttf__u32(pairs + mid * 6);
+    if (key < pair)
+      hi = mid - 1;
+    else if (key > pair)
+      lo = mid + 1;
+    else
+      return ttf__i16(pairs + mid * 6 + 4);
+  }
+  return 0;
+}
+
+/* 0 for glyphs out of range, the loca entries were checked by ttf_init */
+static uint32_t ttf__glyph_offset(const ttf_font* font, int glyph, uint32_t* length)
+{
+  *length = 0;
+  if (glyph < 0 || glyph >= font->num_glyphs)
+    return 0;
+
+  uint32_t start, end;
+  ttf__loca(font, glyph, &start, &end);
+  *length = end - start;
+  return font->glyf + start;
+}
+
+int ttf_get_glyph_box(const ttf_font* font, int glyph, int* x0, int* y0, int* x1, int* y1)
+{
+  uint32_t length;
+  uint32_t offset = ttf__glyph_offset(font, glyph, &length);
+  if (!offset || length < 10)
+    return 0;
+
+  const uint8_t* g = font->data + offset;
+  *x0 = ttf__i16(g + 2);
+  *y0 = ttf__i16(g + 4);
+  *x1 = ttf__i16(g + 6);
+  *y1 = ttf__i16(g + 8);
+  return 1;
+}
+
+/* outlines are flattened into line segments in font units */
+typedef struct ttf__edges
+{
+  float* data; /* x0 y0 x1 y1 per edge */
+  int count;
+  int capacity;
+  /* set when an edge could not be stored */
+  int failed;
+} ttf__edges;
+
+static void ttf__add_edge(ttf__edges* edges, float x0, float y0, float x1, float y1)
+{
+  if (edges->failed)
+    return;
+  if (edges->count == edges->capacity)
+  {
+    int capacity = edges->capacity ? edges->capacity * 2 : 256;
+    float* data = capacity <= TTF_MAX_EDGES
+                    ? (float*)realloc(edges->data, sizeof(float) * 4 * capacity)
+                    : NULL;
+    if (!data)
+    {
+      edges->failed = 1;
+      return;
+    }
+    edges->data = data;
+    edges->capacity = capacity;
+  }
+
+  float* e = edges->data + edges->count * 4;
+  e[0] = x0;
+  e[1] = y0;
+  e[2] = x1;
+  e[3] = y1;
+  edges->count++;
+}
+
+static void ttf__add_curve(ttf__edges* edges, const float* m, float x0, float y0, float cx,
+                           float cy, float x1, float y1)
+{
+  float px = x0, py = y0;
+  for (int i = 1; i <= TTF_CURVE_STEPS; i++)
+  {
+    float t = (float)i / TTF_CURVE_STEPS;
+    float u = 1.0f - t;
+    float x = u * u * x0 + 2.0f * u * t * cx + t * t * x1;
+    float y = u * u * y0 + 2.0f * u * t * cy + t * t * y1;
+    ttf__add_edge(edges, m[0] * px + m[2] * py + m[4], m[1] * px + m[3] * py + m[5],
+                  m[0] * x + m[2] * y + m[4], m[1] * x + m[3] * y + m[5]);
+    px = x;
+    py = y;
+  }
+}
+
+/* reads a coordinate delta of a simple glyph, returns 0 when the data runs out */
+static int ttf__read_coordinate(const uint8_t** p, const uint8_t* end, uint8_t flag,
+                                uint8_t short_bit, uint8_t same_bit, int* value)
+{
+  if (flag & short_bit)
+  {
+    if (*p >= end)
+      return 0;
+    int delta = *(*p)++;
+    *value += (flag & same_bit) ? delta : -delta;
+  }
+  else if (!(flag & same_bit))
+  {
+    if (end - *p < 2)
+      return 0;
+    *value += ttf__i16(*p);
+    *p += 2;
+  }
+  return 1;
+}
+
+static int ttf__simple_glyph(const uint8_t* g, uint32_t length, const float* m,
+                             ttf__edges* edges)
+{
+  const uint8_t* end = g + length;
+  int num_contours = ttf__i16(g);
+  const uint8_t* end_points = g + 10;
+  if (num_contours == 0)
+    return 1;
+  if (10 + 2u * num_contours + 2 > length)
+    return 0;
+
+  /* contours end on increasing points */
+  for (int c = 1; c < num_contours; c++)
+  {
+    if (ttf__u16(end_points + c * 2) <= ttf__u16(end_points + (c - 1) * 2))
+      return 0;
+  }
+
+  int num_points = ttf__u16(end_points + (num_contours - 1) * 2) + 1;
+  int instruction_length = ttf__u16(end_points + num_contours * 2);
+  if (end - (end_points + num_contours * 2 + 2) < instruction_length)
+    return 0;
+  const uint8_t* p = end_points + num_contours * 2 + 2 + instruction_length;
+
+  uint8_t* flags = (uint8_t*)malloc(num_points);
+  float* xs = (float*)malloc(sizeof(float) * num_points);
+  float* ys = (float*)malloc(sizeof(float) * num_points);
+  int result = 0, value = 0, first = 0;
+  if (!flags || !xs || !ys)
+    goto done;
+
+  for (int i = 0; i < num_points;)
+  {
+    if (p >= end)
+      goto done;
+    uint8_t flag = *p++;
+    flags[i++] = flag;
+    if (flag & 8)
+    {
+      if (p >= end)
+        goto done;
+      int repeat = *p++;
+      while (repeat-- > 0 && i < num_points)
+        flags[i++] = flag;
+    }
+  }
+
+  for (int i = 0; i < num_points; i++)
+  {
+    if (!ttf__read_coordinate(&p, end, flags[i], 2, 16, &value))
+      goto done;
+    xs[i] = (float)value;
+  }
+
+  value = 0;
+  for (int i = 0; i < num_points; i++)
+  {
+    if (!ttf__read_coordinate(&p, end, flags[i], 4, 32, &value))
+      goto done;
+    ys[i] = (float)value;
+  }
+
+  for (int c = 0; c < num_contours; c++)
+  {
+    int last = ttf__u16(end_points + c * 2);
+    int count = last - first + 1;
+    if (count < 2)
+    {
+      first = last + 1;
+      continue;
+    }
+
+    /* start on an on-curve point, or on the midpoint of two off-curve points */
+    int start = -1;
+    for (int i = 0; i < count; i++)
+    {
+      if (flags[first + i] & 1)
+      {
+        start = i;
+        break;
+      }
+    }
+
+    float sx, sy;
+    if (start == -1)
+    {
+      sx = (xs[first] + xs[last]) * 0.5f;
+      sy = (ys[first] + ys[last]) * 0.5f;
+      start = 0;
+    }
+    else
+    {
+      sx = xs[first + start];
+      sy = ys[first + start];
+      start++;
+    }
+
+    float px = sx, py = sy;
+    int has_control = 0;
+    float cx = 0.0f, cy = 0.0f;
+    for (int k = 0; k <= count; k++)
+    {
+      int i = first + (start + k) % count;
+      float x = xs[i], y = ys[i];
+      int on_curve = flags[i] & 1;
+
+      /* closing point */
+      if (k == count)
+      {
+        x = sx;
+        y = sy;
+        on_curve = 1;
+      }
+
+      if (on_curve)
+      {
+        if (has_control)
+          ttf__add_curve(edges, m, px, py, cx, cy, x, y);
+        else
+          ttf__add_curve(edges, m, px, py, (px + x) * 0.5f, (py + y) * 0.5f, x, y);
+        px = x;
+        py = y;
+        has_control = 0;
+      }
+      else
+      {
+        if (has_control)
+        {
+          float mx = (cx + x) * 0.5f, my = (cy + y) * 0.5f;
+          ttf__add_curve(edges, m, px, py, cx, cy, mx, my);
+          px = mx;
+          py = my;
+        }
+        cx = x;
+        cy = y;
+        has_control = 1;
+      }
+    }
+
+    first = last + 1;
+  }
+  result = !edges->failed;
+
+done:
+  free(flags);
+  free(xs);
+  free(ys);
+  return result;
+}
+
+static int ttf__glyph_edges(const ttf_font* font, int glyph, const float* m, ttf__edges* edges,
+                            int depth)
+{
+  uint32_t length;
+  uint32_t offset = ttf__glyph_offset(font, glyph, &length);
+  if (!offset || depth > TTF_MAX_COMPOUND_DEPTH)
+    return 0;
+  if (length == 0)
+    return 1;
+
+  const uint8_t* g = font->data + offset;
+  if (ttf__i16(g) >= 0)
+    return ttf__simple_glyph(g, length, m, edges);
+
+  const uint8_t* end = g + length;
+  const uint8_t* p = g + 10;
+  int more = 1;
+  while (more)
+  {
+    if (end - p < 4)
+      return 0;
+    uint16_t flags = ttf__u16(p);
+    int component = ttf__u16(p + 2);
+    p += 4;
+
+    /* arguments, then one, two or four scale values */
+    int arguments = (flags & 1) ? 4 : 2;
+    int scales = (flags & 8) ? 2 : (flags & 0x40) ? 4 : (flags & 0x80) ? 8 : 0;
+    if (end - p < arguments + scales)
+      return 0;
+
+    float dx, dy;
+    if (flags & 1)
+    {
+      dx = ttf__i16(p);
+      dy = ttf__i16(p + 2);
+    }
+    else
+    {
+      dx = (int8_t)p[0];
+      dy = (int8_t)p[1];
+    }
+    p += arguments;
+    /* matching points instead of offsets are not supported */
+    if (!(flags & 2))
+      dx = dy = 0.0f;
+
+    float a = 1.0f, b = 0.0f, c = 0.0f, d = 1.0f;
+    if (flags & 8)
+    {
+      a = d = ttf__i16(p) / 16384.0f;
+    }
+    else if (flags & 0x40)
+    {
+      a = ttf__i16(p) / 16384.0f;
+      d = ttf__i16(p + 2) / 16384.0f;
+    }
+    else if (flags & 0x80)
+    {
+      a = ttf__i16(p) / 16384.0f;
+      b = ttf__i16(p + 2) / 16384.0f;
+      c = ttf__i16(p + 4) / 16384.0f;
+      d = ttf__i16(p + 6) / 16384.0f;
+    }
+    p += scales;
+
+    /* parent * component */
+    float cm[6];
+    cm[0] = m[0] * a + m[2] * b;
+    cm[1] = m[1] * a + m[3] * b;
+    cm[2] = m[0] * c + m[2] * d;
+    cm[3] = m[1] * c + m[3] * d;
+    cm[4] = m[0] * dx + m[2] * dy + m[4];
+    cm[5] = m[1] * dx + m[3] * dy + m[5];
+
+    /* the component index is checked by ttf__glyph_offset */
+    if (!ttf__glyph_edges(font, component, cm, edges, depth + 1))
+      return 0;
+
+    more = flags & 0x20;
+  }
+
+  return 1;
+}
+
+int ttf_get_glyph_sdf_size(const ttf_font* font, int glyph, float scale, int padding, int* width,
+                           int* height, int* x_offset, int* y_offset)
+{
+  int x0, y0, x1, y1;
+  if (!ttf_get_glyph_box(font, glyph, &x0, &y0, &x1, &y1) || x1 <= x0 || y1 <= y0)
+    return 0;
+
+  int ix0 = (int)floorf(x0 * scale) - padding;
+  int iy0 = (int)floorf(-y1 * scale) - padding;
+  int ix1 = (int)ceilf(x1 * scale) + padding;
+  int iy1 = (int)ceilf(-y0 * scale) + padding;
+
+  *width = ix1 - ix0;
+  *height = iy1 - iy0;
+  *x_offset = ix0;
+  *y_offset = iy0;
+  return 1;
+}
+
+int ttf_render_glyph_sdf(const ttf_font* font, int glyph, float scale, int padding,
+                         uint8_t on_edge, float pixel_dist_scale, uint8_t* out, int stride)
+{
+  int width, height, x_offset, y_offset;
+  if (!ttf_get_glyph_sdf_size(font, glyph, scale, padding, &width, &height, &x_offset,
+                              &y_offset))
+    return 0;
+
+  /* font units straight to bitmap pixels, y flipped */
+  const float m[6] = { scale, 0.0f, 0.0f, -scale, 0.0f, 0.0f };
+
+  ttf__edges edges = { NULL, 0, 0, 0 };
+  if (!ttf__glyph_edges(font, glyph, m, &edges, 0))
+  {
+    free(edges.data);
+    return 0;
+  }
+
+  for (int j = 0; j < height; j++)
+  {
+    float py = y_offset + j + 0.5f;
+    for (int i = 0; i < width; i++)
+    {
+      float px = x_offset + i + 0.5f;
+
+      float best = 1e30f;
+      int winding = 0;
+      for (int e = 0; e < edges.count; e++)
+      {
+        const float* s = edges.data + e * 4;
+        float ex = s[2] - s[0], ey = s[3] - s[1];
+        float wx = px - s[0], wy = py - s[1];
+
+        float len = ex * ex + ey * ey;
+        float t = len > 0.0f ? (wx * ex + wy * ey) / len : 0.0f;
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        float dx = wx - ex * t, dy = wy - ey * t;
+        float dist = dx * dx + dy * dy;
+        if (dist < best)
+          best = dist;
+
+        /* nonzero winding of a ray towards +x */
+        if ((s[1] <= py) != (s[3] <= py))
+        {
+          float cross_x = s[0] + (py - s[1]) / ey * ex;
+          if (cross_x > px)
+            winding += s[3] > s[1] ? 1 : -1;
+        }
+      }
+
+      float dist = sqrtf(best);
+      if (winding == 0)
+        dist = -dist;
+
+      float value = on_edge + dist * pixel_dist_scale;
+      value = value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+      out[j * stride + i] = (uint8_t)(value + 0.5f);
+    }
+  }
+
+  free(edges.data);
+  return 1;
+}
+
+#endif /* TINY_TTF_IMPLEMENTATION */
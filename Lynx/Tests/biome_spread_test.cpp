@@ -0,0 +1,228 @@
+#include <Lynx/biome_spread.h>
+#include <Lynx/random.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "test.h"
+
+// not a multiple of the chunk size, so the last chunks are cut by the world edge
+constexpr const int32_t WORLD_WIDTH = 200;
+constexpr const int32_t WORLD_HEIGHT = 150;
+
+enum TestTileType : uint16_t
+{
+  TYPE_STONE = 1,
+  TYPE_GRASS,
+  TYPE_SAND,
+  TYPE_CORRUPT_STONE,
+  TYPE_CORRUPT_GRASS,
+  TYPE_HALLOWED_STONE,
+};
+
+static void createTestWorld(TileStore& store)
+{
+  store = createTileStore(WORLD_WIDTH, WORLD_HEIGHT);
+  for (uint16_t type = TYPE_STONE; type <= TYPE_HALLOWED_STONE; type++)
+    setTileTypeFlags(store, type, TILE_SOLID);
+
+  RandomStream stream = createRandomStream(7);
+  for (int32_t y = 0; y < WORLD_HEIGHT; y++)
+  {
+    for (int32_t x = 0; x < WORLD_WIDTH; x++)
+    {
+      const uint32_t pick = nextRandomBelow(stream, 100);
+      Tile tile;
+      tile.type = TYPE_STONE;
+      if (pick < 25)
+        tile.type = TYPE_GRASS;
+      else if (pick < 40)
+        tile.type = TYPE_SAND;
+      else if (pick < 42)
+        tile.type = TYPE_CORRUPT_STONE;
+      else if (pick < 44)
+        tile.type = TYPE_HALLOWED_STONE;
+      // a fifth are inactive, their type must not count
+      tile.flags = pick % 5 ? TILE_ACTIVE | TILE_SOLID : TILE_SOLID;
+      setTile(store, x, y, tile);
+    }
+  }
+  compressTileStore(store);
+}
+
+static void createTestSpread(BiomeSpread& spread, TileStore& store, JobSystem& jobs)
+{
+  createBiomeSpread(spread, store, jobs, 1234, 2);
+  setBiomeConversion(spread, 0, TYPE_STONE, TYPE_CORRUPT_STONE);
+  setBiomeConversion(spread, 0, TYPE_GRASS, TYPE_CORRUPT_GRASS);
+  setBiomeConversion(spread, 0, TYPE_HALLOWED_STONE, TYPE_CORRUPT_STONE);
+  setBiomeConversion(spread, 1, TYPE_STONE, TYPE_HALLOWED_STONE);
+  setBiomeInfecting(spread, 0, TYPE_CORRUPT_STONE);
+  setBiomeInfecting(spread, 0, TYPE_CORRUPT_GRASS);
+  setBiomeInfecting(spread, 1, TYPE_HALLOWED_STONE);
+}
+
+// Types of the active tiles, 0 for inactive ones.
+static std::vector<uint16_t> getActiveTypes(const TileStore& store)
+{
+  std::vector<uint16_t> types((size_t)WORLD_WIDTH * WORLD_HEIGHT);
+  for (int32_t y = 0; y < WORLD_HEIGHT; y++)
+  {
+    for (int32_t x = 0; x < WORLD_WIDTH; x++)
+    {
+      if (getTileFlags(store, x, y) & TILE_ACTIVE)
+        types[y * WORLD_WIDTH + x] = getTileType(store, x, y);
+    }
+  }
+  return types;
+}
+
+static uint16_t getConversion(const BiomeSpread& spread, uint32_t biome, uint16_t type)
+{
+  return spread.conversions[(size_t)biome * TILE_TYPE_COUNT + type];
+}
+
+// One tick of spreading, tile by tile: a tile converts when a neighbour infects with a biome
+// that converts it, the lowest such biome, and the chance bit of its chunk for the tick is set.
+static std::vector<uint16_t> spreadReference(const BiomeSpread& spread,
+                                             const std::vector<uint16_t>& types)
+{
+  const TileStore& store = *spread.store;
+  std::vector<uint16_t> result = types;
+  for (int32_t y = 0; y < WORLD_HEIGHT; y++)
+  {
+    for (int32_t x = 0; x < WORLD_WIDTH; x++)
+    {
+      const uint16_t type = types[y * WORLD_WIDTH + x];
+      if (!type)
+        continue;
+
+      uint32_t biome = 0;
+      for (; biome < spread.biomeCount; biome++)
+      {
+        if (getConversion(spread, biome, type) == BIOME_NO_CONVERSION)
+          continue;
+        bool reached = false;
+        for (int32_t dy = -1; dy <= 1; dy++)
+        {
+          for (int32_t dx = -1; dx <= 1; dx++)
+          {
+            const int32_t nx = x + dx, ny = y + dy;
+            if (!isInTileStore(store, nx, ny) || !types[ny * WORLD_WIDTH + nx])
+              continue;
+            reached |= spread.infectingBiomes[types[ny * WORLD_WIDTH + nx]] == biome + 1;
+          }
+        }
+        if (reached)
+          break;
+      }
+      if (biome == spread.biomeCount)
+        continue;
+
+      const uint32_t chunk =
+        (uint32_t)((y >> TILE_CHUNK_SHIFT) * store.chunksX + (x >> TILE_CHUNK_SHIFT));
+      RandomStream stream = createRandomStream(spread.seed, spread.pass, chunk, spread.tick);
+      uint32_t chance = ~0u;
+      for (uint32_t n = 0; n < spread.spreadShift; n++)
+      {
+        for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+        {
+          const uint32_t word = nextRandom(stream);
+          if (row == (y & TILE_CHUNK_MASK))
+            chance &= word;
+        }
+      }
+      if (chance >> (x & TILE_CHUNK_MASK) & 1)
+        result[y * WORLD_WIDTH + x] = getConversion(spread, biome, type);
+    }
+  }
+  return result;
+}
+
+// The bitboard spread converts the same tiles as the reference, every tick.
+static void testSpreadMatchesReference()
+{
+  for (uint32_t spreadShift : { 0u, 1u, 3u })
+  {
+    JobSystem jobs;
+    createJobSystem(jobs, 4);
+    TileStore store;
+    createTestWorld(store);
+    BiomeSpread spread;
+    createTestSpread(spread, store, jobs);
+    spread.spreadShift = spreadShift;
+
+    bool same = true, converted = false;
+    for (uint32_t tick = 0; tick < 8; tick++)
+    {
+      const std::vector<uint16_t> before = getActiveTypes(store);
+      const std::vector<uint16_t> expected = spreadReference(spread, before);
+      const BiomeSpreadStats& stats = updateBiomeSpread(spread);
+      same &= getActiveTypes(store) == expected;
+      converted |= stats.converted != 0;
+    }
+    CHECK(same);
+    CHECK(converted);
+
+    destroyBiomeSpread(spread);
+    destroyJobSystem(jobs);
+  }
+}
+
+// Stripes convert what the biome of the first stripe covering a tile converts.
+static void testStripesMatchReference()
+{
+  JobSystem jobs;
+  createJobSystem(jobs, 4);
+  TileStore store;
+  createTestWorld(store);
+  BiomeSpread spread;
+  createTestSpread(spread, store, jobs);
+
+  const BiomeStripe stripes[] = {
+    { 1, 100, 0, 40, 149, 12 },
+    { 0, 60, 10, 190, 120, 20 },
+    { 0, 0, 75, 199, 75, 3 },
+  };
+  std::vector<uint16_t> expected = getActiveTypes(store);
+  for (int32_t y = 0; y < WORLD_HEIGHT; y++)
+  {
+    for (int32_t x = 0; x < WORLD_WIDTH; x++)
+    {
+      uint16_t& type = expected[y * WORLD_WIDTH + x];
+      for (const BiomeStripe& stripe : stripes)
+      {
+        if (!type || y < std::min(stripe.y0, stripe.y1) || y > std::max(stripe.y0, stripe.y1))
+          continue;
+        int32_t left = std::min(stripe.x0, stripe.x1), right = std::max(stripe.x0, stripe.x1);
+        if (stripe.y0 != stripe.y1)
+        {
+          const double t = (double)(y - stripe.y0) / (stripe.y1 - stripe.y0);
+          left = right = (int32_t)std::lround(stripe.x0 + (stripe.x1 - stripe.x0) * t);
+        }
+        if (x < left - stripe.halfWidth || x > right + stripe.halfWidth)
+          continue;
+        const uint16_t to = getConversion(spread, stripe.biome, type);
+        if (to == BIOME_NO_CONVERSION)
+          continue;
+        type = to;
+        break;
+      }
+    }
+  }
+
+  convertBiomeStripes(spread, stripes, (uint32_t)(sizeof(stripes) / sizeof(stripes[0])));
+  CHECK(getActiveTypes(store) == expected);
+
+  destroyBiomeSpread(spread);
+  destroyJobSystem(jobs);
+}
+
+int main()
+{
+  testSpreadMatchesReference();
+  testStripesMatchReference();
+  return getTestResult();
+}
@@ -0,0 +1,99 @@
+#include <Lynx/noise.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "test.h"
+
+static std::vector<NoiseSettings> getTestSettings()
+{
+  std::vector<NoiseSettings> settings;
+  for (NoiseType type : { NOISE_VALUE, NOISE_PERLIN, NOISE_SIMPLEX })
+  {
+    for (NoiseFractal fractal : { NOISE_FRACTAL_NONE, NOISE_FRACTAL_FBM, NOISE_FRACTAL_RIDGED })
+    {
+      for (float warpAmplitude : { 0.0f, 24.0f })
+      {
+        NoiseSettings s;
+        s.type = type;
+        s.fractal = fractal;
+        s.seed = 0x1234567u + (uint32_t)settings.size();
+        s.frequency = 1.0f / 37.0f;
+        s.warpAmplitude = warpAmplitude;
+        settings.push_back(s);
+      }
+    }
+  }
+  return settings;
+}
+
+// Every path the CPU runs gives the scalar noise within NOISE_PATH_EPSILON.
+static void testPathsMatchScalar()
+{
+  for (const NoiseSettings& settings : getTestSettings())
+  {
+    for (NoisePath path : { NOISE_PATH_SSE2, NOISE_PATH_AVX2 })
+    {
+      // an odd width leaves a partial group at the end of every row
+      const NoiseBenchmark benchmark = benchmarkNoise(settings, path, 67, 29);
+      CHECK(benchmark.path <= getNoisePath());
+      CHECK(benchmark.matchesScalar);
+    }
+  }
+}
+
+// Batches of points and rects give the noise of the single sample function at each tile.
+static void testBatchesMatchPoints()
+{
+  for (const NoiseSettings& settings : getTestSettings())
+  {
+    const int32_t x0 = -45, y0 = 1000, width = 19, height = 3;
+    std::vector<float> x, y;
+    for (int32_t row = 0; row < height; row++)
+    {
+      for (int32_t column = 0; column < width; column++)
+      {
+        x.push_back((float)(x0 + column));
+        y.push_back((float)(y0 + row));
+      }
+    }
+
+    for (NoisePath path : { NOISE_PATH_SCALAR, NOISE_PATH_SSE2, NOISE_PATH_AVX2 })
+    {
+      std::vector<float> points(x.size()), rect(x.size());
+      sampleNoise(settings, x.data(), y.data(), points.data(), (uint32_t)x.size(), path);
+      fillNoiseRect(settings, x0, y0, width, height, rect.data(), path);
+
+      bool close = true, inRange = true;
+      for (size_t i = 0; i < x.size(); i++)
+      {
+        const float expected = sampleNoise(settings, x[i], y[i]);
+        close &= std::fabs(points[i] - expected) <= NOISE_PATH_EPSILON;
+        close &= std::fabs(rect[i] - expected) <= NOISE_PATH_EPSILON;
+        inRange &= std::fabs(expected) <= 1.5f;
+      }
+      CHECK(close);
+      CHECK(inRange);
+    }
+  }
+}
+
+// The same settings give the same noise, another seed other noise.
+static void testSeeds()
+{
+  NoiseSettings settings;
+  settings.fractal = NOISE_FRACTAL_FBM;
+  const float a = sampleNoise(settings, 100.5f, -20.25f);
+  CHECK(sampleNoise(settings, 100.5f, -20.25f) == a);
+  settings.seed++;
+  CHECK(sampleNoise(settings, 100.5f, -20.25f) != a);
+}
+
+int main()
+{
+  testPathsMatchScalar();
+  testBatchesMatchPoints();
+  testSeeds();
+  return getTestResult();
+}
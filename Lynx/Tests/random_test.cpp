@@ -0,0 +1,108 @@
+#include <Lynx/random.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "test.h"
+
+static bool blocksEqual(const uint32_t a[4], const uint32_t b[4])
+{
+  return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+}
+
+// Known answers of Philox4x32-10 from its reference implementation, the counter is
+// (block low, block high, chunk, tick).
+static void testKnownAnswers()
+{
+  const uint32_t zeroKey[2] = { 0, 0 };
+  const uint32_t zeroExpected[4] = { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 };
+  uint32_t out[4];
+  generateRandomBlock(zeroKey, 0, 0, 0, out);
+  CHECK(blocksEqual(out, zeroExpected));
+
+  const uint32_t onesKey[2] = { 0xffffffff, 0xffffffff };
+  const uint32_t onesExpected[4] = { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd };
+  generateRandomBlock(onesKey, UINT64_MAX, 0xffffffff, 0xffffffff, out);
+  CHECK(blocksEqual(out, onesExpected));
+
+  const uint32_t piKey[2] = { 0xa4093822, 0x299f31d0 };
+  const uint32_t piExpected[4] = { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 };
+  generateRandomBlock(piKey, 0x85a308d3243f6a88ull, 0x13198a2e, 0x03707344, out);
+  CHECK(blocksEqual(out, piExpected));
+}
+
+static std::vector<uint32_t> drawRandom(RandomStream stream, uint32_t count)
+{
+  std::vector<uint32_t> words(count);
+  for (uint32_t& word : words)
+    word = nextRandom(stream);
+  return words;
+}
+
+// The same seed, pass, chunk and tick give the same stream, changing any of them another one.
+static void testStreamKeys()
+{
+  const RandomStream stream = createRandomStream(1234, 2, 56, 78);
+  const std::vector<uint32_t> words = drawRandom(stream, 64);
+  CHECK(drawRandom(createRandomStream(1234, 2, 56, 78), 64) == words);
+
+  CHECK(drawRandom(createRandomStream(1235, 2, 56, 78), 64) != words);
+  CHECK(drawRandom(createRandomStream(1234, 3, 56, 78), 64) != words);
+  CHECK(drawRandom(createRandomStream(1234, 2, 57, 78), 64) != words);
+  CHECK(drawRandom(createRandomStream(1234, 2, 56, 79), 64) != words);
+
+  // block n is word 4n of the stream, computed without the blocks before it
+  for (uint64_t block : { 0ull, 1ull, 7ull, 15ull })
+  {
+    uint32_t out[4];
+    generateRandomBlock(stream.key, block, stream.chunk, stream.tick, out);
+    CHECK(blocksEqual(out, &words[block * 4]));
+  }
+}
+
+// Batch fills equal the scalar calls, from every position within a block and for counts that
+// end inside the vector width.
+static void testBatchFills()
+{
+  for (uint32_t skip = 0; skip < 4; skip++)
+  {
+    for (uint32_t count : { 0u, 1u, 3u, 4u, 5u, 31u, 32u, 33u, 100u, 257u, 1000u })
+    {
+      RandomStream scalar = createRandomStream(99, 1, 3, 5);
+      for (uint32_t i = 0; i < skip; i++)
+        nextRandom(scalar);
+      RandomStream batch = scalar;
+
+      std::vector<uint32_t> words(count);
+      fillRandom(batch, words.data(), count);
+      bool same = true;
+      for (uint32_t i = 0; i < count; i++)
+        same &= words[i] == nextRandom(scalar);
+      CHECK(same);
+      // both continue from the same word
+      CHECK(nextRandom(batch) == nextRandom(scalar));
+
+      std::vector<float> floats(count);
+      fillRandomFloats(batch, floats.data(), count);
+      same = true;
+      for (uint32_t i = 0; i < count; i++)
+        same &= floats[i] == nextRandomFloat(scalar);
+      CHECK(same);
+
+      fillRandomBelow(batch, words.data(), count, 1000);
+      same = true;
+      for (uint32_t i = 0; i < count; i++)
+        same &= words[i] == nextRandomBelow(scalar, 1000);
+      CHECK(same);
+      CHECK(nextRandom(batch) == nextRandom(scalar));
+    }
+  }
+}
+
+int main()
+{
+  testKnownAnswers();
+  testStreamKeys();
+  testBatchFills();
+  return getTestResult();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+
+// A failed check prints its expression and the checks after it still run, main returns
+// getTestResult().
+inline int testFailures = 0;
+
+#define CHECK(expression)                                                                        \
+  do                                                                                             \
+  {                                                                                              \
+    if (!(expression))                                                                           \
+    {                                                                                            \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expression);        \
+      testFailures++;                                                                            \
+    }                                                                                            \
+  } while (0)
+
+inline int getTestResult()
+{
+  if (testFailures)
+    std::fprintf(stderr, "%d checks failed\n", testFailures);
+  return testFailures ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include <Lynx/random.h>
+#include <Lynx/tile_index.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "test.h"
+
+constexpr const int32_t WORLD_WIDTH = 200;
+constexpr const int32_t WORLD_HEIGHT = 150;
+constexpr const uint16_t TYPE_STONE = 1;
+constexpr const uint16_t TYPE_DIRT = 2;
+constexpr const uint16_t TYPE_ALTAR = 3;
+
+static uint64_t countTilesReference(const TileStore& store, uint16_t type, int32_t x0,
+                                    int32_t y0, int32_t x1, int32_t y1)
+{
+  uint64_t count = 0;
+  for (int32_t y = std::max(y0, 0); y < std::min(y1, WORLD_HEIGHT); y++)
+  {
+    for (int32_t x = std::max(x0, 0); x < std::min(x1, WORLD_WIDTH); x++)
+      count += getTileType(store, x, y) == type && (getTileFlags(store, x, y) & TILE_ACTIVE);
+  }
+  return count;
+}
+
+static void writeRandomTile(TileStore& store, RandomStream& stream)
+{
+  const int32_t x = (int32_t)nextRandomBelow(stream, WORLD_WIDTH);
+  const int32_t y = (int32_t)nextRandomBelow(stream, WORLD_HEIGHT);
+  const uint16_t type = (uint16_t)(TYPE_STONE + nextRandomBelow(stream, 3));
+  switch (nextRandomBelow(stream, 5))
+  {
+  case 0:
+  {
+    Tile tile;
+    tile.type = type;
+    tile.flags = nextRandomBelow(stream, 4) ? TILE_ACTIVE : 0;
+    setTile(store, x, y, tile);
+    break;
+  }
+  case 1:
+    setTileType(store, x, y, type);
+    break;
+  case 2:
+    removeTile(store, x, y);
+    break;
+  case 3:
+    setTileWall(store, x, y, 5);
+    break;
+  default:
+    setTileLiquid(store, x, y, 255, 1);
+    break;
+  }
+}
+
+// Counts kept by single tile writes, and by counting chunks written in bulk again, match the
+// tiles in the store.
+static void testCountsMatchStore()
+{
+  JobSystem jobs;
+  createJobSystem(jobs, 4);
+  TileStore store = createTileStore(WORLD_WIDTH, WORLD_HEIGHT);
+  RandomStream stream = createRandomStream(3);
+  for (uint32_t n = 0; n < 4000; n++)
+    writeRandomTile(store, stream);
+  compressTileStore(store);
+
+  TileIndex index;
+  createTileIndex(index, store, jobs);
+  setTileTypeIndexed(index, TYPE_ALTAR);
+  countTilesInWorld(index, TYPE_STONE);
+
+  bool same = true, noRefresh = true;
+  for (uint32_t round = 0; round < 40; round++)
+  {
+    for (uint32_t n = 0; n < 50; n++)
+      writeRandomTile(store, stream);
+    noRefresh &= refreshTileIndex(index).refreshedChunks == 0;
+    if (round % 10 == 9)
+    {
+      Tile tile;
+      tile.type = TYPE_DIRT;
+      tile.flags = TILE_ACTIVE;
+      fillTiles(store, 20 * (int32_t)round / 10, 30, 100, 70, tile);
+    }
+
+    for (uint16_t type = TYPE_STONE; type <= TYPE_ALTAR; type++)
+    {
+      same &= countTilesInWorld(index, type) ==
+              countTilesReference(store, type, 0, 0, WORLD_WIDTH, WORLD_HEIGHT);
+      const int32_t x0 = (int32_t)nextRandomBelow(stream, WORLD_WIDTH) - 20;
+      const int32_t y0 = (int32_t)nextRandomBelow(stream, WORLD_HEIGHT) - 20;
+      const int32_t x1 = x0 + (int32_t)nextRandomBelow(stream, 120);
+      const int32_t y1 = y0 + (int32_t)nextRandomBelow(stream, 90);
+      same &= countTilesInRect(index, type, x0, y0, x1, y1) ==
+              countTilesReference(store, type, x0, y0, x1, y1);
+    }
+
+    uint64_t altars = 0;
+    bool altarsFound = true;
+    forEachIndexedTile(index, TYPE_ALTAR,
+                       [&](int32_t x, int32_t y)
+                       {
+                         altars++;
+                         altarsFound &= getTileType(store, x, y) == TYPE_ALTAR &&
+                                        (getTileFlags(store, x, y) & TILE_ACTIVE);
+                       });
+    same &= altarsFound &&
+            altars == countTilesReference(store, TYPE_ALTAR, 0, 0, WORLD_WIDTH, WORLD_HEIGHT);
+  }
+  CHECK(same);
+  CHECK(noRefresh);
+
+  destroyTileIndex(index);
+  destroyJobSystem(jobs);
+}
+
+static void loadStoneChunk(void* userData, TileStore& store, uint32_t slot)
+{
+  (*(uint32_t*)userData)++;
+  TileChunkEncoding packed;
+  packed.format = TILE_CHUNK_UNIFORM;
+  packed.palette.push_back({ TYPE_STONE, TILE_ACTIVE, 0, 0 });
+  installTileChunk(store, slot, std::move(packed));
+}
+
+// Queries count the chunks loaded so far and load none themselves.
+static void testUnloadedChunksStayUnloaded()
+{
+  JobSystem jobs;
+  createJobSystem(jobs, 2);
+  TileStore store = createTileStore(WORLD_WIDTH, WORLD_HEIGHT);
+  uint32_t loads = 0;
+  setTileChunkLoader(store, loadStoneChunk, &loads);
+  loadTileChunk(store, getTileChunkSlot(store, 0, 0));
+  loadTileChunk(store, getTileChunkSlot(store, 40, 0));
+
+  TileIndex index;
+  createTileIndex(index, store, jobs);
+  const uint64_t chunkTiles = TILE_CHUNK_SIZE * TILE_CHUNK_SIZE;
+  CHECK(countTilesInWorld(index, TYPE_STONE) == 2 * chunkTiles);
+  CHECK(countTilesInRect(index, TYPE_STONE, 0, 0, WORLD_WIDTH, WORLD_HEIGHT) == 2 * chunkTiles);
+  // partly covering both loaded chunks and many unloaded ones
+  CHECK(countTilesInRect(index, TYPE_STONE, 10, 5, 150, 120) ==
+        (uint64_t)(TILE_CHUNK_SIZE - 10 + TILE_CHUNK_SIZE) * (TILE_CHUNK_SIZE - 5));
+  CHECK(loads == 2);
+
+  // a write loads its chunk, which is counted from then on
+  removeTile(store, 100, 100);
+  CHECK(loads == 3);
+  CHECK(countTilesInWorld(index, TYPE_STONE) == 3 * chunkTiles - 1);
+
+  destroyTileIndex(index);
+  destroyJobSystem(jobs);
+}
+
+int main()
+{
+  testCountsMatchStore();
+  testUnloadedChunksStayUnloaded();
+  return getTestResult();
+}
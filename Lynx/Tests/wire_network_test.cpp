@@ -0,0 +1,145 @@
+#include <Lynx/random.h>
+#include <Lynx/wire_network.h>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+constexpr const int32_t WORLD_WIDTH = 256;
+constexpr const int32_t WORLD_HEIGHT = 160;
+constexpr const uint16_t TYPE_STONE = 1;
+constexpr const uint16_t TYPE_LAMP = 2;
+
+static void onLampsHit(void*, TileStore&, uint16_t, const WireHit*, uint32_t)
+{
+}
+
+// Wires, lamps or actuators on a few tiles of a small rect, or their removal.
+static void editTestWorld(TileStore& store, RandomStream& stream)
+{
+  const int32_t x0 = (int32_t)nextRandomBelow(stream, WORLD_WIDTH - 8);
+  const int32_t y0 = (int32_t)nextRandomBelow(stream, WORLD_HEIGHT - 8);
+  for (uint32_t n = 0; n < 12; n++)
+  {
+    const int32_t x = x0 + (int32_t)nextRandomBelow(stream, 8);
+    const int32_t y = y0 + (int32_t)nextRandomBelow(stream, 8);
+    Tile tile = getTile(store, x, y);
+    const uint32_t pick = nextRandomBelow(stream, 10);
+    if (pick < 5)
+      tile.wires |= (uint8_t)(1u << nextRandomBelow(stream, WIRE_COLOR_COUNT));
+    else if (pick < 8)
+      tile.wires &= (uint8_t)~(1u << nextRandomBelow(stream, WIRE_COLOR_COUNT));
+    else if (pick < 9)
+    {
+      tile.type = tile.type == TYPE_LAMP ? TYPE_STONE : TYPE_LAMP;
+      tile.flags = TILE_ACTIVE;
+    }
+    else
+    {
+      tile.actuator = !tile.actuator;
+      tile.flags = TILE_ACTIVE;
+    }
+    setTile(store, x, y, tile);
+  }
+}
+
+// Positions of the components of every net, keyed by the first tile and color of the net.
+static std::map<std::pair<uint32_t, uint32_t>, std::vector<std::pair<int32_t, int32_t>>>
+getTestNets(const WireNetwork& network, bool& consistent)
+{
+  std::map<uint32_t, std::pair<uint32_t, uint32_t>> firstTiles;
+  std::map<std::pair<uint32_t, uint32_t>, std::vector<std::pair<int32_t, int32_t>>> nets;
+  for (int32_t y = 0; y < WORLD_HEIGHT; y++)
+  {
+    for (int32_t x = 0; x < WORLD_WIDTH; x++)
+    {
+      for (uint32_t color = 0; color < WIRE_COLOR_COUNT; color++)
+      {
+        const uint32_t net = getWireNet(network, x, y, color);
+        if (net == WIRE_NO_NET)
+          continue;
+        consistent &= network.nets[net].first != WIRE_NO_NET;
+        if (firstTiles.count(net))
+          continue;
+        const std::pair<uint32_t, uint32_t> key = { (uint32_t)(y * WORLD_WIDTH + x), color };
+        firstTiles[net] = key;
+        const WireNet& wireNet = network.nets[net];
+        for (uint32_t i = wireNet.first; i < wireNet.first + wireNet.count; i++)
+        {
+          const WireComponent& component = network.components[network.netComponents[i]];
+          nets[key].push_back({ component.x, component.y });
+        }
+      }
+    }
+  }
+  return nets;
+}
+
+// A network compiled around the chunks edited each tick has the nets, and the components of
+// every net in the same order, as one compiled in full.
+static void testCompileAroundMatchesFull()
+{
+  JobSystem jobs;
+  createJobSystem(jobs, 4);
+  TileStore store = createTileStore(WORLD_WIDTH, WORLD_HEIGHT);
+  setTileTypeFlags(store, TYPE_STONE, TILE_SOLID);
+
+  RandomStream stream = createRandomStream(11);
+  // long wires across many chunks, so edits cut and join nets reaching far away
+  for (int32_t x = 2; x < WORLD_WIDTH - 2; x++)
+  {
+    for (int32_t y : { 40, 41, 120 })
+    {
+      Tile tile = getTile(store, x, y);
+      tile.wires = (uint8_t)(y == 120 ? TILE_WIRE_RED | TILE_WIRE_BLUE : TILE_WIRE_RED);
+      setTile(store, x, y, tile);
+    }
+  }
+  for (uint32_t n = 0; n < 200; n++)
+    editTestWorld(store, stream);
+
+  WireNetwork network;
+  createWireNetwork(network, store, jobs);
+  setWireHandler(network, TYPE_LAMP, onLampsHit, nullptr);
+  updateWireNetwork(network);
+
+  bool same = true, consistent = true, aroundOnly = false;
+  for (uint32_t tick = 0; tick < 150; tick++)
+  {
+    if (tick % 10)
+      editTestWorld(store, stream);
+    else
+    {
+      // a cut on the edge of a chunk leaves the wire beyond it with no tile in the chunk
+      const int32_t x = (int32_t)(tick / 10 % 8 + 1) * TILE_CHUNK_SIZE - (int32_t)(tick / 10 % 2);
+      Tile tile = getTile(store, x, 120);
+      tile.wires ^= TILE_WIRE_BLUE;
+      setTile(store, x, 120, tile);
+    }
+    const WireNetworkStats& stats = updateWireNetwork(network);
+    aroundOnly |= stats.changedChunks && !stats.compiled;
+
+    WireNetwork full;
+    createWireNetwork(full, store, jobs);
+    setWireHandler(full, TYPE_LAMP, onLampsHit, nullptr);
+    updateWireNetwork(full);
+    same &= getTestNets(network, consistent) == getTestNets(full, consistent);
+    same &= stats.nets == full.stats.nets && stats.components == full.stats.components;
+    destroyWireNetwork(full);
+  }
+  CHECK(same);
+  CHECK(consistent);
+  CHECK(aroundOnly);
+
+  destroyWireNetwork(network);
+  destroyJobSystem(jobs);
+}
+
+int main()
+{
+  testCompileAroundMatchesFull();
+  return getTestResult();
+}
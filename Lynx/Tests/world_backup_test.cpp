@@ -0,0 +1,123 @@
+#include <Lynx/world_backup.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+// 30 x 30 chunks, each one different from all others
+constexpr const int32_t WORLD_WIDTH = 30 * TILE_CHUNK_SIZE;
+constexpr const int32_t WORLD_HEIGHT = 30 * TILE_CHUNK_SIZE;
+constexpr const uint32_t CHANGED_CHUNKS = 9;
+
+static void createTestWorld(TileStore& store)
+{
+  store = createTileStore(WORLD_WIDTH, WORLD_HEIGHT);
+  Tile tile;
+  tile.type = 1;
+  tile.flags = TILE_ACTIVE;
+  fillTiles(store, 0, 0, WORLD_WIDTH, WORLD_HEIGHT, tile);
+  for (int32_t cy = 0; cy < store.chunksY; cy++)
+  {
+    for (int32_t cx = 0; cx < store.chunksX; cx++)
+    {
+      tile.type = (uint16_t)(2 + cy * store.chunksX + cx);
+      for (int32_t i = 0; i < 8; i++)
+        setTile(store, cx * TILE_CHUNK_SIZE + i * 3, cy * TILE_CHUNK_SIZE + i, tile);
+    }
+  }
+}
+
+static bool sameWorld(const TileStore& store, const std::string& path)
+{
+  WorldFile file = openWorldFile(path);
+  TileStore loaded = createTileStoreFromWorldFile(file);
+  bool same = loaded.width == store.width && loaded.height == store.height;
+  for (int32_t y = 0; same && y < store.height; y++)
+  {
+    for (int32_t x = 0; x < store.width; x++)
+    {
+      const Tile a = getTile(store, x, y), b = getTile(loaded, x, y);
+      same &= a.type == b.type && a.flags == b.flags && a.liquid == b.liquid &&
+              packTileAttributes(a) == packTileAttributes(b);
+    }
+  }
+  closeWorldFile(file);
+  return same;
+}
+
+// Two backups share the chunks that did not change, restore what was saved, and collecting
+// garbage after deleting the first backup keeps everything the second one refers to.
+static void testBackupRestoreCollect()
+{
+  const std::filesystem::path root =
+    std::filesystem::temp_directory_path() / "lynx_world_backup_test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  const std::string firstPath = (root / "first.lwf").string();
+  const std::string secondPath = (root / "second.lwf").string();
+  const std::string restoredPath = (root / "restored.lwf").string();
+
+  TileStore first;
+  createTestWorld(first);
+  WorldFileSaveInfo info;
+  info.spawnX = 100;
+  info.spawnY = 50;
+  saveWorldFile(firstPath, first, info);
+
+  // a percent of the chunks changes
+  TileStore second;
+  createTestWorld(second);
+  Tile tile;
+  tile.type = 9999;
+  tile.flags = TILE_ACTIVE;
+  for (uint32_t n = 0; n < CHANGED_CHUNKS; n++)
+    setTile(second, (int32_t)n * 3 * TILE_CHUNK_SIZE + 20, (int32_t)n * 2 * TILE_CHUNK_SIZE + 20,
+            tile);
+  saveWorldFile(secondPath, second, info);
+
+  const uint32_t chunkCount = (uint32_t)first.chunks.size();
+  WorldBackupStore store = openWorldBackupStore((root / "backups").string());
+  const WorldBackupStats firstStats = backupWorldFile(store, firstPath, "first");
+  CHECK(firstStats.chunks == chunkCount);
+  CHECK(firstStats.newObjects == chunkCount);
+
+  const WorldBackupStats secondStats = backupWorldFile(store, secondPath, "second");
+  CHECK(secondStats.newObjects == CHANGED_CHUNKS);
+  // new objects are about a percent of the bytes, besides the manifest written every time
+  const uint64_t manifestBytes =
+    sizeof(WorldBackupManifestHeader) + chunkCount * sizeof(WorldBackupHash);
+  CHECK((secondStats.bytesWritten - manifestBytes) * 50 < secondStats.bytesReferenced);
+  CHECK(listWorldBackups(store) == std::vector<std::string>({ "first", "second" }));
+
+  // a store opened again knows the objects, a backup of the same world writes none
+  store = openWorldBackupStore((root / "backups").string());
+  CHECK(backupWorldFile(store, secondPath, "again").newObjects == 0);
+  deleteWorldBackup(store, "again");
+
+  restoreWorldBackup(store, "first", restoredPath);
+  CHECK(sameWorld(first, restoredPath));
+  WorldFile restored = openWorldFile(restoredPath);
+  CHECK(readWorldFileSaveInfo(restored).spawnX == 100);
+  closeWorldFile(restored);
+
+  deleteWorldBackup(store, "first");
+  const WorldBackupCollectStats collected = collectWorldBackupGarbage(store);
+  CHECK(collected.manifests == 1);
+  CHECK(collected.objectsRemoved == CHANGED_CHUNKS);
+  // the chunks and the side tables of the second backup
+  CHECK(collected.objectsKept == chunkCount + 1);
+
+  restoreWorldBackup(store, "second", restoredPath);
+  CHECK(sameWorld(second, restoredPath));
+
+  std::filesystem::remove_all(root);
+}
+
+int main()
+{
+  testBackupRestoreCollect();
+  return getTestResult();
+}
@@ -0,0 +1,209 @@
+#include <Lynx/random.h>
+#include <Lynx/world_file.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <zstd.h>
+
+#include "test.h"
+
+static void setTestTile(TileChunkRaw& raw, uint32_t i, uint16_t type, uint32_t attributes)
+{
+  raw.hot.types[i] = type;
+  raw.hot.flags[i] = type ? TILE_ACTIVE : 0;
+  raw.cold.liquids[i] = (uint8_t)(i & 7);
+  raw.cold.attributes[i] = attributes;
+}
+
+// A raw chunk that encodes as format: one record, bands of a few records, scattered picks
+// from a few records, or more records than a palette holds.
+static std::unique_ptr<TileChunkRaw> createTestChunk(TileChunkFormat format)
+{
+  std::unique_ptr<TileChunkRaw> raw(new TileChunkRaw{});
+  RandomStream stream = createRandomStream(21, 0, (uint32_t)format);
+  for (uint32_t i = 0; i < TILE_CHUNK_TILES; i++)
+  {
+    switch (format)
+    {
+    case TILE_CHUNK_UNIFORM:
+      setTestTile(*raw, i, 1, 0);
+      raw->cold.liquids[i] = 0;
+      break;
+    case TILE_CHUNK_RUNS:
+      setTestTile(*raw, i, (uint16_t)(i / 200), 7);
+      raw->cold.liquids[i] = 0;
+      break;
+    case TILE_CHUNK_PALETTE:
+      setTestTile(*raw, i, (uint16_t)nextRandomBelow(stream, 5), 0);
+      raw->cold.liquids[i] = 0;
+      break;
+    default:
+      setTestTile(*raw, i, (uint16_t)i, nextRandom(stream));
+      break;
+    }
+  }
+  return raw;
+}
+
+static bool sameRecord(const TileRecord& record, const TileChunkRaw& raw, uint32_t i)
+{
+  return record.type == raw.hot.types[i] && record.flags == raw.hot.flags[i] &&
+         record.liquid == raw.cold.liquids[i] && record.attributes == raw.cold.attributes[i];
+}
+
+// Decodes stored, false when the blob is rejected.
+static bool decodeTestChunk(const WorldChunkEntry& entry, const std::vector<uint8_t>& stored,
+                            TileChunkEncoding& packed, std::unique_ptr<TileChunkRaw>& raw)
+{
+  ZSTD_DCtx* decompressor = ZSTD_createDCtx();
+  std::vector<uint8_t> scratch;
+  bool decoded = true;
+  try
+  {
+    decodeWorldChunk(entry, stored.data(), decompressor, scratch, packed, raw);
+  }
+  catch (const std::runtime_error&)
+  {
+    decoded = false;
+  }
+  ZSTD_freeDCtx(decompressor);
+  return decoded;
+}
+
+// Blob stored without compression, which has no checksum to catch corruption.
+static WorldChunkEntry getUncompressedEntry(const std::vector<uint8_t>& blob)
+{
+  WorldChunkEntry entry{};
+  entry.codec = WORLD_CODEC_NONE;
+  entry.format = blob[0];
+  entry.size = (uint32_t)blob.size();
+  entry.storedSize = entry.size;
+  return entry;
+}
+
+// Every format comes back tile for tile, compressed or not.
+static void testChunkRoundTrip()
+{
+  ZSTD_CCtx* compressor = ZSTD_createCCtx();
+  ZSTD_CCtx_setParameter(compressor, ZSTD_c_checksumFlag, 1);
+  for (TileChunkFormat format :
+       { TILE_CHUNK_UNIFORM, TILE_CHUNK_PALETTE, TILE_CHUNK_RUNS, TILE_CHUNK_RAW })
+  {
+    TileChunk chunk;
+    chunk.raw = createTestChunk(format);
+    std::vector<uint8_t> blob, stored;
+    serializeWorldChunk(chunk, blob);
+    WorldChunkEntry entry{};
+    storeWorldChunk(compressor, blob, entry, stored);
+    CHECK(entry.format == format);
+
+    for (const WorldChunkEntry& tried : { entry, getUncompressedEntry(blob) })
+    {
+      TileChunkEncoding packed;
+      std::unique_ptr<TileChunkRaw> raw;
+      const std::vector<uint8_t>& bytes = tried.codec == WORLD_CODEC_NONE ? blob : stored;
+      CHECK(decodeTestChunk(tried, bytes, packed, raw));
+      CHECK(packed.format == format);
+      CHECK((raw != nullptr) == (format == TILE_CHUNK_RAW));
+      bool same = true;
+      for (uint32_t i = 0; i < TILE_CHUNK_TILES; i++)
+      {
+        const TileRecord record = raw ? TileRecord{ raw->hot.types[i], raw->hot.flags[i],
+                                                    raw->cold.liquids[i],
+                                                    raw->cold.attributes[i] }
+                                      : getPackedTileRecord(packed, i);
+        same &= sameRecord(record, *chunk.raw, i);
+      }
+      CHECK(same);
+    }
+  }
+  ZSTD_freeCCtx(compressor);
+}
+
+// Offset of the run ends in the blob of a runs chunk.
+static size_t getRunEndsOffset(const std::vector<uint8_t>& blob)
+{
+  WorldChunkBlobHeader header;
+  memcpy(&header, blob.data(), sizeof(header));
+  return sizeof(header) + header.paletteSize * sizeof(TileRecord) +
+         header.indexWords * sizeof(uint64_t);
+}
+
+static void setRunEnd(std::vector<uint8_t>& blob, uint32_t run, uint16_t end)
+{
+  memcpy(blob.data() + getRunEndsOffset(blob) + run * sizeof(uint16_t), &end, sizeof(end));
+}
+
+static bool isTestBlobRejected(const std::vector<uint8_t>& blob)
+{
+  TileChunkEncoding packed;
+  std::unique_ptr<TileChunkRaw> raw;
+  return !decodeTestChunk(getUncompressedEntry(blob), blob, packed, raw);
+}
+
+// Corrupt blobs throw instead of decoding into chunks that read or write out of bounds.
+static void testCorruptChunksRejected()
+{
+  TileChunk chunk;
+  chunk.raw = createTestChunk(TILE_CHUNK_RUNS);
+  std::vector<uint8_t> runs;
+  serializeWorldChunk(chunk, runs);
+  WorldChunkBlobHeader header;
+  memcpy(&header, runs.data(), sizeof(header));
+  CHECK(header.format == TILE_CHUNK_RUNS && header.runCount >= 3);
+
+  std::vector<uint8_t> blob = runs;
+  setRunEnd(blob, 0, 30000);
+  CHECK(isTestBlobRejected(blob));
+
+  // still ending on the last tile, but going back
+  blob = runs;
+  setRunEnd(blob, 1, 10);
+  setRunEnd(blob, 0, 20);
+  CHECK(isTestBlobRejected(blob));
+
+  blob = runs;
+  setRunEnd(blob, 1, 199);
+  CHECK(isTestBlobRejected(blob));
+
+  blob = runs;
+  blob[getRunEndsOffset(blob) + header.runCount * sizeof(uint16_t)] = 200;
+  CHECK(isTestBlobRejected(blob));
+
+  blob = runs;
+  blob.pop_back();
+  CHECK(isTestBlobRejected(blob));
+
+  blob = runs;
+  blob[0] = 9;
+  CHECK(isTestBlobRejected(blob));
+
+  chunk.raw = createTestChunk(TILE_CHUNK_PALETTE);
+  serializeWorldChunk(chunk, blob);
+  blob[1] = 0;
+  CHECK(isTestBlobRejected(blob));
+
+  // compressed blobs are checked by their checksum
+  ZSTD_CCtx* compressor = ZSTD_createCCtx();
+  ZSTD_CCtx_setParameter(compressor, ZSTD_c_checksumFlag, 1);
+  WorldChunkEntry entry{};
+  std::vector<uint8_t> stored;
+  storeWorldChunk(compressor, runs, entry, stored);
+  CHECK(entry.codec == WORLD_CODEC_ZSTD);
+  stored[stored.size() / 2] ^= 0x40;
+  TileChunkEncoding packed;
+  std::unique_ptr<TileChunkRaw> raw;
+  CHECK(!decodeTestChunk(entry, stored, packed, raw));
+  ZSTD_freeCCtx(compressor);
+}
+
+int main()
+{
+  testChunkRoundTrip();
+  testCorruptChunksRejected();
+  return getTestResult();
+}
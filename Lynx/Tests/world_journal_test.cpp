@@ -0,0 +1,289 @@
+#include <Lynx/random.h>
+#include <Lynx/world_journal.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+// 8 x 6 chunks
+constexpr const int32_t WORLD_WIDTH = 8 * TILE_CHUNK_SIZE;
+constexpr const int32_t WORLD_HEIGHT = 6 * TILE_CHUNK_SIZE;
+// journals are only compacted when asked to
+constexpr const uint64_t NO_COMPACTION = 1ull << 40;
+
+static std::vector<uint64_t> getTestTiles(const TileStore& store)
+{
+  std::vector<uint64_t> tiles;
+  tiles.reserve((size_t)WORLD_WIDTH * WORLD_HEIGHT);
+  for (int32_t y = 0; y < WORLD_HEIGHT; y++)
+  {
+    for (int32_t x = 0; x < WORLD_WIDTH; x++)
+    {
+      const Tile tile = getTile(store, x, y);
+      tiles.push_back(tile.type | (uint64_t)tile.flags << 16 | (uint64_t)tile.liquid << 24 |
+                      (uint64_t)packTileAttributes(tile) << 32);
+    }
+  }
+  return tiles;
+}
+
+// A few tiles of a small rect, plus the first tile of the world so every batch writes a chunk
+// earlier batches wrote too.
+static void editTestWorld(TileStore& store, RandomStream& stream)
+{
+  const int32_t x0 = (int32_t)nextRandomBelow(stream, WORLD_WIDTH - 40);
+  const int32_t y0 = (int32_t)nextRandomBelow(stream, WORLD_HEIGHT - 40);
+  Tile tile;
+  tile.flags = TILE_ACTIVE;
+  for (uint32_t n = 0; n < 30; n++)
+  {
+    tile.type = (uint16_t)(2 + nextRandomBelow(stream, 50));
+    tile.wall = (uint16_t)nextRandomBelow(stream, 4);
+    setTile(store, x0 + (int32_t)nextRandomBelow(stream, 40),
+            y0 + (int32_t)nextRandomBelow(stream, 40), tile);
+  }
+  tile.type = (uint16_t)(2 + nextRandomBelow(stream, 50));
+  setTile(store, 0, 0, tile);
+}
+
+static void createTestWorld(const std::string& worldPath)
+{
+  TileStore store = createTileStore(WORLD_WIDTH, WORLD_HEIGHT);
+  Tile tile;
+  tile.type = 1;
+  tile.flags = TILE_ACTIVE;
+  fillTiles(store, 0, WORLD_HEIGHT / 2, WORLD_WIDTH, WORLD_HEIGHT, tile);
+  WorldFileSaveInfo info;
+  info.spawnX = 10;
+  info.spawnY = 20;
+  saveWorldFile(worldPath, store, info);
+}
+
+// Store of the world file with its journals replayed. Every chunk is loaded, so the file can be
+// closed and replaced by a compaction.
+static TileStore loadTestWorld(const std::string& worldPath, WorldJournalReplay& replay)
+{
+  WorldFile file = openWorldFile(worldPath);
+  TileStore store = createTileStoreFromWorldFile(file);
+  replay = replayWorldJournals(worldPath, store);
+  getTestTiles(store);
+  closeWorldFile(file);
+  return store;
+}
+
+static std::vector<uint64_t> replayTestWorld(const std::string& worldPath,
+                                             WorldJournalReplay& replay)
+{
+  return getTestTiles(loadTestWorld(worldPath, replay));
+}
+
+// Journals batches of edits to store, the tiles after each batch are appended to states.
+static void journalTestEdits(TileStore& store, const std::string& worldPath,
+                             RandomStream& stream, uint32_t batches,
+                             std::vector<std::vector<uint64_t>>& states)
+{
+  WorldJournal journal;
+  createWorldJournal(journal, store, worldPath, 60, NO_COMPACTION);
+  for (uint32_t n = 0; n < batches; n++)
+  {
+    editTestWorld(store, stream);
+    flushWorldJournal(journal);
+    states.push_back(getTestTiles(store));
+  }
+  destroyWorldJournal(journal);
+
+  std::string error;
+  const WorldJournalStats stats = getWorldJournalStats(journal, &error);
+  CHECK(error.empty());
+  CHECK(stats.batches == batches && stats.compactions == 0);
+}
+
+static std::vector<uint8_t> readTestFile(const std::string& path)
+{
+  std::vector<uint8_t> data;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return data;
+  data.resize((size_t)std::filesystem::file_size(path));
+  if (fread(data.data(), 1, data.size(), file) != data.size())
+    data.clear();
+  fclose(file);
+  return data;
+}
+
+static void writeTestFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+  FILE* file = fopen(path.c_str(), "wb");
+  CHECK(file != nullptr);
+  if (!file)
+    return;
+  CHECK(fwrite(data.data(), 1, data.size(), file) == data.size());
+  fclose(file);
+}
+
+// Batches replay into a fresh store, compaction folds them into the world file, and journals a
+// crash left behind after the new world file replaced the old one change nothing when replayed
+// onto it.
+static void testReplayAndCompact()
+{
+  const std::filesystem::path root =
+    std::filesystem::temp_directory_path() / "lynx_world_journal_test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  const std::string worldPath = (root / "world.lwf").string();
+  createTestWorld(worldPath);
+
+  RandomStream stream = createRandomStream(5);
+  std::vector<std::vector<uint64_t>> states;
+  WorldJournalReplay replay;
+  {
+    TileStore store = loadTestWorld(worldPath, replay);
+    CHECK(replay.batches == 0);
+
+    WorldJournal journal;
+    createWorldJournal(journal, store, worldPath, 60, NO_COMPACTION);
+    for (uint32_t n = 0; n < 3; n++)
+    {
+      editTestWorld(store, stream);
+      if (n == 1)
+      {
+        WorldFileSaveInfo info;
+        info.spawnX = 30;
+        info.spawnY = 40;
+        setWorldJournalSaveInfo(journal, std::move(info));
+      }
+      flushWorldJournal(journal);
+      states.push_back(getTestTiles(store));
+    }
+    destroyWorldJournal(journal);
+    CHECK(getWorldJournalStats(journal).batches == 3);
+  }
+
+  CHECK(replayTestWorld(worldPath, replay) == states.back());
+  CHECK(replay.batches == 3);
+  CHECK(replay.hasSaveInfo && replay.saveInfo.spawnX == 30 && replay.saveInfo.spawnY == 40);
+
+  // a second session journals to the next generation, after the first one
+  {
+    TileStore store = loadTestWorld(worldPath, replay);
+    journalTestEdits(store, worldPath, stream, 2, states);
+  }
+  CHECK(replayTestWorld(worldPath, replay) == states.back());
+  CHECK(replay.batches == 5);
+
+  const std::string journal0 = worldPath + ".journal.0";
+  const std::string journal1 = worldPath + ".journal.1";
+  const std::vector<uint8_t> leftover0 = readTestFile(journal0);
+  const std::vector<uint8_t> leftover1 = readTestFile(journal1);
+  CHECK(!leftover0.empty() && !leftover1.empty());
+
+  // the third session compacts right away, so the compacted journals hold the first two
+  // sessions only, then keeps journaling to the generation after the compaction
+  {
+    TileStore store = loadTestWorld(worldPath, replay);
+    WorldJournal journal;
+    createWorldJournal(journal, store, worldPath, 60, NO_COMPACTION);
+    flushWorldJournal(journal, true);
+    editTestWorld(store, stream);
+    flushWorldJournal(journal);
+    states.push_back(getTestTiles(store));
+    destroyWorldJournal(journal);
+
+    std::string error;
+    const WorldJournalStats stats = getWorldJournalStats(journal, &error);
+    CHECK(error.empty());
+    CHECK(stats.compactions == 1 && stats.batches == 2);
+  }
+  CHECK(!std::filesystem::exists(journal0) && !std::filesystem::exists(journal1));
+  CHECK(!std::filesystem::exists(worldPath + ".journal.2"));
+  CHECK(std::filesystem::exists(worldPath + ".journal.3"));
+
+  WorldFile file = openWorldFile(worldPath);
+  CHECK(readWorldFileSaveInfo(file).spawnX == 30);
+  closeWorldFile(file);
+
+  CHECK(replayTestWorld(worldPath, replay) == states.back());
+  CHECK(replay.batches == 1);
+
+  // journals are removed oldest first, a crash before or between the removals leaves the newest
+  // compacted ones
+  writeTestFile(journal1, leftover1);
+  CHECK(replayTestWorld(worldPath, replay) == states.back());
+  CHECK(replay.batches == 3);
+
+  writeTestFile(journal0, leftover0);
+  CHECK(replayTestWorld(worldPath, replay) == states.back());
+  CHECK(replay.batches == 6);
+  CHECK(replay.hasSaveInfo && replay.saveInfo.spawnX == 30);
+
+  std::filesystem::remove_all(root);
+}
+
+// A journal cut off in its last batch, or followed by garbage, replays the batches committed
+// before, and a later session journals on top of what was replayed.
+static void testTornRecordDropped()
+{
+  const std::filesystem::path root =
+    std::filesystem::temp_directory_path() / "lynx_world_journal_torn_test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  const std::string worldPath = (root / "world.lwf").string();
+  const std::string journal0 = worldPath + ".journal.0";
+  createTestWorld(worldPath);
+
+  RandomStream stream = createRandomStream(6);
+  std::vector<std::vector<uint64_t>> states;
+  WorldJournalReplay replay;
+  {
+    TileStore store = loadTestWorld(worldPath, replay);
+    journalTestEdits(store, worldPath, stream, 3, states);
+  }
+  const std::vector<uint8_t> full = readTestFile(journal0);
+  CHECK(full.size() > sizeof(WorldJournalHeader) + 3 * sizeof(WorldJournalRecord));
+
+  // the commit record torn, or the last chunk record torn before it
+  for (size_t cut : { (size_t)1, sizeof(WorldJournalRecord) - 1, sizeof(WorldJournalRecord) + 8 })
+  {
+    writeTestFile(journal0, std::vector<uint8_t>(full.begin(), full.end() - cut));
+    CHECK(replayTestWorld(worldPath, replay) == states[1]);
+    CHECK(replay.batches == 2);
+  }
+
+  // a flipped byte in the commit record fails its checksum
+  std::vector<uint8_t> data = full;
+  data[data.size() - 4] ^= 0x10;
+  writeTestFile(journal0, data);
+  CHECK(replayTestWorld(worldPath, replay) == states[1]);
+  CHECK(replay.batches == 2);
+
+  // garbage after the last commit is ignored
+  data = full;
+  for (uint32_t n = 0; n < 100; n++)
+    data.push_back((uint8_t)nextRandom(stream));
+  writeTestFile(journal0, data);
+  CHECK(replayTestWorld(worldPath, replay) == states[2]);
+  CHECK(replay.batches == 3);
+
+  // the batch that was lost stays lost, the next session starts from the replayed world
+  writeTestFile(journal0, std::vector<uint8_t>(full.begin(), full.end() - 1));
+  states.resize(2);
+  {
+    TileStore store = loadTestWorld(worldPath, replay);
+    journalTestEdits(store, worldPath, stream, 1, states);
+  }
+  CHECK(replayTestWorld(worldPath, replay) == states[2]);
+  CHECK(replay.batches == 3);
+
+  std::filesystem::remove_all(root);
+}
+
+int main()
+{
+  testReplayAndCompact();
+  testTornRecordDropped();
+  return getTestResult();
+}
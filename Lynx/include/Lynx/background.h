@@ -0,0 +1,177 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <Volk/volk.h>
+
+#include <Lynx/vk_utils.h>
+
+constexpr const uint32_t BACKGROUND_NO_TEXTURE = ~0u;
+constexpr const uint32_t BACKGROUND_NO_STYLE = ~0u;
+constexpr const uint32_t BACKGROUND_MAX_VISIBLE_LAYERS = 32;
+
+// Decodes a background texture into tightly packed RGBA8 pixels. Called from the streaming
+// thread, so it must not touch anything the game thread owns.
+using BackgroundLoadFn = std::function<bool(uint32_t textureId, std::vector<uint8_t>& pixels,
+                                            uint32_t& width, uint32_t& height)>;
+
+struct BackgroundLayer
+{
+  uint32_t textureId;
+  // 0 stays fixed on screen, 1 moves with the world
+  float scrollFactorX;
+  float scrollFactorY;
+  // world y of the top of the layer before scrolling is applied
+  float offsetY;
+  float scale = 1.0f;
+};
+
+// Surface, underground, cavern or a biome variant of one of them, drawn back to front.
+struct BackgroundStyle
+{
+  std::vector<BackgroundLayer> layers;
+};
+
+// World rectangle in pixels where a style is shown.
+struct BackgroundZone
+{
+  float x0;
+  float y0;
+  float x1;
+  float y1;
+  uint32_t style;
+};
+
+struct BackgroundSystemCreateInfo
+{
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+
+  // VRAM is bounded by slotCount * slotWidth * slotHeight * 4 no matter how many styles exist
+  uint32_t slotCount = 16;
+  uint32_t slotWidth = 2048;
+  uint32_t slotHeight = 1024;
+  uint32_t framesInFlight = 2;
+
+  // how close to a zone the camera has to be before its textures are streamed in
+  float prefetchDistance = 1600.0f;
+  float crossFadeSeconds = 1.0f;
+
+  BackgroundLoadFn load;
+
+  std::string vertexShader;
+  std::string fragmentShader;
+};
+
+enum class BackgroundSlotState
+{
+  Free,
+  Loading,
+  Resident,
+};
+
+struct BackgroundSlot
+{
+  uint32_t textureId = BACKGROUND_NO_TEXTURE;
+  BackgroundSlotState state = BackgroundSlotState::Free;
+  uint64_t lastUsed = 0;
+  float uvScale[2] = { 1.0f, 1.0f };
+  float size[2] = { 0.0f, 0.0f };
+};
+
+struct BackgroundLoadResult
+{
+  uint32_t slot;
+  uint32_t textureId;
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint8_t> pixels;
+};
+
+// Textures are loaded on a streaming thread and uploaded into a fixed pool of array layers.
+// Slots of styles that are neither shown nor fading out can be reused, so leaving a biome frees
+// its textures as soon as the cross-fade is over.
+struct BackgroundSystem
+{
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  uint32_t slotWidth = 0;
+  uint32_t slotHeight = 0;
+  uint32_t framesInFlight = 0;
+  float prefetchDistance = 0.0f;
+  float crossFadeSeconds = 0.0f;
+
+  std::vector<BackgroundStyle> styles;
+  std::vector<BackgroundZone> zones;
+  std::vector<BackgroundSlot> slots;
+  // textures the loader could not decode or that do not fit a slot, never requested again and
+  // left out of their styles so the camera's zone can still switch
+  std::unordered_set<uint32_t> failedTextures;
+
+  uint32_t activeStyle = BACKGROUND_NO_STYLE;
+  uint32_t fadingStyle = BACKGROUND_NO_STYLE;
+  // style the camera is in but whose textures are not resident yet
+  uint32_t pendingStyle = BACKGROUND_NO_STYLE;
+  float fade = 1.0f;
+  uint64_t frame = 0;
+
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+  VkImageView imageView = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+  bool imageInitialized = false;
+
+  // one slot worth of pixels per frame in flight
+  GpuBuffer staging;
+  // BACKGROUND_MAX_VISIBLE_LAYERS instances per frame in flight
+  GpuBuffer instances;
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  BackgroundLoadFn load;
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable condition;
+  // requests only carry the slot and texture, results are waiting for their upload
+  std::deque<BackgroundLoadResult> requests;
+  std::deque<BackgroundLoadResult> results;
+  bool quit = false;
+};
+
+// The system owns a thread and is referenced by it, so it is created in place.
+void createBackgroundSystem(BackgroundSystem& system,
+                            const BackgroundSystemCreateInfo& createInfo);
+
+void destroyBackgroundSystem(BackgroundSystem& system);
+
+uint32_t addBackgroundStyle(BackgroundSystem& system, const BackgroundStyle& style);
+
+void setBackgroundZones(BackgroundSystem& system, const std::vector<BackgroundZone>& zones);
+
+// Picks the style of the zone containing the camera, starts cross-fades once its textures are
+// resident and streams in styles of nearby zones.
+void updateBackgrounds(BackgroundSystem& system, float cameraX, float cameraY, float dt);
+
+// Uploads at most one decoded texture. Must be recorded outside of a render pass.
+void recordBackgroundUploads(VkCommandBuffer commandBuffer, BackgroundSystem& system,
+                             uint32_t frameIndex);
+
+// Draws every visible layer of the active and fading styles with a single instanced draw.
+void recordBackgroundDraw(VkCommandBuffer commandBuffer, BackgroundSystem& system,
+                          uint32_t frameIndex, float cameraX, float cameraY, float viewWidth,
+                          float viewHeight);
+
+uint64_t getBackgroundVramBytes(const BackgroundSystem& system);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/tile_store.h>
+
+constexpr const uint32_t BIOME_SPREAD_MAX_BIOMES = 8;
+constexpr const uint16_t BIOME_NO_CONVERSION = 0xffff;
+
+// Bitboards of a biome in a chunk, bit x of row y.
+enum BiomeBoard : uint32_t
+{
+  // tiles the biome has a conversion for
+  BIOME_BOARD_CONVERTIBLE,
+  // tiles of the biome that spread it
+  BIOME_BOARD_INFECTING,
+  BIOME_BOARD_COUNT,
+};
+
+// Band of a conversion event: in every row from y0 to y1, the tiles within halfWidth of the line
+// from (x0, y0) to (x1, y1).
+struct BiomeStripe
+{
+  uint32_t biome;
+  int32_t x0, y0, x1, y1;
+  int32_t halfWidth;
+};
+
+struct BiomeSpreadStats
+{
+  uint32_t chunks;
+  uint64_t converted;
+  uint64_t nanoseconds;
+};
+
+// Spreading biomes, the evil biomes and the hallow. Each chunk keeps a bitboard per biome of the
+// tiles it can convert and of the tiles that infect, rebuilt from the store when a listener
+// reports the chunk changed. Every tick, the tiles next to an infecting tile (8 neighbours,
+// across chunk borders) that their biome can convert are found by shifting and ORing whole
+// boards 4 rows at a time, and each converts with a chance of 1 in 2^spreadShift from the random
+// stream of the chunk and the tick. Only chunks in reach of an infected chunk are visited.
+//
+// A tile two biomes reach in the same tick goes to the lower biome. Candidates are computed from
+// the boards as they were before the tick, so chunks are independent: they run as jobs, and the
+// result does not depend on the thread count. Conversions are written to raw chunks directly and
+// listeners are notified once per changed chunk.
+struct BiomeSpread
+{
+  TileStore* store = nullptr;
+  JobSystem* jobs = nullptr;
+  uint64_t seed = 0;
+  uint32_t pass = 0;
+  uint32_t tick = 0;
+  uint32_t spreadShift = 8;
+  uint32_t biomeCount = 0;
+
+  // by biome * TILE_TYPE_COUNT + type
+  std::vector<uint16_t> conversions;
+  // by type, the biome it spreads plus one, 0 for none
+  std::vector<uint8_t> infectingBiomes;
+
+  // by chunk index cy * chunksX + cx, BIOME_BOARD_COUNT boards of TILE_CHUNK_SIZE rows per biome
+  std::vector<uint32_t> boards;
+  std::vector<uint8_t> staleFlags;
+  std::vector<uint8_t> infectedFlags;
+  std::vector<uint32_t> staleChunks;
+  // set while the spread notifies its own changes
+  bool updating = false;
+  BiomeSpreadStats stats{};
+};
+
+// The spread is referenced by a listener of store, so it is created in place.
+void createBiomeSpread(BiomeSpread& spread, TileStore& store, JobSystem& jobs, uint64_t seed,
+                       uint32_t biomeCount);
+
+void destroyBiomeSpread(BiomeSpread& spread);
+
+// Tiles of type become to when biome converts them.
+void setBiomeConversion(BiomeSpread& spread, uint32_t biome, uint16_t type, uint16_t to);
+
+// Tiles of type spread biome.
+void setBiomeInfecting(BiomeSpread& spread, uint32_t biome, uint16_t type);
+
+inline uint32_t* getBiomeBoard(BiomeSpread& spread, uint32_t chunk, uint32_t biome,
+                               BiomeBoard board)
+{
+  return &spread.boards[((chunk * spread.biomeCount + biome) * BIOME_BOARD_COUNT + board) *
+                        TILE_CHUNK_SIZE];
+}
+
+// One tick of spreading.
+const BiomeSpreadStats& updateBiomeSpread(BiomeSpread& spread);
+
+// Converts every tile of the stripes their biome can convert, as when the world enters hardmode.
+// Chunks run as jobs; a stripe listed earlier wins where two overlap.
+const BiomeSpreadStats& convertBiomeStripes(BiomeSpread& spread, const BiomeStripe* stripes,
+                                            uint32_t count);
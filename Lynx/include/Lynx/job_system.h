@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// thread is below getJobThreadCount and no two jobs running at once share it, for per-thread
+// scratch. The workers are threads 0 and up, the thread waiting for a batch is the last one.
+typedef void (*JobFn)(void* userData, uint32_t index, uint32_t thread);
+
+// count calls of fn, claimed one index at a time by whichever thread is free.
+struct JobBatch
+{
+  JobFn fn = nullptr;
+  void* userData = nullptr;
+  uint32_t count = 0;
+  std::atomic<uint32_t> next{ 0 };
+
+  // guarded by the system's mutex
+  bool queued = false;
+  // threads inside the batch, it may only be reused once none are and it is no longer queued
+  uint32_t users = 0;
+  // first exception thrown by a job
+  std::string error;
+};
+
+struct JobSystem
+{
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::condition_variable finishedCondition;
+  std::deque<JobBatch*> batches;
+  // size of batches, read by workers between jobs without the mutex
+  std::atomic<uint32_t> queuedBatches{ 0 };
+  bool quit = false;
+};
+
+// The system owns its threads and is referenced by them, so it is created in place. workerCount
+// 0 starts a worker for every core but the one of the calling thread, and at least one.
+void createJobSystem(JobSystem& system, uint32_t workerCount = 0);
+
+// Waits for the batches already submitted.
+void destroyJobSystem(JobSystem& system);
+
+// Workers and the waiting thread, the size of per-thread scratch.
+uint32_t getJobThreadCount(const JobSystem& system);
+
+// Queues count jobs next to the batches already submitted. Workers take turns between all
+// queued batches a few jobs at a time, so a long running batch, like loading a world, does not
+// keep workers from batches submitted later. batch must stay in place until it finished. Jobs
+// must not wait for other batches.
+void submitJobs(JobSystem& system, JobBatch& batch, JobFn fn, void* userData, uint32_t count);
+
+bool isJobBatchFinished(JobSystem& system, JobBatch& batch);
+
+// Runs jobs of batch on the calling thread until none are left, then waits for the workers to
+// finish theirs. Throws the first exception of a job. Only one thread may wait at a time.
+void waitForJobs(JobSystem& system, JobBatch& batch);
+
+// Runs jobs of the batches on the calling thread until one of them finished, without throwing.
+// Follow with waitForJobs on the finished batches for their errors.
+void waitForAnyJobs(JobSystem& system, JobBatch* const* batches, uint32_t count);
+
+// Runs fn(index, thread) for every index below count across the system and waits for them.
+template <typename Fn>
+void runJobs(JobSystem& system, uint32_t count, Fn&& fn)
+{
+  typedef std::remove_reference_t<Fn> Callable;
+  JobBatch batch;
+  submitJobs(
+    system, batch,
+    [](void* userData, uint32_t index, uint32_t thread) { (*(Callable*)userData)(index, thread); },
+    (void*)&fn, count);
+  waitForJobs(system, batch);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include <Lynx/world_gen.h>
+
+// Full tile of liquid.
+constexpr const uint8_t LIQUID_FULL = 255;
+
+struct LiquidSettleStats
+{
+  // horizontal runs of open tiles and the basins they make up
+  uint32_t segments;
+  uint32_t basins;
+  uint64_t volume;
+  // liquid that overflowed a basin open to the top of the world
+  uint64_t lostVolume;
+  // rounds of the cellular pass and tile updates they made
+  uint32_t simSteps;
+  uint64_t simUpdates;
+  // tiles still moving when the cellular pass ran out of steps
+  uint32_t unsettledCells;
+  uint64_t nanoseconds;
+};
+
+// Brings every liquid of store to rest without running the liquid simulation until it stops.
+//
+// The open tiles are swept bottom-up once, joining horizontal runs into basins with union-find:
+// a basin starts at the bottom of a pocket and two basins merge into a new one at the row where
+// their open space meets, which gives a tree of pockets nested in larger pockets. Liquid is
+// dropped straight down onto the run it lands on, then every basin keeps what fits and spills
+// the rest into the basin it merges into, filling the pockets below first and its own rows
+// bottom-up. The basin takes the liquid type it holds most of. What the analytic fill does not
+// settle, mainly the uneven amounts of partially filled surface rows, is evened out by a
+// cellular pass over those tiles only, for at most maxSimSteps rounds.
+LiquidSettleStats settleLiquids(TileStore& store, uint32_t maxSimSteps = 256);
+
+// settleLiquids as a world generation pass: a single job, reads WORLDGEN_TILES and writes
+// WORLDGEN_LIQUIDS and WORLDGEN_ATTRIBUTES everywhere.
+//
+//   { "settle liquids", settleWorldGenLiquids, WORLDGEN_TILES,
+//     WORLDGEN_LIQUIDS | WORLDGEN_ATTRIBUTES }
+void settleWorldGenLiquids(const WorldGenContext& context);
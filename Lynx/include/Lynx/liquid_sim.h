@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/liquid_settle.h>
+#include <Lynx/tile_store.h>
+
+// Tiles of a chunk to update next tick, bit x of rows[y].
+struct LiquidSimChunk
+{
+  uint32_t rows[TILE_CHUNK_SIZE];
+  bool listed;
+};
+
+// Wakes and changes a job made outside its own chunk, merged once the tick is done.
+struct LiquidSimThread
+{
+  // slot << 10 | index in chunk
+  std::vector<uint32_t> wakes;
+  std::vector<uint32_t> changedChunks;
+  uint64_t updates;
+};
+
+struct LiquidSimStats
+{
+  uint32_t activeChunks;
+  uint32_t activeCells;
+  // cells that moved liquid
+  uint64_t updates;
+  uint64_t nanoseconds;
+};
+
+// Cellular liquids of a tile store. Only tiles woken by a change of their own or of a neighbour
+// are updated; a tile that does not move liquid in a tick goes back to sleep, and so does a
+// chunk once none of its tiles are awake, so a world full of still lakes costs nothing. The
+// store's listeners wake the tiles around every change made outside the simulation.
+//
+// Each tick, liquid falls into the tile below while it has room, then spreads evenly with the
+// tiles left and right, bottom row first. Different liquids do not mix. A tile only writes
+// itself and its direct neighbours, so chunks two apart never touch the same tiles: awake chunks
+// run as jobs in four phases by the parity of their coordinates, and the result does not depend
+// on the thread count.
+struct LiquidSim
+{
+  TileStore* store = nullptr;
+  JobSystem* jobs = nullptr;
+  // by slot
+  std::vector<LiquidSimChunk> chunks;
+  std::vector<uint32_t> chunkX, chunkY;
+  std::vector<uint32_t> activeChunks;
+  std::vector<LiquidSimThread> threads;
+  // set while the simulation notifies its own changes
+  bool updating = false;
+  LiquidSimStats stats{};
+};
+
+// The simulation is referenced by a listener of store, so it is created in place.
+void createLiquidSim(LiquidSim& sim, TileStore& store, JobSystem& jobs);
+
+void destroyLiquidSim(LiquidSim& sim);
+
+// Wakes [x0, x1) x [y0, y1), for instance after loading. Chunks holding no liquid are skipped,
+// their tiles are woken by the liquid that flows into them.
+void wakeLiquids(LiquidSim& sim, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+// One tick. Listeners are notified once per chunk that changed.
+const LiquidSimStats& updateLiquidSim(LiquidSim& sim);
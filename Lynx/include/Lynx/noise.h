@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+enum NoiseType : uint8_t
+{
+  NOISE_VALUE,
+  NOISE_PERLIN,
+  NOISE_SIMPLEX,
+};
+
+enum NoiseFractal : uint8_t
+{
+  NOISE_FRACTAL_NONE,
+  // octaves summed with falling amplitude
+  NOISE_FRACTAL_FBM,
+  // octaves of 1 - |noise|, sharp crests where the noise crosses zero
+  NOISE_FRACTAL_RIDGED,
+};
+
+// Instruction sets the kernels have versions for, the AVX2 one is picked at run time. Paths give
+// the same results within NOISE_PATH_EPSILON, the differences come from the compiler fusing
+// multiplies and adds.
+enum NoisePath : uint8_t
+{
+  NOISE_PATH_SCALAR,
+  // 4 samples per call
+  NOISE_PATH_SSE2,
+  // 8 samples per call
+  NOISE_PATH_AVX2,
+};
+
+constexpr const float NOISE_PATH_EPSILON = 1e-4f;
+
+struct NoiseSettings
+{
+  NoiseType type = NOISE_PERLIN;
+  NoiseFractal fractal = NOISE_FRACTAL_NONE;
+  uint32_t seed = 0;
+  // per tile
+  float frequency = 1.0f / 64.0f;
+  int32_t octaves = 4;
+  float lacunarity = 2.0f;
+  float gain = 0.5f;
+  // the sample position is moved by up to warpAmplitude tiles along a second noise of
+  // warpFrequency, 0 turns warping off
+  float warpAmplitude = 0.0f;
+  float warpFrequency = 1.0f / 128.0f;
+};
+
+struct NoiseBenchmark
+{
+  NoisePath path;
+  double scalarNanosecondsPerSample;
+  double pathNanosecondsPerSample;
+  // largest difference between the scalar reference and path
+  float maxDifference;
+  // maxDifference is within NOISE_PATH_EPSILON
+  bool matchesScalar;
+};
+
+// Widest path the CPU runs.
+NoisePath getNoisePath();
+
+// Noise at tile (x, y), roughly in [-1, 1], with the scalar reference kernels.
+float sampleNoise(const NoiseSettings& settings, float x, float y);
+
+// count samples at (x[i], y[i]).
+void sampleNoise(const NoiseSettings& settings, const float* x, const float* y, float* out,
+                 uint32_t count, NoisePath path = getNoisePath());
+
+// out[row * width + column] is the noise at tile (x0 + column, y0 + row). A height of 1 gives
+// 1D noise along a row, for heightmaps. Paths the CPU cannot run fall back to its widest.
+void fillNoiseRect(const NoiseSettings& settings, int32_t x0, int32_t y0, int32_t width,
+                   int32_t height, float* out, NoisePath path = getNoisePath());
+
+// Times the scalar reference against path over a width x height rectangle and checks that they
+// give the same noise.
+NoiseBenchmark benchmarkNoise(const NoiseSettings& settings, NoisePath path = getNoisePath(),
+                              int32_t width = 512, int32_t height = 512);
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <Volk/volk.h>
+
+#include <Lynx/vk_utils.h>
+
+enum ParticleFlags : uint32_t
+{
+  PARTICLE_COLLIDE = 1 << 0,
+  PARTICLE_NO_GRAVITY = 1 << 1,
+};
+
+// One burst of particles, expanded on the GPU. Matches EmitRequest in
+// particle_emit.compute.glsl.
+struct ParticleEmitRequest
+{
+  float position[2];
+  float velocity[2];
+  // random offset added to the position and to the velocity of every particle of the burst
+  float positionSpread;
+  float velocitySpread;
+  float life;
+  float size;
+  uint32_t color; // RGBA8, red in the low byte
+  uint32_t count;
+  uint32_t firstParticle; // filled in by emitParticles
+  uint32_t flags;
+};
+static_assert(sizeof(ParticleEmitRequest) == 48);
+
+struct ParticleSystemCreateInfo
+{
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+
+  // tile types around the camera as R16_UINT, sampled with a nearest filter
+  VkImageView tileIdView = VK_NULL_HANDLE;
+  VkSampler tileIdSampler = VK_NULL_HANDLE;
+
+  uint32_t capacity = 1 << 20;
+  uint32_t maxEmitsPerFrame = 4096;
+  uint32_t framesInFlight = 2;
+
+  // SPIR-V, as returned by readFile
+  std::string emitShader;
+  std::string simulateShader;
+  std::string vertexShader;
+  std::string fragmentShader;
+};
+
+// Particle state lives entirely on the GPU in structure-of-arrays storage buffers. The CPU only
+// writes emit requests into a persistently mapped ring, so its cost is proportional to the number
+// of emit calls and not to the number of live particles. When the pool is full the oldest
+// particles are recycled.
+struct ParticleSystem
+{
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  uint32_t capacity = 0;
+  uint32_t maxEmitsPerFrame = 0;
+  uint32_t framesInFlight = 0;
+
+  // positions | velocities | life (remaining, total) | style (color, size and flags)
+  GpuBuffer particles;
+  VkDeviceSize streamSize = 0;
+
+  GpuBuffer emitRing;
+  VkDeviceSize emitSegmentSize = 0;
+
+  // one bit per tile type, set for types particles collide with
+  GpuBuffer solidTiles;
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline emitPipeline = VK_NULL_HANDLE;
+  VkPipeline simulatePipeline = VK_NULL_HANDLE;
+  VkPipeline renderPipeline = VK_NULL_HANDLE;
+
+  uint32_t frameIndex = 0;
+  uint32_t emitCount = 0;
+  uint32_t emitParticleCount = 0;
+  uint32_t particleHead = 0;
+  uint32_t seed = 0;
+  bool cleared = false;
+};
+
+constexpr const uint32_t PARTICLE_TILE_TYPE_COUNT = 1 << 16;
+
+ParticleSystem createParticleSystem(const ParticleSystemCreateInfo& createInfo);
+
+void destroyParticleSystem(ParticleSystem& system);
+
+// bits holds PARTICLE_TILE_TYPE_COUNT / 32 words.
+void setParticleSolidTileTypes(ParticleSystem& system, const uint32_t* bits);
+
+// Selects the emit ring segment of this frame, which must no longer be in use by the GPU.
+void beginParticleFrame(ParticleSystem& system, uint32_t frameIndex);
+
+// Returns false when the emit ring of this frame is full and the request was dropped.
+bool emitParticles(ParticleSystem& system, const ParticleEmitRequest& request);
+
+// Expands this frame's emit requests and advances the simulation. tileOrigin is the tile
+// coordinate of texel (0, 0) of the tile ID texture.
+void recordParticleUpdate(VkCommandBuffer commandBuffer, ParticleSystem& system, float dt,
+                          float gravity, int32_t tileOriginX, int32_t tileOriginY);
+
+// Draws every slot of the pool as an instanced quad, dead particles are culled in the vertex
+// shader. view maps world pixels to clip space as clip = world * scale + offset.
+void recordParticleDraw(VkCommandBuffer commandBuffer, const ParticleSystem& system,
+                        const float viewScale[2], const float viewOffset[2]);
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+// Philox4x32-10 constants
+constexpr const uint32_t RANDOM_PHILOX_M0 = 0xd2511f53;
+constexpr const uint32_t RANDOM_PHILOX_M1 = 0xcd9e8d57;
+constexpr const uint32_t RANDOM_PHILOX_W0 = 0x9e3779b9;
+constexpr const uint32_t RANDOM_PHILOX_W1 = 0xbb67ae85;
+
+// Counter-based random numbers. Block n of a stream is Philox4x32-10 of the counter
+// (n, chunk, tick) under a key derived from the seed and the pass, so any block can be computed
+// without the ones before it and streams with different keys are independent. Giving every
+// chunk of every pass and tick its own stream keeps results the same however the work is split
+// across threads.
+struct RandomStream
+{
+  uint32_t key[2];
+  uint32_t chunk;
+  uint32_t tick;
+  // next block to generate
+  uint64_t block;
+  uint32_t buffer[4];
+  // words of buffer already used, 4 when it is empty
+  uint32_t used;
+};
+
+inline void generateRandomBlock(const uint32_t key[2], uint64_t block, uint32_t chunk,
+                                uint32_t tick, uint32_t out[4])
+{
+  uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32), c2 = chunk, c3 = tick;
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; round++)
+  {
+    const uint64_t p0 = (uint64_t)RANDOM_PHILOX_M0 * c0;
+    const uint64_t p1 = (uint64_t)RANDOM_PHILOX_M1 * c2;
+    const uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    const uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c0 = n0;
+    c1 = (uint32_t)p1;
+    c2 = n2;
+    c3 = (uint32_t)p0;
+    k0 += RANDOM_PHILOX_W0;
+    k1 += RANDOM_PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+inline RandomStream createRandomStream(uint64_t seed, uint32_t pass = 0, uint32_t chunk = 0,
+                                       uint32_t tick = 0)
+{
+  // splitmix64 of the seed and the pass
+  uint64_t z = seed + (uint64_t)(pass + 1) * 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+
+  RandomStream stream{};
+  stream.key[0] = (uint32_t)z;
+  stream.key[1] = (uint32_t)(z >> 32);
+  stream.chunk = chunk;
+  stream.tick = tick;
+  stream.used = 4;
+  return stream;
+}
+
+inline uint32_t nextRandom(RandomStream& stream)
+{
+  if (stream.used == 4)
+  {
+    generateRandomBlock(stream.key, stream.block++, stream.chunk, stream.tick, stream.buffer);
+    stream.used = 0;
+  }
+  return stream.buffer[stream.used++];
+}
+
+// Uniform in [0, 1), 24 bits.
+inline float toRandomFloat(uint32_t bits)
+{
+  return (float)(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// Below bound by multiply and shift, biased by less than bound / 2^32.
+inline uint32_t toRandomBelow(uint32_t bits, uint32_t bound)
+{
+  return (uint32_t)(((uint64_t)bits * bound) >> 32);
+}
+
+inline float nextRandomFloat(RandomStream& stream)
+{
+  return toRandomFloat(nextRandom(stream));
+}
+
+inline uint32_t nextRandomBelow(RandomStream& stream, uint32_t bound)
+{
+  return toRandomBelow(nextRandom(stream), bound);
+}
+
+// In [min, max].
+inline int32_t nextRandomRange(RandomStream& stream, int32_t min, int32_t max)
+{
+  return min + (int32_t)nextRandomBelow(stream, (uint32_t)(max - min) + 1);
+}
+
+// The batch versions below give the same numbers as count calls of their scalar counterpart,
+// generating whole blocks 4 (SSE2) or 8 (AVX2) at a time.
+void fillRandom(RandomStream& stream, uint32_t* out, uint32_t count);
+void fillRandomFloats(RandomStream& stream, float* out, uint32_t count);
+void fillRandomBelow(RandomStream& stream, uint32_t* out, uint32_t count, uint32_t bound);
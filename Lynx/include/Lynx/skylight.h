@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Per-column heightmap of the first light-blocking tile. Tiles above the top of their column see
+// the open sky, so seeding sunlight only needs one value per column instead of a flood fill from
+// the top of the screen.
+struct SkylightHeightmap
+{
+  int width = 0;
+  int height = 0;
+  int wordsPerColumn = 0;
+
+  // one bit per tile, column-major, set when the tile blocks light
+  std::vector<uint64_t> opacity;
+  // y of the first light-blocking tile of each column, height when the column is fully open
+  std::vector<int32_t> columnTop;
+
+  // columns whose top changed since the last takeSkylightDirtyRange, [dirtyBegin, dirtyEnd)
+  int dirtyBegin = 0;
+  int dirtyEnd = 0;
+};
+
+// Cells of column x in [y0, y1) are sky-lit and border darker cells, so they are where the
+// light propagation has to start from.
+struct SkylightSpan
+{
+  int x;
+  int y0;
+  int y1;
+};
+
+// Matches the push constant block of lighting.fragment.glsl. Sky light is stored as a fraction
+// of full daylight, so changing the time of day only changes these values and never the CPU
+// light map.
+struct SkylightPushConstants
+{
+  float skyColor[4];
+  float dayBrightness;
+  // world tile at the top left of the light map
+  int32_t viewOriginX;
+  int32_t viewOriginY;
+  // columns in the column buffer, the world width
+  int32_t columnCount;
+};
+
+SkylightHeightmap createSkylightHeightmap(int width, int height);
+
+bool isTileOpaque(const SkylightHeightmap& heightmap, int x, int y);
+
+// Only touches the heightmap when the opacity of the tile actually changes. Rescans the column
+// below y when its top tile stops blocking light.
+void setTileOpacity(SkylightHeightmap& heightmap, int x, int y, bool opaque);
+
+// Rebuilds every column from the opacity bits, for use after bulk edits like loading or
+// world generation.
+void rebuildSkylightHeightmap(SkylightHeightmap& heightmap);
+
+inline int getSkylightTop(const SkylightHeightmap& heightmap, int x)
+{
+  return heightmap.columnTop[x];
+}
+
+inline bool isTileSkylit(const SkylightHeightmap& heightmap, int x, int y)
+{
+  return y < heightmap.columnTop[x];
+}
+
+// Appends one span per column in [x0, x1). O(x1 - x0).
+void collectSkylightSeeds(const SkylightHeightmap& heightmap, int x0, int x1,
+                          std::vector<SkylightSpan>& spans);
+
+// Writes the top of every column in [x0, x1) to dst, laid out for the column buffer read by
+// lighting.fragment.glsl.
+void copySkylightColumns(const SkylightHeightmap& heightmap, int x0, int x1, int32_t* dst);
+
+// Returns false if no column changed since the last call, otherwise the range of columns that
+// needs to be uploaded again.
+bool takeSkylightDirtyRange(SkylightHeightmap& heightmap, int& x0, int& x1);
+
+// timeOfDay in [0, 1), 0 being midnight and 0.5 noon.
+SkylightPushConstants getSkylightPushConstants(float timeOfDay);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Volk/volk.h>
+
+#include <Lynx/vk_utils.h>
+
+enum SpriteFlags : uint32_t
+{
+  // the texture holds a signed distance field in its red channel, 0.5 being the edge
+  SPRITE_SDF = 1 << 0,
+};
+
+// Matches SpriteInstance in sprite.vertex.glsl.
+struct SpriteInstance
+{
+  float position[2]; // top left
+  float size[2];
+  float uv[4]; // u0 v0 u1 v1
+  uint32_t color; // RGBA8, red in the low byte
+  uint32_t flags;
+  float padding[2];
+};
+static_assert(sizeof(SpriteInstance) == 48);
+
+// Maps pixels to clip space as clip = position * viewScale + viewOffset.
+struct SpritePushConstants
+{
+  float viewScale[2];
+  float viewOffset[2];
+};
+
+struct SpriteBatchCreateInfo
+{
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+
+  uint32_t maxSprites = 1 << 16;
+  uint32_t maxTextures = 64;
+  uint32_t framesInFlight = 2;
+
+  std::string vertexShader;
+  std::string fragmentShader;
+};
+
+struct SpriteDrawCommand
+{
+  uint32_t texture;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+};
+
+// Instanced quads written straight into a persistently mapped buffer. Consecutive sprites with
+// the same texture share one draw call, and nothing is allocated per frame once the command
+// list reached its working size.
+struct SpriteBatch
+{
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  uint32_t maxSprites = 0;
+  uint32_t maxTextures = 0;
+  uint32_t framesInFlight = 0;
+
+  GpuBuffer instances;
+
+  VkDescriptorSetLayout instanceSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSetLayout textureSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet instanceSet = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> textureSets;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  uint32_t frameIndex = 0;
+  uint32_t count = 0;
+  std::vector<SpriteDrawCommand> commands;
+};
+
+SpriteBatch createSpriteBatch(const SpriteBatchCreateInfo& createInfo);
+
+void destroySpriteBatch(SpriteBatch& batch);
+
+// The view must stay alive and in SHADER_READ_ONLY_OPTIMAL while the batch is drawn.
+uint32_t addSpriteTexture(SpriteBatch& batch, VkImageView imageView, VkSampler sampler);
+
+void beginSpriteBatch(SpriteBatch& batch, uint32_t frameIndex);
+
+// Returns space for count sprites using texture, or nullptr when the batch is full.
+SpriteInstance* allocateSprites(SpriteBatch& batch, uint32_t texture, uint32_t count);
+
+inline bool drawSprite(SpriteBatch& batch, uint32_t texture, const SpriteInstance& sprite)
+{
+  SpriteInstance* instance = allocateSprites(batch, texture, 1);
+  if (!instance)
+    return false;
+
+  *instance = sprite;
+  return true;
+}
+
+// See SpritePushConstants for the meaning of the view.
+void recordSpriteBatch(VkCommandBuffer commandBuffer, const SpriteBatch& batch,
+                       const float viewScale[2], const float viewOffset[2]);
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <Volk/volk.h>
+
+#include <TinyTTF/tiny_ttf.h>
+
+#include <Lynx/sprite_batch.h>
+#include <Lynx/vk_utils.h>
+
+struct TextSystemCreateInfo
+{
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  // contents of a .ttf file
+  std::string fontData;
+
+  // glyphs are rasterized once at this size and scaled by the sprite batch
+  float basePixelSize = 32.0f;
+  // distance field range in pixels on each side of the edge
+  int sdfPadding = 4;
+
+  uint32_t atlasWidth = 1024;
+  uint32_t atlasHeight = 1024;
+  uint32_t framesInFlight = 2;
+
+  // the layout cache is flushed when it grows past this
+  uint32_t maxCachedLayouts = 4096;
+};
+
+struct GlyphAtlasEntry
+{
+  float uv[4];
+  // offset from the pen position to the top left of the quad and its size, in base pixels
+  float offset[2];
+  float size[2];
+  float advance;
+  int glyph;
+  bool empty;
+};
+
+struct TextLayoutGlyph
+{
+  float position[2];
+  float size[2];
+  float uv[4];
+};
+
+// Glyph quads of a string positioned relative to its top left corner, in base pixels.
+struct TextLayout
+{
+  std::string text;
+  std::vector<TextLayoutGlyph> glyphs;
+  float width;
+  float height;
+};
+
+// Signed distance field glyphs packed on demand into a single atlas, plus a cache of laid out
+// strings keyed by their hash, so drawing a string that was drawn before only copies its quads
+// into the sprite batch.
+//
+// When the atlas fills up, glyphs already drawn this frame still need their place in it, so the
+// strings missing glyphs are drawn without them and the atlas is only cleared by the next
+// beginTextFrame. The font points into fontData, so the system can be neither copied nor moved.
+struct TextSystem
+{
+  TextSystem() = default;
+  TextSystem(const TextSystem&) = delete;
+  TextSystem& operator=(const TextSystem&) = delete;
+
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  std::string fontData;
+  ttf_font font{};
+  float basePixelSize = 0.0f;
+  float scale = 0.0f;
+  int sdfPadding = 0;
+  float ascent = 0.0f;
+  float lineHeight = 0.0f;
+
+  uint32_t atlasWidth = 0;
+  uint32_t atlasHeight = 0;
+  uint32_t framesInFlight = 0;
+  std::vector<uint8_t> atlasPixels;
+  // shelf packer
+  uint32_t shelfX = 0;
+  uint32_t shelfY = 0;
+  uint32_t shelfHeight = 0;
+  // rows of the atlas that changed since the last upload, [dirtyBegin, dirtyEnd)
+  uint32_t dirtyBegin = 0;
+  uint32_t dirtyEnd = 0;
+  bool atlasInitialized = false;
+  // a glyph did not fit this frame, the atlas is cleared by the next beginTextFrame
+  bool atlasResetPending = false;
+
+  VkImage atlasImage = VK_NULL_HANDLE;
+  VkDeviceMemory atlasMemory = VK_NULL_HANDLE;
+  VkImageView atlasView = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+  GpuBuffer staging;
+  uint32_t spriteTexture = 0;
+
+  std::unordered_map<uint32_t, GlyphAtlasEntry> glyphs;
+  std::unordered_map<uint64_t, TextLayout> layouts;
+  uint32_t maxCachedLayouts = 0;
+  // layout of a string missing glyphs, not cached
+  TextLayout partialLayout;
+};
+
+// Registers the atlas as a texture of batch. Throws when the font is malformed.
+void createTextSystem(TextSystem& text, const TextSystemCreateInfo& createInfo,
+                      SpriteBatch& batch);
+
+void destroyTextSystem(TextSystem& text);
+
+// Clears the atlas if it ran full during the last frame. Must be called before the first
+// string of a frame is drawn.
+void beginTextFrame(TextSystem& text);
+
+// Cached by the hash of the string; the returned reference stays valid until the next call
+// that misses the cache. Glyphs that do not fit in the atlas this frame are left out.
+const TextLayout& getTextLayout(TextSystem& text, std::string_view string);
+
+// Writes one SDF sprite per glyph of layout into sprites, with the top left of the first line at
+// (x, y).
+void writeTextSprites(const TextSystem& text, const TextLayout& layout, float x, float y,
+                      float pixelSize, uint32_t color, SpriteInstance* sprites);
+
+// Top left of the first line at (x, y). Returns false if the sprite batch is full.
+bool drawText(SpriteBatch& batch, TextSystem& text, std::string_view string, float x, float y,
+              float pixelSize, uint32_t color);
+
+// Size of the string at pixelSize, without drawing it.
+void measureText(TextSystem& text, std::string_view string, float pixelSize, float& width,
+                 float& height);
+
+// Uploads glyphs rasterized since the last call. Must be recorded outside of a render pass and
+// before the sprite batch is drawn.
+void recordTextUploads(VkCommandBuffer commandBuffer, TextSystem& text, uint32_t frameIndex);
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/tile_store.h>
+
+// Neighbours of a tile as bits of an 8 bit mask, clockwise from above.
+enum TileNeighbour : uint8_t
+{
+  TILE_NEIGHBOUR_N = 1 << 0,
+  TILE_NEIGHBOUR_NE = 1 << 1,
+  TILE_NEIGHBOUR_E = 1 << 2,
+  TILE_NEIGHBOUR_SE = 1 << 3,
+  TILE_NEIGHBOUR_S = 1 << 4,
+  TILE_NEIGHBOUR_SW = 1 << 5,
+  TILE_NEIGHBOUR_W = 1 << 6,
+  TILE_NEIGHBOUR_NW = 1 << 7,
+};
+
+// A corner only shows when both sides next to it connect too, which leaves 47 distinct masks.
+constexpr uint8_t reduceTileNeighbourMask(uint8_t mask)
+{
+  const bool n = mask & TILE_NEIGHBOUR_N, e = mask & TILE_NEIGHBOUR_E;
+  const bool s = mask & TILE_NEIGHBOUR_S, w = mask & TILE_NEIGHBOUR_W;
+  if (!n || !e)
+    mask &= ~TILE_NEIGHBOUR_NE;
+  if (!s || !e)
+    mask &= ~TILE_NEIGHBOUR_SE;
+  if (!s || !w)
+    mask &= ~TILE_NEIGHBOUR_SW;
+  if (!n || !w)
+    mask &= ~TILE_NEIGHBOUR_NW;
+  return mask;
+}
+
+constexpr const uint32_t TILE_BLOB_FRAME_COUNT = 47;
+
+// Frame of every neighbour mask, the rank of its reduced mask among the reduced masks.
+constexpr std::array<uint8_t, 256> makeTileBlobFrames()
+{
+  std::array<uint8_t, 256> frames{};
+  uint8_t count = 0;
+  for (uint32_t mask = 0; mask < 256; mask++)
+  {
+    if (reduceTileNeighbourMask((uint8_t)mask) == mask)
+      frames[mask] = count++;
+  }
+  for (uint32_t mask = 0; mask < 256; mask++)
+    frames[mask] = frames[reduceTileNeighbourMask((uint8_t)mask)];
+  return frames;
+}
+
+// Reduced neighbour mask of every frame, for laying out atlases.
+constexpr std::array<uint8_t, TILE_BLOB_FRAME_COUNT> makeTileBlobMasks()
+{
+  std::array<uint8_t, TILE_BLOB_FRAME_COUNT> masks{};
+  uint32_t count = 0;
+  for (uint32_t mask = 0; mask < 256; mask++)
+  {
+    if (reduceTileNeighbourMask((uint8_t)mask) == mask)
+      masks[count++] = (uint8_t)mask;
+  }
+  return masks;
+}
+
+constexpr const std::array<uint8_t, 256> TILE_BLOB_FRAMES = makeTileBlobFrames();
+constexpr const std::array<uint8_t, TILE_BLOB_FRAME_COUNT> TILE_BLOB_MASKS = makeTileBlobMasks();
+static_assert(TILE_BLOB_FRAMES[255] == TILE_BLOB_FRAME_COUNT - 1);
+
+// Sides of a tile left open by its slope, as N, E, S and W neighbour bits. Nothing connects
+// through an open side.
+constexpr const uint8_t TILE_SLOPE_OPEN_SIDES[6] = {
+  0,
+  TILE_NEIGHBOUR_N,
+  TILE_NEIGHBOUR_N | TILE_NEIGHBOUR_E,
+  TILE_NEIGHBOUR_N | TILE_NEIGHBOUR_W,
+  TILE_NEIGHBOUR_S | TILE_NEIGHBOUR_E,
+  TILE_NEIGHBOUR_S | TILE_NEIGHBOUR_W,
+};
+
+// Frame word: blob frame in bits 0-5, the N, E, S and W sides that connect to a different type
+// it merges with in bits 6-9 for blended edges, and one of three variants in bits 10-11 so
+// repeated tiles do not all look the same.
+constexpr const uint16_t TILE_FRAME_BLOB_MASK = 0x3f;
+constexpr const uint32_t TILE_FRAME_BLEND_SHIFT = 6;
+constexpr const uint16_t TILE_FRAME_BLEND_MASK = 0xf;
+constexpr const uint32_t TILE_FRAME_VARIANT_SHIFT = 10;
+constexpr const uint16_t TILE_FRAME_VARIANT_MASK = 0x3;
+
+constexpr const uint8_t TILE_NO_MERGE_CLASS = 0xff;
+
+struct TileFramingChunk
+{
+  // tiles to frame again, bit x of rows[y]
+  uint32_t rows[TILE_CHUNK_SIZE];
+  bool listed;
+};
+
+struct TileFramingStats
+{
+  uint32_t chunks;
+  uint64_t tiles;
+  uint64_t nanoseconds;
+};
+
+// Frames of auto-tiled blocks. Changes reported to the store's listeners mark the changed tiles
+// and their neighbours dirty, and updateTileFraming frames only those again: the frame of a tile
+// comes from which of its 8 neighbours connect, looked up in TILE_BLOB_FRAMES. Two tiles connect
+// when they are of the same type or the first merges with the merge class of the second, and
+// neither has an open side toward the other.
+//
+// Frames are kept per chunk and only for chunks that held a framed type. A chunk is framed by
+// one job reading a 34x34 window of the store, so many dirty chunks, as after loading or
+// generating a world, are framed in parallel.
+struct TileFraming
+{
+  TileStore* store = nullptr;
+  JobSystem* jobs = nullptr;
+
+  // by type
+  std::vector<uint8_t> autoTiled;
+  std::vector<uint8_t> mergeClasses;
+  // bit c set when the type connects to types of merge class c
+  std::vector<uint8_t> mergesWith;
+
+  // by slot, null for chunks never framed
+  std::vector<std::unique_ptr<uint16_t[]>> frames;
+  std::vector<TileFramingChunk> chunks;
+  std::vector<uint32_t> chunkX, chunkY;
+  std::vector<uint32_t> dirtyChunks;
+  // dirty chunks from which updates run as jobs
+  uint32_t parallelChunks = 8;
+  TileFramingStats stats{};
+};
+
+// The framing is referenced by a listener of store, so it is created in place.
+void createTileFraming(TileFraming& framing, TileStore& store, JobSystem& jobs);
+
+void destroyTileFraming(TileFraming& framing);
+
+// Auto-tiles type. It connects to its own type and to the types of the merge classes in
+// mergesWith, a bit per class below 8. Types without a call keep the frames they are given, as
+// furniture does.
+void setTileFramingType(TileFraming& framing, uint16_t type, uint8_t mergeClass,
+                        uint8_t mergesWith);
+
+void markTileFramingDirty(TileFraming& framing, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+// Frames the dirty tiles. Loads unloaded chunks next to them.
+const TileFramingStats& updateTileFraming(TileFraming& framing);
+
+// Frames the whole world, after loading or generating it.
+const TileFramingStats& frameAllTiles(TileFraming& framing);
+
+inline uint16_t getTileFrame(const TileFraming& framing, int32_t x, int32_t y)
+{
+  const uint16_t* frames = framing.frames[getTileChunkSlot(*framing.store, x, y)].get();
+  return frames ? frames[getTileIndexInChunk(x, y)] : 0;
+}
+
+// Frames set by hand, for types that are not auto-tiled.
+void setTileFrame(TileFraming& framing, int32_t x, int32_t y, uint16_t frame);
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/tile_store.h>
+
+struct TileTypeCount
+{
+  uint16_t type;
+  uint16_t count;
+};
+
+struct TileIndexChunk
+{
+  // active tiles by type, in increasing type
+  std::vector<TileTypeCount> counts;
+  // tiles of indexed types as type << 10 | index in chunk, in increasing order
+  std::vector<uint32_t> indexed;
+  bool stale;
+};
+
+struct TileIndexStats
+{
+  uint32_t refreshedChunks;
+  uint64_t nanoseconds;
+};
+
+// Where tiles of each type are, kept up to date with the store. Every chunk has a histogram of
+// its active tile types and the world totals are the sum of them; types marked indexed, rare
+// ones like altars and life crystals, also have the positions of their tiles per chunk and the
+// list of chunks holding them. Counting a type in the world costs nothing, counting it in a
+// rect costs the chunks it covers and the tiles of those only partly inside, and finding the
+// tiles of an indexed type costs the tiles found.
+//
+// Writes of single tiles move one count from the type before to the type after. Listeners of the
+// store mark chunks changed in bulk stale, and queries count those again first, as jobs when
+// there are many. Unloaded chunks are counted once they are loaded, queries skip them until then.
+struct TileIndex
+{
+  TileStore* store = nullptr;
+  JobSystem* jobs = nullptr;
+
+  // by type, the entry of indexedChunks plus one, 0 when not indexed
+  std::vector<uint32_t> indexedTypes;
+  // chunks holding tiles of each indexed type
+  std::vector<std::vector<uint32_t>> indexedChunks;
+
+  // by chunk index, cy * chunksX + cx
+  std::vector<TileIndexChunk> chunks;
+  std::vector<uint32_t> staleChunks;
+  // by type
+  std::vector<uint64_t> totals;
+  // by thread, a counter per type, all 0 between uses
+  std::vector<std::vector<uint16_t>> threadCounts;
+  // stale chunks from which refreshing runs as jobs
+  uint32_t parallelChunks = 8;
+  TileIndexStats stats{};
+};
+
+// The index is referenced by a listener of store, so it is created in place. Every chunk is
+// counted on the first query.
+void createTileIndex(TileIndex& index, TileStore& store, JobSystem& jobs);
+
+void destroyTileIndex(TileIndex& index);
+
+// Keeps the positions of the tiles of type.
+void setTileTypeIndexed(TileIndex& index, uint16_t type);
+
+// Counts the stale chunks again. Queries call it themselves.
+const TileIndexStats& refreshTileIndex(TileIndex& index);
+
+uint64_t countTilesInWorld(TileIndex& index, uint16_t type);
+
+// Active tiles of type in [x0, x1) x [y0, y1) of the loaded chunks.
+uint64_t countTilesInRect(TileIndex& index, uint16_t type, int32_t x0, int32_t y0, int32_t x1,
+                          int32_t y1);
+
+// Tile of the indexed type closest to (x, y). Returns false when there is none.
+bool findNearestTile(TileIndex& index, uint16_t type, int32_t x, int32_t y, int32_t& outX,
+                     int32_t& outY);
+
+// Calls fn(int32_t x, int32_t y) for every tile of the indexed type.
+template <typename F>
+void forEachIndexedTile(TileIndex& index, uint16_t type, F&& fn)
+{
+  refreshTileIndex(index);
+  if (!index.indexedTypes[type])
+    return;
+
+  const TileStore& store = *index.store;
+  for (uint32_t chunk : index.indexedChunks[index.indexedTypes[type] - 1])
+  {
+    const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+    const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+    for (uint32_t entry : index.chunks[chunk].indexed)
+    {
+      if (entry >> 10 != type)
+        continue;
+      const uint32_t i = entry & (TILE_CHUNK_TILES - 1);
+      fn(x0 + (int32_t)(i & TILE_CHUNK_MASK), y0 + (int32_t)(i >> TILE_CHUNK_SHIFT));
+    }
+  }
+}
@@ -0,0 +1,522 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr const int32_t TILE_CHUNK_SHIFT = 5;
+constexpr const int32_t TILE_CHUNK_SIZE = 1 << TILE_CHUNK_SHIFT;
+constexpr const int32_t TILE_CHUNK_MASK = TILE_CHUNK_SIZE - 1;
+constexpr const int32_t TILE_CHUNK_TILES = TILE_CHUNK_SIZE * TILE_CHUNK_SIZE;
+constexpr const uint32_t TILE_TYPE_COUNT = 1 << 16;
+
+enum TileFlags : uint8_t
+{
+  TILE_ACTIVE = 1 << 0,
+  // copied from the properties of the type whenever the type changes
+  TILE_SOLID = 1 << 1,
+  TILE_OPAQUE = 1 << 2,
+  // turned off by an actuator, still there but not solid
+  TILE_ACTUATED = 1 << 3,
+};
+
+constexpr const uint8_t TILE_TYPE_FLAGS = TILE_SOLID | TILE_OPAQUE;
+
+enum TileSlope : uint8_t
+{
+  TILE_SLOPE_NONE,
+  TILE_HALF_BLOCK,
+  TILE_SLOPE_DOWN_RIGHT,
+  TILE_SLOPE_DOWN_LEFT,
+  TILE_SLOPE_UP_RIGHT,
+  TILE_SLOPE_UP_LEFT,
+};
+
+enum TileLiquidType : uint8_t
+{
+  TILE_LIQUID_WATER,
+  TILE_LIQUID_LAVA,
+  TILE_LIQUID_HONEY,
+  TILE_LIQUID_SHIMMER,
+};
+
+enum TileWires : uint8_t
+{
+  TILE_WIRE_RED = 1 << 0,
+  TILE_WIRE_BLUE = 1 << 1,
+  TILE_WIRE_GREEN = 1 << 2,
+  TILE_WIRE_YELLOW = 1 << 3,
+};
+
+// Cold attributes packed in 32 bits: wall:10 wallPaint:5 paint:5 slope:3 liquidType:2 wires:4
+// actuator:1.
+constexpr const uint32_t TILE_WALL_SHIFT = 0;
+constexpr const uint32_t TILE_WALL_MASK = 0x3ff;
+constexpr const uint32_t TILE_WALL_PAINT_SHIFT = 10;
+constexpr const uint32_t TILE_PAINT_SHIFT = 15;
+constexpr const uint32_t TILE_PAINT_MASK = 0x1f;
+constexpr const uint32_t TILE_SLOPE_SHIFT = 20;
+constexpr const uint32_t TILE_SLOPE_MASK = 0x7;
+constexpr const uint32_t TILE_LIQUID_TYPE_SHIFT = 23;
+constexpr const uint32_t TILE_LIQUID_TYPE_MASK = 0x3;
+constexpr const uint32_t TILE_WIRES_SHIFT = 25;
+constexpr const uint32_t TILE_WIRES_MASK = 0xf;
+constexpr const uint32_t TILE_ACTUATOR_BIT = 1u << 29;
+
+// Unpacked copy of a tile, for code that is not on a hot path.
+struct Tile
+{
+  uint16_t type = 0;
+  uint8_t flags = 0;
+  uint8_t liquid = 0;
+  uint16_t wall = 0;
+  uint8_t wallPaint = 0;
+  uint8_t paint = 0;
+  uint8_t slope = TILE_SLOPE_NONE;
+  uint8_t liquidType = TILE_LIQUID_WATER;
+  uint8_t wires = 0;
+  bool actuator = false;
+};
+
+// What rendering, lighting and collision read for every tile.
+struct TileChunkHot
+{
+  uint16_t types[TILE_CHUNK_TILES];
+  uint8_t flags[TILE_CHUNK_TILES];
+};
+
+struct TileChunkCold
+{
+  uint8_t liquids[TILE_CHUNK_TILES];
+  uint32_t attributes[TILE_CHUNK_TILES];
+};
+
+// Chunk that was written recently. Hot and cold fields share one allocation per chunk rather than
+// living in world-sized hot and cold arrays: chunks are raw or compressed one by one, so a raw
+// chunk is allocated when it is decompressed and freed when it is compressed again. The split
+// still holds within the chunk, the hot fields fill the first 48 cache lines and the cold ones
+// start on a line of their own, so scans of the hot fields never load cold data.
+struct alignas(64) TileChunkRaw
+{
+  TileChunkHot hot;
+  TileChunkCold cold;
+};
+static_assert(sizeof(TileChunkHot) % 64 == 0);
+
+// All fields of one tile, the unit compressed chunks are made of.
+struct TileRecord
+{
+  uint16_t type;
+  uint8_t flags;
+  uint8_t liquid;
+  uint32_t attributes;
+};
+static_assert(sizeof(TileRecord) == 8);
+
+enum TileChunkFormat : uint8_t
+{
+  TILE_CHUNK_RAW,
+  // palette[0] everywhere
+  TILE_CHUNK_UNIFORM,
+  // bitsPerIndex wide palette indices, never straddling two words
+  TILE_CHUNK_PALETTE,
+  // row-major runs of palette indices, run r covers tiles up to runEnds[r] included
+  TILE_CHUNK_RUNS,
+};
+
+constexpr const uint32_t TILE_CHUNK_MAX_PALETTE = 256;
+
+struct TileChunkEncoding
+{
+  TileChunkFormat format = TILE_CHUNK_RAW;
+  uint8_t bitsPerIndex = 0;
+  std::vector<TileRecord> palette;
+  std::vector<uint64_t> indices;
+  std::vector<uint16_t> runEnds;
+  std::vector<uint8_t> runIndices;
+};
+
+// Either raw or compressed. Compressed chunks are decompressed by the first write and raw chunks
+// that were not written for a while are compressed again by the TileCompressor.
+struct TileChunk
+{
+  std::unique_ptr<TileChunkRaw> raw;
+  TileChunkEncoding packed;
+  // store clock of the last write and a counter of writes, to drop compressions of stale copies
+  uint32_t lastWrite = 0;
+  uint32_t version = 0;
+  bool compressing = false;
+  // still on disk, the chunk loader of the store brings it in on first access
+  bool unloaded = false;
+};
+
+// [x0, x1) x [y0, y1) changed.
+using TileChangeFn = void (*)(void* userData, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+// The single tile at (x, y) was written, before and after are its records around the write.
+using TileWriteFn = void (*)(void* userData, int32_t x, int32_t y, const TileRecord& before,
+                             const TileRecord& after);
+
+struct TileChangeListener
+{
+  TileChangeFn fn;
+  // called instead of fn for writes of single tiles when set
+  TileWriteFn writeFn;
+  void* userData;
+};
+
+struct TileStore;
+struct TileSnapshot;
+
+// Fills the chunk at slot with installTileChunk.
+using TileChunkLoadFn = void (*)(void* userData, TileStore& store, uint32_t slot);
+
+// Tiles of up to 32 consecutive columns of one row, all in the same chunk.
+struct TileRowSpan
+{
+  uint16_t* types;
+  uint8_t* flags;
+  uint8_t* liquids;
+  uint32_t* attributes;
+  int32_t count;
+};
+
+struct TileRowView
+{
+  const uint16_t* types;
+  const uint8_t* flags;
+  const uint8_t* liquids;
+  const uint32_t* attributes;
+  int32_t count;
+};
+
+// Storage for the rows of compressed chunks while they are being read.
+struct TileRowBuffer
+{
+  uint16_t types[TILE_CHUNK_SIZE];
+  uint8_t flags[TILE_CHUNK_SIZE];
+  uint8_t liquids[TILE_CHUNK_SIZE];
+  uint32_t attributes[TILE_CHUNK_SIZE];
+};
+
+struct TileStoreMemoryReport
+{
+  uint64_t residentBytes;
+  // what the same chunks take with every one of them raw
+  uint64_t uncompressedBytes;
+  uint32_t rawChunks;
+  uint32_t uniformChunks;
+  uint32_t paletteChunks;
+  uint32_t runChunks;
+  uint32_t unloadedChunks;
+};
+
+// The world grid, 8 bytes per tile at most. Tiles are grouped in 32x32 chunks stored row-major,
+// so a chunk row of types is a single cache line and scanning a row of the world walks memory
+// sequentially 32 tiles at a time. Raw chunks keep hot fields and cold fields apart.
+// The chunk table is laid out in Morton order of the chunk coordinates so neighbouring chunks
+// stay close in memory in both directions.
+//
+// Most of a world is long stretches of the same few tiles, so chunks are stored as a single
+// record, a palette with packed indices or palette runs whenever that is smaller. Reads decode
+// compressed chunks in place, every write goes through a raw copy.
+struct TileStore
+{
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t chunksX = 0;
+  int32_t chunksY = 0;
+
+  // slot of the chunk at (cx, cy) in chunks, indexed by cy * chunksX + cx
+  std::vector<uint32_t> chunkSlots;
+  std::vector<TileChunk> chunks;
+  // advanced by updateTileCompressor, stamped on chunks when they are written
+  uint32_t clock = 0;
+
+  // TILE_SOLID and TILE_OPAQUE of every type
+  std::vector<uint8_t> typeFlags;
+
+  std::vector<TileChangeListener> listeners;
+
+  // called for unloaded chunks the first time they are read or written
+  TileChunkLoadFn chunkLoader = nullptr;
+  void* chunkLoaderUserData = nullptr;
+  uint32_t unloadedChunks = 0;
+
+  // snapshot in progress and its number; a chunk is part of snapshot snapshotEpoch once its state
+  // reaches 2 * snapshotEpoch, 2 * snapshotEpoch - 1 while it is being copied or read
+  TileSnapshot* snapshot = nullptr;
+  uint32_t snapshotEpoch = 0;
+  std::unique_ptr<std::atomic<uint32_t>[]> snapshotStates;
+};
+
+// The store as it was when the snapshot began, readable from another thread while the game keeps
+// writing. Beginning a snapshot touches no chunk; instead the first write to each chunk afterwards
+// copies it, unless the reader got to it first. Writes only wait for a reader that is copying the
+// same chunk at that moment.
+struct TileSnapshot
+{
+  // chunks written since the snapshot began, as they were before the write
+  std::vector<TileChunk> copies;
+  // chunks not yet handed out by readTileSnapshotChunk
+  std::atomic<uint32_t> remaining{ 0 };
+  // chunks the game thread had to copy, for tuning
+  uint32_t copiedChunks = 0;
+};
+
+// width and height are rounded up to whole chunks internally but tiles outside of them are not
+// part of the world.
+TileStore createTileStore(int32_t width, int32_t height);
+
+void setTileTypeFlags(TileStore& store, uint16_t type, uint8_t flags);
+
+void addTileChangeListener(TileStore& store, TileChangeFn fn, void* userData);
+// Also told the records of single tiles written, for listeners that keep counts.
+void addTileChangeListener(TileStore& store, TileChangeFn fn, TileWriteFn writeFn,
+                           void* userData);
+void removeTileChangeListener(TileStore& store, TileChangeFn fn, void* userData);
+
+// For code that writes through row spans.
+void notifyTilesChanged(const TileStore& store, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+inline bool isInTileStore(const TileStore& store, int32_t x, int32_t y)
+{
+  return x >= 0 && y >= 0 && x < store.width && y < store.height;
+}
+
+inline uint32_t getTileChunkSlot(const TileStore& store, int32_t x, int32_t y)
+{
+  return store.chunkSlots[(y >> TILE_CHUNK_SHIFT) * store.chunksX + (x >> TILE_CHUNK_SHIFT)];
+}
+
+inline uint32_t getTileIndexInChunk(int32_t x, int32_t y)
+{
+  return (uint32_t)(((y & TILE_CHUNK_MASK) << TILE_CHUNK_SHIFT) | (x & TILE_CHUNK_MASK));
+}
+
+// Record i of a compressed chunk.
+TileRecord getPackedTileRecord(const TileChunkEncoding& packed, uint32_t i);
+
+// Record i of a chunk that is not raw, loading it first if it is still unloaded. Loading changes
+// the chunk table, so reads of unloaded chunks must not race with each other.
+TileRecord getStoredTileRecord(const TileStore& store, const TileChunk& chunk, uint32_t i);
+
+// The accessors below expect coordinates inside the world.
+
+inline const TileChunk& getTileChunk(const TileStore& store, int32_t x, int32_t y)
+{
+  return store.chunks[getTileChunkSlot(store, x, y)];
+}
+
+inline uint16_t getTileType(const TileStore& store, int32_t x, int32_t y)
+{
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  if (chunk.raw)
+    return chunk.raw->hot.types[getTileIndexInChunk(x, y)];
+  return getStoredTileRecord(store, chunk, getTileIndexInChunk(x, y)).type;
+}
+
+inline uint8_t getTileFlags(const TileStore& store, int32_t x, int32_t y)
+{
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  if (chunk.raw)
+    return chunk.raw->hot.flags[getTileIndexInChunk(x, y)];
+  return getStoredTileRecord(store, chunk, getTileIndexInChunk(x, y)).flags;
+}
+
+inline bool isTileSolid(const TileStore& store, int32_t x, int32_t y)
+{
+  const uint8_t flags = getTileFlags(store, x, y);
+  return (flags & (TILE_ACTIVE | TILE_SOLID | TILE_ACTUATED)) == (TILE_ACTIVE | TILE_SOLID);
+}
+
+inline uint8_t getTileLiquid(const TileStore& store, int32_t x, int32_t y)
+{
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  if (chunk.raw)
+    return chunk.raw->cold.liquids[getTileIndexInChunk(x, y)];
+  return getStoredTileRecord(store, chunk, getTileIndexInChunk(x, y)).liquid;
+}
+
+inline uint16_t getTileWall(const TileStore& store, int32_t x, int32_t y)
+{
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  const uint32_t attributes =
+    chunk.raw ? chunk.raw->cold.attributes[getTileIndexInChunk(x, y)]
+              : getStoredTileRecord(store, chunk, getTileIndexInChunk(x, y)).attributes;
+  return (uint16_t)((attributes >> TILE_WALL_SHIFT) & TILE_WALL_MASK);
+}
+
+uint32_t packTileAttributes(const Tile& tile);
+void unpackTileAttributes(uint32_t attributes, Tile& tile);
+
+Tile getTile(const TileStore& store, int32_t x, int32_t y);
+
+void setTile(TileStore& store, int32_t x, int32_t y, const Tile& tile);
+
+// Places a tile of type, keeping the wall, liquid and wiring.
+void setTileType(TileStore& store, int32_t x, int32_t y, uint16_t type);
+void removeTile(TileStore& store, int32_t x, int32_t y);
+void setTileWall(TileStore& store, int32_t x, int32_t y, uint16_t wall);
+void setTileLiquid(TileStore& store, int32_t x, int32_t y, uint8_t amount, uint8_t liquidType);
+
+// Clipped to the world, listeners are notified once for the whole rectangle. Chunks covered
+// entirely become uniform without being decompressed.
+void fillTiles(TileStore& store, int32_t x0, int32_t y0, int32_t x1, int32_t y1, const Tile& tile);
+
+// Raw chunk for writing, loading and decompressing it if needed.
+TileChunkRaw& getWritableTileChunk(TileStore& store, uint32_t slot);
+
+// Marks every chunk unloaded, for stores filled lazily by loader.
+void setTileChunkLoader(TileStore& store, TileChunkLoadFn loader, void* userData);
+
+// Loads the chunk now if it is unloaded.
+void loadTileChunk(const TileStore& store, uint32_t slot);
+
+// Replaces the contents of the chunk without counting as a write, for loaders. A raw encoding
+// takes the tiles from raw instead.
+void installTileChunk(TileStore& store, uint32_t slot, TileChunkEncoding&& packed,
+                      const TileChunkRaw* raw = nullptr);
+
+// Smallest compressed encoding of raw. Returns false when the chunk has more distinct records
+// than a palette can hold.
+bool encodeTileChunk(const TileChunkRaw& raw, TileChunkEncoding& packed);
+
+// Tiles from (x, y) to the end of its chunk row or of the world, for writing. Decompresses the
+// chunk. Writing through the span does not notify listeners.
+TileRowSpan getTileRowSpan(TileStore& store, int32_t x, int32_t y);
+
+// Same for reading, rows of compressed chunks are decoded into buffer.
+TileRowView getTileRowView(const TileStore& store, int32_t x, int32_t y, TileRowBuffer& buffer);
+
+// Calls fn(const TileRowSpan& span, int32_t x) for consecutive spans covering [x0, x1) of row y,
+// in increasing x. The range is clipped to the world.
+template <typename F>
+void forEachTileRowSpan(TileStore& store, int32_t y, int32_t x0, int32_t x1, F&& fn)
+{
+  if (y < 0 || y >= store.height)
+    return;
+
+  x0 = x0 < 0 ? 0 : x0;
+  x1 = x1 > store.width ? store.width : x1;
+  while (x0 < x1)
+  {
+    TileRowSpan span = getTileRowSpan(store, x0, y);
+    if (span.count > x1 - x0)
+      span.count = x1 - x0;
+    fn(span, x0);
+    x0 += span.count;
+  }
+}
+
+// Read-only counterpart of forEachTileRowSpan, fn(const TileRowView& view, int32_t x).
+template <typename F>
+void forEachTileRowView(const TileStore& store, int32_t y, int32_t x0, int32_t x1, F&& fn)
+{
+  if (y < 0 || y >= store.height)
+    return;
+
+  TileRowBuffer buffer;
+  x0 = x0 < 0 ? 0 : x0;
+  x1 = x1 > store.width ? store.width : x1;
+  while (x0 < x1)
+  {
+    TileRowView view = getTileRowView(store, x0, y, buffer);
+    if (view.count > x1 - x0)
+      view.count = x1 - x0;
+    fn(view, x0);
+    x0 += view.count;
+  }
+}
+
+// Starts a snapshot of store in constant time. Returns false while chunks are still unloaded, as
+// the snapshot reader cannot load them.
+bool beginTileSnapshot(TileStore& store, TileSnapshot& snapshot);
+
+// Calls fn(const TileChunk& chunk) with the chunk at slot as it was when the snapshot began. May be
+// called from any thread, once per slot; the chunk is only valid during the call, which should be
+// short as a write to the chunk waits for it.
+template <typename F>
+void readTileSnapshotChunk(const TileStore& store, TileSnapshot& snapshot, uint32_t slot, F&& fn)
+{
+  std::atomic<uint32_t>& state = store.snapshotStates[slot];
+  const uint32_t done = 2 * store.snapshotEpoch;
+
+  uint32_t current = state.load(std::memory_order_acquire);
+  if (current < done - 1 &&
+      state.compare_exchange_strong(current, done - 1, std::memory_order_acq_rel))
+  {
+    // not written since the snapshot began, the live chunk is still the snapshot's
+    fn(store.chunks[slot]);
+    state.store(done, std::memory_order_release);
+  }
+  else
+  {
+    // the game thread is copying it or has copied it
+    while (state.load(std::memory_order_acquire) != done)
+      std::this_thread::yield();
+    TileChunk& copy = snapshot.copies[slot];
+    fn((const TileChunk&)copy);
+    copy.raw.reset();
+    copy.packed = {};
+  }
+
+  snapshot.remaining.fetch_sub(1, std::memory_order_release);
+}
+
+// True once every chunk was read.
+bool isTileSnapshotRead(const TileSnapshot& snapshot);
+
+// Stops copying chunks on write. The snapshot must have been read entirely.
+void endTileSnapshot(TileStore& store, TileSnapshot& snapshot);
+
+// Compresses the chunk now if that makes it smaller. Returns true if it is compressed.
+bool compressTileChunk(TileStore& store, uint32_t slot);
+
+// Compresses every raw chunk, for use after world generation or loading.
+void compressTileStore(TileStore& store);
+
+TileStoreMemoryReport getTileStoreMemoryReport(const TileStore& store);
+
+struct TileCompressJob
+{
+  uint32_t slot;
+  uint32_t version;
+  std::unique_ptr<TileChunkRaw> copy;
+  TileChunkEncoding packed;
+  bool compressed;
+};
+
+// Recompresses chunks that were not written for idleTicks updates on a worker thread. The game
+// thread only copies the chunk for the worker, and swaps the result in if the chunk was not
+// written in the meantime.
+struct TileCompressor
+{
+  uint32_t idleTicks = 0;
+  uint32_t maxJobsInFlight = 0;
+  // chunks scanned per update, so finding idle chunks is spread over many frames
+  uint32_t scanPerUpdate = 0;
+  uint32_t scanCursor = 0;
+  uint32_t jobsInFlight = 0;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<TileCompressJob> requests;
+  std::deque<TileCompressJob> results;
+  bool quit = false;
+};
+
+// The compressor owns a thread and is referenced by it, so it is created in place.
+void createTileCompressor(TileCompressor& compressor, uint32_t idleTicks = 600,
+                          uint32_t maxJobsInFlight = 64, uint32_t scanPerUpdate = 512);
+
+void destroyTileCompressor(TileCompressor& compressor);
+
+// Advances the store clock, installs finished compressions and hands idle chunks to the worker.
+void updateTileCompressor(TileCompressor& compressor, TileStore& store);
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/tile_store.h>
+
+struct TileUpdate
+{
+  int32_t x, y;
+};
+
+// Updates every tile of a batch had type when it was picked. Handlers run one after another, so
+// an earlier one may have changed a tile since.
+using TileUpdateFn = void (*)(void* userData, TileStore& store, uint16_t type,
+                              const TileUpdate* updates, uint32_t count);
+
+struct TileUpdateHandler
+{
+  uint16_t type;
+  TileUpdateFn fn;
+  void* userData;
+  std::vector<TileUpdate> batch;
+};
+
+enum TileUpdateChunkState : uint8_t
+{
+  // changed since it was last looked at
+  TILE_UPDATE_CHUNK_STALE,
+  TILE_UPDATE_CHUNK_IDLE,
+  TILE_UPDATE_CHUNK_UPDATABLE,
+};
+
+// Picks a job made, by handler.
+struct TileUpdatePick
+{
+  int32_t x, y;
+  uint32_t handler;
+};
+
+struct TileUpdateThread
+{
+  std::vector<TileUpdatePick> picks;
+};
+
+struct TileUpdateStats
+{
+  uint32_t chunks;
+  // random tiles drawn and those handed to handlers
+  uint64_t picks;
+  uint64_t updates;
+  uint64_t nanoseconds;
+};
+
+// Random tile updates, for grass spreading, trees and plants growing and the like. Rather than
+// drawing tiles across the whole world, every resident chunk holding a type with a handler draws
+// a Poisson count of tiles of its own with mean updatesPerTick times its share of the world,
+// which updates each tile as often on average as drawing updatesPerTick tiles of the world, and
+// chunks without such types are not visited at all. A chunk draws from the random stream of its
+// chunk index and the tick, so the picks do not depend on the thread count.
+//
+// Chunks draw in parallel, reading only their own tiles. The picks are then handed to the
+// handlers batched by type, in chunk order, on the calling thread: handlers write through the
+// store, whose listeners are not thread safe.
+struct TileUpdater
+{
+  TileStore* store = nullptr;
+  JobSystem* jobs = nullptr;
+  uint64_t seed = 0;
+  uint32_t pass = 0;
+  uint32_t tick = 0;
+  double updatesPerTick = 0.0;
+
+  std::vector<TileUpdateHandler> handlers;
+  // by type, index of its handler plus one, 0 for none
+  std::vector<uint32_t> handlerIndices;
+
+  // by chunk index, cy * chunksX + cx
+  std::vector<uint8_t> chunkStates;
+  std::vector<uint32_t> staleChunks;
+  // updatable chunks in increasing chunk index
+  std::vector<uint32_t> chunkList;
+  // by entry of chunkList, the thread that drew it and where its picks begin and end
+  std::vector<uint32_t> pickThreads, pickBegins, pickEnds;
+  std::vector<TileUpdateThread> threads;
+  TileUpdateStats stats{};
+};
+
+// The updater is referenced by a listener of store, so it is created in place.
+void createTileUpdater(TileUpdater& updater, TileStore& store, JobSystem& jobs, uint64_t seed,
+                       double updatesPerTick);
+
+void destroyTileUpdater(TileUpdater& updater);
+
+// Replaces the handler of type if it has one.
+void setTileUpdateHandler(TileUpdater& updater, uint16_t type, TileUpdateFn fn,
+                          void* userData);
+
+// One tick: draws the tiles to update and runs their handlers.
+const TileUpdateStats& updateRandomTiles(TileUpdater& updater);
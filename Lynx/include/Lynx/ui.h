@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <Volk/volk.h>
+
+#include <Lynx/sprite_batch.h>
+#include <Lynx/text.h>
+#include <Lynx/vk_utils.h>
+
+struct UiCreateInfo
+{
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  uint32_t maxQuads = 1 << 15;
+  uint32_t framesInFlight = 2;
+
+  // texture drawn by uiRect, a single white texel is enough
+  uint32_t whiteTexture = 0;
+};
+
+struct UiInput
+{
+  float mouseX = 0.0f;
+  float mouseY = 0.0f;
+  bool mouseDown = false;
+  // went down this frame
+  bool mousePressed = false;
+};
+
+struct UiClipRect
+{
+  int32_t x, y;
+  int32_t width, height;
+};
+
+struct UiDrawCommand
+{
+  uint32_t texture;
+  UiClipRect clip;
+  uint32_t firstQuad;
+  uint32_t quadCount;
+  // union of the quads of the command, used to tell whether later quads may be merged into it
+  float bounds[4];
+};
+
+struct UiStats
+{
+  uint32_t quads;
+  uint32_t draws;
+  // false when the frame matched the previous one and the GPU buffer was reused
+  bool uploaded;
+};
+
+// Immediate-mode UI drawn with the sprite batch pipeline. Widgets are re-emitted every frame, but
+// the resulting quad stream is compared against the previous frame's and only uploaded when it
+// differs, so a static inventory costs one memcmp. Quads are grouped by texture and clip rect
+// across the frame as long as no quad drawn in between overlaps them.
+struct Ui
+{
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  uint32_t maxQuads = 0;
+  uint32_t framesInFlight = 0;
+  uint32_t whiteTexture = 0;
+
+  // one segment per frame in flight, a new one is only written when the stream changes
+  GpuBuffer quadBuffer;
+  uint32_t segment = 0;
+  bool segmentValid = false;
+
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet quadSet = VK_NULL_HANDLE;
+
+  UiInput input;
+  float width = 0.0f;
+  float height = 0.0f;
+  std::vector<UiClipRect> clipStack;
+
+  // quads in emission order with the command each one belongs to
+  std::vector<SpriteInstance> quads;
+  std::vector<uint32_t> quadCommands;
+  std::vector<UiDrawCommand> commands;
+
+  // grouped by command, this frame and the last uploaded one which is what gets drawn
+  std::vector<SpriteInstance> stream;
+  std::vector<SpriteInstance> uploadedStream;
+  std::vector<UiDrawCommand> uploadedCommands;
+
+  UiStats stats{};
+};
+
+// Uses the instance set layout of batch; textures are sprite batch textures.
+Ui createUi(const UiCreateInfo& createInfo, const SpriteBatch& batch);
+
+void destroyUi(Ui& ui);
+
+// Coordinates are framebuffer pixels, origin top left.
+void uiBegin(Ui& ui, const UiInput& input, float width, float height);
+
+// Groups the frame's quads and uploads them if they changed.
+void uiEnd(Ui& ui);
+
+void uiPushClip(Ui& ui, float x, float y, float width, float height);
+void uiPopClip(Ui& ui);
+
+void uiImage(Ui& ui, uint32_t texture, float x, float y, float width, float height,
+             const float uv[4], uint32_t color = 0xffffffff);
+void uiRect(Ui& ui, float x, float y, float width, float height, uint32_t color);
+void uiText(Ui& ui, TextSystem& text, std::string_view string, float x, float y, float pixelSize,
+            uint32_t color);
+
+bool uiHovered(const Ui& ui, float x, float y, float width, float height);
+
+// Draws a rect tinted while hovered, returns true on the frame it is clicked.
+bool uiButton(Ui& ui, float x, float y, float width, float height, uint32_t color,
+              uint32_t hoverColor);
+
+// Horizontal bar filled to fraction, for health and mana.
+void uiBar(Ui& ui, float x, float y, float width, float height, float fraction,
+           uint32_t backgroundColor, uint32_t fillColor);
+
+// Must be recorded inside the render pass of batch. Leaves the scissor set to the whole frame.
+void recordUi(VkCommandBuffer commandBuffer, const Ui& ui, const SpriteBatch& batch);
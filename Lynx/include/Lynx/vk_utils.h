@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include <Volk/volk.h>
+
+struct GpuBuffer
+{
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+  // persistently mapped when the memory is host visible, nullptr otherwise
+  void* mapped = nullptr;
+};
+
+struct GraphicsPipelineDesc
+{
+  VkShaderModule vertexShader = VK_NULL_HANDLE;
+  VkShaderModule fragmentShader = VK_NULL_HANDLE;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+
+  // nullptr when the vertex shader pulls everything from storage buffers
+  const VkPipelineVertexInputStateCreateInfo* vertexInput = nullptr;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  bool alphaBlend = true;
+  bool additiveBlend = false;
+};
+
+uint32_t findMemoryType(const VkPhysicalDevice physicalDevice, uint32_t typeBits,
+                        VkMemoryPropertyFlags properties);
+
+GpuBuffer createBuffer(const VkPhysicalDevice physicalDevice, const VkDevice logicalDevice,
+                       VkDeviceSize size, VkBufferUsageFlags usage,
+                       VkMemoryPropertyFlags properties);
+
+void destroyBuffer(const VkDevice logicalDevice, GpuBuffer& buffer);
+
+VkShaderModule createShaderModule(const VkDevice logicalDevice, const std::string& shaderByteCode);
+
+VkPipeline createComputePipeline(const VkDevice logicalDevice, VkShaderModule shaderModule,
+                                 VkPipelineLayout layout);
+
+// Viewport and scissor are dynamic state.
+VkPipeline buildGraphicsPipeline(const VkDevice logicalDevice, const GraphicsPipelineDesc& desc);
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/tile_store.h>
+
+constexpr const uint32_t WIRE_COLOR_COUNT = 4;
+constexpr const uint32_t WIRE_NO_NET = 0xffffffff;
+
+// Component hit by a signal, a tile of a type with a handler or a tile with an actuator.
+struct WireHit
+{
+  int32_t x, y;
+};
+
+// Called with the components of type hit in a tick. Handlers may trigger wires again, those
+// signals run next tick.
+using WireHitFn = void (*)(void* userData, TileStore& store, uint16_t type, const WireHit* hits,
+                           uint32_t count);
+
+struct WireHandler
+{
+  uint16_t type;
+  WireHitFn fn;
+  void* userData;
+  std::vector<WireHit> batch;
+};
+
+// A wired tile of a chunk as last read from the store.
+struct WireTile
+{
+  uint16_t index;
+  uint8_t wires;
+  uint8_t actuator;
+  // handler of the tile type plus one, 0 for none
+  uint32_t handler;
+};
+
+struct WireChunk
+{
+  // in increasing index
+  std::vector<WireTile> tiles;
+  // net of every tile and color, WIRE_COLOR_COUNT per tile, and component of every tile
+  std::vector<uint32_t> nets;
+  std::vector<uint32_t> components;
+  bool stale;
+};
+
+struct WireComponent
+{
+  int32_t x, y;
+  uint32_t handler;
+  bool actuator;
+};
+
+// Components a net reaches, components[first] to components[first + count - 1] of netComponents.
+// Nets replaced by a compile around changed chunks have first WIRE_NO_NET.
+struct WireNet
+{
+  uint32_t first;
+  uint32_t count;
+};
+
+struct WireNetworkStats
+{
+  uint32_t nets;
+  uint32_t components;
+  uint32_t triggers;
+  // nets signalled and components hit in the tick
+  uint32_t signalledNets;
+  uint32_t hits;
+  // chunks read again, chunks whose wiring changed and whether the graph was compiled in full
+  uint32_t rescannedChunks;
+  uint32_t changedChunks;
+  bool compiled;
+  uint64_t compileNanoseconds;
+  uint64_t nanoseconds;
+};
+
+// Wiring compiled into a graph. Tiles connected by wire of the same color, side by side, make up
+// a net, and every wired tile with a handler for its type or an actuator is a component of the
+// nets of its colors. A signal then costs the components of the nets it reaches, however long
+// their wires are.
+//
+// Listeners of the store mark changed chunks stale; they are read again as jobs on the next
+// update. When the wires or components of some of them changed, only the nets reaching those
+// chunks are traced again, and the others keep their numbers; the replaced nets and components
+// are left behind until they make up half of the graph, which is then compiled in full.
+// Triggers are batched per tick: every net reached is signalled once and every component it
+// reaches is hit once, however many triggers or nets lead to it, except the tiles that
+// triggered. Hits go to the handlers batched by type in the order they were found, and
+// actuators toggle. Signals sent by handlers wait for the next tick, so clocks and loops advance
+// one step per tick instead of recursing.
+struct WireNetwork
+{
+  TileStore* store = nullptr;
+  JobSystem* jobs = nullptr;
+
+  std::vector<WireHandler> handlers;
+  // by type, index of its handler plus one, 0 for none
+  std::vector<uint32_t> handlerIndices;
+
+  // by chunk index, cy * chunksX + cx
+  std::vector<WireChunk> chunks;
+  std::vector<uint32_t> staleChunks;
+  bool compileNeeded = false;
+
+  std::vector<WireNet> nets;
+  std::vector<uint32_t> netComponents;
+  std::vector<WireComponent> components;
+  // left behind by compiles around changed chunks, and entries of netComponents of dead nets
+  uint32_t deadNets = 0;
+  uint32_t deadComponents = 0;
+  uint32_t deadNetComponents = 0;
+
+  std::vector<WireHit> triggers;
+  // stamp of the last tick a net or component was reached
+  std::vector<uint32_t> netStamps;
+  std::vector<uint32_t> componentStamps;
+  uint32_t stamp = 0;
+  WireNetworkStats stats{};
+};
+
+// The network is referenced by a listener of store, so it is created in place.
+void createWireNetwork(WireNetwork& network, TileStore& store, JobSystem& jobs);
+
+void destroyWireNetwork(WireNetwork& network);
+
+// Makes tiles of type components, replacing the handler of type if it has one.
+void setWireHandler(WireNetwork& network, uint16_t type, WireHitFn fn, void* userData);
+
+// Sends a signal down every wire of (x, y) on the next update, as a switch, pressure plate or
+// timer does.
+void triggerWire(WireNetwork& network, int32_t x, int32_t y);
+
+// Net of the wire of color at (x, y), WIRE_NO_NET when there is none. Valid after an update.
+uint32_t getWireNet(const WireNetwork& network, int32_t x, int32_t y, uint32_t color);
+
+// One tick: compiles the graph if wiring changed, then runs the signals triggered since the
+// last update.
+const WireNetworkStats& updateWireNetwork(WireNetwork& network);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <Lynx/tile_store.h>
+#include <Lynx/world_file.h>
+
+struct WorldAutosaveStats
+{
+  // time the game thread spent in beginWorldAutosave
+  uint64_t pauseNanoseconds;
+  // from the snapshot to the file being renamed into place
+  uint64_t saveNanoseconds;
+  // chunks written during the save, which the game thread copied
+  uint32_t copiedChunks;
+  uint64_t bytesWritten;
+  uint32_t saves;
+  uint32_t failures;
+};
+
+// Saves the world without stopping the game. Beginning a save only starts a copy-on-write
+// snapshot of the tile store, which a worker thread then serializes, compresses and writes while
+// the game keeps changing tiles.
+struct WorldAutosave
+{
+  std::string path;
+  TileStore* store = nullptr;
+  TileSnapshot snapshot;
+  // side tables and spawn as they were when the save began
+  WorldFileSaveInfo info;
+  WorldFileWriter writer;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool requested = false;
+  bool finished = false;
+  bool quit = false;
+  // set by the worker when the save failed, read once it finished
+  std::string error;
+
+  bool saving = false;
+  uint64_t saveStart = 0;
+  WorldAutosaveStats stats{};
+};
+
+// The autosave owns a thread and is referenced by it, so it is created in place. store must
+// outlive it.
+void createWorldAutosave(WorldAutosave& autosave, TileStore& store, const std::string& path);
+
+// Waits for a save in progress to finish.
+void destroyWorldAutosave(WorldAutosave& autosave);
+
+// Starts saving the store with the side tables of info. Returns false if a save is still in
+// progress or chunks of the store are still unloaded.
+bool beginWorldAutosave(WorldAutosave& autosave, WorldFileSaveInfo&& info);
+
+// Ends the snapshot once the worker is done with it. Returns true on the call that sees a save
+// complete; error is set if it failed.
+bool updateWorldAutosave(WorldAutosave& autosave);
+
+bool isWorldAutosaveInProgress(const WorldAutosave& autosave);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <Lynx/world_file.h>
+
+// Store layout:
+//   objects/<first two hex digits>/<32 hex digits>  a WorldBackupObjectHeader and stored bytes
+//   manifests/<name>  a WorldBackupManifestHeader and the object of every chunk in slot order
+//
+// Objects are named after a 128 bit hash of their stored bytes, so a chunk that did not change
+// between two backups is the same object and is written once. Chunks are taken from the world
+// file as they are stored there, without decompressing them.
+constexpr const char WORLD_BACKUP_MAGIC[8] = { 'L', 'Y', 'N', 'X', 'B', 'K', 'U', 'P' };
+constexpr const uint32_t WORLD_BACKUP_VERSION = 1;
+// marks objects that hold side tables rather than a chunk
+constexpr const uint8_t WORLD_BACKUP_SAVE_INFO = 0xff;
+
+struct WorldBackupHash
+{
+  uint64_t low;
+  uint64_t high;
+
+  bool operator==(const WorldBackupHash& other) const
+  {
+    return low == other.low && high == other.high;
+  }
+};
+
+struct WorldBackupHashHasher
+{
+  size_t operator()(const WorldBackupHash& hash) const { return (size_t)hash.low; }
+};
+
+struct WorldBackupObjectHeader
+{
+  uint8_t codec;
+  // TileChunkFormat, or WORLD_BACKUP_SAVE_INFO
+  uint8_t format;
+  uint16_t reserved;
+  uint32_t size;
+  uint32_t storedSize;
+};
+static_assert(sizeof(WorldBackupObjectHeader) == 12);
+
+struct WorldBackupManifestHeader
+{
+  char magic[8];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  uint32_t chunkCount;
+  // seconds since the epoch
+  uint64_t createdTime;
+  WorldBackupHash saveInfo;
+};
+static_assert(sizeof(WorldBackupManifestHeader) == 48);
+
+struct WorldBackupStats
+{
+  uint32_t chunks;
+  uint32_t newObjects;
+  // bytes of new objects, against the bytes the backup refers to
+  uint64_t bytesWritten;
+  uint64_t bytesReferenced;
+  uint64_t nanoseconds;
+};
+
+struct WorldBackupCollectStats
+{
+  uint32_t manifests;
+  uint32_t objectsKept;
+  uint32_t objectsRemoved;
+  uint64_t bytesRemoved;
+};
+
+struct WorldBackupStore
+{
+  std::string root;
+  // every object in the store, read once when it is opened
+  std::unordered_set<WorldBackupHash, WorldBackupHashHasher> objects;
+};
+
+// Creates the directories if needed.
+WorldBackupStore openWorldBackupStore(const std::string& root);
+
+// Backs up the world file at worldPath as name, replacing an older backup of that name. Fold any
+// journal into the world file first, changes only in a journal are not part of the backup.
+WorldBackupStats backupWorldFile(WorldBackupStore& store, const std::string& worldPath,
+                                 const std::string& name);
+
+// Names of the backups, oldest first.
+std::vector<std::string> listWorldBackups(const WorldBackupStore& store);
+
+// Writes the world of backup name to worldPath, replacing what is there.
+void restoreWorldBackup(const WorldBackupStore& store, const std::string& name,
+                        const std::string& worldPath);
+
+// Removes the manifest only, collectWorldBackupGarbage frees the objects.
+void deleteWorldBackup(WorldBackupStore& store, const std::string& name);
+
+// Removes the objects no backup refers to.
+WorldBackupCollectStats collectWorldBackupGarbage(WorldBackupStore& store);
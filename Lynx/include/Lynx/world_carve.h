@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Lynx/world_gen.h>
+
+enum CarveShape : uint8_t
+{
+  // disc of radius around (x0, y0)
+  CARVE_DISC,
+  // capsule of radius around the segment from (x0, y0) to (x1, y1)
+  CARVE_SEGMENT,
+};
+
+enum CarveOp : uint8_t
+{
+  // empties the tiles, caves and tunnels
+  CARVE_REMOVE,
+  // places type everywhere, blobs of dirt, mud or sand
+  CARVE_FILL,
+  // places type only over existing tiles, ore veins and biome blobs that keep cavities open
+  CARVE_REPLACE,
+};
+
+// A tile is covered when its center is inside the shape.
+struct CarveStroke
+{
+  CarveShape shape;
+  CarveOp op;
+  uint16_t type;
+  float x0, y0, x1, y1;
+  float radius;
+};
+
+// Random walk leaving strokes along its path, in the manner of the classic tile runner: the
+// brush starts at radius and shrinks to nothing over steps, the direction drifts by up to drift
+// per step and is renormalized to speed.
+struct CarveWalk
+{
+  float x = 0.0f, y = 0.0f;
+  float directionX = 0.0f, directionY = 1.0f;
+  float radius = 4.0f;
+  int32_t steps = 32;
+  float speed = 1.0f;
+  float drift = 0.5f;
+  CarveOp op = CARVE_REMOVE;
+  uint16_t type = 0;
+};
+
+// Strokes of a carving stage in the order they would be applied one after the other. Brushes
+// reach anywhere, so rather than running strokes as jobs, the world is cut in regions aligned
+// to the world like the regions of a WorldGenPass and every region applies the strokes that
+// overlap it, clipped to it and in order. Regions never share a tile, so they run in parallel
+// without phases and every tile ends up as if the strokes had been applied serially.
+struct WorldCarve
+{
+  std::vector<CarveStroke> strokes;
+
+  // set by binWorldCarve
+  int32_t regionSize = 0;
+  int32_t regionsX = 0, regionsY = 0;
+  // indices of the strokes overlapping each region, in order, by ry * regionsX + rx
+  std::vector<std::vector<uint32_t>> bins;
+  // tiles any stroke may have changed, [x0, x1) x [y0, y1), empty without strokes
+  int32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+};
+
+inline void addCarveDisc(WorldCarve& carve, CarveOp op, uint16_t type, float x, float y,
+                         float radius)
+{
+  carve.strokes.push_back({ CARVE_DISC, op, type, x, y, x, y, radius });
+}
+
+inline void addCarveSegment(WorldCarve& carve, CarveOp op, uint16_t type, float x0, float y0,
+                            float x1, float y1, float radius)
+{
+  carve.strokes.push_back({ CARVE_SEGMENT, op, type, x0, y0, x1, y1, radius });
+}
+
+// Appends the strokes of walk, one segment per step. Draws from random only, so walks started
+// with their own stream give the same strokes wherever they are generated.
+void addCarveWalk(WorldCarve& carve, const CarveWalk& walk, RandomStream& random);
+
+// Sorts the strokes into regions of regionSize tiles a side, rounded up to whole chunks. Call it
+// once the strokes are complete and before they are applied.
+void binWorldCarve(WorldCarve& carve, const TileStore& store, int32_t regionSize = 128);
+
+// Applies the strokes to the region of context, for a pass with the regionSize of carve that
+// writes WORLDGEN_TILES:
+//
+//   static void carveCaves(const WorldGenContext& context)
+//   {
+//     applyWorldCarve(context, ((Generator*)context.userData)->caves);
+//   }
+//
+// The strokes may come from an earlier pass writing a user layer that the carving pass reads.
+void applyWorldCarve(const WorldGenContext& context, const WorldCarve& carve);
+
+// Outside world generation: applies the binned strokes to store with one job per region and
+// notifies listeners once. store must have no unloaded chunks and no snapshot.
+void carveWorld(TileStore& store, JobSystem& jobs, const WorldCarve& carve);
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Lynx/tile_store.h>
+
+// File layout, little endian:
+//   WorldFileHeader
+//   WorldChunkEntry per chunk, in the order of the chunk table of a TileStore of the same size
+//   WorldSideTableEntry per side table
+//   per side table, WorldRecordEntry per record sorted by chunk then position, then the records
+//   chunk blobs in Morton order, each compressed on its own
+//
+// A chunk blob is a WorldChunkBlobHeader followed by the palette, then the packed indices, the
+// run ends and run indices, or a whole TileChunkRaw for chunks that could not be compressed.
+constexpr const char WORLD_FILE_MAGIC[8] = { 'L', 'Y', 'N', 'X', 'W', 'R', 'L', 'D' };
+constexpr const uint32_t WORLD_FILE_VERSION = 1;
+
+enum WorldChunkCodec : uint8_t
+{
+  WORLD_CODEC_NONE,
+  WORLD_CODEC_ZSTD,
+};
+
+// Side tables are keyed by a four character tag, chests, signs and tile entities are the ones the
+// game knows about. Records are opaque to the file.
+constexpr const uint32_t WORLD_TABLE_TILE_ENTITIES = 'T' | 'E' << 8 | 'N' << 16 | 'T' << 24;
+constexpr const uint32_t WORLD_TABLE_CHESTS = 'C' | 'H' << 8 | 'S' << 16 | 'T' << 24;
+constexpr const uint32_t WORLD_TABLE_SIGNS = 'S' | 'I' << 8 | 'G' << 16 | 'N' << 24;
+
+struct WorldFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t chunkSize;
+  int32_t width;
+  int32_t height;
+  int32_t chunksX;
+  int32_t chunksY;
+  int32_t spawnX;
+  int32_t spawnY;
+  uint32_t sideTableCount;
+  uint32_t reserved;
+  uint64_t chunkDirectoryOffset;
+  uint64_t sideTableDirectoryOffset;
+  uint64_t fileSize;
+};
+static_assert(sizeof(WorldFileHeader) == 72);
+
+struct WorldChunkEntry
+{
+  uint64_t offset;
+  uint32_t storedSize;
+  // size of the blob once decompressed
+  uint32_t size;
+  uint8_t codec;
+  // TileChunkFormat, so uniform chunks can be told apart without reading the blob
+  uint8_t format;
+  uint16_t reserved0;
+  uint32_t reserved1;
+};
+static_assert(sizeof(WorldChunkEntry) == 24);
+
+struct WorldChunkBlobHeader
+{
+  uint8_t format;
+  uint8_t bitsPerIndex;
+  uint16_t paletteSize;
+  uint16_t runCount;
+  uint16_t indexWords;
+};
+static_assert(sizeof(WorldChunkBlobHeader) == 8);
+
+struct WorldSideTableEntry
+{
+  uint32_t tag;
+  uint32_t recordCount;
+  uint64_t indexOffset;
+  uint64_t dataOffset;
+  uint64_t dataSize;
+};
+static_assert(sizeof(WorldSideTableEntry) == 32);
+
+struct WorldRecordEntry
+{
+  uint32_t chunk;
+  int32_t x;
+  int32_t y;
+  uint32_t size;
+  // from the dataOffset of the table
+  uint64_t offset;
+};
+static_assert(sizeof(WorldRecordEntry) == 24);
+
+// Side table contents to save, records of the tile at (x, y).
+struct WorldRecord
+{
+  int32_t x, y;
+  std::vector<uint8_t> data;
+};
+
+struct WorldSideTable
+{
+  uint32_t tag;
+  std::vector<WorldRecord> records;
+};
+
+struct WorldFileSaveInfo
+{
+  int32_t spawnX = 0;
+  int32_t spawnY = 0;
+  // zstd level of the chunk blobs
+  int32_t compressionLevel = 3;
+  std::vector<WorldSideTable> sideTables;
+};
+
+struct WorldRecordView
+{
+  int32_t x, y;
+  const uint8_t* data;
+  uint32_t size;
+};
+
+struct WorldLoadStats
+{
+  uint64_t openNanoseconds;
+  uint32_t chunksLoaded;
+  uint64_t bytesDecompressed;
+  uint64_t loadNanoseconds;
+};
+
+// A saved world mapped into memory. Opening only validates the header and the directories, chunks
+// are decompressed straight from the mapping when the tile store first touches them and the OS
+// pages in only the parts of the file that are read.
+struct WorldFile
+{
+  const uint8_t* data = nullptr;
+  uint64_t size = 0;
+  const WorldFileHeader* header = nullptr;
+  const WorldChunkEntry* chunks = nullptr;
+  const WorldSideTableEntry* sideTables = nullptr;
+
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mappingHandle = nullptr;
+#else
+  int fileDescriptor = -1;
+#endif
+
+  // ZSTD_DCtx, reused by every chunk
+  void* decompressor = nullptr;
+  std::vector<uint8_t> scratch;
+
+  WorldLoadStats stats{};
+};
+
+// Builds a world file in memory one chunk at a time, for saving from a snapshot.
+struct WorldFileWriter
+{
+  WorldFileHeader header{};
+  std::vector<uint8_t> out;
+  std::vector<WorldChunkEntry> directory;
+  uint32_t nextSlot = 0;
+  uint64_t bytesWritten = 0;
+
+  // ZSTD_CCtx, kept across saves
+  void* compressor = nullptr;
+  std::vector<uint8_t> compressed;
+};
+
+// Writes to a temporary file next to path and renames it over path once complete, so a crash
+// while saving leaves the previous save intact. Both the file and the rename are synced to disk
+// before it returns.
+void saveWorldFile(const std::string& path, const TileStore& store, const WorldFileSaveInfo& info);
+
+// Writes header then data to a temporary file next to path and renames it over path. The file
+// and the rename are both synced to disk before it returns, so after a crash path holds either
+// its old contents or all of the new ones.
+void writeSyncedFile(const std::string& path, const void* header, size_t headerSize,
+                     const void* data, size_t size);
+
+// Syncs the entries of directory, such as files or directories just created in it.
+void syncDirectory(const std::string& directory);
+
+// World of width x height tiles, chunks are passed to writeWorldChunk.
+void beginWorldFileWriter(WorldFileWriter& writer, int32_t width, int32_t height,
+                          const WorldFileSaveInfo& info);
+
+// Uncompressed blob of a chunk. Only encodes, cheap enough to do while holding a snapshot chunk.
+void serializeWorldChunk(const TileChunk& chunk, std::vector<uint8_t>& blob);
+
+// Compresses and appends the blob of the chunk at slot. Slots must come in increasing order.
+void writeWorldChunk(WorldFileWriter& writer, uint32_t slot, const std::vector<uint8_t>& blob);
+
+// Blob as world files store it, compressed with compressor (a ZSTD_CCtx) unless that does not
+// make it smaller. Fills everything in entry but the offset.
+void storeWorldChunk(void* compressor, const std::vector<uint8_t>& blob, WorldChunkEntry& entry,
+                     std::vector<uint8_t>& stored);
+
+// Appends a chunk stored by storeWorldChunk, or copied from another world file.
+void writeStoredWorldChunk(WorldFileWriter& writer, uint32_t slot, const WorldChunkEntry& entry,
+                           const uint8_t* stored);
+
+// Writes the file the same way saveWorldFile does.
+void finishWorldFileWriter(WorldFileWriter& writer, const std::string& path);
+
+void destroyWorldFileWriter(WorldFileWriter& writer);
+
+WorldFile openWorldFile(const std::string& path);
+
+void closeWorldFile(WorldFile& file);
+
+// Store of the size of the world with every chunk unloaded, loaded from file when first accessed.
+// file must stay open and in place while the store has unloaded chunks.
+TileStore createTileStoreFromWorldFile(WorldFile& file);
+
+// Decompresses the chunk at slot of store into it. store must have the size of the world.
+void loadWorldChunk(WorldFile& file, TileStore& store, uint32_t slot);
+
+// Decodes a stored chunk without touching a store, so it can run on any thread with its own
+// decompressor (a ZSTD_DCtx) and scratch. raw is set for TILE_CHUNK_RAW chunks only.
+void decodeWorldChunk(const WorldChunkEntry& entry, const uint8_t* stored, void* decompressor,
+                      std::vector<uint8_t>& scratch, TileChunkEncoding& packed,
+                      std::unique_ptr<TileChunkRaw>& raw);
+
+// Decodes a stored chunk into the chunk at slot of store, decompressing into scratch with
+// decompressor (a ZSTD_DCtx).
+void installWorldChunk(TileStore& store, uint32_t slot, const WorldChunkEntry& entry,
+                       const uint8_t* stored, void* decompressor, std::vector<uint8_t>& scratch);
+
+// Stored bytes of the chunk at slot, described by file.chunks[slot].
+const uint8_t* getStoredWorldChunk(const WorldFile& file, uint32_t slot);
+
+// Loads the chunks within radius tiles of (x, y), for the area around spawn or a player.
+void loadWorldChunksAround(WorldFile& file, TileStore& store, int32_t x, int32_t y,
+                           int32_t radius);
+
+// Loads up to maxChunks unloaded chunks in file order, for finishing the load a little at a time.
+// Returns the number of chunks still unloaded.
+uint32_t loadRemainingWorldChunks(WorldFile& file, TileStore& store, uint32_t maxChunks);
+
+// Records of the side table tag in the chunk at (cx, cy), pointing into the mapping.
+void findWorldRecords(const WorldFile& file, uint32_t tag, int32_t cx, int32_t cy,
+                      std::vector<WorldRecordView>& records);
+
+// Record of the side table tag at tile (x, y), or false if there is none.
+bool findWorldRecord(const WorldFile& file, uint32_t tag, int32_t x, int32_t y,
+                     WorldRecordView& record);
+
+// Spawn and side tables of file, as they were passed to saveWorldFile.
+WorldFileSaveInfo readWorldFileSaveInfo(const WorldFile& file);
+
+// Spawn and side tables as one blob, for journals and backups.
+void serializeWorldFileSaveInfo(const WorldFileSaveInfo& info, std::vector<uint8_t>& out);
+bool deserializeWorldFileSaveInfo(const uint8_t* in, const uint8_t* end, WorldFileSaveInfo& info);
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/random.h>
+#include <Lynx/tile_store.h>
+
+// What a pass reads and writes. The tile layers follow the arrays of a raw chunk, so passes on
+// different layers of the same chunk never touch the same memory.
+enum WorldGenLayer : uint32_t
+{
+  // types and flags
+  WORLDGEN_TILES = 1 << 0,
+  // liquid amounts
+  WORLDGEN_LIQUIDS = 1 << 1,
+  // walls, paint, slopes, liquid types and wiring, which share one word per tile
+  WORLDGEN_ATTRIBUTES = 1 << 2,
+  // first of the layers for data the generator keeps outside the tile store, such as surface
+  // heights. They have no area, passes sharing one always run in order.
+  WORLDGEN_USER_LAYER = 1 << 8,
+};
+
+constexpr const uint32_t WORLDGEN_TILE_LAYERS =
+  WORLDGEN_TILES | WORLDGEN_LIQUIDS | WORLDGEN_ATTRIBUTES;
+
+struct WorldGenContext
+{
+  TileStore* store;
+  void* userData;
+  uint64_t seed;
+  uint32_t pass;
+  // tiles the job may write, [x0, x1) x [y0, y1); it may read up to the pass margin further
+  int32_t x0, y0, x1, y1;
+  // job thread, for per-thread scratch
+  uint32_t thread;
+};
+
+typedef void (*WorldGenPassFn)(const WorldGenContext& context);
+
+struct WorldGenPass
+{
+  const char* name = "";
+  WorldGenPassFn fn = nullptr;
+  uint32_t reads = 0;
+  uint32_t writes = 0;
+  // tiles the pass covers, the whole world when empty
+  int32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  // 0 runs the pass as one job over its area, otherwise as jobs over regions of regionSize
+  // tiles a side, rounded up to whole chunks
+  int32_t regionSize = 0;
+  // how far outside its region a job reads, at most regionSize. With a margin, neighbouring
+  // regions never run at the same time: they run in four phases by the parity of the region.
+  int32_t margin = 0;
+};
+
+struct WorldGenPassStats
+{
+  const char* name;
+  uint32_t jobs;
+  // since generateWorld started
+  uint64_t startNanoseconds;
+  uint64_t nanoseconds;
+  // sum of the time of every job, the time the pass would take on a single thread
+  uint64_t jobNanoseconds;
+};
+
+struct WorldGenStats
+{
+  std::vector<WorldGenPassStats> passes;
+  uint64_t nanoseconds;
+  uint64_t compressNanoseconds;
+};
+
+// Runs the passes over store. A pass depends on every earlier pass that writes what it reads or
+// writes, or reads what it writes, in an overlapping area; passes without a dependency between
+// them run at the same time, as do the regions of a pass. The result matches running the passes
+// one after the other in order, which is what parallel = false does on the calling thread.
+//
+// Every chunk is raw while the passes run and store is compressed at the end. Passes must write
+// through the helpers below rather than setTile and the like, which are not safe from jobs and
+// notify listeners; listeners are notified once for the whole world when generation finishes.
+// store must have no unloaded chunks and no snapshot.
+WorldGenStats generateWorld(TileStore& store, JobSystem& jobs,
+                            const std::vector<WorldGenPass>& passes, uint64_t seed,
+                            void* userData = nullptr, bool parallel = true);
+
+// One line per pass, for logs.
+std::string formatWorldGenStats(const WorldGenStats& stats);
+
+// Random numbers of the pass for the chunk holding (x, y). Drawing from the stream of the chunk
+// being generated keeps the world the same whatever the regions and the thread count.
+inline RandomStream createWorldGenRandom(const WorldGenContext& context, int32_t x, int32_t y)
+{
+  const uint32_t chunk =
+    (uint32_t)((y >> TILE_CHUNK_SHIFT) * context.store->chunksX + (x >> TILE_CHUNK_SHIFT));
+  return createRandomStream(context.seed, context.pass, chunk);
+}
+
+inline TileChunkRaw& getWorldGenChunk(const WorldGenContext& context, int32_t x, int32_t y)
+{
+  return *context.store->chunks[getTileChunkSlot(*context.store, x, y)].raw;
+}
+
+inline void setWorldGenTileType(const WorldGenContext& context, int32_t x, int32_t y,
+                                uint16_t type)
+{
+  TileChunkRaw& raw = getWorldGenChunk(context, x, y);
+  const uint32_t i = getTileIndexInChunk(x, y);
+  raw.hot.types[i] = type;
+  raw.hot.flags[i] =
+    (raw.hot.flags[i] & ~TILE_TYPE_FLAGS) | TILE_ACTIVE | context.store->typeFlags[type];
+}
+
+inline void removeWorldGenTile(const WorldGenContext& context, int32_t x, int32_t y)
+{
+  TileChunkRaw& raw = getWorldGenChunk(context, x, y);
+  const uint32_t i = getTileIndexInChunk(x, y);
+  raw.hot.types[i] = 0;
+  raw.hot.flags[i] &= ~(TILE_ACTIVE | TILE_TYPE_FLAGS);
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Lynx/tile_store.h>
+#include <Lynx/world_file.h>
+
+// Journal files sit next to the world file as <world>.journal.<generation>. Each is a
+// WorldJournalHeader followed by records, a WorldJournalRecord and its payload each. A batch of
+// records only counts once its commit record is on disk, so a crash in the middle of a batch
+// drops the whole batch and replay stops at the first torn record.
+constexpr const char WORLD_JOURNAL_MAGIC[8] = { 'L', 'Y', 'N', 'X', 'J', 'R', 'N', 'L' };
+constexpr const uint32_t WORLD_JOURNAL_VERSION = 1;
+
+enum WorldJournalRecordType : uint8_t
+{
+  // stored chunk blob of the chunk at slot, as in world files
+  WORLD_JOURNAL_CHUNK,
+  // spawn and side tables
+  WORLD_JOURNAL_SAVE_INFO,
+  WORLD_JOURNAL_COMMIT,
+};
+
+struct WorldJournalHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t generation;
+  int32_t width;
+  int32_t height;
+};
+static_assert(sizeof(WorldJournalHeader) == 24);
+
+struct WorldJournalRecord
+{
+  // FNV-1a of the record with this field zero, then of the payload
+  uint32_t checksum;
+  uint8_t type;
+  uint8_t codec;
+  uint8_t format;
+  uint8_t reserved0;
+  uint32_t slot;
+  uint32_t size;
+  uint32_t storedSize;
+  uint32_t reserved1;
+  uint64_t sequence;
+};
+static_assert(sizeof(WorldJournalRecord) == 32);
+
+struct WorldJournalBatch
+{
+  uint64_t sequence;
+  std::vector<uint32_t> slots;
+  // the chunks at slots when the batch was taken
+  std::vector<TileChunk> chunks;
+  bool hasSaveInfo;
+  WorldFileSaveInfo saveInfo;
+  bool compact;
+};
+
+struct WorldJournalStats
+{
+  uint32_t batches;
+  uint32_t chunksWritten;
+  uint64_t bytesWritten;
+  uint32_t syncs;
+  uint32_t compactions;
+  uint64_t lastCompactionNanoseconds;
+  // size of the journal being appended to
+  uint64_t journalBytes;
+};
+
+struct WorldJournalReplay
+{
+  uint32_t batches;
+  uint32_t chunks;
+  bool hasSaveInfo;
+  WorldFileSaveInfo saveInfo;
+};
+
+// Incremental saves. Every syncInterval updates, the chunks written since the last batch are
+// copied and handed to a worker thread that appends them to the journal and syncs it to disk, so
+// save I/O follows the edits instead of the world size. Once the journal grows past compactBytes
+// the worker starts a new one and folds the old ones into the world file, copying untouched chunks
+// as they are stored without recompressing them.
+struct WorldJournal
+{
+  std::string worldPath;
+  TileStore* store = nullptr;
+  uint32_t syncInterval = 0;
+  uint32_t ticksSinceSync = 0;
+  uint64_t compactBytes = 0;
+
+  // version of every chunk when it was last journaled
+  std::vector<uint32_t> versions;
+  uint64_t sequence = 0;
+  bool hasSaveInfo = false;
+  WorldFileSaveInfo saveInfo;
+
+  // worker side
+  FILE* file = nullptr;
+  uint32_t generation = 0;
+  // ZSTD_CCtx
+  void* compressor = nullptr;
+  std::vector<uint8_t> blob;
+  std::vector<uint8_t> stored;
+  bool hasLatestSaveInfo = false;
+  WorldFileSaveInfo latestSaveInfo;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<WorldJournalBatch> batches;
+  bool quit = false;
+  // first error of the worker, the journal stops writing after it
+  std::string error;
+  WorldJournalStats stats{};
+};
+
+// Applies the journals of the world at worldPath to store, which must have been created from the
+// world file and not written yet. Call before createWorldJournal.
+WorldJournalReplay replayWorldJournals(const std::string& worldPath, TileStore& store);
+
+// The world file at worldPath must exist. The journal owns a thread and is referenced by it, so
+// it is created in place; store must outlive it. On Windows the world file cannot be replaced
+// while it is mapped, so compaction fails until the store finished loading and the file is closed.
+void createWorldJournal(WorldJournal& journal, TileStore& store, const std::string& worldPath,
+                        uint32_t syncInterval = 60, uint64_t compactBytes = 64ull << 20);
+
+// Journals the last changes and waits for the worker.
+void destroyWorldJournal(WorldJournal& journal);
+
+// Recorded with the next batch, for chests, signs and other side tables.
+void setWorldJournalSaveInfo(WorldJournal& journal, WorldFileSaveInfo&& info);
+
+// Call once per tick.
+void updateWorldJournal(WorldJournal& journal);
+
+// Journals the chunks changed since the last batch now.
+void flushWorldJournal(WorldJournal& journal, bool compact = false);
+
+// Copy of the worker's statistics and error.
+WorldJournalStats getWorldJournalStats(WorldJournal& journal, std::string* error = nullptr);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Lynx/job_system.h>
+#include <Lynx/tile_store.h>
+#include <Lynx/world_file.h>
+
+struct WorldLoadFocus
+{
+  int32_t x, y;
+};
+
+struct WorldLoaderStats
+{
+  // from createWorldLoader until the chunks within the playable radius were resident
+  uint64_t firstPlayableNanoseconds;
+  // from createWorldLoader until no chunk was unloaded
+  uint64_t fullyLoadedNanoseconds;
+  uint32_t chunksDecoded;
+  // decoded after the store had already faulted them in
+  uint32_t chunksDiscarded;
+  uint64_t bytesDecompressed;
+};
+
+struct WorldLoadedChunk
+{
+  uint32_t slot;
+  TileChunkEncoding packed;
+  std::unique_ptr<TileChunkRaw> raw;
+};
+
+// Loads a whole world in the background. Chunks are decoded by the job system nearest spawn and
+// the players first and installed into the store by the game thread, which can start simulating
+// and rendering as soon as the area around them is resident. Chunks the game touches before they
+// arrive are still faulted in by the store as usual.
+struct WorldLoader
+{
+  WorldFile* file = nullptr;
+  TileStore* store = nullptr;
+  JobSystem* jobs = nullptr;
+  int32_t playableRadius = 0;
+  uint64_t start = 0;
+
+  // slots unloaded when the loader was created, nearest first
+  std::vector<uint32_t> order;
+  std::atomic<uint32_t> nextOrder{ 0 };
+  // set once a thread took the slot to decode
+  std::unique_ptr<std::atomic<uint8_t>[]> claimed;
+  // ZSTD_DCtx and scratch of every job thread
+  std::vector<void*> decompressors;
+  std::vector<std::vector<uint8_t>> scratch;
+  JobBatch batch;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  // claimed before order, for players that connect while the world loads
+  std::deque<uint32_t> urgent;
+  // decoded and waiting for the game thread
+  std::vector<WorldLoadedChunk> loaded;
+  uint32_t chunksDecoded = 0;
+  uint64_t bytesDecompressed = 0;
+
+  // game thread side, slots within the playable radius still unloaded
+  std::vector<uint32_t> playable;
+  bool playableReached = false;
+  bool fullyLoaded = false;
+  std::vector<WorldLoadedChunk> installing;
+  WorldLoaderStats stats{};
+};
+
+// The loader is referenced by its jobs, so it is created in place. file, store and jobs must
+// outlive it and store must have been created from file. The playable area is every chunk within
+// playableRadius tiles of spawn or of a player in players.
+void createWorldLoader(WorldLoader& loader, WorldFile& file, TileStore& store, JobSystem& jobs,
+                       int32_t playableRadius = 1024,
+                       const std::vector<WorldLoadFocus>& players = {});
+
+// Waits for the chunks being decoded and installs them.
+void destroyWorldLoader(WorldLoader& loader);
+
+// Installs the chunks decoded since the last call. Call once per tick. Returns true once the
+// world is fully loaded, after which the file can be closed.
+bool updateWorldLoader(WorldLoader& loader);
+
+// Decodes chunks on the calling thread as well until the playable area is resident.
+void waitForWorldPlayable(WorldLoader& loader);
+
+bool isWorldPlayable(const WorldLoader& loader);
+
+// Moves the chunks within radius tiles of (x, y) to the front, for a player that connected.
+void prioritizeWorldLoad(WorldLoader& loader, int32_t x, int32_t y, int32_t radius);
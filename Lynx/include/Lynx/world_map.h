@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Volk/volk.h>
+
+#include <Lynx/vk_utils.h>
+
+constexpr const uint32_t WORLD_MAP_BLOCK_SHIFT = 6;
+constexpr const uint32_t WORLD_MAP_BLOCK_SIZE = 1 << WORLD_MAP_BLOCK_SHIFT;
+constexpr const uint32_t WORLD_MAP_BLOCK_TEXELS = WORLD_MAP_BLOCK_SIZE * WORLD_MAP_BLOCK_SIZE;
+constexpr const uint32_t WORLD_MAP_MAX_LEVELS = 12;
+constexpr const uint32_t WORLD_MAP_NO_PAGE = ~0u;
+
+// Map color of a tile as RGBA8, red in the low byte. The alpha is ignored, revealed tiles are
+// always opaque.
+using WorldMapColorFn = uint32_t (*)(void* userData, int32_t x, int32_t y);
+
+struct WorldMapCreateInfo
+{
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  WorldMapColorFn tileColor = nullptr;
+  void* userData = nullptr;
+
+  // pages of 64x64 texels in the GPU atlas; the coarse levels are kept resident and use at most
+  // a quarter of them
+  uint32_t atlasSize = 2048;
+  uint32_t maxUploadsPerFrame = 32;
+  uint32_t framesInFlight = 2;
+
+  std::string vertexShader;
+  std::string fragmentShader;
+};
+
+// Colors of a revealed 64x64 block of tiles as indices into a palette, with as few bits per index
+// as the palette needs. Index 0 is always the transparent color of unrevealed tiles. An empty
+// palette means nothing in the block was revealed yet.
+struct WorldMapBlock
+{
+  std::vector<uint32_t> palette;
+  std::vector<uint64_t> indices;
+  uint32_t bitsPerIndex = 0;
+};
+
+struct WorldMapLevel
+{
+  uint32_t blocksX = 0;
+  uint32_t blocksY = 0;
+  // first entry of the level in the page table
+  uint32_t pageTableOffset = 0;
+  // coarser levels store averaged RGBA8 texels, the alpha being the revealed fraction; empty
+  // until something below the block is revealed
+  std::vector<std::vector<uint32_t>> texels;
+  std::vector<uint8_t> dirty;
+  std::vector<uint32_t> dirtyList;
+};
+
+struct WorldMapPage
+{
+  // page table entry using the page, WORLD_MAP_NO_PAGE when free
+  uint32_t entry = WORLD_MAP_NO_PAGE;
+  uint64_t lastUsed = 0;
+  bool pinned = false;
+};
+
+// Fullscreen map colors. Level 0 keeps one palette compressed block per 64x64 tiles and each
+// coarser level halves the resolution, so zoomed out views read a few hundred blocks at most.
+// Memory grows with the explored area only. Reveals and tile changes mark the touched blocks
+// dirty; updateWorldMap rebuilds their mips and the GPU receives only those blocks, streamed
+// into a fixed atlas of pages looked up through a page table.
+struct WorldMap
+{
+  VkDevice logicalDevice = VK_NULL_HANDLE;
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  WorldMapColorFn tileColor = nullptr;
+  void* userData = nullptr;
+
+  std::vector<WorldMapBlock> blocks;
+  std::vector<WorldMapLevel> levels;
+  // levels from this one up are always resident on the GPU
+  uint32_t pinnedLevel = 0;
+  // one decoded block, used while rebuilding mips
+  std::vector<uint32_t> scratch;
+
+  uint32_t pagesPerRow = 0;
+  uint32_t maxUploadsPerFrame = 0;
+  uint32_t framesInFlight = 0;
+  std::vector<WorldMapPage> pages;
+  std::vector<uint32_t> freePages;
+  // page of every block of every level, and the CPU copy of the page table which only points to
+  // a page once its texels were uploaded
+  std::vector<uint32_t> blockPages;
+  std::vector<uint32_t> pageTable;
+  uint64_t pageTableVersion = 0;
+  std::vector<uint64_t> segmentVersions;
+  // page table entries waiting for their texels to be uploaded
+  std::vector<uint32_t> uploadQueue;
+  std::vector<uint8_t> queued;
+  uint64_t frame = 0;
+
+  VkImage atlas = VK_NULL_HANDLE;
+  VkDeviceMemory atlasMemory = VK_NULL_HANDLE;
+  VkImageView atlasView = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+  bool atlasInitialized = false;
+
+  GpuBuffer staging;
+  // one copy of the page table per frame in flight
+  GpuBuffer pageTableBuffer;
+  VkDeviceSize pageTableSegmentSize = 0;
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+WorldMap createWorldMap(const WorldMapCreateInfo& createInfo);
+
+void destroyWorldMap(WorldMap& map);
+
+// Reveals every tile of the rectangle [x0, x1) x [y0, y1), reading colors of the tiles that were
+// not revealed yet.
+void revealWorldMap(WorldMap& map, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+void revealWorldMapCircle(WorldMap& map, int32_t centerX, int32_t centerY, int32_t radius);
+
+// Rereads the color of a tile after it changed, if it was revealed.
+void onWorldMapTileChanged(WorldMap& map, int32_t x, int32_t y);
+
+uint32_t getWorldMapColor(const WorldMap& map, int32_t x, int32_t y);
+
+// Rebuilds the coarser levels of the blocks changed since the last call and makes sure the
+// blocks of level needed to show the tile rectangle [x0, x1) x [y0, y1) are resident, evicting
+// pages that were not seen for the longest time.
+void updateWorldMap(WorldMap& map, uint32_t level, float x0, float y0, float x1, float y1);
+
+// Coarsest level that still shows at least one texel per screen pixel.
+uint32_t chooseWorldMapLevel(const WorldMap& map, float tilesPerPixel);
+
+// Uploads up to maxUploadsPerFrame blocks. Must be recorded outside of a render pass.
+void recordWorldMapUploads(VkCommandBuffer commandBuffer, WorldMap& map, uint32_t frameIndex);
+
+// Fills the viewport with the tile rectangle [x0, x1) x [y0, y1). Blocks missing at level fall
+// back to the first resident coarser level.
+void recordWorldMapDraw(VkCommandBuffer commandBuffer, const WorldMap& map, uint32_t frameIndex,
+                        uint32_t level, float x0, float y0, float x1, float y1);
+
+// CPU memory used by the colors of all levels.
+uint64_t getWorldMapMemoryBytes(const WorldMap& map);
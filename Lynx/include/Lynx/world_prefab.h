@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Lynx/world_gen.h>
+
+// One bit per tile, set where the tile is solid. Rows are padded to whole words and the padding
+// is always clear.
+struct TileSolidMask
+{
+  int32_t width = 0;
+  int32_t height = 0;
+  uint32_t wordsPerRow = 0;
+  std::vector<uint64_t> bits;
+};
+
+enum PrefabRequirement : uint8_t
+{
+  PREFAB_ANY,
+  // the tile under the cell must not be solid
+  PREFAB_EMPTY,
+  // the tile under the cell must be solid, for foundations and anchors
+  PREFAB_SOLID,
+};
+
+// What a symbol of a prefab source stands for.
+struct PrefabLegend
+{
+  char symbol;
+  // written where stamp is set; the type flags come from the store
+  Tile tile;
+  bool stamp;
+  PrefabRequirement requirement;
+};
+
+// Tiles of a template row from x on, all stamped.
+struct PrefabRun
+{
+  int32_t x;
+  int32_t y;
+  int32_t count;
+  // first of the run in the tile arrays of the template
+  uint32_t first;
+};
+
+// A structure compiled for placement: the stamped cells as row runs over arrays laid out like
+// the fields of a raw chunk, so a run is a few copies per chunk it crosses, and the requirements
+// as bit rows to intersect with a TileSolidMask.
+struct PrefabTemplate
+{
+  int32_t width = 0;
+  int32_t height = 0;
+
+  std::vector<PrefabRun> runs;
+  std::vector<uint16_t> types;
+  std::vector<uint8_t> flags;
+  std::vector<uint8_t> liquids;
+  std::vector<uint32_t> attributes;
+
+  uint32_t wordsPerRow = 0;
+  // bit x of row y at [y * wordsPerRow + x / 64]
+  std::vector<uint64_t> emptyMask;
+  std::vector<uint64_t> solidMask;
+};
+
+// Compiles rows of symbols, all of the same length, with the tile flags of store. Throws on a
+// symbol that is not in legend.
+PrefabTemplate compilePrefab(const TileStore& store, const std::vector<std::string>& rows,
+                             const std::vector<PrefabLegend>& legend);
+
+void buildTileSolidMask(const TileStore& store, TileSolidMask& mask);
+
+// Reads [x0, x1) x [y0, y1) of store again, after writes that did not go through stampPrefab.
+void updateTileSolidMask(const TileStore& store, TileSolidMask& mask, int32_t x0, int32_t y0,
+                         int32_t x1, int32_t y1);
+
+// True when the template fits in the world at (x, y) and every requirement holds, a handful of
+// word operations per template row.
+bool canPlacePrefab(const TileSolidMask& mask, const PrefabTemplate& prefab, int32_t x, int32_t y);
+
+// Tries up to attempts random positions with the top left corner in [x0, x1) x [y0, y1) and
+// returns the first that fits in x and y.
+bool findPrefabPlacement(const TileSolidMask& mask, const PrefabTemplate& prefab,
+                         RandomStream& random, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                         uint32_t attempts, int32_t& x, int32_t& y);
+
+// Writes the template at (x, y), which must fit in the world, and notifies listeners once. mask
+// is kept up to date when given.
+void stampPrefab(TileStore& store, const PrefabTemplate& prefab, int32_t x, int32_t y,
+                 TileSolidMask* mask = nullptr);
+
+// Same from a world generation pass, the template must lie in the tiles the job may write. mask
+// is kept up to date when given; words of the mask are shared by neighbouring regions, so only
+// passes running as a single job should pass one.
+void stampWorldGenPrefab(const WorldGenContext& context, const PrefabTemplate& prefab, int32_t x,
+                         int32_t y, TileSolidMask* mask = nullptr);
@@ -0,0 +1,595 @@
+#include <Lynx/background.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Matches BackgroundInstance in background.vertex.glsl.
+struct BackgroundInstance
+{
+  float scroll[2];
+  float uvScale[2];
+  float size[2];
+  float offsetY;
+  float alpha;
+  uint32_t layer;
+  uint32_t padding[3];
+};
+static_assert(sizeof(BackgroundInstance) == 48);
+
+struct BackgroundPushConstants
+{
+  float camera[2];
+  float viewSize[2];
+};
+
+static void runBackgroundWorker(BackgroundSystem* system)
+{
+  while (true)
+  {
+    BackgroundLoadResult request;
+    {
+      std::unique_lock<std::mutex> lock(system->mutex);
+      system->condition.wait(lock, [&] { return system->quit || !system->requests.empty(); });
+      if (system->quit)
+        return;
+
+      request = std::move(system->requests.front());
+      system->requests.pop_front();
+    }
+
+    request.width = request.height = 0;
+    if (!system->load(request.textureId, request.pixels, request.width, request.height) ||
+        request.width > system->slotWidth || request.height > system->slotHeight ||
+        request.pixels.size() < (size_t)request.width * request.height * 4)
+    {
+      // slot goes back to the pool when the result is consumed
+      request.width = request.height = 0;
+      request.pixels.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(system->mutex);
+    system->results.push_back(std::move(request));
+  }
+}
+
+static void createBackgroundImage(BackgroundSystem& system, const VkPhysicalDevice physicalDevice,
+                                  uint32_t slotCount)
+{
+  const VkDevice logicalDevice = system.logicalDevice;
+
+  VkImageCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ci.imageType = VK_IMAGE_TYPE_2D;
+  ci.format = VK_FORMAT_R8G8B8A8_SRGB;
+  ci.extent = { system.slotWidth, system.slotHeight, 1 };
+  ci.mipLevels = 1;
+  ci.arrayLayers = slotCount;
+  ci.samples = VK_SAMPLE_COUNT_1_BIT;
+  ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ci.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (vkCreateImage(logicalDevice, &ci, nullptr, &system.image) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create background image");
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(logicalDevice, system.image, &requirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &system.imageMemory) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate background image memory");
+
+  vkBindImageMemory(logicalDevice, system.image, system.imageMemory, 0);
+
+  VkImageViewCreateInfo viewCI{};
+  viewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewCI.image = system.image;
+  viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+  viewCI.format = ci.format;
+  viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, slotCount };
+  if (vkCreateImageView(logicalDevice, &viewCI, nullptr, &system.imageView) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create background image view");
+
+  VkSamplerCreateInfo samplerCI{};
+  samplerCI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCI.magFilter = VK_FILTER_LINEAR;
+  samplerCI.minFilter = VK_FILTER_LINEAR;
+  samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (vkCreateSampler(logicalDevice, &samplerCI, nullptr, &system.sampler) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create background sampler");
+}
+
+static void createBackgroundPipeline(BackgroundSystem& system,
+                                     const BackgroundSystemCreateInfo& createInfo)
+{
+  const VkDevice logicalDevice = system.logicalDevice;
+
+  VkDescriptorSetLayoutBinding bindings[2]{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutCI{};
+  layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutCI.bindingCount = 2;
+  layoutCI.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(logicalDevice, &layoutCI, nullptr,
+                                  &system.descriptorSetLayout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create background descriptor set layout");
+
+  VkDescriptorPoolSize poolSizes[] = {
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+  };
+
+  VkDescriptorPoolCreateInfo poolCI{};
+  poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCI.maxSets = 1;
+  poolCI.poolSizeCount = 2;
+  poolCI.pPoolSizes = poolSizes;
+  if (vkCreateDescriptorPool(logicalDevice, &poolCI, nullptr, &system.descriptorPool) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create background descriptor pool");
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = system.descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &system.descriptorSetLayout;
+  if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &system.descriptorSet) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate background descriptor set");
+
+  VkDescriptorImageInfo imageInfo{ system.sampler, system.imageView,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+  VkDescriptorBufferInfo bufferInfo{ system.instances.buffer, 0,
+                                     BACKGROUND_MAX_VISIBLE_LAYERS * sizeof(BackgroundInstance) };
+
+  VkWriteDescriptorSet writes[2]{};
+  writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[0].dstSet = system.descriptorSet;
+  writes[0].dstBinding = 0;
+  writes[0].descriptorCount = 1;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[0].pImageInfo = &imageInfo;
+  writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[1].dstSet = system.descriptorSet;
+  writes[1].dstBinding = 1;
+  writes[1].descriptorCount = 1;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  writes[1].pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(logicalDevice, 2, writes, 0, nullptr);
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.size = sizeof(BackgroundPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+  pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutCI.setLayoutCount = 1;
+  pipelineLayoutCI.pSetLayouts = &system.descriptorSetLayout;
+  pipelineLayoutCI.pushConstantRangeCount = 1;
+  pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr,
+                             &system.pipelineLayout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create background pipeline layout");
+
+  VkShaderModule vertexModule = createShaderModule(logicalDevice, createInfo.vertexShader);
+  VkShaderModule fragmentModule = createShaderModule(logicalDevice, createInfo.fragmentShader);
+
+  GraphicsPipelineDesc desc;
+  desc.vertexShader = vertexModule;
+  desc.fragmentShader = fragmentModule;
+  desc.layout = system.pipelineLayout;
+  desc.renderPass = createInfo.renderPass;
+  system.pipeline = buildGraphicsPipeline(logicalDevice, desc);
+
+  vkDestroyShaderModule(logicalDevice, fragmentModule, nullptr);
+  vkDestroyShaderModule(logicalDevice, vertexModule, nullptr);
+}
+
+void createBackgroundSystem(BackgroundSystem& system,
+                            const BackgroundSystemCreateInfo& createInfo)
+{
+  if (!createInfo.load)
+    throw std::runtime_error("createBackgroundSystem: no texture loader");
+
+  system.logicalDevice = createInfo.logicalDevice;
+  system.slotWidth = createInfo.slotWidth;
+  system.slotHeight = createInfo.slotHeight;
+  system.framesInFlight = createInfo.framesInFlight;
+  system.prefetchDistance = createInfo.prefetchDistance;
+  system.crossFadeSeconds = createInfo.crossFadeSeconds;
+  system.slots.assign(createInfo.slotCount, {});
+  system.load = createInfo.load;
+
+  createBackgroundImage(system, createInfo.physicalDevice, createInfo.slotCount);
+
+  const VkDeviceSize slotBytes = (VkDeviceSize)system.slotWidth * system.slotHeight * 4;
+  system.staging = createBuffer(
+    createInfo.physicalDevice, system.logicalDevice, slotBytes * system.framesInFlight,
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  // 48 byte instances keep every frame's segment at a multiple of 256
+  system.instances = createBuffer(
+    createInfo.physicalDevice, system.logicalDevice,
+    BACKGROUND_MAX_VISIBLE_LAYERS * sizeof(BackgroundInstance) * system.framesInFlight,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  createBackgroundPipeline(system, createInfo);
+
+  system.worker = std::thread(runBackgroundWorker, &system);
+}
+
+void destroyBackgroundSystem(BackgroundSystem& system)
+{
+  {
+    std::lock_guard<std::mutex> lock(system.mutex);
+    system.quit = true;
+  }
+  system.condition.notify_all();
+  if (system.worker.joinable())
+    system.worker.join();
+
+  const VkDevice logicalDevice = system.logicalDevice;
+
+  vkDestroyPipeline(logicalDevice, system.pipeline, nullptr);
+  vkDestroyPipelineLayout(logicalDevice, system.pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(logicalDevice, system.descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(logicalDevice, system.descriptorSetLayout, nullptr);
+
+  destroyBuffer(logicalDevice, system.instances);
+  destroyBuffer(logicalDevice, system.staging);
+
+  vkDestroySampler(logicalDevice, system.sampler, nullptr);
+  vkDestroyImageView(logicalDevice, system.imageView, nullptr);
+  vkDestroyImage(logicalDevice, system.image, nullptr);
+  vkFreeMemory(logicalDevice, system.imageMemory, nullptr);
+
+  system.requests.clear();
+  system.results.clear();
+  system.slots.clear();
+  system.failedTextures.clear();
+}
+
+uint32_t addBackgroundStyle(BackgroundSystem& system, const BackgroundStyle& style)
+{
+  if (style.layers.size() > BACKGROUND_MAX_VISIBLE_LAYERS / 2)
+    throw std::runtime_error("addBackgroundStyle: too many layers");
+
+  system.styles.push_back(style);
+  return (uint32_t)system.styles.size() - 1;
+}
+
+void setBackgroundZones(BackgroundSystem& system, const std::vector<BackgroundZone>& zones)
+{
+  system.zones = zones;
+}
+
+static int findBackgroundSlot(const BackgroundSystem& system, uint32_t textureId)
+{
+  for (size_t i = 0; i < system.slots.size(); i++)
+  {
+    if (system.slots[i].textureId == textureId &&
+        system.slots[i].state != BackgroundSlotState::Free)
+      return (int)i;
+  }
+  return -1;
+}
+
+static bool styleUsesTexture(const BackgroundSystem& system, uint32_t style, uint32_t textureId)
+{
+  if (style == BACKGROUND_NO_STYLE)
+    return false;
+
+  for (const BackgroundLayer& layer : system.styles[style].layers)
+  {
+    if (layer.textureId == textureId)
+      return true;
+  }
+  return false;
+}
+
+static bool isTexturePinned(const BackgroundSystem& system, uint32_t textureId)
+{
+  return styleUsesTexture(system, system.activeStyle, textureId) ||
+         styleUsesTexture(system, system.fadingStyle, textureId) ||
+         styleUsesTexture(system, system.pendingStyle, textureId);
+}
+
+// Free slots first, then the least recently used resident slot no shown style depends on.
+static int acquireBackgroundSlot(BackgroundSystem& system)
+{
+  int best = -1;
+  for (size_t i = 0; i < system.slots.size(); i++)
+  {
+    const BackgroundSlot& slot = system.slots[i];
+    if (slot.state == BackgroundSlotState::Free)
+      return (int)i;
+
+    if (slot.state == BackgroundSlotState::Resident && !isTexturePinned(system, slot.textureId) &&
+        (best == -1 || slot.lastUsed < system.slots[best].lastUsed))
+      best = (int)i;
+  }
+  return best;
+}
+
+static void requestBackgroundStyle(BackgroundSystem& system, uint32_t style)
+{
+  for (const BackgroundLayer& layer : system.styles[style].layers)
+  {
+    if (system.failedTextures.count(layer.textureId))
+      continue;
+
+    int slot = findBackgroundSlot(system, layer.textureId);
+    if (slot == -1)
+    {
+      slot = acquireBackgroundSlot(system);
+      if (slot == -1)
+        return;
+
+      system.slots[slot].textureId = layer.textureId;
+      system.slots[slot].state = BackgroundSlotState::Loading;
+
+      {
+        std::lock_guard<std::mutex> lock(system.mutex);
+        system.requests.push_back({ (uint32_t)slot, layer.textureId, 0, 0, {} });
+      }
+      system.condition.notify_one();
+    }
+
+    system.slots[slot].lastUsed = system.frame;
+  }
+}
+
+static bool isBackgroundStyleResident(const BackgroundSystem& system, uint32_t style)
+{
+  for (const BackgroundLayer& layer : system.styles[style].layers)
+  {
+    if (system.failedTextures.count(layer.textureId))
+      continue;
+
+    int slot = findBackgroundSlot(system, layer.textureId);
+    if (slot == -1 || system.slots[slot].state != BackgroundSlotState::Resident)
+      return false;
+  }
+  return true;
+}
+
+static float distanceToZone(const BackgroundZone& zone, float x, float y)
+{
+  const float dx = std::max({ zone.x0 - x, 0.0f, x - zone.x1 });
+  const float dy = std::max({ zone.y0 - y, 0.0f, y - zone.y1 });
+  return std::max(dx, dy);
+}
+
+void updateBackgrounds(BackgroundSystem& system, float cameraX, float cameraY, float dt)
+{
+  system.frame++;
+
+  uint32_t cameraStyle = BACKGROUND_NO_STYLE;
+  for (const BackgroundZone& zone : system.zones)
+  {
+    if (distanceToZone(zone, cameraX, cameraY) == 0.0f)
+    {
+      cameraStyle = zone.style;
+      break;
+    }
+  }
+
+  if (cameraStyle != BACKGROUND_NO_STYLE && cameraStyle != system.activeStyle)
+    system.pendingStyle = cameraStyle;
+  else if (cameraStyle == system.activeStyle)
+    system.pendingStyle = BACKGROUND_NO_STYLE;
+
+  if (system.activeStyle != BACKGROUND_NO_STYLE)
+    requestBackgroundStyle(system, system.activeStyle);
+
+  // a new transition can only start once the previous one is over, otherwise three styles
+  // would have to stay resident
+  if (system.pendingStyle != BACKGROUND_NO_STYLE && system.fadingStyle == BACKGROUND_NO_STYLE)
+  {
+    requestBackgroundStyle(system, system.pendingStyle);
+    if (isBackgroundStyleResident(system, system.pendingStyle))
+    {
+      system.fadingStyle = system.activeStyle;
+      system.activeStyle = system.pendingStyle;
+      system.pendingStyle = BACKGROUND_NO_STYLE;
+      system.fade = system.fadingStyle == BACKGROUND_NO_STYLE ? 1.0f : 0.0f;
+    }
+  }
+
+  if (system.fadingStyle != BACKGROUND_NO_STYLE)
+  {
+    system.fade += system.crossFadeSeconds > 0.0f ? dt / system.crossFadeSeconds : 1.0f;
+    if (system.fade >= 1.0f)
+    {
+      // its slots are no longer pinned and will be the first to be reused
+      system.fade = 1.0f;
+      system.fadingStyle = BACKGROUND_NO_STYLE;
+    }
+  }
+
+  for (const BackgroundZone& zone : system.zones)
+  {
+    if (zone.style != system.activeStyle && zone.style != system.pendingStyle &&
+        distanceToZone(zone, cameraX, cameraY) < system.prefetchDistance)
+      requestBackgroundStyle(system, zone.style);
+  }
+}
+
+static void transitionBackgroundLayers(VkCommandBuffer commandBuffer, VkImage image,
+                                       uint32_t baseLayer, uint32_t layerCount,
+                                       VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, baseLayer, layerCount };
+
+  VkPipelineStageFlags srcStage, dstStage;
+  if (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+  {
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  }
+  else
+  {
+    barrier.srcAccessMask = oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? 0
+                                                                   : VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    srcStage = oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+                                                      : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  }
+
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1,
+                       &barrier);
+}
+
+void recordBackgroundUploads(VkCommandBuffer commandBuffer, BackgroundSystem& system,
+                             uint32_t frameIndex)
+{
+  if (!system.imageInitialized)
+  {
+    transitionBackgroundLayers(commandBuffer, system.image, 0, (uint32_t)system.slots.size(),
+                               VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    system.imageInitialized = true;
+  }
+
+  BackgroundLoadResult result;
+  {
+    std::lock_guard<std::mutex> lock(system.mutex);
+    if (system.results.empty())
+      return;
+
+    result = std::move(system.results.front());
+    system.results.pop_front();
+  }
+
+  BackgroundSlot& slot = system.slots[result.slot];
+  if (slot.textureId != result.textureId || slot.state != BackgroundSlotState::Loading)
+    return;
+
+  if (result.width == 0)
+  {
+    // decoding it again would fail the same way
+    system.failedTextures.insert(result.textureId);
+    slot = {};
+    return;
+  }
+
+  const VkDeviceSize slotBytes = (VkDeviceSize)system.slotWidth * system.slotHeight * 4;
+  const VkDeviceSize offset = (frameIndex % system.framesInFlight) * slotBytes;
+  memcpy((char*)system.staging.mapped + offset, result.pixels.data(),
+         (size_t)result.width * result.height * 4);
+
+  transitionBackgroundLayers(commandBuffer, system.image, result.slot, 1,
+                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = offset;
+  region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, result.slot, 1 };
+  region.imageExtent = { result.width, result.height, 1 };
+  vkCmdCopyBufferToImage(commandBuffer, system.staging.buffer, system.image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  transitionBackgroundLayers(commandBuffer, system.image, result.slot, 1,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  slot.state = BackgroundSlotState::Resident;
+  slot.uvScale[0] = (float)result.width / system.slotWidth;
+  slot.uvScale[1] = (float)result.height / system.slotHeight;
+  slot.size[0] = (float)result.width;
+  slot.size[1] = (float)result.height;
+}
+
+static uint32_t appendStyleInstances(const BackgroundSystem& system, uint32_t style, float alpha,
+                                     BackgroundInstance* instances, uint32_t count)
+{
+  if (style == BACKGROUND_NO_STYLE || alpha <= 0.0f)
+    return count;
+
+  for (const BackgroundLayer& layer : system.styles[style].layers)
+  {
+    int slotIndex = findBackgroundSlot(system, layer.textureId);
+    if (slotIndex == -1 || count == BACKGROUND_MAX_VISIBLE_LAYERS)
+      continue;
+
+    const BackgroundSlot& slot = system.slots[slotIndex];
+    if (slot.state != BackgroundSlotState::Resident)
+      continue;
+
+    BackgroundInstance& instance = instances[count++];
+    instance = {};
+    instance.scroll[0] = layer.scrollFactorX;
+    instance.scroll[1] = layer.scrollFactorY;
+    instance.uvScale[0] = slot.uvScale[0];
+    instance.uvScale[1] = slot.uvScale[1];
+    instance.size[0] = slot.size[0] * layer.scale;
+    instance.size[1] = slot.size[1] * layer.scale;
+    instance.offsetY = layer.offsetY;
+    instance.alpha = alpha;
+    instance.layer = (uint32_t)slotIndex;
+  }
+
+  return count;
+}
+
+void recordBackgroundDraw(VkCommandBuffer commandBuffer, BackgroundSystem& system,
+                          uint32_t frameIndex, float cameraX, float cameraY, float viewWidth,
+                          float viewHeight)
+{
+  const uint32_t segment = frameIndex % system.framesInFlight;
+  BackgroundInstance* instances =
+    (BackgroundInstance*)system.instances.mapped + segment * BACKGROUND_MAX_VISIBLE_LAYERS;
+
+  // the outgoing style stays opaque and the incoming one fades in over it, fading both would
+  // let the clear color show through halfway
+  uint32_t count = appendStyleInstances(system, system.fadingStyle, 1.0f, instances, 0);
+  count = appendStyleInstances(system, system.activeStyle,
+                               system.fadingStyle == BACKGROUND_NO_STYLE ? 1.0f : system.fade,
+                               instances, count);
+  if (count == 0)
+    return;
+
+  BackgroundPushConstants pc{ { cameraX, cameraY }, { viewWidth, viewHeight } };
+  const uint32_t dynamicOffset =
+    segment * BACKGROUND_MAX_VISIBLE_LAYERS * (uint32_t)sizeof(BackgroundInstance);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system.pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system.pipelineLayout,
+                          0, 1, &system.descriptorSet, 1, &dynamicOffset);
+  vkCmdPushConstants(commandBuffer, system.pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc),
+                     &pc);
+  vkCmdDraw(commandBuffer, 6, count, 0, 0);
+}
+
+uint64_t getBackgroundVramBytes(const BackgroundSystem& system)
+{
+  return (uint64_t)system.slotWidth * system.slotHeight * 4 * system.slots.size();
+}
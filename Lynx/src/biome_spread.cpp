@@ -0,0 +1,511 @@
+#include <Lynx/biome_spread.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#include <Lynx/random.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BIOME_SPREAD_SSE2
+#endif
+
+// Rows of a board with one more row above and below taken from the neighbouring chunks.
+constexpr const int32_t WINDOW_ROWS = TILE_CHUNK_SIZE + 2;
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static void markBiomeChunkStale(BiomeSpread& spread, uint32_t chunk)
+{
+  if (spread.staleFlags[chunk])
+    return;
+  spread.staleFlags[chunk] = 1;
+  spread.staleChunks.push_back(chunk);
+}
+
+static void markAllBiomeChunksStale(BiomeSpread& spread)
+{
+  for (uint32_t chunk = 0; chunk < (uint32_t)spread.staleFlags.size(); chunk++)
+    markBiomeChunkStale(spread, chunk);
+}
+
+static void onBiomeSpreadTilesChanged(void* userData, int32_t x0, int32_t y0, int32_t x1,
+                                      int32_t y1)
+{
+  BiomeSpread& spread = *(BiomeSpread*)userData;
+  if (spread.updating)
+    return;
+
+  const TileStore& store = *spread.store;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+      markBiomeChunkStale(spread, (uint32_t)(cy * store.chunksX + cx));
+  }
+}
+
+void createBiomeSpread(BiomeSpread& spread, TileStore& store, JobSystem& jobs, uint64_t seed,
+                       uint32_t biomeCount)
+{
+  if (biomeCount == 0 || biomeCount > BIOME_SPREAD_MAX_BIOMES)
+    throw std::runtime_error("createBiomeSpread: biome count out of range");
+
+  const size_t chunks = store.chunks.size();
+  spread.store = &store;
+  spread.jobs = &jobs;
+  spread.seed = seed;
+  spread.tick = 0;
+  spread.biomeCount = biomeCount;
+  spread.conversions.assign((size_t)biomeCount * TILE_TYPE_COUNT, BIOME_NO_CONVERSION);
+  spread.infectingBiomes.assign(TILE_TYPE_COUNT, 0);
+  spread.boards.assign(chunks * biomeCount * BIOME_BOARD_COUNT * TILE_CHUNK_SIZE, 0);
+  spread.staleFlags.assign(chunks, 0);
+  spread.infectedFlags.assign(chunks, 0);
+  spread.staleChunks.clear();
+  spread.updating = false;
+  spread.stats = {};
+  markAllBiomeChunksStale(spread);
+  addTileChangeListener(store, onBiomeSpreadTilesChanged, &spread);
+}
+
+void destroyBiomeSpread(BiomeSpread& spread)
+{
+  if (spread.store)
+    removeTileChangeListener(*spread.store, onBiomeSpreadTilesChanged, &spread);
+  spread.store = nullptr;
+  spread.conversions.clear();
+  spread.infectingBiomes.clear();
+  spread.boards.clear();
+  spread.staleFlags.clear();
+  spread.infectedFlags.clear();
+  spread.staleChunks.clear();
+}
+
+void setBiomeConversion(BiomeSpread& spread, uint32_t biome, uint16_t type, uint16_t to)
+{
+  if (biome >= spread.biomeCount)
+    throw std::runtime_error("setBiomeConversion: biome out of range");
+
+  spread.conversions[(size_t)biome * TILE_TYPE_COUNT + type] = to;
+  markAllBiomeChunksStale(spread);
+}
+
+void setBiomeInfecting(BiomeSpread& spread, uint32_t biome, uint16_t type)
+{
+  if (biome >= spread.biomeCount)
+    throw std::runtime_error("setBiomeInfecting: biome out of range");
+
+  spread.infectingBiomes[type] = (uint8_t)(biome + 1);
+  markAllBiomeChunksStale(spread);
+}
+
+// Sets the board bits of tile i of chunk from type, for an active tile, or clears them.
+static void setBiomeBoardBits(BiomeSpread& spread, uint32_t chunk, uint32_t i, uint16_t type,
+                              bool active)
+{
+  const uint32_t row = i >> TILE_CHUNK_SHIFT, bit = 1u << (i & TILE_CHUNK_MASK);
+  for (uint32_t biome = 0; biome < spread.biomeCount; biome++)
+  {
+    uint32_t* convertible = getBiomeBoard(spread, chunk, biome, BIOME_BOARD_CONVERTIBLE);
+    uint32_t* infecting = getBiomeBoard(spread, chunk, biome, BIOME_BOARD_INFECTING);
+    const bool converts =
+      active && spread.conversions[(size_t)biome * TILE_TYPE_COUNT + type] != BIOME_NO_CONVERSION;
+    const bool infects = active && spread.infectingBiomes[type] == biome + 1;
+    convertible[row] = converts ? convertible[row] | bit : convertible[row] & ~bit;
+    infecting[row] = infects ? infecting[row] | bit : infecting[row] & ~bit;
+  }
+}
+
+static void updateBiomeInfectedFlag(BiomeSpread& spread, uint32_t chunk)
+{
+  uint32_t any = 0;
+  for (uint32_t biome = 0; biome < spread.biomeCount; biome++)
+  {
+    const uint32_t* infecting = getBiomeBoard(spread, chunk, biome, BIOME_BOARD_INFECTING);
+    for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+      any |= infecting[row];
+  }
+  spread.infectedFlags[chunk] = any != 0;
+}
+
+static void rebuildBiomeBoards(BiomeSpread& spread, uint32_t chunk)
+{
+  const TileStore& store = *spread.store;
+  const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+  const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+  std::fill_n(getBiomeBoard(spread, chunk, 0, BIOME_BOARD_CONVERTIBLE),
+              spread.biomeCount * BIOME_BOARD_COUNT * TILE_CHUNK_SIZE, 0u);
+  for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+  {
+    forEachTileRowView(store, y0 + row, x0, x0 + TILE_CHUNK_SIZE,
+                       [&](const TileRowView& view, int32_t x)
+                       {
+                         for (int32_t i = 0; i < view.count; i++)
+                         {
+                           if (view.flags[i] & TILE_ACTIVE)
+                             setBiomeBoardBits(spread, chunk,
+                                               (uint32_t)(row * TILE_CHUNK_SIZE + x - x0 + i),
+                                               view.types[i], true);
+                         }
+                       });
+  }
+  updateBiomeInfectedFlag(spread, chunk);
+}
+
+// Rebuilds the boards of stale chunks as jobs. Unloaded chunks stay stale until they are loaded.
+static void refreshBiomeBoards(BiomeSpread& spread)
+{
+  const TileStore& store = *spread.store;
+  std::vector<uint32_t> rebuilt;
+  uint32_t kept = 0;
+  for (uint32_t chunk : spread.staleChunks)
+  {
+    if (store.chunks[store.chunkSlots[chunk]].unloaded)
+      spread.staleChunks[kept++] = chunk;
+    else
+      rebuilt.push_back(chunk);
+  }
+  spread.staleChunks.resize(kept);
+
+  runJobs(*spread.jobs, (uint32_t)rebuilt.size(),
+          [&](uint32_t index, uint32_t) { rebuildBiomeBoards(spread, rebuilt[index]); });
+  for (uint32_t chunk : rebuilt)
+    spread.staleFlags[chunk] = 0;
+}
+
+// Row r of the board of the chunk at (cx, cy), 0 outside the world.
+static uint32_t getBiomeBoardRow(BiomeSpread& spread, int32_t cx, int32_t cy, int32_t row,
+                                 uint32_t biome, BiomeBoard board)
+{
+  const TileStore& store = *spread.store;
+  if (cx < 0 || cy < 0 || cx >= store.chunksX || cy >= store.chunksY)
+    return 0;
+  return getBiomeBoard(spread, (uint32_t)(cy * store.chunksX + cx), biome, board)[row];
+}
+
+// 8 neighbourhood of the center board: every bit next to or on a set bit of the window rows,
+// where left and right are the boards of the chunks to either side.
+static void dilateBiomeBoard(const uint32_t center[WINDOW_ROWS], const uint32_t left[WINDOW_ROWS],
+                             const uint32_t right[WINDOW_ROWS], uint32_t out[TILE_CHUNK_SIZE])
+{
+  uint32_t rows[WINDOW_ROWS];
+  int32_t row = 0;
+#if defined(BIOME_SPREAD_SSE2)
+  for (; row + 4 <= WINDOW_ROWS; row += 4)
+  {
+    const __m128i c = _mm_loadu_si128((const __m128i*)(center + row));
+    const __m128i l = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(left + row)), 31);
+    const __m128i r = _mm_slli_epi32(_mm_loadu_si128((const __m128i*)(right + row)), 31);
+    const __m128i h = _mm_or_si128(_mm_or_si128(c, _mm_slli_epi32(c, 1)), _mm_srli_epi32(c, 1));
+    _mm_storeu_si128((__m128i*)(rows + row), _mm_or_si128(h, _mm_or_si128(l, r)));
+  }
+#endif
+  for (; row < WINDOW_ROWS; row++)
+  {
+    const uint32_t c = center[row];
+    rows[row] = c | c << 1 | c >> 1 | left[row] >> 31 | right[row] << 31;
+  }
+
+#if defined(BIOME_SPREAD_SSE2)
+  static_assert(TILE_CHUNK_SIZE % 4 == 0);
+  for (row = 0; row < TILE_CHUNK_SIZE; row += 4)
+  {
+    const __m128i above = _mm_loadu_si128((const __m128i*)(rows + row));
+    const __m128i middle = _mm_loadu_si128((const __m128i*)(rows + row + 1));
+    const __m128i below = _mm_loadu_si128((const __m128i*)(rows + row + 2));
+    _mm_storeu_si128((__m128i*)(out + row), _mm_or_si128(_mm_or_si128(above, middle), below));
+  }
+#else
+  for (row = 0; row < TILE_CHUNK_SIZE; row++)
+    out[row] = rows[row] | rows[row + 1] | rows[row + 2];
+#endif
+}
+
+// out = a & b & ~taken, then taken |= out. Returns whether out has a bit set.
+static bool maskBiomeCandidates(const uint32_t* a, const uint32_t* b, uint32_t* taken,
+                                uint32_t* out)
+{
+  int32_t row = 0;
+  uint32_t any = 0;
+#if defined(BIOME_SPREAD_SSE2)
+  __m128i anyRows = _mm_setzero_si128();
+  for (; row + 4 <= TILE_CHUNK_SIZE; row += 4)
+  {
+    const __m128i t = _mm_loadu_si128((const __m128i*)(taken + row));
+    const __m128i ab = _mm_and_si128(_mm_loadu_si128((const __m128i*)(a + row)),
+                                     _mm_loadu_si128((const __m128i*)(b + row)));
+    const __m128i m = _mm_andnot_si128(t, ab);
+    _mm_storeu_si128((__m128i*)(out + row), m);
+    _mm_storeu_si128((__m128i*)(taken + row), _mm_or_si128(t, m));
+    anyRows = _mm_or_si128(anyRows, m);
+  }
+  any = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi32(anyRows, _mm_setzero_si128())) != 0xffff;
+#endif
+  for (; row < TILE_CHUNK_SIZE; row++)
+  {
+    out[row] = a[row] & b[row] & ~taken[row];
+    taken[row] |= out[row];
+    any |= out[row];
+  }
+  return any != 0;
+}
+
+// Spread candidates of chunk for this tick into masks, a board per biome. Returns whether there
+// are any.
+static bool findBiomeSpread(BiomeSpread& spread, uint32_t chunk, uint32_t* masks)
+{
+  const TileStore& store = *spread.store;
+  const int32_t cx = (int32_t)(chunk % store.chunksX), cy = (int32_t)(chunk / store.chunksX);
+  uint32_t taken[TILE_CHUNK_SIZE] = {};
+  bool any = false;
+  for (uint32_t biome = 0; biome < spread.biomeCount; biome++)
+  {
+    uint32_t windows[3][WINDOW_ROWS];
+    for (int32_t side = 0; side < 3; side++)
+    {
+      windows[side][0] = getBiomeBoardRow(spread, cx + side - 1, cy - 1, TILE_CHUNK_SIZE - 1,
+                                          biome, BIOME_BOARD_INFECTING);
+      windows[side][WINDOW_ROWS - 1] =
+        getBiomeBoardRow(spread, cx + side - 1, cy + 1, 0, biome, BIOME_BOARD_INFECTING);
+      for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+        windows[side][row + 1] =
+          getBiomeBoardRow(spread, cx + side - 1, cy, row, biome, BIOME_BOARD_INFECTING);
+    }
+    uint32_t reach[TILE_CHUNK_SIZE];
+    dilateBiomeBoard(windows[1], windows[0], windows[2], reach);
+    any |= maskBiomeCandidates(reach, getBiomeBoard(spread, chunk, biome, BIOME_BOARD_CONVERTIBLE),
+                               taken, masks + biome * TILE_CHUNK_SIZE);
+  }
+  if (!any || spread.spreadShift == 0)
+    return any;
+
+  // every candidate converts with a chance of 1 in 2^spreadShift, the AND of that many words
+  RandomStream stream = createRandomStream(spread.seed, spread.pass, chunk, spread.tick);
+  uint32_t chance[TILE_CHUNK_SIZE], words[TILE_CHUNK_SIZE];
+  fillRandom(stream, chance, TILE_CHUNK_SIZE);
+  for (uint32_t n = 1; n < spread.spreadShift; n++)
+  {
+    fillRandom(stream, words, TILE_CHUNK_SIZE);
+    for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+      chance[row] &= words[row];
+  }
+  any = false;
+  for (uint32_t biome = 0; biome < spread.biomeCount; biome++)
+  {
+    uint32_t* mask = masks + biome * TILE_CHUNK_SIZE;
+    for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+    {
+      mask[row] &= chance[row];
+      any |= mask[row] != 0;
+    }
+  }
+  return any;
+}
+
+// Converts the tiles of masks, a board per biome for every chunk of chunks, and notifies the
+// listeners of the chunks that changed. Adds to the stats.
+static void applyBiomeConversions(BiomeSpread& spread, const std::vector<uint32_t>& chunks,
+                                  const std::vector<uint32_t>& masks)
+{
+  TileStore& store = *spread.store;
+  const uint32_t boardRows = spread.biomeCount * TILE_CHUNK_SIZE;
+
+  // writable chunks are made serially, writing their tiles is then safe per chunk
+  std::vector<uint32_t> changed;
+  std::vector<TileChunkRaw*> raws;
+  for (uint32_t index = 0; index < (uint32_t)chunks.size(); index++)
+  {
+    uint32_t any = 0;
+    for (uint32_t row = 0; row < boardRows; row++)
+      any |= masks[index * boardRows + row];
+    if (!any)
+      continue;
+    changed.push_back(index);
+    raws.push_back(&getWritableTileChunk(store, store.chunkSlots[chunks[index]]));
+  }
+
+  std::vector<uint32_t> converted(changed.size());
+  runJobs(*spread.jobs, (uint32_t)changed.size(),
+          [&](uint32_t index, uint32_t)
+          {
+            const uint32_t chunk = chunks[changed[index]];
+            const uint32_t* mask = &masks[changed[index] * boardRows];
+            TileChunkRaw& raw = *raws[index];
+            for (uint32_t biome = 0; biome < spread.biomeCount; biome++)
+            {
+              const uint16_t* conversions = &spread.conversions[(size_t)biome * TILE_TYPE_COUNT];
+              for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+              {
+                uint32_t bits = mask[biome * TILE_CHUNK_SIZE + row];
+                converted[index] += (uint32_t)std::popcount(bits);
+                while (bits)
+                {
+                  const uint32_t i = (uint32_t)(row * TILE_CHUNK_SIZE + std::countr_zero(bits));
+                  bits &= bits - 1;
+                  const uint16_t type = conversions[raw.hot.types[i]];
+                  raw.hot.types[i] = type;
+                  raw.hot.flags[i] = (raw.hot.flags[i] & ~TILE_TYPE_FLAGS) | store.typeFlags[type];
+                  setBiomeBoardBits(spread, chunk, i, type, true);
+                }
+              }
+            }
+            updateBiomeInfectedFlag(spread, chunk);
+          });
+
+  spread.updating = true;
+  for (uint32_t index = 0; index < (uint32_t)changed.size(); index++)
+  {
+    const uint32_t chunk = chunks[changed[index]];
+    const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+    const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+    notifyTilesChanged(store, x0, y0, std::min(x0 + TILE_CHUNK_SIZE, store.width),
+                       std::min(y0 + TILE_CHUNK_SIZE, store.height));
+    spread.stats.converted += converted[index];
+  }
+  spread.updating = false;
+  spread.stats.chunks += (uint32_t)changed.size();
+}
+
+const BiomeSpreadStats& updateBiomeSpread(BiomeSpread& spread)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  const TileStore& store = *spread.store;
+  spread.stats = {};
+  refreshBiomeBoards(spread);
+
+  // chunks in reach of an infected one, in chunk order; stale chunks wait for their boards
+  std::vector<uint8_t> reached(spread.infectedFlags.size(), 0);
+  for (int32_t cy = 0; cy < store.chunksY; cy++)
+  {
+    for (int32_t cx = 0; cx < store.chunksX; cx++)
+    {
+      if (!spread.infectedFlags[cy * store.chunksX + cx])
+        continue;
+      for (int32_t y = std::max(cy - 1, 0); y <= std::min(cy + 1, store.chunksY - 1); y++)
+      {
+        for (int32_t x = std::max(cx - 1, 0); x <= std::min(cx + 1, store.chunksX - 1); x++)
+          reached[y * store.chunksX + x] = 1;
+      }
+    }
+  }
+  std::vector<uint32_t> chunks;
+  for (uint32_t chunk = 0; chunk < (uint32_t)reached.size(); chunk++)
+  {
+    if (reached[chunk] && !spread.staleFlags[chunk])
+      chunks.push_back(chunk);
+  }
+
+  const uint32_t boardRows = spread.biomeCount * TILE_CHUNK_SIZE;
+  std::vector<uint32_t> masks(chunks.size() * boardRows, 0);
+  runJobs(*spread.jobs, (uint32_t)chunks.size(), [&](uint32_t index, uint32_t)
+          { findBiomeSpread(spread, chunks[index], &masks[index * boardRows]); });
+  applyBiomeConversions(spread, chunks, masks);
+
+  spread.tick++;
+  spread.stats.nanoseconds = getSteadyNanoseconds() - start;
+  return spread.stats;
+}
+
+// Columns of row y of the chunk at x0 inside stripe, as bits.
+static uint32_t getBiomeStripeBits(const BiomeStripe& stripe, int32_t x0, int32_t y)
+{
+  if (y < std::min(stripe.y0, stripe.y1) || y > std::max(stripe.y0, stripe.y1))
+    return 0;
+
+  int32_t left, right;
+  if (stripe.y0 == stripe.y1)
+  {
+    left = std::min(stripe.x0, stripe.x1) - stripe.halfWidth;
+    right = std::max(stripe.x0, stripe.x1) + stripe.halfWidth;
+  }
+  else
+  {
+    const double t = (double)(y - stripe.y0) / (stripe.y1 - stripe.y0);
+    const int32_t center = (int32_t)std::lround(stripe.x0 + (stripe.x1 - stripe.x0) * t);
+    left = center - stripe.halfWidth;
+    right = center + stripe.halfWidth;
+  }
+  left = std::max(left - x0, 0);
+  right = std::min(right - x0, TILE_CHUNK_SIZE - 1);
+  if (right < left)
+    return 0;
+  const uint32_t count = (uint32_t)(right - left + 1);
+  return (count == 32 ? ~0u : (1u << count) - 1) << left;
+}
+
+const BiomeSpreadStats& convertBiomeStripes(BiomeSpread& spread, const BiomeStripe* stripes,
+                                            uint32_t count)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  TileStore& store = *spread.store;
+  spread.stats = {};
+  for (uint32_t s = 0; s < count; s++)
+  {
+    if (stripes[s].biome >= spread.biomeCount)
+      throw std::runtime_error("convertBiomeStripes: biome out of range");
+  }
+
+  // chunks the stripes cross, loaded first since the event must reach every one of them
+  std::vector<uint32_t> chunks;
+  for (int32_t cy = 0; cy < store.chunksY; cy++)
+  {
+    for (int32_t cx = 0; cx < store.chunksX; cx++)
+    {
+      bool crossed = false;
+      for (uint32_t s = 0; s < count && !crossed; s++)
+      {
+        for (int32_t row = 0; row < TILE_CHUNK_SIZE && !crossed; row++)
+          crossed = getBiomeStripeBits(stripes[s], cx << TILE_CHUNK_SHIFT,
+                                       (cy << TILE_CHUNK_SHIFT) + row) != 0;
+      }
+      if (!crossed)
+        continue;
+      const uint32_t chunk = (uint32_t)(cy * store.chunksX + cx);
+      loadTileChunk(store, store.chunkSlots[chunk]);
+      chunks.push_back(chunk);
+    }
+  }
+  refreshBiomeBoards(spread);
+
+  const uint32_t boardRows = spread.biomeCount * TILE_CHUNK_SIZE;
+  std::vector<uint32_t> masks(chunks.size() * boardRows, 0);
+  runJobs(*spread.jobs, (uint32_t)chunks.size(),
+          [&](uint32_t index, uint32_t)
+          {
+            const uint32_t chunk = chunks[index];
+            const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+            const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+            uint32_t taken[TILE_CHUNK_SIZE] = {}, band[TILE_CHUNK_SIZE], mask[TILE_CHUNK_SIZE];
+            for (uint32_t s = 0; s < count; s++)
+            {
+              const BiomeStripe& stripe = stripes[s];
+              for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+                band[row] = getBiomeStripeBits(stripe, x0, y0 + row);
+              maskBiomeCandidates(
+                band, getBiomeBoard(spread, chunk, stripe.biome, BIOME_BOARD_CONVERTIBLE), taken,
+                mask);
+              uint32_t* out = &masks[index * boardRows + stripe.biome * TILE_CHUNK_SIZE];
+              for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+                out[row] |= mask[row];
+            }
+          });
+  applyBiomeConversions(spread, chunks, masks);
+
+  spread.stats.nanoseconds = getSteadyNanoseconds() - start;
+  return spread.stats;
+}
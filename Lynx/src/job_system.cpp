@@ -0,0 +1,179 @@
+#include <Lynx/job_system.h>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+// jobs a worker runs of a batch before it turns to the next queued one, if there is one
+constexpr const uint32_t JOB_WORKER_SLICE = 8;
+
+// Claims and runs up to maxJobs jobs of batch, the caller entered the batch as a user. A worker
+// passes yield to stop after a slice whenever other batches are queued. The batch leaves the
+// queue once a claim finds no job left.
+static void runJobBatch(JobSystem& system, JobBatch& batch, uint32_t thread,
+                        uint32_t maxJobs = UINT32_MAX, bool yield = false)
+{
+  bool exhausted = false;
+  for (uint32_t run = 0; run < maxJobs; run++)
+  {
+    if (yield && run >= JOB_WORKER_SLICE &&
+        system.queuedBatches.load(std::memory_order_relaxed) > 1)
+      break;
+
+    const uint32_t index = batch.next.fetch_add(1, std::memory_order_relaxed);
+    if (index >= batch.count)
+    {
+      exhausted = true;
+      break;
+    }
+
+    try
+    {
+      batch.fn(batch.userData, index, thread);
+    }
+    catch (const std::exception& e)
+    {
+      std::lock_guard<std::mutex> lock(system.mutex);
+      if (batch.error.empty())
+        batch.error = e.what();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(system.mutex);
+  if (exhausted && batch.queued)
+  {
+    system.batches.erase(std::find(system.batches.begin(), system.batches.end(), &batch));
+    system.queuedBatches.store((uint32_t)system.batches.size(), std::memory_order_relaxed);
+    batch.queued = false;
+  }
+  if (--batch.users == 0)
+    system.finishedCondition.notify_all();
+}
+
+// Workers take the batch at the front and move it to the back, so every queued batch gets its
+// turn and a long one does not hold back those submitted after it.
+static void runJobWorker(JobSystem* system, uint32_t thread)
+{
+  while (true)
+  {
+    JobBatch* batch;
+    {
+      std::unique_lock<std::mutex> lock(system->mutex);
+      system->condition.wait(lock, [&] { return system->quit || !system->batches.empty(); });
+      if (system->batches.empty())
+        return;
+      batch = system->batches.front();
+      if (system->batches.size() > 1)
+      {
+        system->batches.pop_front();
+        system->batches.push_back(batch);
+      }
+      batch->users++;
+    }
+
+    runJobBatch(*system, *batch, thread, UINT32_MAX, true);
+  }
+}
+
+void createJobSystem(JobSystem& system, uint32_t workerCount)
+{
+  if (workerCount == 0)
+    workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+  system.workers.reserve(workerCount);
+  for (uint32_t thread = 0; thread < workerCount; thread++)
+    system.workers.emplace_back(runJobWorker, &system, thread);
+}
+
+void destroyJobSystem(JobSystem& system)
+{
+  {
+    std::lock_guard<std::mutex> lock(system.mutex);
+    system.quit = true;
+  }
+  system.condition.notify_all();
+  for (std::thread& worker : system.workers)
+    worker.join();
+  system.workers.clear();
+}
+
+uint32_t getJobThreadCount(const JobSystem& system)
+{
+  return (uint32_t)system.workers.size() + 1;
+}
+
+void submitJobs(JobSystem& system, JobBatch& batch, JobFn fn, void* userData, uint32_t count)
+{
+  batch.fn = fn;
+  batch.userData = userData;
+  batch.count = count;
+  batch.next.store(0, std::memory_order_relaxed);
+  batch.error.clear();
+  if (count == 0)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(system.mutex);
+    batch.queued = true;
+    system.batches.push_back(&batch);
+    system.queuedBatches.store((uint32_t)system.batches.size(), std::memory_order_relaxed);
+  }
+  if (count == 1)
+    system.condition.notify_one();
+  else
+    system.condition.notify_all();
+}
+
+bool isJobBatchFinished(JobSystem& system, JobBatch& batch)
+{
+  std::lock_guard<std::mutex> lock(system.mutex);
+  return !batch.queued && batch.users == 0 &&
+         batch.next.load(std::memory_order_relaxed) >= batch.count;
+}
+
+void waitForJobs(JobSystem& system, JobBatch& batch)
+{
+  {
+    std::lock_guard<std::mutex> lock(system.mutex);
+    batch.users++;
+  }
+  runJobBatch(system, batch, (uint32_t)system.workers.size());
+
+  std::string error;
+  {
+    std::unique_lock<std::mutex> lock(system.mutex);
+    system.finishedCondition.wait(lock, [&] { return batch.users == 0; });
+    error = std::move(batch.error);
+  }
+  if (!error.empty())
+    throw std::runtime_error("waitForJobs: " + error);
+}
+
+void waitForAnyJobs(JobSystem& system, JobBatch* const* batches, uint32_t count)
+{
+  const uint32_t thread = (uint32_t)system.workers.size();
+  std::unique_lock<std::mutex> lock(system.mutex);
+  while (true)
+  {
+    JobBatch* help = nullptr;
+    for (uint32_t b = 0; b < count; b++)
+    {
+      if (!batches[b]->queued && batches[b]->users == 0)
+        return;
+      if (!help && batches[b]->queued)
+        help = batches[b];
+    }
+
+    if (!help)
+    {
+      system.finishedCondition.wait(lock);
+      continue;
+    }
+
+    // one job at a time, so a batch finishing elsewhere is noticed soon
+    help->users++;
+    lock.unlock();
+    runJobBatch(system, *help, thread, 1);
+    lock.lock();
+  }
+}
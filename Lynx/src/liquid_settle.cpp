@@ -0,0 +1,519 @@
+#include <Lynx/liquid_settle.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+struct SettleSegment
+{
+  int32_t x0, x1, y;
+  // basin the run was given in its own row
+  int32_t basin;
+  // next run of the same basin, higher up or further right
+  int32_t next;
+};
+
+struct SettleBasin
+{
+  int32_t parent = -1;
+  int32_t firstChild = -1;
+  int32_t nextSibling = -1;
+  int32_t firstSegment = -1;
+  int32_t lastSegment = -1;
+
+  uint64_t ownCapacity = 0;
+  // own capacity and that of every basin below
+  uint64_t capacity = 0;
+  // liquid landed on the basin's own runs or spilled into it, by type
+  uint64_t volumes[4] = {};
+  // liquid held by the basin and the basins below, and the part its own rows hold
+  uint64_t kept = 0;
+  uint64_t ownFill = 0;
+  uint64_t overflow = 0;
+  // poured down from the parent after the basin was settled
+  uint64_t extra = 0;
+  uint8_t type = TILE_LIQUID_WATER;
+};
+
+struct LiquidSettler
+{
+  TileStore* store;
+  // writes straight to the raw chunks of a store being generated
+  bool generating;
+  std::vector<SettleSegment> segments;
+  std::vector<int32_t> parents;
+  // basin of the component a root run belongs to
+  std::vector<int32_t> rootBasins;
+  std::vector<SettleBasin> basins;
+  // 1 for chunks that held liquid before settling
+  std::vector<uint8_t> wetChunks;
+  // tiles the cellular pass starts from, y << 32 | x
+  std::vector<uint64_t> unsettled;
+};
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static TileChunkRaw& getSettleChunk(LiquidSettler& settler, int32_t x, int32_t y)
+{
+  const uint32_t slot = getTileChunkSlot(*settler.store, x, y);
+  if (settler.generating)
+    return *settler.store->chunks[slot].raw;
+  return getWritableTileChunk(*settler.store, slot);
+}
+
+static bool isSettleTileOpen(uint8_t flags)
+{
+  return (flags & (TILE_ACTIVE | TILE_SOLID | TILE_ACTUATED)) != (TILE_ACTIVE | TILE_SOLID);
+}
+
+static int32_t findSettleRoot(LiquidSettler& settler, int32_t s)
+{
+  while (settler.parents[s] != s)
+  {
+    settler.parents[s] = settler.parents[settler.parents[s]];
+    s = settler.parents[s];
+  }
+  return s;
+}
+
+static void appendSettleSegment(LiquidSettler& settler, int32_t basin, int32_t s)
+{
+  SettleBasin& b = settler.basins[basin];
+  if (b.lastSegment >= 0)
+    settler.segments[b.lastSegment].next = s;
+  else
+    b.firstSegment = s;
+  b.lastSegment = s;
+
+  SettleSegment& segment = settler.segments[s];
+  segment.basin = basin;
+  b.ownCapacity += (uint64_t)(segment.x1 - segment.x0) * LIQUID_FULL;
+}
+
+// Calls fn(s, t) for every run s of [first, last) overlapping a run t of [below, first).
+template <typename F>
+static void forEachSettleOverlap(const LiquidSettler& settler, int32_t below, int32_t first,
+                                 int32_t last, F&& fn)
+{
+  for (int32_t s = first, t = below; s < last && t < first;)
+  {
+    const SettleSegment& a = settler.segments[s];
+    const SettleSegment& b = settler.segments[t];
+    if (a.x0 < b.x1 && b.x0 < a.x1)
+      fn(s, t);
+    if (a.x1 < b.x1)
+      s++;
+    else
+      t++;
+  }
+}
+
+// One sweep from the bottom row up, building the runs and basins and landing the liquid.
+static void buildSettleBasins(LiquidSettler& settler, LiquidSettleStats& stats)
+{
+  TileStore& store = *settler.store;
+  const int32_t width = store.width;
+  std::vector<uint8_t> open(width), openBelow(width, 0);
+  std::vector<uint8_t> liquids(width), types(width);
+  // run each open column drops its liquid onto
+  std::vector<int32_t> landing(width, -1);
+  // run of this row and basin of the run below it
+  std::vector<std::pair<int32_t, int32_t>> overlaps;
+  // basins below each group of runs joined through this row, by root run
+  std::vector<std::vector<int32_t>> groups;
+  std::vector<int32_t> groupOf;
+  int32_t below = 0;
+
+  for (int32_t y = store.height - 1; y >= 0; y--)
+  {
+    forEachTileRowView(store, y, 0, width, [&](const TileRowView& view, int32_t x) {
+      bool wet = false;
+      for (int32_t i = 0; i < view.count; i++)
+      {
+        open[x + i] = isSettleTileOpen(view.flags[i]);
+        liquids[x + i] = open[x + i] ? view.liquids[i] : 0;
+        types[x + i] =
+          (uint8_t)((view.attributes[i] >> TILE_LIQUID_TYPE_SHIFT) & TILE_LIQUID_TYPE_MASK);
+        wet |= view.liquids[i] != 0;
+      }
+      if (wet)
+        settler.wetChunks[getTileChunkSlot(store, x, y)] = 1;
+    });
+
+    const int32_t first = (int32_t)settler.segments.size();
+    for (int32_t x = 0; x < width;)
+    {
+      if (!open[x])
+      {
+        x++;
+        continue;
+      }
+      const int32_t x0 = x;
+      while (x < width && open[x])
+        x++;
+      const int32_t s = (int32_t)settler.segments.size();
+      settler.segments.push_back({ x0, x, y, -1, -1 });
+      settler.parents.push_back(s);
+      settler.rootBasins.push_back(-1);
+      groupOf.push_back(-1);
+    }
+    const int32_t last = (int32_t)settler.segments.size();
+
+    // basins below are read before the runs of this row join them
+    overlaps.clear();
+    forEachSettleOverlap(settler, below, first, last, [&](int32_t s, int32_t t) {
+      overlaps.push_back({ s, settler.rootBasins[findSettleRoot(settler, t)] });
+    });
+    forEachSettleOverlap(settler, below, first, last, [&](int32_t s, int32_t t) {
+      const int32_t a = findSettleRoot(settler, s), b = findSettleRoot(settler, t);
+      if (a != b)
+        settler.parents[b] = a;
+    });
+
+    groups.clear();
+    for (int32_t s = first; s < last; s++)
+    {
+      const int32_t root = findSettleRoot(settler, s);
+      if (groupOf[root] < 0)
+      {
+        groupOf[root] = (int32_t)groups.size();
+        groups.emplace_back();
+      }
+    }
+    for (const std::pair<int32_t, int32_t>& overlap : overlaps)
+    {
+      std::vector<int32_t>& group = groups[groupOf[findSettleRoot(settler, overlap.first)]];
+      if (std::find(group.begin(), group.end(), overlap.second) == group.end())
+        group.push_back(overlap.second);
+    }
+
+    // a group over nothing starts a basin on a pocket floor, a group over one basin extends it
+    // and a group over several merges them into a new one
+    for (std::vector<int32_t>& group : groups)
+    {
+      if (group.size() == 1)
+        continue;
+      const int32_t basin = (int32_t)settler.basins.size();
+      settler.basins.emplace_back();
+      for (int32_t child : group)
+      {
+        settler.basins[child].parent = basin;
+        settler.basins[child].nextSibling = settler.basins[basin].firstChild;
+        settler.basins[basin].firstChild = child;
+      }
+      group.assign(1, basin);
+    }
+    for (int32_t s = first; s < last; s++)
+    {
+      const int32_t root = findSettleRoot(settler, s);
+      const int32_t basin = groups[groupOf[root]][0];
+      settler.rootBasins[root] = basin;
+      appendSettleSegment(settler, basin, s);
+    }
+    for (int32_t s = first; s < last; s++)
+      groupOf[findSettleRoot(settler, s)] = -1;
+
+    // liquid falls to the first run with ground under it
+    for (int32_t s = first; s < last; s++)
+    {
+      const SettleSegment& segment = settler.segments[s];
+      for (int32_t x = segment.x0; x < segment.x1; x++)
+      {
+        if (!openBelow[x])
+          landing[x] = s;
+        if (liquids[x] == 0)
+          continue;
+        settler.basins[settler.segments[landing[x]].basin].volumes[types[x]] += liquids[x];
+        stats.volume += liquids[x];
+      }
+    }
+
+    std::swap(open, openBelow);
+    below = first;
+  }
+}
+
+static uint8_t getSettleBasinType(const SettleBasin& basin)
+{
+  uint8_t type = 0;
+  for (uint8_t t = 1; t < 4; t++)
+  {
+    if (basin.volumes[t] > basin.volumes[type])
+      type = t;
+  }
+  return type;
+}
+
+// Pours up to volume into the basins below basin that still have room, returns what is left.
+static uint64_t pourIntoSettleChildren(LiquidSettler& settler, const SettleBasin& basin,
+                                       uint64_t volume)
+{
+  for (int32_t c = basin.firstChild; c >= 0 && volume > 0; c = settler.basins[c].nextSibling)
+  {
+    SettleBasin& child = settler.basins[c];
+    const uint64_t poured = std::min(volume, child.capacity - child.kept);
+    if (poured == 0)
+      continue;
+    if (child.kept == 0)
+      child.type = basin.type;
+    child.kept += poured;
+    child.extra += poured;
+    volume -= poured;
+  }
+  return volume;
+}
+
+// Children are created before their parent, so in order of index every basin is settled after
+// the ones below it: pockets keep what fits and spill the rest up. What lands on the runs of a
+// basin falls into the pockets below that still have room before filling its own rows; that
+// pouring down is passed on in reverse order.
+static void settleBasinVolumes(LiquidSettler& settler, LiquidSettleStats& stats)
+{
+  for (SettleBasin& basin : settler.basins)
+  {
+    basin.capacity = basin.ownCapacity;
+    for (int32_t c = basin.firstChild; c >= 0; c = settler.basins[c].nextSibling)
+    {
+      const SettleBasin& child = settler.basins[c];
+      basin.capacity += child.capacity;
+      basin.volumes[child.type] += child.overflow;
+    }
+    basin.type = getSettleBasinType(basin);
+
+    uint64_t available = 0;
+    for (uint8_t t = 0; t < 4; t++)
+      available += basin.volumes[t];
+    available = pourIntoSettleChildren(settler, basin, available);
+
+    basin.ownFill = std::min(available, basin.ownCapacity);
+    basin.overflow = available - basin.ownFill;
+    basin.kept = basin.ownFill;
+    for (int32_t c = basin.firstChild; c >= 0; c = settler.basins[c].nextSibling)
+      basin.kept += settler.basins[c].kept;
+    if (basin.parent < 0)
+    {
+      // only a basin open to the top of the world can hold less than what landed in it
+      stats.lostVolume += basin.overflow;
+      basin.overflow = 0;
+    }
+  }
+
+  for (size_t b = settler.basins.size(); b-- > 0;)
+  {
+    SettleBasin& basin = settler.basins[b];
+    if (basin.extra == 0)
+      continue;
+    basin.ownFill += pourIntoSettleChildren(settler, basin, basin.extra);
+    basin.extra = 0;
+  }
+}
+
+static void setSettleLiquid(LiquidSettler& settler, int32_t x, int32_t y, uint8_t amount,
+                            uint8_t type)
+{
+  TileChunkRaw& raw = getSettleChunk(settler, x, y);
+  const uint32_t i = getTileIndexInChunk(x, y);
+  raw.cold.liquids[i] = amount;
+  raw.cold.attributes[i] =
+    (raw.cold.attributes[i] & ~(TILE_LIQUID_TYPE_MASK << TILE_LIQUID_TYPE_SHIFT)) |
+    ((uint32_t)type << TILE_LIQUID_TYPE_SHIFT);
+}
+
+// Empties every chunk that held liquid and fills the own rows of every basin bottom-up.
+static void writeSettledLiquids(LiquidSettler& settler)
+{
+  TileStore& store = *settler.store;
+  for (uint32_t slot = 0; slot < (uint32_t)store.chunks.size(); slot++)
+  {
+    if (!settler.wetChunks[slot])
+      continue;
+    TileChunkRaw& raw =
+      settler.generating ? *store.chunks[slot].raw : getWritableTileChunk(store, slot);
+    memset(raw.cold.liquids, 0, sizeof(raw.cold.liquids));
+  }
+
+  for (const SettleBasin& basin : settler.basins)
+  {
+    uint64_t fill = basin.ownFill;
+    for (int32_t s = basin.firstSegment; s >= 0 && fill > 0;)
+    {
+      // the runs of one row are consecutive in the list
+      const int32_t y = settler.segments[s].y;
+      int32_t end = s;
+      uint64_t cells = 0;
+      for (; end >= 0 && settler.segments[end].y == y; end = settler.segments[end].next)
+        cells += (uint64_t)(settler.segments[end].x1 - settler.segments[end].x0);
+
+      const bool full = fill >= cells * LIQUID_FULL;
+      const uint8_t amount = full ? LIQUID_FULL : (uint8_t)(fill / cells);
+      uint64_t remainder = full ? 0 : fill % cells;
+      for (int32_t r = s; r != end; r = settler.segments[r].next)
+      {
+        const SettleSegment& segment = settler.segments[r];
+        for (int32_t x = segment.x0; x < segment.x1; x++)
+        {
+          const uint8_t a = amount + (remainder > 0 ? 1 : 0);
+          remainder -= remainder > 0 ? 1 : 0;
+          if (a > 0)
+            setSettleLiquid(settler, x, y, a, basin.type);
+          if (!full)
+            settler.unsettled.push_back((uint64_t)y << 32 | (uint32_t)x);
+        }
+      }
+      fill -= full ? cells * LIQUID_FULL : fill;
+      s = end;
+    }
+  }
+}
+
+struct SettleCell
+{
+  bool open;
+  uint8_t amount;
+  uint8_t type;
+};
+
+static SettleCell getSettleCell(const TileStore& store, int32_t x, int32_t y)
+{
+  if (!isInTileStore(store, x, y) || isTileSolid(store, x, y))
+    return { false, 0, 0 };
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const uint32_t attributes =
+    chunk.raw ? chunk.raw->cold.attributes[i] : getStoredTileRecord(store, chunk, i).attributes;
+  return { true, getTileLiquid(store, x, y),
+           (uint8_t)((attributes >> TILE_LIQUID_TYPE_SHIFT) & TILE_LIQUID_TYPE_MASK) };
+}
+
+static void wakeSettleCell(std::vector<uint64_t>& next, int32_t x, int32_t y)
+{
+  for (int32_t d = 0; d < 4; d++)
+  {
+    const int32_t nx = x + (d == 0) - (d == 1), ny = y + (d == 2) - (d == 3);
+    if (nx >= 0 && ny >= 0)
+      next.push_back((uint64_t)ny << 32 | (uint32_t)nx);
+  }
+  next.push_back((uint64_t)y << 32 | (uint32_t)x);
+}
+
+// Cellular rounds over the unsettled tiles and whatever they wake: liquid falls into the tile
+// below while it has room, then spreads evenly with the open tiles left and right of it.
+static void runSettleCells(LiquidSettler& settler, uint32_t maxSteps, LiquidSettleStats& stats)
+{
+  TileStore& store = *settler.store;
+  std::vector<uint64_t> active = std::move(settler.unsettled);
+  std::vector<uint64_t> next;
+
+  for (; stats.simSteps < maxSteps && !active.empty(); stats.simSteps++)
+  {
+    // bottom-up then left to right, so the result never depends on the order tiles woke in
+    std::sort(active.begin(), active.end(), [](uint64_t a, uint64_t b) {
+      return (a >> 32) != (b >> 32) ? (a >> 32) > (b >> 32) : a < b;
+    });
+    active.erase(std::unique(active.begin(), active.end()), active.end());
+    next.clear();
+
+    for (uint64_t key : active)
+    {
+      const int32_t x = (int32_t)(uint32_t)key, y = (int32_t)(key >> 32);
+      SettleCell cell = getSettleCell(store, x, y);
+      if (!cell.open || cell.amount == 0)
+        continue;
+
+      const SettleCell down = getSettleCell(store, x, y + 1);
+      if (down.open && down.amount < LIQUID_FULL && (down.amount == 0 || down.type == cell.type))
+      {
+        const uint8_t moved = std::min<uint8_t>(cell.amount, LIQUID_FULL - down.amount);
+        setSettleLiquid(settler, x, y + 1, down.amount + moved, cell.type);
+        cell.amount -= moved;
+        setSettleLiquid(settler, x, y, cell.amount, cell.type);
+        wakeSettleCell(next, x, y);
+        wakeSettleCell(next, x, y + 1);
+        stats.simUpdates++;
+        if (cell.amount == 0)
+          continue;
+      }
+
+      const SettleCell left = getSettleCell(store, x - 1, y);
+      const SettleCell right = getSettleCell(store, x + 1, y);
+      const bool useLeft = left.open && (left.amount == 0 || left.type == cell.type);
+      const bool useRight = right.open && (right.amount == 0 || right.type == cell.type);
+      uint32_t total = cell.amount, count = 1;
+      uint8_t low = cell.amount, high = cell.amount;
+      if (useLeft)
+      {
+        total += left.amount;
+        count++;
+        low = std::min(low, left.amount);
+        high = std::max(high, left.amount);
+      }
+      if (useRight)
+      {
+        total += right.amount;
+        count++;
+        low = std::min(low, right.amount);
+        high = std::max(high, right.amount);
+      }
+      // differences of one are as level as whole amounts allow
+      if (high - low <= 1)
+        continue;
+
+      const uint8_t even = (uint8_t)(total / count);
+      if (useLeft)
+        setSettleLiquid(settler, x - 1, y, even, cell.type);
+      if (useRight)
+        setSettleLiquid(settler, x + 1, y, even, cell.type);
+      setSettleLiquid(settler, x, y, (uint8_t)(even + total % count), cell.type);
+      wakeSettleCell(next, x - 1, y);
+      wakeSettleCell(next, x, y);
+      wakeSettleCell(next, x + 1, y);
+      stats.simUpdates++;
+    }
+    std::swap(active, next);
+  }
+
+  std::sort(active.begin(), active.end());
+  stats.unsettledCells = (uint32_t)(std::unique(active.begin(), active.end()) - active.begin());
+}
+
+static LiquidSettleStats settleStoreLiquids(TileStore& store, bool generating,
+                                            uint32_t maxSimSteps)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  LiquidSettleStats stats{};
+
+  LiquidSettler settler;
+  settler.store = &store;
+  settler.generating = generating;
+  settler.wetChunks.assign(store.chunks.size(), 0);
+  buildSettleBasins(settler, stats);
+  stats.segments = (uint32_t)settler.segments.size();
+  stats.basins = (uint32_t)settler.basins.size();
+  if (stats.volume > 0)
+  {
+    settleBasinVolumes(settler, stats);
+    writeSettledLiquids(settler);
+    runSettleCells(settler, maxSimSteps, stats);
+  }
+
+  stats.nanoseconds = getSteadyNanoseconds() - start;
+  return stats;
+}
+
+LiquidSettleStats settleLiquids(TileStore& store, uint32_t maxSimSteps)
+{
+  const LiquidSettleStats stats = settleStoreLiquids(store, false, maxSimSteps);
+  if (stats.volume > 0)
+    notifyTilesChanged(store, 0, 0, store.width, store.height);
+  return stats;
+}
+
+void settleWorldGenLiquids(const WorldGenContext& context)
+{
+  settleStoreLiquids(*context.store, true, 256);
+}
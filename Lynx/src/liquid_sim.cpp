@@ -0,0 +1,464 @@
+#include <Lynx/liquid_sim.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+
+struct LiquidSimCell
+{
+  // null for compressed chunks, which are only read
+  TileChunkRaw* raw;
+  uint32_t index;
+  bool open;
+  uint8_t amount;
+  uint8_t type;
+};
+
+// What a job of a phase works with.
+struct LiquidSimJob
+{
+  LiquidSim* sim;
+  uint32_t slot;
+  int32_t x0, y0;
+  LiquidSimThread* thread;
+  bool changed;
+};
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static bool mayHoldLiquid(const TileStore& store, uint32_t slot)
+{
+  const TileChunk& chunk = store.chunks[slot];
+  if (chunk.unloaded)
+    return true;
+  if (chunk.raw)
+  {
+    for (uint32_t i = 0; i < (uint32_t)TILE_CHUNK_TILES; i++)
+    {
+      if (chunk.raw->cold.liquids[i])
+        return true;
+    }
+    return false;
+  }
+  for (const TileRecord& record : chunk.packed.palette)
+  {
+    if (record.liquid)
+      return true;
+  }
+  return false;
+}
+
+static void listLiquidSimChunk(LiquidSim& sim, uint32_t slot)
+{
+  if (sim.chunks[slot].listed)
+    return;
+  sim.chunks[slot].listed = true;
+  sim.activeChunks.push_back(slot);
+}
+
+static void onLiquidSimTilesChanged(void* userData, int32_t x0, int32_t y0, int32_t x1,
+                                    int32_t y1)
+{
+  LiquidSim& sim = *(LiquidSim*)userData;
+  if (sim.updating)
+    return;
+  // liquid next to the change may now flow into it
+  wakeLiquids(sim, x0 - 1, y0 - 1, x1 + 1, y1 + 1);
+}
+
+void createLiquidSim(LiquidSim& sim, TileStore& store, JobSystem& jobs)
+{
+  sim.store = &store;
+  sim.jobs = &jobs;
+  sim.chunks.assign(store.chunks.size(), LiquidSimChunk{});
+  sim.chunkX.resize(store.chunks.size());
+  sim.chunkY.resize(store.chunks.size());
+  for (int32_t cy = 0; cy < store.chunksY; cy++)
+  {
+    for (int32_t cx = 0; cx < store.chunksX; cx++)
+    {
+      const uint32_t slot = store.chunkSlots[cy * store.chunksX + cx];
+      sim.chunkX[slot] = (uint32_t)cx;
+      sim.chunkY[slot] = (uint32_t)cy;
+    }
+  }
+  sim.activeChunks.clear();
+  sim.threads.assign(getJobThreadCount(jobs), LiquidSimThread{});
+  sim.stats = {};
+  addTileChangeListener(store, onLiquidSimTilesChanged, &sim);
+}
+
+void destroyLiquidSim(LiquidSim& sim)
+{
+  if (sim.store)
+    removeTileChangeListener(*sim.store, onLiquidSimTilesChanged, &sim);
+  sim.store = nullptr;
+  sim.chunks.clear();
+  sim.activeChunks.clear();
+  sim.threads.clear();
+}
+
+void wakeLiquids(LiquidSim& sim, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+  const TileStore& store = *sim.store;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+    {
+      const uint32_t slot = store.chunkSlots[cy * store.chunksX + cx];
+      if (!mayHoldLiquid(store, slot))
+        continue;
+
+      const int32_t left = std::max(x0 - (cx << TILE_CHUNK_SHIFT), 0);
+      const int32_t right = std::min(x1 - (cx << TILE_CHUNK_SHIFT), TILE_CHUNK_SIZE);
+      const uint32_t bits =
+        (right - left == 32 ? ~0u : ((1u << (right - left)) - 1)) << left;
+      const int32_t top = std::max(y0 - (cy << TILE_CHUNK_SHIFT), 0);
+      const int32_t bottom = std::min(y1 - (cy << TILE_CHUNK_SHIFT), TILE_CHUNK_SIZE);
+      for (int32_t row = top; row < bottom; row++)
+        sim.chunks[slot].rows[row] |= bits;
+      listLiquidSimChunk(sim, slot);
+    }
+  }
+}
+
+static LiquidSimCell getLiquidSimCell(const TileStore& store, int32_t x, int32_t y)
+{
+  if (!isInTileStore(store, x, y))
+    return { nullptr, 0, false, 0, 0 };
+  // the chunks of a phase and their neighbours were loaded before it started, and the ones it
+  // writes were made raw
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  TileChunkRaw* raw = chunk.raw.get();
+  const uint32_t i = getTileIndexInChunk(x, y);
+  uint8_t flags, liquid;
+  uint32_t attributes;
+  if (raw)
+  {
+    flags = raw->hot.flags[i];
+    liquid = raw->cold.liquids[i];
+    attributes = raw->cold.attributes[i];
+  }
+  else
+  {
+    const TileRecord record = getPackedTileRecord(chunk.packed, i);
+    flags = record.flags;
+    liquid = record.liquid;
+    attributes = record.attributes;
+  }
+  if ((flags & (TILE_ACTIVE | TILE_SOLID | TILE_ACTUATED)) == (TILE_ACTIVE | TILE_SOLID))
+    return { raw, i, false, 0, 0 };
+  return { raw, i, true, liquid,
+           (uint8_t)((attributes >> TILE_LIQUID_TYPE_SHIFT) & TILE_LIQUID_TYPE_MASK) };
+}
+
+static void setLiquidSimCell(const LiquidSimCell& cell, uint8_t amount, uint8_t type)
+{
+  cell.raw->cold.liquids[cell.index] = amount;
+  uint32_t& attributes = cell.raw->cold.attributes[cell.index];
+  attributes = (attributes & ~(TILE_LIQUID_TYPE_MASK << TILE_LIQUID_TYPE_SHIFT)) |
+               ((uint32_t)type << TILE_LIQUID_TYPE_SHIFT);
+}
+
+// Wakes (x, y) and its neighbours for the next tick and records the chunk of (x, y) as changed.
+static void wakeLiquidSimCell(LiquidSimJob& job, int32_t x, int32_t y)
+{
+  const TileStore& store = *job.sim->store;
+  for (int32_t d = 0; d < 5; d++)
+  {
+    const int32_t nx = x + (d == 1) - (d == 2), ny = y + (d == 3) - (d == 4);
+    if (!isInTileStore(store, nx, ny))
+      continue;
+    const int32_t lx = nx - job.x0, ly = ny - job.y0;
+    if (lx >= 0 && ly >= 0 && lx < TILE_CHUNK_SIZE && ly < TILE_CHUNK_SIZE)
+    {
+      job.sim->chunks[job.slot].rows[ly] |= 1u << lx;
+      continue;
+    }
+    const uint32_t slot = getTileChunkSlot(store, nx, ny);
+    job.thread->wakes.push_back(slot << 10 | getTileIndexInChunk(nx, ny));
+    if (d == 0)
+      job.thread->changedChunks.push_back(slot);
+  }
+  if ((x - job.x0) >> TILE_CHUNK_SHIFT == 0 && (y - job.y0) >> TILE_CHUNK_SHIFT == 0)
+    job.changed = true;
+}
+
+static bool canLiquidFallInto(const LiquidSimCell& cell, const LiquidSimCell& down)
+{
+  return down.open && down.amount < LIQUID_FULL && (down.amount == 0 || down.type == cell.type);
+}
+
+static bool canLiquidSpreadInto(const LiquidSimCell& cell, const LiquidSimCell& side)
+{
+  return side.open && (side.amount == 0 || side.type == cell.type);
+}
+
+// Differences of one are as level as whole amounts allow, stopping there lets tiles sleep.
+static bool isLiquidLevel(const LiquidSimCell& cell, const LiquidSimCell& left,
+                          const LiquidSimCell& right)
+{
+  uint8_t low = cell.amount, high = cell.amount;
+  if (canLiquidSpreadInto(cell, left))
+  {
+    low = std::min(low, left.amount);
+    high = std::max(high, left.amount);
+  }
+  if (canLiquidSpreadInto(cell, right))
+  {
+    low = std::min(low, right.amount);
+    high = std::max(high, right.amount);
+  }
+  return high - low <= 1;
+}
+
+// Whether updateLiquidSimCell would change anything, without writing.
+static bool isLiquidSimCellMoving(const TileStore& store, int32_t x, int32_t y)
+{
+  const LiquidSimCell cell = getLiquidSimCell(store, x, y);
+  if (!cell.open || cell.amount == 0)
+    return false;
+  if (canLiquidFallInto(cell, getLiquidSimCell(store, x, y + 1)))
+    return true;
+  return !isLiquidLevel(cell, getLiquidSimCell(store, x - 1, y), getLiquidSimCell(store, x + 1, y));
+}
+
+static void updateLiquidSimCell(LiquidSimJob& job, int32_t x, int32_t y)
+{
+  const TileStore& store = *job.sim->store;
+  LiquidSimCell cell = getLiquidSimCell(store, x, y);
+  if (!cell.open || cell.amount == 0)
+    return;
+
+  const LiquidSimCell down = getLiquidSimCell(store, x, y + 1);
+  if (canLiquidFallInto(cell, down))
+  {
+    const uint8_t moved = std::min<uint8_t>(cell.amount, LIQUID_FULL - down.amount);
+    setLiquidSimCell(down, down.amount + moved, cell.type);
+    cell.amount -= moved;
+    setLiquidSimCell(cell, cell.amount, cell.type);
+    wakeLiquidSimCell(job, x, y);
+    wakeLiquidSimCell(job, x, y + 1);
+    job.thread->updates++;
+    if (cell.amount == 0)
+      return;
+  }
+
+  const LiquidSimCell left = getLiquidSimCell(store, x - 1, y);
+  const LiquidSimCell right = getLiquidSimCell(store, x + 1, y);
+  if (isLiquidLevel(cell, left, right))
+    return;
+
+  const bool useLeft = canLiquidSpreadInto(cell, left);
+  const bool useRight = canLiquidSpreadInto(cell, right);
+  uint32_t total = cell.amount, count = 1;
+  if (useLeft)
+  {
+    total += left.amount;
+    count++;
+  }
+  if (useRight)
+  {
+    total += right.amount;
+    count++;
+  }
+
+  const uint8_t even = (uint8_t)(total / count);
+  if (useLeft)
+  {
+    setLiquidSimCell(left, even, cell.type);
+    wakeLiquidSimCell(job, x - 1, y);
+  }
+  if (useRight)
+  {
+    setLiquidSimCell(right, even, cell.type);
+    wakeLiquidSimCell(job, x + 1, y);
+  }
+  setLiquidSimCell(cell, (uint8_t)(even + total % count), cell.type);
+  wakeLiquidSimCell(job, x, y);
+  job.thread->updates++;
+}
+
+// Calls fn(slot) for the chunk at slot and the neighbours its awake tiles read and write.
+template <typename F>
+static void forEachLiquidSimChunkReached(const LiquidSim& sim, uint32_t slot, uint32_t columns,
+                                         F&& fn)
+{
+  const TileStore& store = *sim.store;
+  const int32_t cx = (int32_t)sim.chunkX[slot], cy = (int32_t)sim.chunkY[slot];
+  fn(slot);
+  if ((columns & 1) && cx > 0)
+    fn(store.chunkSlots[cy * store.chunksX + cx - 1]);
+  if ((columns >> 31) && cx + 1 < store.chunksX)
+    fn(store.chunkSlots[cy * store.chunksX + cx + 1]);
+  if (sim.chunks[slot].rows[TILE_CHUNK_SIZE - 1] && cy + 1 < store.chunksY)
+    fn(store.chunkSlots[(cy + 1) * store.chunksX + cx]);
+}
+
+static uint32_t getLiquidSimColumns(const LiquidSimChunk& chunk)
+{
+  uint32_t columns = 0;
+  for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+    columns |= chunk.rows[row];
+  return columns;
+}
+
+// Tiles of a chunk only change once one of them moves liquid, and until then each is updated
+// against the same tiles, so checking every awake tile tells whether running the chunk writes.
+static bool isLiquidSimChunkMoving(const LiquidSim& sim, uint32_t slot)
+{
+  const LiquidSimChunk& chunk = sim.chunks[slot];
+  const int32_t x0 = (int32_t)sim.chunkX[slot] << TILE_CHUNK_SHIFT;
+  const int32_t y0 = (int32_t)sim.chunkY[slot] << TILE_CHUNK_SHIFT;
+  for (int32_t row = TILE_CHUNK_SIZE - 1; row >= 0; row--)
+  {
+    for (uint32_t bits = chunk.rows[row]; bits; bits &= bits - 1)
+    {
+      if (isLiquidSimCellMoving(*sim.store, x0 + std::countr_zero(bits), y0 + row))
+        return true;
+    }
+  }
+  return false;
+}
+
+static void runLiquidSimChunk(LiquidSim& sim, uint32_t slot, uint32_t thread)
+{
+  LiquidSimJob job{ &sim,
+                    slot,
+                    (int32_t)sim.chunkX[slot] << TILE_CHUNK_SHIFT,
+                    (int32_t)sim.chunkY[slot] << TILE_CHUNK_SHIFT,
+                    &sim.threads[thread],
+                    false };
+
+  // tiles woken during the tick wait for the next one
+  uint32_t rows[TILE_CHUNK_SIZE];
+  memcpy(rows, sim.chunks[slot].rows, sizeof(rows));
+  memset(sim.chunks[slot].rows, 0, sizeof(rows));
+
+  for (int32_t row = TILE_CHUNK_SIZE - 1; row >= 0; row--)
+  {
+    for (uint32_t bits = rows[row]; bits; bits &= bits - 1)
+      updateLiquidSimCell(job, job.x0 + std::countr_zero(bits), job.y0 + row);
+  }
+  if (job.changed)
+    job.thread->changedChunks.push_back(slot);
+}
+
+const LiquidSimStats& updateLiquidSim(LiquidSim& sim)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  TileStore& store = *sim.store;
+  LiquidSimStats& stats = sim.stats;
+  stats = {};
+
+  // everything a job may read is loaded here, jobs must not load chunks
+  std::vector<uint32_t> phases[4];
+  for (uint32_t slot : sim.activeChunks)
+  {
+    LiquidSimChunk& chunk = sim.chunks[slot];
+    chunk.listed = false;
+    const uint32_t columns = getLiquidSimColumns(chunk);
+    if (!columns)
+      continue;
+
+    for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+      stats.activeCells += (uint32_t)std::popcount(chunk.rows[row]);
+    forEachLiquidSimChunkReached(sim, slot, columns,
+                                 [&](uint32_t reached) { loadTileChunk(store, reached); });
+    phases[(sim.chunkX[slot] & 1) + 2 * (sim.chunkY[slot] & 1)].push_back(slot);
+    stats.activeChunks++;
+  }
+  sim.activeChunks.clear();
+
+  // Each phase first finds its chunks that move liquid, reading chunks as they are, and only
+  // those and the neighbours they reach are made raw for writing. Chunks that stay still keep
+  // their version, so they are neither held back from compression nor copied for snapshots.
+  std::vector<uint8_t> moving;
+  std::vector<uint32_t> running;
+  for (const std::vector<uint32_t>& phase : phases)
+  {
+    if (phase.empty())
+      continue;
+    moving.assign(phase.size(), 0);
+    runJobs(*sim.jobs, (uint32_t)phase.size(), [&](uint32_t index, uint32_t) {
+      moving[index] = isLiquidSimChunkMoving(sim, phase[index]);
+    });
+
+    running.clear();
+    for (size_t i = 0; i < phase.size(); i++)
+    {
+      LiquidSimChunk& chunk = sim.chunks[phase[i]];
+      if (!moving[i])
+      {
+        // no tile would move, they all go back to sleep
+        memset(chunk.rows, 0, sizeof(chunk.rows));
+        continue;
+      }
+      forEachLiquidSimChunkReached(sim, phase[i], getLiquidSimColumns(chunk),
+                                   [&](uint32_t reached) { getWritableTileChunk(store, reached); });
+      running.push_back(phase[i]);
+    }
+    if (running.empty())
+      continue;
+    runJobs(*sim.jobs, (uint32_t)running.size(), [&](uint32_t index, uint32_t thread) {
+      runLiquidSimChunk(sim, running[index], thread);
+    });
+  }
+
+  // the wakes are a set, merging them in any order gives the same tiles
+  std::vector<uint32_t> changed;
+  for (LiquidSimThread& thread : sim.threads)
+  {
+    for (uint32_t wake : thread.wakes)
+    {
+      const uint32_t slot = wake >> 10, i = wake & (TILE_CHUNK_TILES - 1);
+      sim.chunks[slot].rows[i >> TILE_CHUNK_SHIFT] |= 1u << (i & TILE_CHUNK_MASK);
+      listLiquidSimChunk(sim, slot);
+    }
+    changed.insert(changed.end(), thread.changedChunks.begin(), thread.changedChunks.end());
+    stats.updates += thread.updates;
+    thread.wakes.clear();
+    thread.changedChunks.clear();
+    thread.updates = 0;
+  }
+  for (const std::vector<uint32_t>& phase : phases)
+  {
+    for (uint32_t slot : phase)
+    {
+      const LiquidSimChunk& chunk = sim.chunks[slot];
+      uint32_t any = 0;
+      for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+        any |= chunk.rows[row];
+      if (any)
+        listLiquidSimChunk(sim, slot);
+    }
+  }
+
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  sim.updating = true;
+  for (uint32_t slot : changed)
+  {
+    const int32_t x0 = (int32_t)sim.chunkX[slot] << TILE_CHUNK_SHIFT;
+    const int32_t y0 = (int32_t)sim.chunkY[slot] << TILE_CHUNK_SHIFT;
+    notifyTilesChanged(store, x0, y0, std::min(x0 + TILE_CHUNK_SIZE, store.width),
+                       std::min(y0 + TILE_CHUNK_SIZE, store.height));
+  }
+  sim.updating = false;
+
+  stats.nanoseconds = getSteadyNanoseconds() - start;
+  return stats;
+}
@@ -0,0 +1,218 @@
+// glm's simd layer only picks an instruction set when intrinsics are forced. This file uses the
+// layer's functions and no glm vector types, so it does not change their layout elsewhere.
+#define GLM_FORCE_INTRINSICS
+#include <glm/detail/setup.hpp>
+#include <glm/simd/common.h>
+
+#include <Lynx/noise.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#include "noise_kernels.h"
+
+// Lanes of the kernels: NoiseScalar for the reference and 4 wide lanes on top of SSE2, which
+// every x86-64 CPU has. The 8 wide AVX2 lanes are in noise_avx2.cpp.
+
+struct NoiseScalar
+{
+  typedef float F;
+  typedef uint32_t I;
+  static constexpr uint32_t WIDTH = 1;
+
+  static F set(float a) { return a; }
+  static I seti(uint32_t a) { return a; }
+  static F load(const float* p) { return *p; }
+  static void store(float* p, F a) { *p = a; }
+  static F add(F a, F b) { return a + b; }
+  static F sub(F a, F b) { return a - b; }
+  static F mul(F a, F b) { return a * b; }
+  static F max(F a, F b) { return a > b ? a : b; }
+  static F abs(F a) { return std::fabs(a); }
+  static F floor(F a) { return std::floor(a); }
+  static I toInt(F a) { return (uint32_t)(int32_t)a; }
+  static F toFloat(I a) { return (float)(int32_t)a; }
+  static I addi(I a, I b) { return a + b; }
+  static I xori(I a, I b) { return a ^ b; }
+  static I andi(I a, I b) { return a & b; }
+  static I shr(I a, int n) { return a >> n; }
+  static I shl(I a, int n) { return a << n; }
+  static I mullo(I a, uint32_t b) { return a * b; }
+  static I isZero(I a) { return a == 0 ? ~0u : 0u; }
+  static I greater(F a, F b) { return a > b ? ~0u : 0u; }
+  static F select(I mask, F a, F b) { return mask ? a : b; }
+  static F xorBits(F a, I bits)
+  {
+    uint32_t word;
+    memcpy(&word, &a, sizeof(word));
+    word ^= bits;
+    memcpy(&a, &word, sizeof(word));
+    return a;
+  }
+};
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+struct NoiseSse
+{
+  typedef glm_vec4 F;
+  typedef glm_ivec4 I;
+  static constexpr uint32_t WIDTH = 4;
+
+  static F set(float a) { return _mm_set1_ps(a); }
+  static I seti(uint32_t a) { return _mm_set1_epi32((int)a); }
+  static F load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, F a) { _mm_storeu_ps(p, a); }
+  static F add(F a, F b) { return glm_vec4_add(a, b); }
+  static F sub(F a, F b) { return glm_vec4_sub(a, b); }
+  static F mul(F a, F b) { return glm_vec4_mul(a, b); }
+  static F max(F a, F b) { return _mm_max_ps(a, b); }
+  static F abs(F a) { return glm_vec4_abs(a); }
+  static F floor(F a) { return glm_vec4_floor(a); }
+  static I toInt(F a) { return _mm_cvttps_epi32(a); }
+  static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+  static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+  static I xori(I a, I b) { return _mm_xor_si128(a, b); }
+  static I andi(I a, I b) { return _mm_and_si128(a, b); }
+  static I shr(I a, int n) { return _mm_srli_epi32(a, n); }
+  static I shl(I a, int n) { return _mm_slli_epi32(a, n); }
+  static I mullo(I a, uint32_t b)
+  {
+#if GLM_ARCH & GLM_ARCH_SSE41_BIT
+    return _mm_mullo_epi32(a, _mm_set1_epi32((int)b));
+#else
+    // low halves of the even and the odd lane products
+    const __m128i m = _mm_set1_epi32((int)b);
+    const __m128i even = _mm_shuffle_epi32(_mm_mul_epu32(a, m), _MM_SHUFFLE(0, 0, 2, 0));
+    const __m128i odd =
+      _mm_shuffle_epi32(_mm_mul_epu32(_mm_srli_epi64(a, 32), m), _MM_SHUFFLE(0, 0, 2, 0));
+    return _mm_unpacklo_epi32(even, odd);
+#endif
+  }
+  static I isZero(I a) { return _mm_cmpeq_epi32(a, _mm_setzero_si128()); }
+  static I greater(F a, F b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+  static F select(I mask, F a, F b)
+  {
+    const __m128 m = _mm_castsi128_ps(mask);
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+  }
+  static F xorBits(F a, I bits) { return _mm_xor_ps(a, _mm_castsi128_ps(bits)); }
+};
+
+#endif
+
+
+#ifdef NOISE_X86
+
+static bool hasAvx2()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  // the OS has to save the upper halves of the ymm registers too
+  __cpuid(info, 1);
+  const int osxsaveAndAvx = (1 << 27) | (1 << 28);
+  if ((info[2] & osxsaveAndAvx) != osxsaveAndAvx || (_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  // checks the OS support as well
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+NoisePath getNoisePath()
+{
+#ifdef NOISE_X86
+  static const bool avx2 = hasAvx2();
+  if (avx2)
+    return NOISE_PATH_AVX2;
+#endif
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+  return NOISE_PATH_SSE2;
+#else
+  return NOISE_PATH_SCALAR;
+#endif
+}
+
+float sampleNoise(const NoiseSettings& settings, float x, float y)
+{
+  return fractalNoise<NoiseScalar>(settings, x, y);
+}
+
+void sampleNoise(const NoiseSettings& settings, const float* x, const float* y, float* out,
+                 uint32_t count, NoisePath path)
+{
+  switch (std::min(path, getNoisePath()))
+  {
+#ifdef NOISE_X86
+  case NOISE_PATH_AVX2:
+    sampleNoiseAvx2(settings, x, y, out, count);
+    return;
+#endif
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+  case NOISE_PATH_SSE2:
+    samplePoints<NoiseSse>(settings, x, y, out, count);
+    return;
+#endif
+  default:
+    samplePoints<NoiseScalar>(settings, x, y, out, count);
+  }
+}
+
+void fillNoiseRect(const NoiseSettings& settings, int32_t x0, int32_t y0, int32_t width,
+                   int32_t height, float* out, NoisePath path)
+{
+  switch (std::min(path, getNoisePath()))
+  {
+#ifdef NOISE_X86
+  case NOISE_PATH_AVX2:
+    fillNoiseRectAvx2(settings, x0, y0, width, height, out);
+    return;
+#endif
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+  case NOISE_PATH_SSE2:
+    fillRect<NoiseSse>(settings, x0, y0, width, height, out);
+    return;
+#endif
+  default:
+    fillRect<NoiseScalar>(settings, x0, y0, width, height, out);
+  }
+}
+
+NoiseBenchmark benchmarkNoise(const NoiseSettings& settings, NoisePath path, int32_t width,
+                              int32_t height)
+{
+  const size_t count = (size_t)width * height;
+  std::vector<float> reference(count), result(count);
+
+  auto timeFill = [&](NoisePath p, std::vector<float>& out) {
+    const auto start = std::chrono::steady_clock::now();
+    fillNoiseRect(settings, -width / 2, -height / 2, width, height, out.data(), p);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)count;
+  };
+
+  NoiseBenchmark benchmark{};
+  benchmark.path = std::min(path, getNoisePath());
+  benchmark.scalarNanosecondsPerSample = timeFill(NOISE_PATH_SCALAR, reference);
+  benchmark.pathNanosecondsPerSample = timeFill(benchmark.path, result);
+  for (size_t i = 0; i < count; i++)
+    benchmark.maxDifference =
+      std::max(benchmark.maxDifference, std::fabs(reference[i] - result[i]));
+  benchmark.matchesScalar = benchmark.maxDifference <= NOISE_PATH_EPSILON;
+  return benchmark;
+}
@@ -0,0 +1,55 @@
+// Built with AVX2 enabled, see CMakeLists.txt. getNoisePath only picks these when the CPU has it.
+#include "noise_kernels.h"
+
+#ifdef NOISE_X86
+
+#ifndef __AVX2__
+#error "noise_avx2.cpp must be compiled with AVX2 enabled"
+#endif
+
+#include <immintrin.h>
+
+// glm's simd layer stops at 4 floats, the 8 wide lanes use AVX2 directly.
+struct NoiseAvx
+{
+  typedef __m256 F;
+  typedef __m256i I;
+  static constexpr uint32_t WIDTH = 8;
+
+  static F set(float a) { return _mm256_set1_ps(a); }
+  static I seti(uint32_t a) { return _mm256_set1_epi32((int)a); }
+  static F load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, F a) { _mm256_storeu_ps(p, a); }
+  static F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static F max(F a, F b) { return _mm256_max_ps(a, b); }
+  static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+  static F floor(F a) { return _mm256_floor_ps(a); }
+  static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+  static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+  static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+  static I xori(I a, I b) { return _mm256_xor_si256(a, b); }
+  static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+  static I shr(I a, int n) { return _mm256_srli_epi32(a, n); }
+  static I shl(I a, int n) { return _mm256_slli_epi32(a, n); }
+  static I mullo(I a, uint32_t b) { return _mm256_mullo_epi32(a, _mm256_set1_epi32((int)b)); }
+  static I isZero(I a) { return _mm256_cmpeq_epi32(a, _mm256_setzero_si256()); }
+  static I greater(F a, F b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+  static F select(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+  static F xorBits(F a, I bits) { return _mm256_xor_ps(a, _mm256_castsi256_ps(bits)); }
+};
+
+void sampleNoiseAvx2(const NoiseSettings& settings, const float* x, const float* y, float* out,
+                     uint32_t count)
+{
+  samplePoints<NoiseAvx>(settings, x, y, out, count);
+}
+
+void fillNoiseRectAvx2(const NoiseSettings& settings, int32_t x0, int32_t y0, int32_t width,
+                       int32_t height, float* out)
+{
+  fillRect<NoiseAvx>(settings, x0, y0, width, height, out);
+}
+
+#endif
@@ -0,0 +1,250 @@
+#pragma once
+
+// Noise kernels shared by noise.cpp and noise_avx2.cpp, written once against a set of lanes: F
+// holds floats, I holds 32 bit integers and masks. noise_avx2.cpp is built with AVX2 enabled, so
+// everything here is static; an inline function with external linkage compiled there could be
+// the copy the linker keeps for callers on machines without AVX2.
+
+#include <Lynx/noise.h>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NOISE_X86
+#endif
+
+// output ranges of the single octave kernels, measured, to bring them to about [-1, 1]
+constexpr const float NOISE_PERLIN_SCALE = 0.66f;
+constexpr const float NOISE_SIMPLEX_SCALE = 45.0f;
+// skew and unskew factors of the 2D simplex grid
+constexpr const float NOISE_SIMPLEX_F2 = 0.36602540378f;
+constexpr const float NOISE_SIMPLEX_G2 = 0.21132486540f;
+
+template <typename L>
+static typename L::I hashNoise(typename L::I x, typename L::I y, typename L::I seed)
+{
+  typename L::I h = L::xori(L::xori(L::mullo(x, 0x9e3779b1), L::mullo(y, 0x85ebca77)), seed);
+  h = L::mullo(L::xori(h, L::shr(h, 15)), 0x2c1b3c6d);
+  h = L::mullo(L::xori(h, L::shr(h, 12)), 0x297a2d39);
+  return L::xori(h, L::shr(h, 15));
+}
+
+// one of 8 gradients picked by the low bits of h, dotted with (x, y)
+template <typename L>
+static typename L::F gradientNoise(typename L::I h, typename L::F x, typename L::F y)
+{
+  const typename L::I swap = L::isZero(L::andi(h, L::seti(4)));
+  const typename L::F u = L::select(swap, x, y);
+  const typename L::F v = L::select(swap, y, x);
+  // bit 0 flips u, bit 1 flips v
+  const typename L::F su = L::xorBits(u, L::shl(L::andi(h, L::seti(1)), 31));
+  const typename L::F sv = L::xorBits(v, L::shl(L::andi(h, L::seti(2)), 30));
+  return L::add(su, L::add(sv, sv));
+}
+
+template <typename L>
+static typename L::F fadeNoise(typename L::F t)
+{
+  // 6t^5 - 15t^4 + 10t^3
+  const typename L::F inner =
+    L::add(L::mul(t, L::sub(L::mul(t, L::set(6.0f)), L::set(15.0f))), L::set(10.0f));
+  return L::mul(L::mul(L::mul(t, t), t), inner);
+}
+
+template <typename L>
+static typename L::F lerpNoise(typename L::F a, typename L::F b, typename L::F t)
+{
+  return L::add(a, L::mul(t, L::sub(b, a)));
+}
+
+template <typename L>
+static typename L::F valueNoise(typename L::F x, typename L::F y, typename L::I seed)
+{
+  const typename L::F xf = L::floor(x), yf = L::floor(y);
+  const typename L::I xi = L::toInt(xf), yi = L::toInt(yf);
+  const typename L::I xi1 = L::addi(xi, L::seti(1)), yi1 = L::addi(yi, L::seti(1));
+  const typename L::F u = fadeNoise<L>(L::sub(x, xf)), v = fadeNoise<L>(L::sub(y, yf));
+
+  // 24 bits of the hash to [-1, 1]
+  const typename L::F scale = L::set(2.0f / 16777215.0f), one = L::set(1.0f);
+  auto corner = [&](typename L::I cx, typename L::I cy) {
+    return L::sub(L::mul(L::toFloat(L::shr(hashNoise<L>(cx, cy, seed), 8)), scale), one);
+  };
+  return lerpNoise<L>(lerpNoise<L>(corner(xi, yi), corner(xi1, yi), u),
+                      lerpNoise<L>(corner(xi, yi1), corner(xi1, yi1), u), v);
+}
+
+template <typename L>
+static typename L::F perlinNoise(typename L::F x, typename L::F y, typename L::I seed)
+{
+  const typename L::F xf = L::floor(x), yf = L::floor(y);
+  const typename L::I xi = L::toInt(xf), yi = L::toInt(yf);
+  const typename L::I xi1 = L::addi(xi, L::seti(1)), yi1 = L::addi(yi, L::seti(1));
+  const typename L::F fx = L::sub(x, xf), fy = L::sub(y, yf);
+  const typename L::F fx1 = L::sub(fx, L::set(1.0f)), fy1 = L::sub(fy, L::set(1.0f));
+  const typename L::F u = fadeNoise<L>(fx), v = fadeNoise<L>(fy);
+
+  const typename L::F g00 = gradientNoise<L>(hashNoise<L>(xi, yi, seed), fx, fy);
+  const typename L::F g10 = gradientNoise<L>(hashNoise<L>(xi1, yi, seed), fx1, fy);
+  const typename L::F g01 = gradientNoise<L>(hashNoise<L>(xi, yi1, seed), fx, fy1);
+  const typename L::F g11 = gradientNoise<L>(hashNoise<L>(xi1, yi1, seed), fx1, fy1);
+  return L::mul(lerpNoise<L>(lerpNoise<L>(g00, g10, u), lerpNoise<L>(g01, g11, u), v),
+                L::set(NOISE_PERLIN_SCALE));
+}
+
+template <typename L>
+static typename L::F simplexCorner(typename L::I h, typename L::F x, typename L::F y)
+{
+  // (0.5 - x^2 - y^2)^4 falloff, nothing outside the radius
+  typename L::F t = L::sub(L::sub(L::set(0.5f), L::mul(x, x)), L::mul(y, y));
+  t = L::max(t, L::set(0.0f));
+  t = L::mul(t, t);
+  return L::mul(L::mul(t, t), gradientNoise<L>(h, x, y));
+}
+
+template <typename L>
+static typename L::F simplexNoise(typename L::F x, typename L::F y, typename L::I seed)
+{
+  const typename L::F s = L::mul(L::add(x, y), L::set(NOISE_SIMPLEX_F2));
+  const typename L::F xf = L::floor(L::add(x, s)), yf = L::floor(L::add(y, s));
+  const typename L::I xi = L::toInt(xf), yi = L::toInt(yf);
+  const typename L::F t = L::mul(L::add(xf, yf), L::set(NOISE_SIMPLEX_G2));
+  const typename L::F x0 = L::sub(x, L::sub(xf, t)), y0 = L::sub(y, L::sub(yf, t));
+
+  // the middle corner is one step along x in the lower triangle, along y in the upper one
+  const typename L::I lower = L::greater(x0, y0);
+  const typename L::F one = L::set(1.0f), zero = L::set(0.0f), g2 = L::set(NOISE_SIMPLEX_G2);
+  const typename L::F i1 = L::select(lower, one, zero), j1 = L::select(lower, zero, one);
+  const typename L::I ii1 = L::andi(lower, L::seti(1));
+  const typename L::I jj1 = L::xori(ii1, L::seti(1));
+
+  const typename L::F x1 = L::add(L::sub(x0, i1), g2), y1 = L::add(L::sub(y0, j1), g2);
+  const typename L::F x2 = L::add(L::sub(x0, one), L::add(g2, g2));
+  const typename L::F y2 = L::add(L::sub(y0, one), L::add(g2, g2));
+
+  const typename L::F n0 = simplexCorner<L>(hashNoise<L>(xi, yi, seed), x0, y0);
+  const typename L::F n1 =
+    simplexCorner<L>(hashNoise<L>(L::addi(xi, ii1), L::addi(yi, jj1), seed), x1, y1);
+  const typename L::F n2 = simplexCorner<L>(
+    hashNoise<L>(L::addi(xi, L::seti(1)), L::addi(yi, L::seti(1)), seed), x2, y2);
+  return L::mul(L::add(n0, L::add(n1, n2)), L::set(NOISE_SIMPLEX_SCALE));
+}
+
+template <typename L>
+static typename L::F baseNoise(NoiseType type, typename L::F x, typename L::F y,
+                               typename L::I seed)
+{
+  switch (type)
+  {
+  case NOISE_VALUE:
+    return valueNoise<L>(x, y, seed);
+  case NOISE_SIMPLEX:
+    return simplexNoise<L>(x, y, seed);
+  default:
+    return perlinNoise<L>(x, y, seed);
+  }
+}
+
+// x and y in tiles
+template <typename L>
+static typename L::F fractalNoise(const NoiseSettings& settings, typename L::F x,
+                                  typename L::F y)
+{
+  if (settings.warpAmplitude != 0.0f)
+  {
+    const typename L::F wf = L::set(settings.warpFrequency);
+    const typename L::F amplitude = L::set(settings.warpAmplitude);
+    const typename L::F wx = L::mul(x, wf), wy = L::mul(y, wf);
+    const typename L::F dx =
+      baseNoise<L>(settings.type, wx, wy, L::seti(settings.seed ^ 0x5bd1e995));
+    const typename L::F dy =
+      baseNoise<L>(settings.type, wx, wy, L::seti(settings.seed ^ 0x1b873593));
+    x = L::add(x, L::mul(dx, amplitude));
+    y = L::add(y, L::mul(dy, amplitude));
+  }
+
+  typename L::F fx = L::mul(x, L::set(settings.frequency));
+  typename L::F fy = L::mul(y, L::set(settings.frequency));
+  if (settings.fractal == NOISE_FRACTAL_NONE)
+    return baseNoise<L>(settings.type, fx, fy, L::seti(settings.seed));
+
+  const typename L::F lacunarity = L::set(settings.lacunarity);
+  typename L::F sum = L::set(0.0f);
+  float amplitude = 1.0f;
+  float amplitudeSum = 0.0f;
+  for (int32_t octave = 0; octave < (settings.octaves > 1 ? settings.octaves : 1); octave++)
+  {
+    typename L::F n = baseNoise<L>(settings.type, fx, fy, L::seti(settings.seed + octave));
+    if (settings.fractal == NOISE_FRACTAL_RIDGED)
+      n = L::sub(L::set(1.0f), L::abs(n));
+    sum = L::add(sum, L::mul(n, L::set(amplitude)));
+    amplitudeSum += amplitude;
+    amplitude *= settings.gain;
+    fx = L::mul(fx, lacunarity);
+    fy = L::mul(fy, lacunarity);
+  }
+
+  sum = L::mul(sum, L::set(1.0f / amplitudeSum));
+  // ridges sum to [0, 1]
+  if (settings.fractal == NOISE_FRACTAL_RIDGED)
+    sum = L::sub(L::add(sum, sum), L::set(1.0f));
+  return sum;
+}
+
+template <typename L>
+static void samplePoints(const NoiseSettings& settings, const float* x, const float* y,
+                         float* out, uint32_t count)
+{
+  uint32_t i = 0;
+  for (; i + L::WIDTH <= count; i += L::WIDTH)
+    L::store(out + i, fractalNoise<L>(settings, L::load(x + i), L::load(y + i)));
+  if (i == count)
+    return;
+
+  // the tail goes through the same kernel, padded
+  float px[L::WIDTH] = {}, py[L::WIDTH] = {}, po[L::WIDTH];
+  memcpy(px, x + i, (count - i) * sizeof(float));
+  memcpy(py, y + i, (count - i) * sizeof(float));
+  L::store(po, fractalNoise<L>(settings, L::load(px), L::load(py)));
+  memcpy(out + i, po, (count - i) * sizeof(float));
+}
+
+template <typename L>
+static void fillRect(const NoiseSettings& settings, int32_t x0, int32_t y0, int32_t width,
+                     int32_t height, float* out)
+{
+  // x of the lanes of the first group of a row, later groups add WIDTH
+  float lanes[L::WIDTH];
+  for (uint32_t lane = 0; lane < L::WIDTH; lane++)
+    lanes[lane] = (float)lane;
+  const typename L::F offsets = L::load(lanes);
+
+  float po[L::WIDTH];
+  for (int32_t row = 0; row < height; row++)
+  {
+    const typename L::F y = L::set((float)(y0 + row));
+    float* line = out + (size_t)row * width;
+    for (int32_t column = 0; column < width; column += (int32_t)L::WIDTH)
+    {
+      const typename L::F x = L::add(L::set((float)(x0 + column)), offsets);
+      const typename L::F n = fractalNoise<L>(settings, x, y);
+      if (column + (int32_t)L::WIDTH <= width)
+        L::store(line + column, n);
+      else
+      {
+        L::store(po, n);
+        memcpy(line + column, po, (width - column) * sizeof(float));
+      }
+    }
+  }
+}
+
+#ifdef NOISE_X86
+
+// In noise_avx2.cpp, only called when the CPU has AVX2.
+void sampleNoiseAvx2(const NoiseSettings& settings, const float* x, const float* y, float* out,
+                     uint32_t count);
+void fillNoiseRectAvx2(const NoiseSettings& settings, int32_t x0, int32_t y0, int32_t width,
+                       int32_t height, float* out);
+
+#endif
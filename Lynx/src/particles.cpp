@@ -0,0 +1,346 @@
+#include <Lynx/particles.h>
+
+#include <cstring>
+#include <stdexcept>
+
+constexpr const uint32_t PARTICLE_GROUP_SIZE = 256;
+constexpr const uint32_t PARTICLE_STREAM_COUNT = 4;
+
+// Shared by the emit, simulate and render stages, matches the push constant block of the
+// particle shaders.
+struct ParticlePushConstants
+{
+  float viewScale[2];
+  float viewOffset[2];
+  float dt;
+  float gravity;
+  int32_t tileOriginX;
+  int32_t tileOriginY;
+  uint32_t capacity;
+  uint32_t particleHead;
+  uint32_t emitCount;
+  uint32_t emitParticleCount;
+  uint32_t seed;
+};
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDescriptorSetLayout createParticleDescriptorSetLayout(const VkDevice logicalDevice)
+{
+  VkDescriptorSetLayoutBinding bindings[7]{};
+  for (uint32_t i = 0; i < PARTICLE_STREAM_COUNT; i++)
+  {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+  }
+
+  bindings[4].binding = 4;
+  bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  bindings[4].descriptorCount = 1;
+  bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[5].binding = 5;
+  bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[5].descriptorCount = 1;
+  bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[6].binding = 6;
+  bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[6].descriptorCount = 1;
+  bindings[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  ci.bindingCount = 7;
+  ci.pBindings = bindings;
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(logicalDevice, &ci, nullptr, &layout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create particle descriptor set layout");
+
+  return layout;
+}
+
+static void writeParticleDescriptorSet(const ParticleSystem& system,
+                                       const ParticleSystemCreateInfo& createInfo)
+{
+  VkDescriptorBufferInfo bufferInfos[6]{};
+  for (uint32_t i = 0; i < PARTICLE_STREAM_COUNT; i++)
+    bufferInfos[i] = { system.particles.buffer, i * system.streamSize, system.streamSize };
+  bufferInfos[4] = { system.emitRing.buffer, 0, system.emitSegmentSize };
+  bufferInfos[5] = { system.solidTiles.buffer, 0, VK_WHOLE_SIZE };
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = createInfo.tileIdSampler;
+  imageInfo.imageView = createInfo.tileIdView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet writes[7]{};
+  for (uint32_t i = 0; i < 7; i++)
+  {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = system.descriptorSet;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  }
+
+  for (uint32_t i = 0; i < 5; i++)
+    writes[i].pBufferInfo = bufferInfos + i;
+  writes[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  writes[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[5].pImageInfo = &imageInfo;
+  writes[6].pBufferInfo = bufferInfos + 5;
+
+  vkUpdateDescriptorSets(system.logicalDevice, 7, writes, 0, nullptr);
+}
+
+ParticleSystem createParticleSystem(const ParticleSystemCreateInfo& createInfo)
+{
+  const VkDevice logicalDevice = createInfo.logicalDevice;
+
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(createInfo.physicalDevice, &props);
+  const VkDeviceSize alignment = props.limits.minStorageBufferOffsetAlignment;
+
+  ParticleSystem system;
+  system.logicalDevice = logicalDevice;
+  system.capacity = (uint32_t)alignUp(createInfo.capacity, PARTICLE_GROUP_SIZE);
+  system.maxEmitsPerFrame = createInfo.maxEmitsPerFrame;
+  system.framesInFlight = createInfo.framesInFlight;
+
+  // every stream is 8 bytes per particle
+  system.streamSize = alignUp((VkDeviceSize)system.capacity * 8, alignment);
+  system.particles =
+    createBuffer(createInfo.physicalDevice, logicalDevice,
+                 system.streamSize * PARTICLE_STREAM_COUNT,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  system.emitSegmentSize =
+    alignUp((VkDeviceSize)system.maxEmitsPerFrame * sizeof(ParticleEmitRequest), alignment);
+  system.emitRing = createBuffer(
+    createInfo.physicalDevice, logicalDevice, system.emitSegmentSize * system.framesInFlight,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  system.solidTiles = createBuffer(
+    createInfo.physicalDevice, logicalDevice, PARTICLE_TILE_TYPE_COUNT / 8,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  memset(system.solidTiles.mapped, 0, PARTICLE_TILE_TYPE_COUNT / 8);
+
+  system.descriptorSetLayout = createParticleDescriptorSetLayout(logicalDevice);
+
+  VkDescriptorPoolSize poolSizes[] = {
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, PARTICLE_STREAM_COUNT + 1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+  };
+
+  VkDescriptorPoolCreateInfo poolCI{};
+  poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCI.maxSets = 1;
+  poolCI.poolSizeCount = sizeof(poolSizes) / sizeof(poolSizes[0]);
+  poolCI.pPoolSizes = poolSizes;
+  if (vkCreateDescriptorPool(logicalDevice, &poolCI, nullptr, &system.descriptorPool) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create particle descriptor pool");
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = system.descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &system.descriptorSetLayout;
+  if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &system.descriptorSet) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate particle descriptor set");
+
+  writeParticleDescriptorSet(system, createInfo);
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.size = sizeof(ParticlePushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+  pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutCI.setLayoutCount = 1;
+  pipelineLayoutCI.pSetLayouts = &system.descriptorSetLayout;
+  pipelineLayoutCI.pushConstantRangeCount = 1;
+  pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr,
+                             &system.pipelineLayout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create particle pipeline layout");
+
+  VkShaderModule emitModule = createShaderModule(logicalDevice, createInfo.emitShader);
+  VkShaderModule simulateModule = createShaderModule(logicalDevice, createInfo.simulateShader);
+  VkShaderModule vertexModule = createShaderModule(logicalDevice, createInfo.vertexShader);
+  VkShaderModule fragmentModule = createShaderModule(logicalDevice, createInfo.fragmentShader);
+
+  system.emitPipeline = createComputePipeline(logicalDevice, emitModule, system.pipelineLayout);
+  system.simulatePipeline =
+    createComputePipeline(logicalDevice, simulateModule, system.pipelineLayout);
+
+  GraphicsPipelineDesc renderDesc;
+  renderDesc.vertexShader = vertexModule;
+  renderDesc.fragmentShader = fragmentModule;
+  renderDesc.layout = system.pipelineLayout;
+  renderDesc.renderPass = createInfo.renderPass;
+  system.renderPipeline = buildGraphicsPipeline(logicalDevice, renderDesc);
+
+  vkDestroyShaderModule(logicalDevice, fragmentModule, nullptr);
+  vkDestroyShaderModule(logicalDevice, vertexModule, nullptr);
+  vkDestroyShaderModule(logicalDevice, simulateModule, nullptr);
+  vkDestroyShaderModule(logicalDevice, emitModule, nullptr);
+
+  return system;
+}
+
+void destroyParticleSystem(ParticleSystem& system)
+{
+  const VkDevice logicalDevice = system.logicalDevice;
+
+  vkDestroyPipeline(logicalDevice, system.renderPipeline, nullptr);
+  vkDestroyPipeline(logicalDevice, system.simulatePipeline, nullptr);
+  vkDestroyPipeline(logicalDevice, system.emitPipeline, nullptr);
+  vkDestroyPipelineLayout(logicalDevice, system.pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(logicalDevice, system.descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(logicalDevice, system.descriptorSetLayout, nullptr);
+
+  destroyBuffer(logicalDevice, system.solidTiles);
+  destroyBuffer(logicalDevice, system.emitRing);
+  destroyBuffer(logicalDevice, system.particles);
+
+  system = {};
+}
+
+void setParticleSolidTileTypes(ParticleSystem& system, const uint32_t* bits)
+{
+  memcpy(system.solidTiles.mapped, bits, PARTICLE_TILE_TYPE_COUNT / 8);
+}
+
+void beginParticleFrame(ParticleSystem& system, uint32_t frameIndex)
+{
+  system.frameIndex = frameIndex % system.framesInFlight;
+  system.emitCount = 0;
+  system.emitParticleCount = 0;
+}
+
+bool emitParticles(ParticleSystem& system, const ParticleEmitRequest& request)
+{
+  if (system.emitCount == system.maxEmitsPerFrame || request.count == 0)
+    return false;
+
+  // more particles than the pool holds in one frame would overwrite themselves
+  if (system.emitParticleCount + request.count > system.capacity)
+    return false;
+
+  ParticleEmitRequest* segment =
+    (ParticleEmitRequest*)((char*)system.emitRing.mapped +
+                           system.frameIndex * system.emitSegmentSize);
+
+  ParticleEmitRequest& slot = segment[system.emitCount++];
+  slot = request;
+  slot.firstParticle = system.emitParticleCount;
+  system.emitParticleCount += request.count;
+
+  return true;
+}
+
+static void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStage,
+                           VkAccessFlags dstAccess)
+{
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStage, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+}
+
+void recordParticleUpdate(VkCommandBuffer commandBuffer, ParticleSystem& system, float dt,
+                          float gravity, int32_t tileOriginX, int32_t tileOriginY)
+{
+  ParticlePushConstants pc{};
+  pc.dt = dt;
+  pc.gravity = gravity;
+  pc.tileOriginX = tileOriginX;
+  pc.tileOriginY = tileOriginY;
+  pc.capacity = system.capacity;
+  pc.particleHead = system.particleHead;
+  pc.emitCount = system.emitCount;
+  pc.emitParticleCount = system.emitParticleCount;
+  pc.seed = system.seed++;
+
+  const uint32_t dynamicOffset = (uint32_t)(system.frameIndex * system.emitSegmentSize);
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  if (!system.cleared)
+  {
+    // zero life marks every slot as dead
+    vkCmdFillBuffer(commandBuffer, system.particles.buffer, 0, VK_WHOLE_SIZE, 0);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+    system.cleared = true;
+  }
+  else
+  {
+    // the draw of the previous frame reads the same streams
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+  }
+
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, system.pipelineLayout, 0,
+                          1, &system.descriptorSet, 1, &dynamicOffset);
+  vkCmdPushConstants(commandBuffer, system.pipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pc),
+                     &pc);
+
+  if (system.emitParticleCount > 0)
+  {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, system.emitPipeline);
+    vkCmdDispatch(commandBuffer,
+                  (system.emitParticleCount + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1,
+                  1);
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, system.simulatePipeline);
+  vkCmdDispatch(commandBuffer, system.capacity / PARTICLE_GROUP_SIZE, 1, 1);
+  computeBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+  system.particleHead = (system.particleHead + system.emitParticleCount) % system.capacity;
+}
+
+void recordParticleDraw(VkCommandBuffer commandBuffer, const ParticleSystem& system,
+                        const float viewScale[2], const float viewOffset[2])
+{
+  ParticlePushConstants pc{};
+  pc.viewScale[0] = viewScale[0];
+  pc.viewScale[1] = viewScale[1];
+  pc.viewOffset[0] = viewOffset[0];
+  pc.viewOffset[1] = viewOffset[1];
+  pc.capacity = system.capacity;
+
+  const uint32_t dynamicOffset = (uint32_t)(system.frameIndex * system.emitSegmentSize);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system.renderPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system.pipelineLayout,
+                          0, 1, &system.descriptorSet, 1, &dynamicOffset);
+  vkCmdPushConstants(commandBuffer, system.pipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pc),
+                     &pc);
+  vkCmdDraw(commandBuffer, 6, system.capacity, 0, 0);
+}
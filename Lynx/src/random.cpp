@@ -0,0 +1,211 @@
+#include <Lynx/random.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RANDOM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RANDOM_SSE2
+#endif
+
+#if defined(RANDOM_AVX2)
+
+// high and low halves of the 32 bit products of every lane of a with m
+static inline void multiplyRandomLanes(__m256i a, __m256i m, __m256i& hi, __m256i& lo)
+{
+  const __m256i even = _mm256_shuffle_epi32(_mm256_mul_epu32(a, m), _MM_SHUFFLE(3, 1, 2, 0));
+  const __m256i odd =
+    _mm256_shuffle_epi32(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), m), _MM_SHUFFLE(3, 1, 2, 0));
+  lo = _mm256_unpacklo_epi32(even, odd);
+  hi = _mm256_unpackhi_epi32(even, odd);
+}
+
+// 8 blocks from first on, lane j computes block first + j
+static void generateRandomBlocks8(const RandomStream& stream, uint64_t first, uint32_t* out)
+{
+  alignas(32) uint32_t low[8], high[8];
+  for (uint32_t j = 0; j < 8; j++)
+  {
+    low[j] = (uint32_t)(first + j);
+    high[j] = (uint32_t)((first + j) >> 32);
+  }
+
+  __m256i c0 = _mm256_load_si256((const __m256i*)low);
+  __m256i c1 = _mm256_load_si256((const __m256i*)high);
+  __m256i c2 = _mm256_set1_epi32((int)stream.chunk);
+  __m256i c3 = _mm256_set1_epi32((int)stream.tick);
+  __m256i k0 = _mm256_set1_epi32((int)stream.key[0]);
+  __m256i k1 = _mm256_set1_epi32((int)stream.key[1]);
+  const __m256i m0 = _mm256_set1_epi32((int)RANDOM_PHILOX_M0);
+  const __m256i m1 = _mm256_set1_epi32((int)RANDOM_PHILOX_M1);
+  const __m256i w0 = _mm256_set1_epi32((int)RANDOM_PHILOX_W0);
+  const __m256i w1 = _mm256_set1_epi32((int)RANDOM_PHILOX_W1);
+
+  for (int round = 0; round < 10; round++)
+  {
+    __m256i hi0, lo0, hi1, lo1;
+    multiplyRandomLanes(c0, m0, hi0, lo0);
+    multiplyRandomLanes(c2, m1, hi1, lo1);
+    c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+    c1 = lo1;
+    c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+    c3 = lo0;
+    k0 = _mm256_add_epi32(k0, w0);
+    k1 = _mm256_add_epi32(k1, w1);
+  }
+
+  // transposed within each half, blocks 0-3 end up in the low halves and 4-7 in the high ones
+  const __m256i t0 = _mm256_unpacklo_epi32(c0, c1);
+  const __m256i t1 = _mm256_unpacklo_epi32(c2, c3);
+  const __m256i t2 = _mm256_unpackhi_epi32(c0, c1);
+  const __m256i t3 = _mm256_unpackhi_epi32(c2, c3);
+  const __m256i r0 = _mm256_unpacklo_epi64(t0, t1);
+  const __m256i r1 = _mm256_unpackhi_epi64(t0, t1);
+  const __m256i r2 = _mm256_unpacklo_epi64(t2, t3);
+  const __m256i r3 = _mm256_unpackhi_epi64(t2, t3);
+  _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(r0, r1, 0x20));
+  _mm256_storeu_si256((__m256i*)(out + 8), _mm256_permute2x128_si256(r2, r3, 0x20));
+  _mm256_storeu_si256((__m256i*)(out + 16), _mm256_permute2x128_si256(r0, r1, 0x31));
+  _mm256_storeu_si256((__m256i*)(out + 24), _mm256_permute2x128_si256(r2, r3, 0x31));
+}
+
+#elif defined(RANDOM_SSE2)
+
+static inline void multiplyRandomLanes(__m128i a, __m128i m, __m128i& hi, __m128i& lo)
+{
+  const __m128i even = _mm_shuffle_epi32(_mm_mul_epu32(a, m), _MM_SHUFFLE(3, 1, 2, 0));
+  const __m128i odd =
+    _mm_shuffle_epi32(_mm_mul_epu32(_mm_srli_epi64(a, 32), m), _MM_SHUFFLE(3, 1, 2, 0));
+  lo = _mm_unpacklo_epi32(even, odd);
+  hi = _mm_unpackhi_epi32(even, odd);
+}
+
+static void generateRandomBlocks4(const RandomStream& stream, uint64_t first, uint32_t* out)
+{
+  alignas(16) uint32_t low[4], high[4];
+  for (uint32_t j = 0; j < 4; j++)
+  {
+    low[j] = (uint32_t)(first + j);
+    high[j] = (uint32_t)((first + j) >> 32);
+  }
+
+  __m128i c0 = _mm_load_si128((const __m128i*)low);
+  __m128i c1 = _mm_load_si128((const __m128i*)high);
+  __m128i c2 = _mm_set1_epi32((int)stream.chunk);
+  __m128i c3 = _mm_set1_epi32((int)stream.tick);
+  __m128i k0 = _mm_set1_epi32((int)stream.key[0]);
+  __m128i k1 = _mm_set1_epi32((int)stream.key[1]);
+  const __m128i m0 = _mm_set1_epi32((int)RANDOM_PHILOX_M0);
+  const __m128i m1 = _mm_set1_epi32((int)RANDOM_PHILOX_M1);
+  const __m128i w0 = _mm_set1_epi32((int)RANDOM_PHILOX_W0);
+  const __m128i w1 = _mm_set1_epi32((int)RANDOM_PHILOX_W1);
+
+  for (int round = 0; round < 10; round++)
+  {
+    __m128i hi0, lo0, hi1, lo1;
+    multiplyRandomLanes(c0, m0, hi0, lo0);
+    multiplyRandomLanes(c2, m1, hi1, lo1);
+    c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+    c1 = lo1;
+    c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+    c3 = lo0;
+    k0 = _mm_add_epi32(k0, w0);
+    k1 = _mm_add_epi32(k1, w1);
+  }
+
+  const __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+  const __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+  const __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+  const __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+  _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi64(t0, t1));
+  _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi64(t0, t1));
+  _mm_storeu_si128((__m128i*)(out + 8), _mm_unpacklo_epi64(t2, t3));
+  _mm_storeu_si128((__m128i*)(out + 12), _mm_unpackhi_epi64(t2, t3));
+}
+
+#endif
+
+// Writes blockCount whole blocks into out and advances the stream past them.
+static void generateRandomBlocks(RandomStream& stream, uint32_t* out, uint32_t blockCount)
+{
+  uint32_t b = 0;
+#if defined(RANDOM_AVX2)
+  for (; b + 8 <= blockCount; b += 8)
+    generateRandomBlocks8(stream, stream.block + b, out + b * 4);
+#elif defined(RANDOM_SSE2)
+  for (; b + 4 <= blockCount; b += 4)
+    generateRandomBlocks4(stream, stream.block + b, out + b * 4);
+#endif
+  for (; b < blockCount; b++)
+    generateRandomBlock(stream.key, stream.block + b, stream.chunk, stream.tick, out + b * 4);
+  stream.block += blockCount;
+}
+
+void fillRandom(RandomStream& stream, uint32_t* out, uint32_t count)
+{
+  uint32_t i = 0;
+  for (; i < count && stream.used < 4; i++)
+    out[i] = stream.buffer[stream.used++];
+
+  const uint32_t blockCount = (count - i) / 4;
+  generateRandomBlocks(stream, out + i, blockCount);
+  i += blockCount * 4;
+
+  for (; i < count; i++)
+    out[i] = nextRandom(stream);
+}
+
+void fillRandomFloats(RandomStream& stream, float* out, uint32_t count)
+{
+  uint32_t bits[256];
+  for (uint32_t start = 0; start < count; start += 256)
+  {
+    const uint32_t n = count - start < 256 ? count - start : 256;
+    fillRandom(stream, bits, n);
+
+    uint32_t i = 0;
+#if defined(RANDOM_AVX2)
+    const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+    for (; i + 8 <= n; i += 8)
+    {
+      const __m256i v = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(bits + i)), 8);
+      _mm256_storeu_ps(out + start + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+#elif defined(RANDOM_SSE2)
+    const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+    for (; i + 4 <= n; i += 4)
+    {
+      const __m128i v = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(bits + i)), 8);
+      _mm_storeu_ps(out + start + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+#endif
+    for (; i < n; i++)
+      out[start + i] = toRandomFloat(bits[i]);
+  }
+}
+
+void fillRandomBelow(RandomStream& stream, uint32_t* out, uint32_t count, uint32_t bound)
+{
+  fillRandom(stream, out, count);
+
+  uint32_t i = 0;
+#if defined(RANDOM_AVX2)
+  const __m256i m = _mm256_set1_epi32((int)bound);
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256i hi, lo;
+    multiplyRandomLanes(_mm256_loadu_si256((const __m256i*)(out + i)), m, hi, lo);
+    _mm256_storeu_si256((__m256i*)(out + i), hi);
+  }
+#elif defined(RANDOM_SSE2)
+  const __m128i m = _mm_set1_epi32((int)bound);
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128i hi, lo;
+    multiplyRandomLanes(_mm_loadu_si128((const __m128i*)(out + i)), m, hi, lo);
+    _mm_storeu_si128((__m128i*)(out + i), hi);
+  }
+#endif
+  for (; i < count; i++)
+    out[i] = toRandomBelow(out[i], bound);
+}
@@ -0,0 +1,169 @@
+#include <Lynx/skylight.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+static uint64_t* getColumnWords(SkylightHeightmap& heightmap, int x)
+{
+  return heightmap.opacity.data() + (size_t)x * heightmap.wordsPerColumn;
+}
+
+static const uint64_t* getColumnWords(const SkylightHeightmap& heightmap, int x)
+{
+  return heightmap.opacity.data() + (size_t)x * heightmap.wordsPerColumn;
+}
+
+// first opaque tile at or below y, height if there is none
+static int findFirstOpaque(const SkylightHeightmap& heightmap, int x, int y)
+{
+  const uint64_t* words = getColumnWords(heightmap, x);
+
+  int word = y >> 6;
+  if (word >= heightmap.wordsPerColumn)
+    return heightmap.height;
+
+  uint64_t bits = words[word] & (~0ull << (y & 63));
+  while (bits == 0)
+  {
+    if (++word == heightmap.wordsPerColumn)
+      return heightmap.height;
+    bits = words[word];
+  }
+
+  return std::min(word * 64 + std::countr_zero(bits), heightmap.height);
+}
+
+static void markColumnDirty(SkylightHeightmap& heightmap, int x)
+{
+  if (heightmap.dirtyBegin == heightmap.dirtyEnd)
+  {
+    heightmap.dirtyBegin = x;
+    heightmap.dirtyEnd = x + 1;
+    return;
+  }
+
+  heightmap.dirtyBegin = std::min(heightmap.dirtyBegin, x);
+  heightmap.dirtyEnd = std::max(heightmap.dirtyEnd, x + 1);
+}
+
+SkylightHeightmap createSkylightHeightmap(int width, int height)
+{
+  if (width <= 0 || height <= 0)
+    throw std::runtime_error("createSkylightHeightmap: invalid world size");
+
+  SkylightHeightmap heightmap;
+  heightmap.width = width;
+  heightmap.height = height;
+  heightmap.wordsPerColumn = (height + 63) / 64;
+  heightmap.opacity.assign((size_t)width * heightmap.wordsPerColumn, 0);
+  heightmap.columnTop.assign(width, height);
+  heightmap.dirtyBegin = 0;
+  heightmap.dirtyEnd = width;
+
+  return heightmap;
+}
+
+bool isTileOpaque(const SkylightHeightmap& heightmap, int x, int y)
+{
+  return (getColumnWords(heightmap, x)[y >> 6] >> (y & 63)) & 1;
+}
+
+void setTileOpacity(SkylightHeightmap& heightmap, int x, int y, bool opaque)
+{
+  uint64_t& word = getColumnWords(heightmap, x)[y >> 6];
+  const uint64_t bit = 1ull << (y & 63);
+
+  if (((word & bit) != 0) == opaque)
+    return;
+
+  int32_t& top = heightmap.columnTop[x];
+  if (opaque)
+  {
+    word |= bit;
+    if (y < top)
+    {
+      top = y;
+      markColumnDirty(heightmap, x);
+    }
+  }
+  else
+  {
+    word &= ~bit;
+    if (y == top)
+    {
+      top = findFirstOpaque(heightmap, x, y + 1);
+      markColumnDirty(heightmap, x);
+    }
+  }
+}
+
+void rebuildSkylightHeightmap(SkylightHeightmap& heightmap)
+{
+  for (int x = 0; x < heightmap.width; x++)
+    heightmap.columnTop[x] = findFirstOpaque(heightmap, x, 0);
+
+  heightmap.dirtyBegin = 0;
+  heightmap.dirtyEnd = heightmap.width;
+}
+
+void collectSkylightSeeds(const SkylightHeightmap& heightmap, int x0, int x1,
+                          std::vector<SkylightSpan>& spans)
+{
+  x0 = std::max(x0, 0);
+  x1 = std::min(x1, heightmap.width);
+
+  const int32_t* tops = heightmap.columnTop.data();
+  for (int x = x0; x < x1; x++)
+  {
+    const int top = tops[x];
+    const int left = x > 0 ? tops[x - 1] : top;
+    const int right = x + 1 < heightmap.width ? tops[x + 1] : top;
+
+    // lit cells next to a darker neighbour column, plus the surface of the blocking tile
+    int y0 = std::max(std::min({ left, right, top - 1 }), 0);
+    int y1 = std::min(top + 1, heightmap.height);
+    spans.push_back({ x, y0, y1 });
+  }
+}
+
+void copySkylightColumns(const SkylightHeightmap& heightmap, int x0, int x1, int32_t* dst)
+{
+  std::copy(heightmap.columnTop.begin() + x0, heightmap.columnTop.begin() + x1, dst);
+}
+
+bool takeSkylightDirtyRange(SkylightHeightmap& heightmap, int& x0, int& x1)
+{
+  if (heightmap.dirtyBegin == heightmap.dirtyEnd)
+    return false;
+
+  x0 = heightmap.dirtyBegin;
+  x1 = heightmap.dirtyEnd;
+  heightmap.dirtyBegin = heightmap.dirtyEnd = 0;
+
+  return true;
+}
+
+SkylightPushConstants getSkylightPushConstants(float timeOfDay)
+{
+  constexpr float PI = 3.14159265358979f;
+
+  // 1 at noon, -1 at midnight
+  const float sunHeight = -std::cos(timeOfDay * 2.0f * PI);
+
+  const float t = std::clamp((sunHeight + 0.2f) / 0.5f, 0.0f, 1.0f);
+  const float daylight = t * t * (3.0f - 2.0f * t);
+
+  // warm tint while the sun is close to the horizon
+  const float dusk = std::clamp(1.0f - std::abs(sunHeight) * 4.0f, 0.0f, 1.0f);
+
+  SkylightPushConstants constants{};
+  constants.skyColor[0] = std::lerp(0.35f, 1.0f, daylight);
+  constants.skyColor[1] = std::lerp(0.40f, 1.0f, daylight) - 0.25f * dusk;
+  constants.skyColor[2] = std::lerp(0.65f, 1.0f, daylight) - 0.45f * dusk;
+  constants.skyColor[3] = 1.0f;
+  constants.dayBrightness = std::lerp(0.12f, 1.0f, daylight);
+
+  return constants;
+}
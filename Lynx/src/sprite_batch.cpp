@@ -0,0 +1,207 @@
+#include <Lynx/sprite_batch.h>
+
+#include <stdexcept>
+
+static VkDescriptorSetLayout createSingleBindingLayout(const VkDevice logicalDevice,
+                                                       VkDescriptorType type,
+                                                       VkShaderStageFlags stages)
+{
+  VkDescriptorSetLayoutBinding binding{};
+  binding.binding = 0;
+  binding.descriptorType = type;
+  binding.descriptorCount = 1;
+  binding.stageFlags = stages;
+
+  VkDescriptorSetLayoutCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  ci.bindingCount = 1;
+  ci.pBindings = &binding;
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(logicalDevice, &ci, nullptr, &layout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create sprite descriptor set layout");
+
+  return layout;
+}
+
+static VkDescriptorSet allocateDescriptorSet(const SpriteBatch& batch,
+                                             VkDescriptorSetLayout layout)
+{
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = batch.descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  VkDescriptorSet set;
+  if (vkAllocateDescriptorSets(batch.logicalDevice, &allocInfo, &set) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate sprite descriptor set");
+
+  return set;
+}
+
+SpriteBatch createSpriteBatch(const SpriteBatchCreateInfo& createInfo)
+{
+  const VkDevice logicalDevice = createInfo.logicalDevice;
+
+  SpriteBatch batch;
+  batch.logicalDevice = logicalDevice;
+  batch.maxSprites = createInfo.maxSprites;
+  batch.maxTextures = createInfo.maxTextures;
+  batch.framesInFlight = createInfo.framesInFlight;
+  batch.commands.reserve(1024);
+  batch.textureSets.reserve(createInfo.maxTextures);
+
+  // 48 byte sprites, a multiple of 16 of them keeps frame segments 256 byte aligned
+  batch.maxSprites = (batch.maxSprites + 15) / 16 * 16;
+  batch.instances = createBuffer(
+    createInfo.physicalDevice, logicalDevice,
+    (VkDeviceSize)batch.maxSprites * sizeof(SpriteInstance) * batch.framesInFlight,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  batch.instanceSetLayout = createSingleBindingLayout(
+    logicalDevice, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT);
+  batch.textureSetLayout = createSingleBindingLayout(
+    logicalDevice, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+  VkDescriptorPoolSize poolSizes[] = {
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, createInfo.maxTextures },
+  };
+
+  VkDescriptorPoolCreateInfo poolCI{};
+  poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCI.maxSets = 1 + createInfo.maxTextures;
+  poolCI.poolSizeCount = 2;
+  poolCI.pPoolSizes = poolSizes;
+  if (vkCreateDescriptorPool(logicalDevice, &poolCI, nullptr, &batch.descriptorPool) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create sprite descriptor pool");
+
+  batch.instanceSet = allocateDescriptorSet(batch, batch.instanceSetLayout);
+
+  VkDescriptorBufferInfo bufferInfo{ batch.instances.buffer, 0,
+                                     (VkDeviceSize)batch.maxSprites * sizeof(SpriteInstance) };
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = batch.instanceSet;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+
+  VkDescriptorSetLayout setLayouts[] = { batch.instanceSetLayout, batch.textureSetLayout };
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.size = sizeof(SpritePushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+  pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutCI.setLayoutCount = 2;
+  pipelineLayoutCI.pSetLayouts = setLayouts;
+  pipelineLayoutCI.pushConstantRangeCount = 1;
+  pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &batch.pipelineLayout) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create sprite pipeline layout");
+
+  VkShaderModule vertexModule = createShaderModule(logicalDevice, createInfo.vertexShader);
+  VkShaderModule fragmentModule = createShaderModule(logicalDevice, createInfo.fragmentShader);
+
+  GraphicsPipelineDesc desc;
+  desc.vertexShader = vertexModule;
+  desc.fragmentShader = fragmentModule;
+  desc.layout = batch.pipelineLayout;
+  desc.renderPass = createInfo.renderPass;
+  batch.pipeline = buildGraphicsPipeline(logicalDevice, desc);
+
+  vkDestroyShaderModule(logicalDevice, fragmentModule, nullptr);
+  vkDestroyShaderModule(logicalDevice, vertexModule, nullptr);
+
+  return batch;
+}
+
+void destroySpriteBatch(SpriteBatch& batch)
+{
+  const VkDevice logicalDevice = batch.logicalDevice;
+
+  vkDestroyPipeline(logicalDevice, batch.pipeline, nullptr);
+  vkDestroyPipelineLayout(logicalDevice, batch.pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(logicalDevice, batch.descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(logicalDevice, batch.textureSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(logicalDevice, batch.instanceSetLayout, nullptr);
+
+  destroyBuffer(logicalDevice, batch.instances);
+
+  batch = {};
+}
+
+uint32_t addSpriteTexture(SpriteBatch& batch, VkImageView imageView, VkSampler sampler)
+{
+  if (batch.textureSets.size() == batch.maxTextures)
+    throw std::runtime_error("addSpriteTexture: too many textures");
+
+  VkDescriptorSet set = allocateDescriptorSet(batch, batch.textureSetLayout);
+
+  VkDescriptorImageInfo imageInfo{ sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(batch.logicalDevice, 1, &write, 0, nullptr);
+
+  batch.textureSets.push_back(set);
+  return (uint32_t)batch.textureSets.size() - 1;
+}
+
+void beginSpriteBatch(SpriteBatch& batch, uint32_t frameIndex)
+{
+  batch.frameIndex = frameIndex % batch.framesInFlight;
+  batch.count = 0;
+  batch.commands.clear();
+}
+
+SpriteInstance* allocateSprites(SpriteBatch& batch, uint32_t texture, uint32_t count)
+{
+  if (batch.count + count > batch.maxSprites)
+    return nullptr;
+
+  if (!batch.commands.empty() && batch.commands.back().texture == texture)
+    batch.commands.back().instanceCount += count;
+  else
+    batch.commands.push_back({ texture, batch.count, count });
+
+  SpriteInstance* instances = (SpriteInstance*)batch.instances.mapped +
+                              (size_t)batch.frameIndex * batch.maxSprites + batch.count;
+  batch.count += count;
+
+  return instances;
+}
+
+void recordSpriteBatch(VkCommandBuffer commandBuffer, const SpriteBatch& batch,
+                       const float viewScale[2], const float viewOffset[2])
+{
+  if (batch.count == 0)
+    return;
+
+  SpritePushConstants pc{ { viewScale[0], viewScale[1] }, { viewOffset[0], viewOffset[1] } };
+  const uint32_t dynamicOffset =
+    batch.frameIndex * batch.maxSprites * (uint32_t)sizeof(SpriteInstance);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipelineLayout, 0,
+                          1, &batch.instanceSet, 1, &dynamicOffset);
+  vkCmdPushConstants(commandBuffer, batch.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(pc), &pc);
+
+  for (const SpriteDrawCommand& command : batch.commands)
+  {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipelineLayout,
+                            1, 1, &batch.textureSets[command.texture], 0, nullptr);
+    vkCmdDraw(commandBuffer, 6, command.instanceCount, 0, command.firstInstance);
+  }
+}
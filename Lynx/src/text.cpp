@@ -0,0 +1,407 @@
+#include <Lynx/text.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static uint64_t hashString(std::string_view string)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : string)
+  {
+    hash ^= (uint8_t)c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Returns the codepoint at index and advances it, U+FFFD for malformed sequences.
+static uint32_t decodeUtf8(std::string_view string, size_t& index)
+{
+  const uint8_t c = (uint8_t)string[index++];
+  if (c < 0x80)
+    return c;
+
+  int extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : -1;
+  if (extra < 0 || index + extra > string.size())
+    return 0xfffd;
+
+  uint32_t codepoint = c & (0x3f >> extra);
+  for (int i = 0; i < extra; i++)
+  {
+    const uint8_t next = (uint8_t)string[index];
+    if ((next & 0xc0) != 0x80)
+      return 0xfffd;
+    codepoint = (codepoint << 6) | (next & 0x3f);
+    index++;
+  }
+  return codepoint;
+}
+
+static void createAtlasImage(TextSystem& text, const VkPhysicalDevice physicalDevice)
+{
+  const VkDevice logicalDevice = text.logicalDevice;
+
+  VkImageCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ci.imageType = VK_IMAGE_TYPE_2D;
+  ci.format = VK_FORMAT_R8_UNORM;
+  ci.extent = { text.atlasWidth, text.atlasHeight, 1 };
+  ci.mipLevels = 1;
+  ci.arrayLayers = 1;
+  ci.samples = VK_SAMPLE_COUNT_1_BIT;
+  ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ci.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if (vkCreateImage(logicalDevice, &ci, nullptr, &text.atlasImage) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create glyph atlas");
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(logicalDevice, text.atlasImage, &requirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &text.atlasMemory) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate glyph atlas memory");
+
+  vkBindImageMemory(logicalDevice, text.atlasImage, text.atlasMemory, 0);
+
+  VkImageViewCreateInfo viewCI{};
+  viewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewCI.image = text.atlasImage;
+  viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewCI.format = ci.format;
+  viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  if (vkCreateImageView(logicalDevice, &viewCI, nullptr, &text.atlasView) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create glyph atlas view");
+
+  VkSamplerCreateInfo samplerCI{};
+  samplerCI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCI.magFilter = VK_FILTER_LINEAR;
+  samplerCI.minFilter = VK_FILTER_LINEAR;
+  samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (vkCreateSampler(logicalDevice, &samplerCI, nullptr, &text.sampler) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create glyph atlas sampler");
+}
+
+static void markAtlasDirty(TextSystem& text, uint32_t y0, uint32_t y1)
+{
+  if (text.dirtyBegin == text.dirtyEnd)
+  {
+    text.dirtyBegin = y0;
+    text.dirtyEnd = y1;
+    return;
+  }
+
+  text.dirtyBegin = std::min(text.dirtyBegin, y0);
+  text.dirtyEnd = std::max(text.dirtyEnd, y1);
+}
+
+// Drops every glyph and every layout referencing them.
+static void resetAtlas(TextSystem& text)
+{
+  std::fill(text.atlasPixels.begin(), text.atlasPixels.end(), 0);
+  text.glyphs.clear();
+  text.layouts.clear();
+  text.shelfX = text.shelfY = text.shelfHeight = 0;
+  markAtlasDirty(text, 0, text.atlasHeight);
+}
+
+void createTextSystem(TextSystem& text, const TextSystemCreateInfo& createInfo,
+                      SpriteBatch& batch)
+{
+  text.logicalDevice = createInfo.logicalDevice;
+  text.fontData = createInfo.fontData;
+
+  if (!ttf_init(&text.font, (const uint8_t*)text.fontData.data(), text.fontData.size()))
+    throw std::runtime_error("createTextSystem: malformed or unsupported font");
+
+  text.basePixelSize = createInfo.basePixelSize;
+  text.scale = ttf_scale_for_pixel_height(&text.font, text.basePixelSize);
+  text.sdfPadding = createInfo.sdfPadding;
+  text.ascent = text.font.ascent * text.scale;
+  text.lineHeight = (text.font.ascent - text.font.descent + text.font.line_gap) * text.scale;
+
+  text.atlasWidth = createInfo.atlasWidth;
+  text.atlasHeight = createInfo.atlasHeight;
+  text.framesInFlight = createInfo.framesInFlight;
+  text.atlasPixels.assign((size_t)text.atlasWidth * text.atlasHeight, 0);
+  text.maxCachedLayouts = createInfo.maxCachedLayouts;
+  text.layouts.reserve(text.maxCachedLayouts);
+  markAtlasDirty(text, 0, text.atlasHeight);
+
+  createAtlasImage(text, createInfo.physicalDevice);
+
+  text.staging = createBuffer(
+    createInfo.physicalDevice, text.logicalDevice,
+    (VkDeviceSize)text.atlasWidth * text.atlasHeight * text.framesInFlight,
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  text.spriteTexture = addSpriteTexture(batch, text.atlasView, text.sampler);
+}
+
+void destroyTextSystem(TextSystem& text)
+{
+  const VkDevice logicalDevice = text.logicalDevice;
+
+  destroyBuffer(logicalDevice, text.staging);
+  vkDestroySampler(logicalDevice, text.sampler, nullptr);
+  vkDestroyImageView(logicalDevice, text.atlasView, nullptr);
+  vkDestroyImage(logicalDevice, text.atlasImage, nullptr);
+  vkFreeMemory(logicalDevice, text.atlasMemory, nullptr);
+
+  text.logicalDevice = VK_NULL_HANDLE;
+  text.atlasImage = VK_NULL_HANDLE;
+  text.atlasMemory = VK_NULL_HANDLE;
+  text.atlasView = VK_NULL_HANDLE;
+  text.sampler = VK_NULL_HANDLE;
+  text.staging = {};
+  text.font = {};
+  text.fontData.clear();
+  text.atlasPixels.clear();
+  text.glyphs.clear();
+  text.layouts.clear();
+  text.partialLayout = {};
+}
+
+void beginTextFrame(TextSystem& text)
+{
+  if (!text.atlasResetPending)
+    return;
+
+  resetAtlas(text);
+  text.atlasResetPending = false;
+}
+
+// Returns nullptr when the atlas has no room left for the glyph. Throws when its outline is
+// malformed.
+static const GlyphAtlasEntry* getGlyph(TextSystem& text, uint32_t codepoint)
+{
+  auto it = text.glyphs.find(codepoint);
+  if (it != text.glyphs.end())
+    return &it->second;
+
+  GlyphAtlasEntry entry{};
+  entry.glyph = ttf_find_glyph(&text.font, codepoint);
+
+  int advance;
+  ttf_get_glyph_hmetrics(&text.font, entry.glyph, &advance, nullptr);
+  entry.advance = advance * text.scale;
+
+  int width, height, xOffset, yOffset;
+  entry.empty = !ttf_get_glyph_sdf_size(&text.font, entry.glyph, text.scale, text.sdfPadding,
+                                        &width, &height, &xOffset, &yOffset);
+  if (!entry.empty)
+  {
+    // one texel of spacing so linear filtering never reads a neighbour
+    if (text.shelfX + width + 1 > text.atlasWidth)
+    {
+      text.shelfX = 0;
+      text.shelfY += text.shelfHeight + 1;
+      text.shelfHeight = 0;
+    }
+    if (text.shelfY + height > text.atlasHeight || (uint32_t)width > text.atlasWidth)
+      return nullptr;
+
+    uint8_t* dst = text.atlasPixels.data() + (size_t)text.shelfY * text.atlasWidth + text.shelfX;
+    if (!ttf_render_glyph_sdf(&text.font, entry.glyph, text.scale, text.sdfPadding, 128,
+                              127.0f / text.sdfPadding, dst, (int)text.atlasWidth))
+      throw std::runtime_error("getTextLayout: malformed glyph outline");
+    markAtlasDirty(text, text.shelfY, text.shelfY + height);
+
+    entry.uv[0] = (float)text.shelfX / text.atlasWidth;
+    entry.uv[1] = (float)text.shelfY / text.atlasHeight;
+    entry.uv[2] = (float)(text.shelfX + width) / text.atlasWidth;
+    entry.uv[3] = (float)(text.shelfY + height) / text.atlasHeight;
+    entry.offset[0] = (float)xOffset;
+    entry.offset[1] = (float)yOffset;
+    entry.size[0] = (float)width;
+    entry.size[1] = (float)height;
+
+    text.shelfX += width + 1;
+    text.shelfHeight = std::max(text.shelfHeight, (uint32_t)height);
+  }
+
+  return &text.glyphs.emplace(codepoint, entry).first->second;
+}
+
+// Returns false when glyphs were left out because the atlas is full.
+static bool buildLayout(TextSystem& text, std::string_view string, TextLayout& layout)
+{
+  bool complete = true;
+  layout.glyphs.clear();
+  layout.width = 0.0f;
+  layout.height = text.lineHeight;
+
+  float penX = 0.0f;
+  float baseline = text.ascent;
+  int previousGlyph = -1;
+
+  for (size_t i = 0; i < string.size();)
+  {
+    const uint32_t codepoint = decodeUtf8(string, i);
+    if (codepoint == '\n')
+    {
+      layout.width = std::max(layout.width, penX);
+      penX = 0.0f;
+      baseline += text.lineHeight;
+      layout.height += text.lineHeight;
+      previousGlyph = -1;
+      continue;
+    }
+
+    const GlyphAtlasEntry* glyph = getGlyph(text, codepoint);
+    if (!glyph)
+    {
+      complete = false;
+      previousGlyph = -1;
+      continue;
+    }
+
+    if (previousGlyph != -1)
+      penX += ttf_get_kerning(&text.font, previousGlyph, glyph->glyph) * text.scale;
+
+    if (!glyph->empty)
+    {
+      TextLayoutGlyph& quad = layout.glyphs.emplace_back();
+      quad.position[0] = penX + glyph->offset[0];
+      quad.position[1] = baseline + glyph->offset[1];
+      quad.size[0] = glyph->size[0];
+      quad.size[1] = glyph->size[1];
+      memcpy(quad.uv, glyph->uv, sizeof(quad.uv));
+    }
+
+    penX += glyph->advance;
+    previousGlyph = glyph->glyph;
+  }
+
+  layout.width = std::max(layout.width, penX);
+  return complete;
+}
+
+const TextLayout& getTextLayout(TextSystem& text, std::string_view string)
+{
+  const uint64_t hash = hashString(string);
+
+  auto it = text.layouts.find(hash);
+  if (it != text.layouts.end() && it->second.text == string)
+    return it->second;
+
+  if (text.layouts.size() >= text.maxCachedLayouts)
+    text.layouts.clear();
+
+  const bool atlasEmpty = text.glyphs.empty();
+  TextLayout layout;
+  layout.text = string;
+  if (!buildLayout(text, string, layout))
+  {
+    if (atlasEmpty)
+      throw std::runtime_error("getTextLayout: string does not fit in the glyph atlas");
+
+    // sprites of this frame may use any glyph of the atlas, so it is only cleared next frame
+    text.atlasResetPending = true;
+    text.partialLayout = std::move(layout);
+    return text.partialLayout;
+  }
+
+  // a colliding hash simply replaces the older string
+  TextLayout& cached = text.layouts[hash];
+  cached = std::move(layout);
+  return cached;
+}
+
+void writeTextSprites(const TextSystem& text, const TextLayout& layout, float x, float y,
+                      float pixelSize, uint32_t color, SpriteInstance* sprites)
+{
+  const float s = pixelSize / text.basePixelSize;
+  for (const TextLayoutGlyph& glyph : layout.glyphs)
+  {
+    SpriteInstance& sprite = *sprites++;
+    sprite.position[0] = x + glyph.position[0] * s;
+    sprite.position[1] = y + glyph.position[1] * s;
+    sprite.size[0] = glyph.size[0] * s;
+    sprite.size[1] = glyph.size[1] * s;
+    memcpy(sprite.uv, glyph.uv, sizeof(sprite.uv));
+    sprite.color = color;
+    sprite.flags = SPRITE_SDF;
+    sprite.padding[0] = sprite.padding[1] = 0.0f;
+  }
+}
+
+bool drawText(SpriteBatch& batch, TextSystem& text, std::string_view string, float x, float y,
+              float pixelSize, uint32_t color)
+{
+  const TextLayout& layout = getTextLayout(text, string);
+  if (layout.glyphs.empty())
+    return true;
+
+  SpriteInstance* sprites =
+    allocateSprites(batch, text.spriteTexture, (uint32_t)layout.glyphs.size());
+  if (!sprites)
+    return false;
+
+  writeTextSprites(text, layout, x, y, pixelSize, color, sprites);
+  return true;
+}
+
+void measureText(TextSystem& text, std::string_view string, float pixelSize, float& width,
+                 float& height)
+{
+  const TextLayout& layout = getTextLayout(text, string);
+  const float s = pixelSize / text.basePixelSize;
+  width = layout.width * s;
+  height = layout.height * s;
+}
+
+void recordTextUploads(VkCommandBuffer commandBuffer, TextSystem& text, uint32_t frameIndex)
+{
+  if (text.dirtyBegin == text.dirtyEnd)
+    return;
+
+  const VkDeviceSize atlasBytes = (VkDeviceSize)text.atlasWidth * text.atlasHeight;
+  const VkDeviceSize rowOffset = (VkDeviceSize)text.dirtyBegin * text.atlasWidth;
+  const VkDeviceSize offset = (frameIndex % text.framesInFlight) * atlasBytes + rowOffset;
+  memcpy((char*)text.staging.mapped + offset, text.atlasPixels.data() + rowOffset,
+         (size_t)(text.dirtyEnd - text.dirtyBegin) * text.atlasWidth);
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = text.atlasInitialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                            : VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = text.atlasImage;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = offset;
+  region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+  region.imageOffset = { 0, (int32_t)text.dirtyBegin, 0 };
+  region.imageExtent = { text.atlasWidth, text.dirtyEnd - text.dirtyBegin, 1 };
+  vkCmdCopyBufferToImage(commandBuffer, text.staging.buffer, text.atlasImage,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                       &barrier);
+
+  text.atlasInitialized = true;
+  text.dirtyBegin = text.dirtyEnd = 0;
+}
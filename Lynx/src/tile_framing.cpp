@@ -0,0 +1,312 @@
+#include <Lynx/tile_framing.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <stdexcept>
+
+// Tiles a chunk is framed from, with a border of one tile on every side.
+constexpr const int32_t WINDOW_SIZE = TILE_CHUNK_SIZE + 2;
+constexpr const uint32_t WINDOW_TILES = WINDOW_SIZE * WINDOW_SIZE;
+
+// set in the sides of active tiles, the other bits are open sides
+constexpr const uint8_t WINDOW_ACTIVE = 0x80;
+
+// by neighbour bit, clockwise from above
+constexpr const int32_t WINDOW_OFFSETS[8] = {
+  -WINDOW_SIZE, -WINDOW_SIZE + 1, 1, WINDOW_SIZE + 1,
+  WINDOW_SIZE,  WINDOW_SIZE - 1,  -1, -WINDOW_SIZE - 1,
+};
+
+static_assert((TILE_SLOPE_OPEN_SIDES[TILE_SLOPE_UP_LEFT] & WINDOW_ACTIVE) == 0);
+
+struct TileFramingWindow
+{
+  uint16_t types[WINDOW_TILES];
+  uint8_t sides[WINDOW_TILES];
+  // bit of the merge class, 0 for none
+  uint8_t classes[WINDOW_TILES];
+};
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static void onTileFramingTilesChanged(void* userData, int32_t x0, int32_t y0, int32_t x1,
+                                      int32_t y1)
+{
+  // the neighbours of a changed tile see it in their frames
+  markTileFramingDirty(*(TileFraming*)userData, x0 - 1, y0 - 1, x1 + 1, y1 + 1);
+}
+
+void createTileFraming(TileFraming& framing, TileStore& store, JobSystem& jobs)
+{
+  framing.store = &store;
+  framing.jobs = &jobs;
+  framing.autoTiled.assign(TILE_TYPE_COUNT, 0);
+  framing.mergeClasses.assign(TILE_TYPE_COUNT, TILE_NO_MERGE_CLASS);
+  framing.mergesWith.assign(TILE_TYPE_COUNT, 0);
+  framing.frames.clear();
+  framing.frames.resize(store.chunks.size());
+  framing.chunks.assign(store.chunks.size(), TileFramingChunk{});
+  framing.chunkX.resize(store.chunks.size());
+  framing.chunkY.resize(store.chunks.size());
+  for (int32_t cy = 0; cy < store.chunksY; cy++)
+  {
+    for (int32_t cx = 0; cx < store.chunksX; cx++)
+    {
+      const uint32_t slot = store.chunkSlots[cy * store.chunksX + cx];
+      framing.chunkX[slot] = (uint32_t)cx;
+      framing.chunkY[slot] = (uint32_t)cy;
+    }
+  }
+  framing.dirtyChunks.clear();
+  framing.stats = {};
+  addTileChangeListener(store, onTileFramingTilesChanged, &framing);
+}
+
+void destroyTileFraming(TileFraming& framing)
+{
+  if (framing.store)
+    removeTileChangeListener(*framing.store, onTileFramingTilesChanged, &framing);
+  framing.store = nullptr;
+  framing.frames.clear();
+  framing.chunks.clear();
+  framing.dirtyChunks.clear();
+}
+
+void setTileFramingType(TileFraming& framing, uint16_t type, uint8_t mergeClass,
+                        uint8_t mergesWith)
+{
+  if (mergeClass != TILE_NO_MERGE_CLASS && mergeClass >= 8)
+    throw std::runtime_error("setTileFramingType: merge class out of range");
+
+  framing.autoTiled[type] = 1;
+  framing.mergeClasses[type] = mergeClass;
+  framing.mergesWith[type] = mergesWith;
+}
+
+void markTileFramingDirty(TileFraming& framing, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+  const TileStore& store = *framing.store;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+    {
+      const uint32_t slot = store.chunkSlots[cy * store.chunksX + cx];
+      const int32_t left = std::max(x0 - (cx << TILE_CHUNK_SHIFT), 0);
+      const int32_t right = std::min(x1 - (cx << TILE_CHUNK_SHIFT), TILE_CHUNK_SIZE);
+      const uint32_t bits =
+        (right - left == 32 ? ~0u : ((1u << (right - left)) - 1)) << left;
+      const int32_t top = std::max(y0 - (cy << TILE_CHUNK_SHIFT), 0);
+      const int32_t bottom = std::min(y1 - (cy << TILE_CHUNK_SHIFT), TILE_CHUNK_SIZE);
+      TileFramingChunk& chunk = framing.chunks[slot];
+      for (int32_t row = top; row < bottom; row++)
+        chunk.rows[row] |= bits;
+      if (!chunk.listed)
+      {
+        chunk.listed = true;
+        framing.dirtyChunks.push_back(slot);
+      }
+    }
+  }
+}
+
+void setTileFrame(TileFraming& framing, int32_t x, int32_t y, uint16_t frame)
+{
+  std::unique_ptr<uint16_t[]>& frames = framing.frames[getTileChunkSlot(*framing.store, x, y)];
+  if (!frames)
+    frames.reset(new uint16_t[TILE_CHUNK_TILES]());
+  frames[getTileIndexInChunk(x, y)] = frame;
+}
+
+static bool holdsAutoTiledType(const TileFraming& framing, uint32_t slot)
+{
+  const TileChunk& chunk = framing.store->chunks[slot];
+  if (chunk.raw)
+  {
+    for (uint32_t i = 0; i < (uint32_t)TILE_CHUNK_TILES; i++)
+    {
+      if ((chunk.raw->hot.flags[i] & TILE_ACTIVE) && framing.autoTiled[chunk.raw->hot.types[i]])
+        return true;
+    }
+    return false;
+  }
+  for (const TileRecord& record : chunk.packed.palette)
+  {
+    if ((record.flags & TILE_ACTIVE) && framing.autoTiled[record.type])
+      return true;
+  }
+  return false;
+}
+
+static void readTileFramingWindow(const TileFraming& framing, int32_t x0, int32_t y0,
+                                  TileFramingWindow& window)
+{
+  const TileStore& store = *framing.store;
+  // inactive tiles and tiles outside the world are type 0 without sides, the neighbour loop reads
+  // the type of every neighbour
+  std::fill(window.types, window.types + WINDOW_TILES, (uint16_t)0);
+  std::fill(window.sides, window.sides + WINDOW_TILES, (uint8_t)0);
+  std::fill(window.classes, window.classes + WINDOW_TILES, (uint8_t)0);
+  for (int32_t row = 0; row < WINDOW_SIZE; row++)
+  {
+    const int32_t left = x0 - 1;
+    forEachTileRowView(store, y0 - 1 + row, left, left + WINDOW_SIZE,
+                       [&](const TileRowView& view, int32_t x)
+                       {
+                         const int32_t base = row * WINDOW_SIZE + x - left;
+                         for (int32_t i = 0; i < view.count; i++)
+                         {
+                           if (!(view.flags[i] & TILE_ACTIVE))
+                             continue;
+                           const uint32_t slope =
+                             (view.attributes[i] >> TILE_SLOPE_SHIFT) & TILE_SLOPE_MASK;
+                           const uint8_t mergeClass = framing.mergeClasses[view.types[i]];
+                           window.types[base + i] = view.types[i];
+                           window.classes[base + i] =
+                             mergeClass < 8 ? (uint8_t)(1u << mergeClass) : 0;
+                           window.sides[base + i] =
+                             WINDOW_ACTIVE | (slope < 6 ? TILE_SLOPE_OPEN_SIDES[slope] : 0);
+                         }
+                       });
+  }
+}
+
+static uint16_t getTileVariant(int32_t x, int32_t y)
+{
+  uint32_t hash = (uint32_t)x * 0x9e3779b1u ^ (uint32_t)y * 0x85ebca77u;
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6du;
+  hash ^= hash >> 12;
+  return (uint16_t)(hash % 3);
+}
+
+// Frames the dirty tiles of the chunk at slot and clears them. Returns the tiles framed.
+static uint32_t frameTileFramingChunk(TileFraming& framing, uint32_t slot)
+{
+  TileFramingChunk& chunk = framing.chunks[slot];
+  std::unique_ptr<uint16_t[]>& frames = framing.frames[slot];
+  if (!frames && !holdsAutoTiledType(framing, slot))
+  {
+    std::fill(chunk.rows, chunk.rows + TILE_CHUNK_SIZE, 0u);
+    return 0;
+  }
+  if (!frames)
+    frames.reset(new uint16_t[TILE_CHUNK_TILES]());
+
+  const int32_t x0 = (int32_t)framing.chunkX[slot] << TILE_CHUNK_SHIFT;
+  const int32_t y0 = (int32_t)framing.chunkY[slot] << TILE_CHUNK_SHIFT;
+  TileFramingWindow window;
+  readTileFramingWindow(framing, x0, y0, window);
+
+  const uint8_t* mergesWith = framing.mergesWith.data();
+  uint32_t framed = 0;
+  for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+  {
+    uint32_t bits = chunk.rows[row];
+    chunk.rows[row] = 0;
+    while (bits)
+    {
+      const int32_t x = std::countr_zero(bits);
+      bits &= bits - 1;
+      const uint32_t center = (row + 1) * WINDOW_SIZE + x + 1;
+      const uint32_t index = (uint32_t)(row * TILE_CHUNK_SIZE + x);
+      const uint8_t sides = window.sides[center];
+      if (!(sides & WINDOW_ACTIVE))
+      {
+        frames[index] = 0;
+        continue;
+      }
+      const uint16_t type = window.types[center];
+      if (!framing.autoTiled[type])
+        continue;
+
+      // branch free, neighbourhoods of generated worlds are too irregular to predict
+      const uint8_t merges = mergesWith[type];
+      uint32_t mask = 0, blend = 0;
+      for (uint32_t k = 0; k < 8; k++)
+      {
+        const uint32_t neighbour = center + WINDOW_OFFSETS[k];
+        const uint8_t neighbourSides = window.sides[neighbour];
+        const uint32_t same = window.types[neighbour] == type;
+        uint32_t connects =
+          (uint32_t)(neighbourSides >> 7) & (same | ((merges & window.classes[neighbour]) != 0));
+        if (!(k & 1))
+        {
+          // the side of the neighbour facing back is the bit four steps around
+          connects &= ~((sides | std::rotl(neighbourSides, 4)) >> k) & 1;
+          blend |= (connects & ~same) << (k >> 1);
+        }
+        mask |= connects << k;
+      }
+      frames[index] = (uint16_t)(TILE_BLOB_FRAMES[mask] | blend << TILE_FRAME_BLEND_SHIFT |
+                                 getTileVariant(x0 + x, y0 + row) << TILE_FRAME_VARIANT_SHIFT);
+      framed++;
+    }
+  }
+  return framed;
+}
+
+const TileFramingStats& updateTileFraming(TileFraming& framing)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  TileStore& store = *framing.store;
+  framing.stats = {};
+  if (framing.dirtyChunks.empty())
+    return framing.stats;
+
+  // loading changes the chunk table, which the jobs read without locks
+  if (store.unloadedChunks)
+  {
+    for (uint32_t slot : framing.dirtyChunks)
+    {
+      const int32_t cx = (int32_t)framing.chunkX[slot], cy = (int32_t)framing.chunkY[slot];
+      for (int32_t y = std::max(cy - 1, 0); y <= std::min(cy + 1, store.chunksY - 1); y++)
+      {
+        for (int32_t x = std::max(cx - 1, 0); x <= std::min(cx + 1, store.chunksX - 1); x++)
+          loadTileChunk(store, store.chunkSlots[y * store.chunksX + x]);
+      }
+    }
+  }
+
+  const std::vector<uint32_t>& dirty = framing.dirtyChunks;
+  std::vector<uint32_t> framed(dirty.size());
+  if (dirty.size() >= framing.parallelChunks)
+  {
+    // a job writes the frames of its own chunk only
+    runJobs(*framing.jobs, (uint32_t)dirty.size(), [&](uint32_t index, uint32_t)
+            { framed[index] = frameTileFramingChunk(framing, dirty[index]); });
+  }
+  else
+  {
+    for (uint32_t index = 0; index < (uint32_t)dirty.size(); index++)
+      framed[index] = frameTileFramingChunk(framing, dirty[index]);
+  }
+
+  for (uint32_t index = 0; index < (uint32_t)dirty.size(); index++)
+  {
+    framing.chunks[dirty[index]].listed = false;
+    framing.stats.tiles += framed[index];
+  }
+  framing.stats.chunks = (uint32_t)dirty.size();
+  framing.dirtyChunks.clear();
+  framing.stats.nanoseconds = getSteadyNanoseconds() - start;
+  return framing.stats;
+}
+
+const TileFramingStats& frameAllTiles(TileFraming& framing)
+{
+  markTileFramingDirty(framing, 0, 0, framing.store->width, framing.store->height);
+  return updateTileFraming(framing);
+}
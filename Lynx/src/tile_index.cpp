@@ -0,0 +1,352 @@
+#include <Lynx/tile_index.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static void markTileIndexChunkStale(TileIndex& index, uint32_t chunk)
+{
+  if (index.chunks[chunk].stale)
+    return;
+  index.chunks[chunk].stale = true;
+  index.staleChunks.push_back(chunk);
+}
+
+static void onTileIndexTilesChanged(void* userData, int32_t x0, int32_t y0, int32_t x1,
+                                    int32_t y1)
+{
+  TileIndex& index = *(TileIndex*)userData;
+  const TileStore& store = *index.store;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+      markTileIndexChunkStale(index, (uint32_t)(cy * store.chunksX + cx));
+  }
+}
+
+// Adds or removes one tile of type at i in chunk.
+static void countTileIndexTile(TileIndex& index, uint32_t chunk, uint16_t type, uint32_t i,
+                               bool add)
+{
+  TileIndexChunk& indexChunk = index.chunks[chunk];
+  std::vector<TileTypeCount>& counts = indexChunk.counts;
+  auto it = std::lower_bound(counts.begin(), counts.end(), type,
+                             [](const TileTypeCount& count, uint16_t value)
+                             { return count.type < value; });
+  const bool found = it != counts.end() && it->type == type;
+  if (!add && !found)
+  {
+    // written without a notification, counted again instead
+    markTileIndexChunkStale(index, chunk);
+    return;
+  }
+
+  if (add)
+  {
+    if (!found)
+      it = counts.insert(it, { type, 0 });
+    it->count++;
+    index.totals[type]++;
+  }
+  else
+  {
+    it->count--;
+    index.totals[type]--;
+  }
+  const bool first = add && it->count == 1, last = !add && it->count == 0;
+  if (last)
+    counts.erase(it);
+  if (!index.indexedTypes[type])
+    return;
+
+  std::vector<uint32_t>& indexed = indexChunk.indexed;
+  const uint32_t entry = (uint32_t)type << 10 | i;
+  const auto position = std::lower_bound(indexed.begin(), indexed.end(), entry);
+  if (add)
+    indexed.insert(position, entry);
+  else if (position != indexed.end() && *position == entry)
+    indexed.erase(position);
+
+  std::vector<uint32_t>& chunks = index.indexedChunks[index.indexedTypes[type] - 1];
+  if (first)
+    chunks.push_back(chunk);
+  if (last)
+  {
+    const auto at = std::find(chunks.begin(), chunks.end(), chunk);
+    if (at != chunks.end())
+    {
+      *at = chunks.back();
+      chunks.pop_back();
+    }
+  }
+}
+
+// Single tiles move their counts from the type before to the type after, chunks counted again
+// anyway are left alone.
+static void onTileIndexTileWritten(void* userData, int32_t x, int32_t y,
+                                   const TileRecord& before, const TileRecord& after)
+{
+  TileIndex& index = *(TileIndex*)userData;
+  const bool wasActive = before.flags & TILE_ACTIVE;
+  const bool isActive = after.flags & TILE_ACTIVE;
+  if (wasActive == isActive && (!isActive || before.type == after.type))
+    return;
+
+  const TileStore& store = *index.store;
+  const uint32_t chunk =
+    (uint32_t)((y >> TILE_CHUNK_SHIFT) * store.chunksX + (x >> TILE_CHUNK_SHIFT));
+  const uint32_t i = getTileIndexInChunk(x, y);
+  if (wasActive && !index.chunks[chunk].stale)
+    countTileIndexTile(index, chunk, before.type, i, false);
+  if (isActive && !index.chunks[chunk].stale)
+    countTileIndexTile(index, chunk, after.type, i, true);
+}
+
+void createTileIndex(TileIndex& index, TileStore& store, JobSystem& jobs)
+{
+  index.store = &store;
+  index.jobs = &jobs;
+  index.indexedTypes.assign(TILE_TYPE_COUNT, 0);
+  index.indexedChunks.clear();
+  index.chunks.clear();
+  index.chunks.resize(store.chunks.size());
+  index.staleChunks.clear();
+  index.totals.assign(TILE_TYPE_COUNT, 0);
+  index.threadCounts.assign(getJobThreadCount(jobs), std::vector<uint16_t>(TILE_TYPE_COUNT, 0));
+  index.stats = {};
+  for (uint32_t chunk = 0; chunk < (uint32_t)index.chunks.size(); chunk++)
+    markTileIndexChunkStale(index, chunk);
+  addTileChangeListener(store, onTileIndexTilesChanged, onTileIndexTileWritten, &index);
+}
+
+void destroyTileIndex(TileIndex& index)
+{
+  if (index.store)
+    removeTileChangeListener(*index.store, onTileIndexTilesChanged, &index);
+  index.store = nullptr;
+  index.indexedChunks.clear();
+  index.chunks.clear();
+  index.staleChunks.clear();
+  index.threadCounts.clear();
+}
+
+void setTileTypeIndexed(TileIndex& index, uint16_t type)
+{
+  if (index.indexedTypes[type])
+    return;
+  index.indexedChunks.emplace_back();
+  index.indexedTypes[type] = (uint32_t)index.indexedChunks.size();
+
+  // the positions are read with the chunks holding type
+  for (uint32_t chunk = 0; chunk < (uint32_t)index.chunks.size(); chunk++)
+  {
+    const std::vector<TileTypeCount>& counts = index.chunks[chunk].counts;
+    if (std::binary_search(counts.begin(), counts.end(), TileTypeCount{ type, 0 },
+                           [](const TileTypeCount& a, const TileTypeCount& b)
+                           { return a.type < b.type; }))
+      markTileIndexChunkStale(index, chunk);
+  }
+}
+
+// Histogram and indexed tiles of chunk into result, using counters, a counter per type.
+static void countTileIndexChunk(const TileIndex& index, uint32_t chunk,
+                                std::vector<uint16_t>& counters, TileIndexChunk& result)
+{
+  const TileStore& store = *index.store;
+  const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+  const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+  std::vector<uint16_t> seen;
+  for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+  {
+    forEachTileRowView(store, y0 + row, x0, x0 + TILE_CHUNK_SIZE,
+                       [&](const TileRowView& view, int32_t x)
+                       {
+                         for (int32_t i = 0; i < view.count; i++)
+                         {
+                           if (!(view.flags[i] & TILE_ACTIVE))
+                             continue;
+                           const uint16_t type = view.types[i];
+                           if (!counters[type]++)
+                             seen.push_back(type);
+                           if (index.indexedTypes[type])
+                             result.indexed.push_back(
+                               (uint32_t)type << 10 |
+                               (uint32_t)(row * TILE_CHUNK_SIZE + x - x0 + i));
+                         }
+                       });
+  }
+
+  std::sort(seen.begin(), seen.end());
+  result.counts.clear();
+  for (uint16_t type : seen)
+  {
+    result.counts.push_back({ type, counters[type] });
+    counters[type] = 0;
+  }
+  std::sort(result.indexed.begin(), result.indexed.end());
+}
+
+// Moves the counts of chunk to fresh, keeping the totals and the chunk lists of indexed types.
+static void replaceTileIndexChunk(TileIndex& index, uint32_t chunk, TileIndexChunk& fresh)
+{
+  TileIndexChunk& old = index.chunks[chunk];
+  for (const TileTypeCount& count : old.counts)
+  {
+    index.totals[count.type] -= count.count;
+    if (index.indexedTypes[count.type])
+    {
+      // missing when the type was indexed after the chunk was counted
+      std::vector<uint32_t>& chunks = index.indexedChunks[index.indexedTypes[count.type] - 1];
+      const auto it = std::find(chunks.begin(), chunks.end(), chunk);
+      if (it != chunks.end())
+      {
+        *it = chunks.back();
+        chunks.pop_back();
+      }
+    }
+  }
+  for (const TileTypeCount& count : fresh.counts)
+  {
+    index.totals[count.type] += count.count;
+    if (index.indexedTypes[count.type])
+      index.indexedChunks[index.indexedTypes[count.type] - 1].push_back(chunk);
+  }
+  old.counts.swap(fresh.counts);
+  old.indexed.swap(fresh.indexed);
+  old.stale = false;
+}
+
+const TileIndexStats& refreshTileIndex(TileIndex& index)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  const TileStore& store = *index.store;
+  index.stats = {};
+  if (index.staleChunks.empty())
+    return index.stats;
+
+  // unloaded chunks stay stale until they are loaded
+  std::vector<uint32_t> refreshed;
+  uint32_t kept = 0;
+  for (uint32_t chunk : index.staleChunks)
+  {
+    if (store.chunks[store.chunkSlots[chunk]].unloaded)
+      index.staleChunks[kept++] = chunk;
+    else
+      refreshed.push_back(chunk);
+  }
+  index.staleChunks.resize(kept);
+
+  std::vector<TileIndexChunk> fresh(refreshed.size());
+  if (refreshed.size() >= index.parallelChunks)
+  {
+    runJobs(*index.jobs, (uint32_t)refreshed.size(),
+            [&](uint32_t i, uint32_t thread)
+            { countTileIndexChunk(index, refreshed[i], index.threadCounts[thread], fresh[i]); });
+  }
+  else
+  {
+    for (uint32_t i = 0; i < (uint32_t)refreshed.size(); i++)
+      countTileIndexChunk(index, refreshed[i], index.threadCounts[0], fresh[i]);
+  }
+  for (uint32_t i = 0; i < (uint32_t)refreshed.size(); i++)
+    replaceTileIndexChunk(index, refreshed[i], fresh[i]);
+
+  index.stats.refreshedChunks = (uint32_t)refreshed.size();
+  index.stats.nanoseconds = getSteadyNanoseconds() - start;
+  return index.stats;
+}
+
+uint64_t countTilesInWorld(TileIndex& index, uint16_t type)
+{
+  refreshTileIndex(index);
+  return index.totals[type];
+}
+
+uint64_t countTilesInRect(TileIndex& index, uint16_t type, int32_t x0, int32_t y0, int32_t x1,
+                          int32_t y1)
+{
+  refreshTileIndex(index);
+  const TileStore& store = *index.store;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x1 <= x0 || y1 <= y0)
+    return 0;
+
+  uint64_t total = 0;
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+    {
+      const int32_t left = std::max(x0, cx << TILE_CHUNK_SHIFT);
+      const int32_t right = std::min(x1, (cx + 1) << TILE_CHUNK_SHIFT);
+      const int32_t top = std::max(y0, cy << TILE_CHUNK_SHIFT);
+      const int32_t bottom = std::min(y1, (cy + 1) << TILE_CHUNK_SHIFT);
+      // chunks still stale after the refresh are unloaded, they are not counted until loaded
+      const TileIndexChunk& chunk = index.chunks[cy * store.chunksX + cx];
+      if (chunk.stale)
+        continue;
+      const auto it = std::lower_bound(chunk.counts.begin(), chunk.counts.end(), type,
+                                       [](const TileTypeCount& count, uint16_t value)
+                                       { return count.type < value; });
+      if (it == chunk.counts.end() || it->type != type)
+        continue;
+      const bool whole = left == cx << TILE_CHUNK_SHIFT && top == cy << TILE_CHUNK_SHIFT &&
+                         (right == (cx + 1) << TILE_CHUNK_SHIFT || right == store.width) &&
+                         (bottom == (cy + 1) << TILE_CHUNK_SHIFT || bottom == store.height);
+      if (whole)
+      {
+        total += it->count;
+        continue;
+      }
+
+      // partly covered, the tiles inside are counted
+      for (int32_t y = top; y < bottom; y++)
+      {
+        forEachTileRowView(store, y, left, right,
+                           [&](const TileRowView& view, int32_t)
+                           {
+                             for (int32_t i = 0; i < view.count; i++)
+                               total += view.types[i] == type && (view.flags[i] & TILE_ACTIVE);
+                           });
+      }
+    }
+  }
+  return total;
+}
+
+bool findNearestTile(TileIndex& index, uint16_t type, int32_t x, int32_t y, int32_t& outX,
+                     int32_t& outY)
+{
+  int64_t best = INT64_MAX;
+  forEachIndexedTile(index, type,
+                     [&](int32_t tileX, int32_t tileY)
+                     {
+                       const int64_t dx = tileX - x, dy = tileY - y;
+                       const int64_t distance = dx * dx + dy * dy;
+                       // ties go to the lowest row, then column, whatever the chunk order
+                       if (distance < best ||
+                           (distance == best && (tileY < outY || (tileY == outY && tileX < outX))))
+                       {
+                         best = distance;
+                         outX = tileX;
+                         outY = tileY;
+                       }
+                     });
+  return best != INT64_MAX;
+}
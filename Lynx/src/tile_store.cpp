@@ -0,0 +1,792 @@
+#include <Lynx/tile_store.h>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+static uint32_t spreadBits(uint32_t v)
+{
+  v &= 0xffff;
+  v = (v | (v << 8)) & 0x00ff00ff;
+  v = (v | (v << 4)) & 0x0f0f0f0f;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+
+static uint32_t mortonCode(uint32_t x, uint32_t y)
+{
+  return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+TileStore createTileStore(int32_t width, int32_t height)
+{
+  if (width <= 0 || height <= 0)
+    throw std::runtime_error("createTileStore: invalid size");
+
+  TileStore store;
+  store.width = width;
+  store.height = height;
+  store.chunksX = (width + TILE_CHUNK_MASK) >> TILE_CHUNK_SHIFT;
+  store.chunksY = (height + TILE_CHUNK_MASK) >> TILE_CHUNK_SHIFT;
+
+  // the grid is rarely a power of two, so chunks are ranked by their Morton code instead of
+  // being placed at it
+  const uint32_t chunkCount = (uint32_t)(store.chunksX * store.chunksY);
+  std::vector<uint32_t> order(chunkCount);
+  std::iota(order.begin(), order.end(), 0u);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return mortonCode(a % store.chunksX, a / store.chunksX) <
+           mortonCode(b % store.chunksX, b / store.chunksX);
+  });
+
+  store.chunkSlots.resize(chunkCount);
+  for (uint32_t slot = 0; slot < chunkCount; slot++)
+    store.chunkSlots[order[slot]] = slot;
+
+  // every chunk starts as uniform empty tiles
+  store.chunks.resize(chunkCount);
+  for (TileChunk& chunk : store.chunks)
+  {
+    chunk.packed.format = TILE_CHUNK_UNIFORM;
+    chunk.packed.palette.push_back({});
+  }
+
+  store.typeFlags.assign(TILE_TYPE_COUNT, 0);
+
+  store.snapshotStates.reset(new std::atomic<uint32_t>[chunkCount]);
+  for (uint32_t slot = 0; slot < chunkCount; slot++)
+    store.snapshotStates[slot].store(0, std::memory_order_relaxed);
+
+  return store;
+}
+
+void setTileTypeFlags(TileStore& store, uint16_t type, uint8_t flags)
+{
+  store.typeFlags[type] = flags & TILE_TYPE_FLAGS;
+}
+
+void addTileChangeListener(TileStore& store, TileChangeFn fn, void* userData)
+{
+  store.listeners.push_back({ fn, nullptr, userData });
+}
+
+void addTileChangeListener(TileStore& store, TileChangeFn fn, TileWriteFn writeFn,
+                           void* userData)
+{
+  store.listeners.push_back({ fn, writeFn, userData });
+}
+
+void removeTileChangeListener(TileStore& store, TileChangeFn fn, void* userData)
+{
+  auto it = std::find_if(store.listeners.begin(), store.listeners.end(),
+                         [&](const TileChangeListener& listener) {
+                           return listener.fn == fn && listener.userData == userData;
+                         });
+  if (it != store.listeners.end())
+    store.listeners.erase(it);
+}
+
+void notifyTilesChanged(const TileStore& store, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+  for (const TileChangeListener& listener : store.listeners)
+    listener.fn(listener.userData, x0, y0, x1, y1);
+}
+
+uint32_t packTileAttributes(const Tile& tile)
+{
+  return ((uint32_t)(tile.wall & TILE_WALL_MASK) << TILE_WALL_SHIFT) |
+         ((uint32_t)(tile.wallPaint & TILE_PAINT_MASK) << TILE_WALL_PAINT_SHIFT) |
+         ((uint32_t)(tile.paint & TILE_PAINT_MASK) << TILE_PAINT_SHIFT) |
+         ((uint32_t)(tile.slope & TILE_SLOPE_MASK) << TILE_SLOPE_SHIFT) |
+         ((uint32_t)(tile.liquidType & TILE_LIQUID_TYPE_MASK) << TILE_LIQUID_TYPE_SHIFT) |
+         ((uint32_t)(tile.wires & TILE_WIRES_MASK) << TILE_WIRES_SHIFT) |
+         (tile.actuator ? TILE_ACTUATOR_BIT : 0);
+}
+
+void unpackTileAttributes(uint32_t attributes, Tile& tile)
+{
+  tile.wall = (uint16_t)((attributes >> TILE_WALL_SHIFT) & TILE_WALL_MASK);
+  tile.wallPaint = (uint8_t)((attributes >> TILE_WALL_PAINT_SHIFT) & TILE_PAINT_MASK);
+  tile.paint = (uint8_t)((attributes >> TILE_PAINT_SHIFT) & TILE_PAINT_MASK);
+  tile.slope = (uint8_t)((attributes >> TILE_SLOPE_SHIFT) & TILE_SLOPE_MASK);
+  tile.liquidType = (uint8_t)((attributes >> TILE_LIQUID_TYPE_SHIFT) & TILE_LIQUID_TYPE_MASK);
+  tile.wires = (uint8_t)((attributes >> TILE_WIRES_SHIFT) & TILE_WIRES_MASK);
+  tile.actuator = (attributes & TILE_ACTUATOR_BIT) != 0;
+}
+
+// Type flags are derived from the type, everything else about the flags comes from the caller.
+static uint8_t resolveTileFlags(const TileStore& store, uint16_t type, uint8_t flags)
+{
+  if (!(flags & TILE_ACTIVE))
+    return flags & ~TILE_TYPE_FLAGS;
+  return (flags & ~TILE_TYPE_FLAGS) | store.typeFlags[type];
+}
+
+static TileRecord getRawTileRecord(const TileChunkRaw& raw, uint32_t i)
+{
+  return { raw.hot.types[i], raw.hot.flags[i], raw.cold.liquids[i], raw.cold.attributes[i] };
+}
+
+static bool sameTileRecord(const TileRecord& a, const TileRecord& b)
+{
+  return a.type == b.type && a.flags == b.flags && a.liquid == b.liquid &&
+         a.attributes == b.attributes;
+}
+
+static uint32_t bitsForPaletteSize(size_t size)
+{
+  uint32_t bits = 1;
+  while ((1ull << bits) < size)
+    bits++;
+  return bits;
+}
+
+// Picks the smallest of uniform, palette and runs.
+bool encodeTileChunk(const TileChunkRaw& raw, TileChunkEncoding& packed)
+{
+  packed = {};
+
+  uint8_t indices[TILE_CHUNK_TILES];
+  uint32_t runs = 1;
+  TileRecord previous = getRawTileRecord(raw, 0);
+  uint8_t previousIndex = 0;
+  packed.palette.push_back(previous);
+  indices[0] = 0;
+
+  for (uint32_t i = 1; i < TILE_CHUNK_TILES; i++)
+  {
+    const TileRecord record = getRawTileRecord(raw, i);
+    if (sameTileRecord(record, previous))
+    {
+      indices[i] = previousIndex;
+      continue;
+    }
+
+    uint32_t index = 0;
+    while (index < packed.palette.size() && !sameTileRecord(packed.palette[index], record))
+      index++;
+    if (index == packed.palette.size())
+    {
+      if (index == TILE_CHUNK_MAX_PALETTE)
+        return false;
+      packed.palette.push_back(record);
+    }
+
+    indices[i] = (uint8_t)index;
+    previous = record;
+    previousIndex = (uint8_t)index;
+    runs++;
+  }
+
+  if (packed.palette.size() == 1)
+  {
+    packed.format = TILE_CHUNK_UNIFORM;
+    return true;
+  }
+
+  const uint32_t bits = bitsForPaletteSize(packed.palette.size());
+  const uint32_t perWord = 64 / bits;
+  const uint32_t words = (TILE_CHUNK_TILES + perWord - 1) / perWord;
+
+  if (runs * (sizeof(uint16_t) + sizeof(uint8_t)) < words * sizeof(uint64_t))
+  {
+    packed.format = TILE_CHUNK_RUNS;
+    packed.runEnds.reserve(runs);
+    packed.runIndices.reserve(runs);
+    for (uint32_t i = 0; i < TILE_CHUNK_TILES; i++)
+    {
+      if (i + 1 == TILE_CHUNK_TILES || indices[i + 1] != indices[i])
+      {
+        packed.runEnds.push_back((uint16_t)i);
+        packed.runIndices.push_back(indices[i]);
+      }
+    }
+    return true;
+  }
+
+  packed.format = TILE_CHUNK_PALETTE;
+  packed.bitsPerIndex = (uint8_t)bits;
+  packed.indices.assign(words, 0);
+  for (uint32_t i = 0; i < TILE_CHUNK_TILES; i++)
+    packed.indices[i / perWord] |= (uint64_t)indices[i] << (i % perWord * bits);
+  return true;
+}
+
+TileRecord getPackedTileRecord(const TileChunkEncoding& packed, uint32_t i)
+{
+  switch (packed.format)
+  {
+  case TILE_CHUNK_PALETTE:
+  {
+    const uint32_t perWord = 64 / packed.bitsPerIndex;
+    const uint64_t mask = (1ull << packed.bitsPerIndex) - 1;
+    const uint64_t word = packed.indices[i / perWord];
+    return packed.palette[(word >> (i % perWord * packed.bitsPerIndex)) & mask];
+  }
+  case TILE_CHUNK_RUNS:
+  {
+    const size_t run =
+      std::lower_bound(packed.runEnds.begin(), packed.runEnds.end(), (uint16_t)i) -
+      packed.runEnds.begin();
+    return packed.palette[packed.runIndices[run]];
+  }
+  default:
+    return packed.palette[0];
+  }
+}
+
+TileRecord getStoredTileRecord(const TileStore& store, const TileChunk& chunk, uint32_t i)
+{
+  if (chunk.unloaded)
+    loadTileChunk(store, (uint32_t)(&chunk - store.chunks.data()));
+  if (chunk.raw)
+    return getRawTileRecord(*chunk.raw, i);
+  return getPackedTileRecord(chunk.packed, i);
+}
+
+static void fillRawTileRecords(TileChunkRaw& raw, uint32_t begin, uint32_t end,
+                               const TileRecord& record)
+{
+  std::fill(raw.hot.types + begin, raw.hot.types + end, record.type);
+  std::fill(raw.hot.flags + begin, raw.hot.flags + end, record.flags);
+  std::fill(raw.cold.liquids + begin, raw.cold.liquids + end, record.liquid);
+  std::fill(raw.cold.attributes + begin, raw.cold.attributes + end, record.attributes);
+}
+
+static void decodeTileChunk(const TileChunkEncoding& packed, TileChunkRaw& raw)
+{
+  switch (packed.format)
+  {
+  case TILE_CHUNK_UNIFORM:
+    fillRawTileRecords(raw, 0, TILE_CHUNK_TILES, packed.palette[0]);
+    break;
+  case TILE_CHUNK_RUNS:
+  {
+    uint32_t begin = 0;
+    for (size_t run = 0; run < packed.runEnds.size(); run++)
+    {
+      const uint32_t end = packed.runEnds[run] + 1u;
+      fillRawTileRecords(raw, begin, end, packed.palette[packed.runIndices[run]]);
+      begin = end;
+    }
+    break;
+  }
+  default:
+    for (uint32_t i = 0; i < TILE_CHUNK_TILES; i++)
+    {
+      const TileRecord record = getPackedTileRecord(packed, i);
+      raw.hot.types[i] = record.type;
+      raw.hot.flags[i] = record.flags;
+      raw.cold.liquids[i] = record.liquid;
+      raw.cold.attributes[i] = record.attributes;
+    }
+    break;
+  }
+}
+
+// Copies the chunk into the snapshot in progress before its first write, unless the snapshot
+// reader already read it. Every change to a chunk's contents or representation goes through here.
+static void prepareTileChunkWrite(TileStore& store, uint32_t slot)
+{
+  if (!store.snapshot)
+    return;
+
+  std::atomic<uint32_t>& state = store.snapshotStates[slot];
+  const uint32_t done = 2 * store.snapshotEpoch;
+  uint32_t current = state.load(std::memory_order_acquire);
+  while (current != done)
+  {
+    if (current == done - 1)
+    {
+      // the reader is on this chunk right now
+      std::this_thread::yield();
+      current = state.load(std::memory_order_acquire);
+      continue;
+    }
+    if (state.compare_exchange_weak(current, done - 1, std::memory_order_acq_rel))
+    {
+      const TileChunk& chunk = store.chunks[slot];
+      TileChunk& copy = store.snapshot->copies[slot];
+      if (chunk.raw)
+        copy.raw.reset(new TileChunkRaw(*chunk.raw));
+      copy.packed = chunk.packed;
+      state.store(done, std::memory_order_release);
+      store.snapshot->copiedChunks++;
+      return;
+    }
+  }
+}
+
+bool beginTileSnapshot(TileStore& store, TileSnapshot& snapshot)
+{
+  if (store.snapshot)
+    throw std::runtime_error("beginTileSnapshot: a snapshot is already in progress");
+  if (store.unloadedChunks > 0)
+    return false;
+
+  // sized once, copies are released as they are read; callers that care about the first pause
+  // size it beforehand
+  if (snapshot.copies.size() != store.chunks.size())
+    snapshot.copies.resize(store.chunks.size());
+  snapshot.remaining.store((uint32_t)store.chunks.size(), std::memory_order_relaxed);
+  snapshot.copiedChunks = 0;
+
+  // every chunk state is now below 2 * snapshotEpoch - 1, which marks them all not yet copied
+  store.snapshotEpoch++;
+  store.snapshot = &snapshot;
+  return true;
+}
+
+bool isTileSnapshotRead(const TileSnapshot& snapshot)
+{
+  return snapshot.remaining.load(std::memory_order_acquire) == 0;
+}
+
+void endTileSnapshot(TileStore& store, TileSnapshot& snapshot)
+{
+  if (store.snapshot != &snapshot || !isTileSnapshotRead(snapshot))
+    throw std::runtime_error("endTileSnapshot: snapshot not read yet");
+  store.snapshot = nullptr;
+}
+
+void setTileChunkLoader(TileStore& store, TileChunkLoadFn loader, void* userData)
+{
+  if (store.snapshot)
+    throw std::runtime_error("setTileChunkLoader: a snapshot is in progress");
+
+  store.chunkLoader = loader;
+  store.chunkLoaderUserData = userData;
+  store.unloadedChunks = (uint32_t)store.chunks.size();
+  for (TileChunk& chunk : store.chunks)
+  {
+    chunk.raw.reset();
+    chunk.packed = {};
+    chunk.unloaded = true;
+  }
+}
+
+void loadTileChunk(const TileStore& store, uint32_t slot)
+{
+  if (!store.chunks[slot].unloaded)
+    return;
+  if (!store.chunkLoader)
+    throw std::runtime_error("loadTileChunk: no chunk loader");
+
+  // loading is not a change of the world, so it is allowed through const references
+  store.chunkLoader(store.chunkLoaderUserData, const_cast<TileStore&>(store), slot);
+  if (store.chunks[slot].unloaded)
+    throw std::runtime_error("loadTileChunk: chunk was not loaded");
+}
+
+void installTileChunk(TileStore& store, uint32_t slot, TileChunkEncoding&& packed,
+                      const TileChunkRaw* raw)
+{
+  prepareTileChunkWrite(store, slot);
+
+  TileChunk& chunk = store.chunks[slot];
+  store.unloadedChunks -= chunk.unloaded;
+  chunk.unloaded = false;
+  if (packed.format == TILE_CHUNK_RAW)
+  {
+    if (!raw)
+      throw std::runtime_error("installTileChunk: raw chunk without tiles");
+    chunk.raw.reset(new TileChunkRaw(*raw));
+    chunk.packed = {};
+    // gives the compressor an idle period before it tries again
+    chunk.lastWrite = store.clock;
+    return;
+  }
+
+  chunk.raw.reset();
+  chunk.packed = std::move(packed);
+}
+
+TileChunkRaw& getWritableTileChunk(TileStore& store, uint32_t slot)
+{
+  TileChunk& chunk = store.chunks[slot];
+  if (chunk.unloaded)
+    loadTileChunk(store, slot);
+  prepareTileChunkWrite(store, slot);
+  if (!chunk.raw)
+  {
+    // default initialized, decoding writes every tile
+    chunk.raw.reset(new TileChunkRaw);
+    decodeTileChunk(chunk.packed, *chunk.raw);
+    chunk.packed = {};
+  }
+
+  chunk.lastWrite = store.clock;
+  chunk.version++;
+  return *chunk.raw;
+}
+
+static void setTileChunkUniform(TileStore& store, uint32_t slot, const TileRecord& record)
+{
+  prepareTileChunkWrite(store, slot);
+
+  TileChunk& chunk = store.chunks[slot];
+  chunk.raw.reset();
+  store.unloadedChunks -= chunk.unloaded;
+  chunk.unloaded = false;
+  chunk.packed = {};
+  chunk.packed.format = TILE_CHUNK_UNIFORM;
+  chunk.packed.palette.push_back(record);
+  chunk.lastWrite = store.clock;
+  chunk.version++;
+}
+
+Tile getTile(const TileStore& store, int32_t x, int32_t y)
+{
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const TileRecord record = getStoredTileRecord(store, chunk, i);
+
+  Tile tile;
+  tile.type = record.type;
+  tile.flags = record.flags;
+  tile.liquid = record.liquid;
+  unpackTileAttributes(record.attributes, tile);
+  return tile;
+}
+
+// Tells the listeners that the tile at (x, y), i in raw, was before until now.
+static void notifyTileWritten(const TileStore& store, int32_t x, int32_t y,
+                              const TileRecord& before, const TileChunkRaw& raw, uint32_t i)
+{
+  const TileRecord after = getRawTileRecord(raw, i);
+  for (const TileChangeListener& listener : store.listeners)
+  {
+    if (listener.writeFn)
+      listener.writeFn(listener.userData, x, y, before, after);
+    else
+      listener.fn(listener.userData, x, y, x + 1, y + 1);
+  }
+}
+
+void setTile(TileStore& store, int32_t x, int32_t y, const Tile& tile)
+{
+  TileChunkRaw& raw = getWritableTileChunk(store, getTileChunkSlot(store, x, y));
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const TileRecord before = getRawTileRecord(raw, i);
+
+  raw.hot.types[i] = tile.type;
+  raw.hot.flags[i] = resolveTileFlags(store, tile.type, tile.flags);
+  raw.cold.liquids[i] = tile.liquid;
+  raw.cold.attributes[i] = packTileAttributes(tile);
+
+  notifyTileWritten(store, x, y, before, raw, i);
+}
+
+void setTileType(TileStore& store, int32_t x, int32_t y, uint16_t type)
+{
+  TileChunkRaw& raw = getWritableTileChunk(store, getTileChunkSlot(store, x, y));
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const TileRecord before = getRawTileRecord(raw, i);
+
+  raw.hot.types[i] = type;
+  raw.hot.flags[i] = resolveTileFlags(store, type, raw.hot.flags[i] | TILE_ACTIVE);
+
+  notifyTileWritten(store, x, y, before, raw, i);
+}
+
+void removeTile(TileStore& store, int32_t x, int32_t y)
+{
+  TileChunkRaw& raw = getWritableTileChunk(store, getTileChunkSlot(store, x, y));
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const TileRecord before = getRawTileRecord(raw, i);
+
+  raw.hot.types[i] = 0;
+  raw.hot.flags[i] = 0;
+  // a removed block loses its shape and paint, the wall behind it stays
+  const uint32_t keep = (TILE_WALL_MASK << TILE_WALL_SHIFT) |
+                        (TILE_PAINT_MASK << TILE_WALL_PAINT_SHIFT) |
+                        (TILE_LIQUID_TYPE_MASK << TILE_LIQUID_TYPE_SHIFT) |
+                        (TILE_WIRES_MASK << TILE_WIRES_SHIFT) | TILE_ACTUATOR_BIT;
+  raw.cold.attributes[i] &= keep;
+
+  notifyTileWritten(store, x, y, before, raw, i);
+}
+
+void setTileWall(TileStore& store, int32_t x, int32_t y, uint16_t wall)
+{
+  TileChunkRaw& raw = getWritableTileChunk(store, getTileChunkSlot(store, x, y));
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const TileRecord before = getRawTileRecord(raw, i);
+  uint32_t& attributes = raw.cold.attributes[i];
+  attributes = (attributes & ~(TILE_WALL_MASK << TILE_WALL_SHIFT)) |
+               ((uint32_t)(wall & TILE_WALL_MASK) << TILE_WALL_SHIFT);
+
+  notifyTileWritten(store, x, y, before, raw, i);
+}
+
+void setTileLiquid(TileStore& store, int32_t x, int32_t y, uint8_t amount, uint8_t liquidType)
+{
+  TileChunkRaw& raw = getWritableTileChunk(store, getTileChunkSlot(store, x, y));
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const TileRecord before = getRawTileRecord(raw, i);
+
+  raw.cold.liquids[i] = amount;
+  raw.cold.attributes[i] =
+    (raw.cold.attributes[i] & ~(TILE_LIQUID_TYPE_MASK << TILE_LIQUID_TYPE_SHIFT)) |
+    ((uint32_t)(liquidType & TILE_LIQUID_TYPE_MASK) << TILE_LIQUID_TYPE_SHIFT);
+
+  notifyTileWritten(store, x, y, before, raw, i);
+}
+
+void fillTiles(TileStore& store, int32_t x0, int32_t y0, int32_t x1, int32_t y1, const Tile& tile)
+{
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  const TileRecord record = { tile.type, resolveTileFlags(store, tile.type, tile.flags),
+                              tile.liquid, packTileAttributes(tile) };
+
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+    {
+      const uint32_t slot = store.chunkSlots[cy * store.chunksX + cx];
+
+      // chunks at the edge of the world only need their part inside it covered
+      const int32_t chunkX0 = cx << TILE_CHUNK_SHIFT;
+      const int32_t chunkY0 = cy << TILE_CHUNK_SHIFT;
+      const int32_t chunkX1 = std::min(chunkX0 + TILE_CHUNK_SIZE, store.width);
+      const int32_t chunkY1 = std::min(chunkY0 + TILE_CHUNK_SIZE, store.height);
+      const int32_t fx0 = std::max(x0, chunkX0);
+      const int32_t fy0 = std::max(y0, chunkY0);
+      const int32_t fx1 = std::min(x1, chunkX1);
+      const int32_t fy1 = std::min(y1, chunkY1);
+      if (fx0 == chunkX0 && fy0 == chunkY0 && fx1 == chunkX1 && fy1 == chunkY1)
+      {
+        setTileChunkUniform(store, slot, record);
+        continue;
+      }
+
+      TileChunkRaw& raw = getWritableTileChunk(store, slot);
+      for (int32_t y = fy0; y < fy1; y++)
+      {
+        const uint32_t begin = getTileIndexInChunk(fx0, y);
+        fillRawTileRecords(raw, begin, begin + (fx1 - fx0), record);
+      }
+    }
+  }
+
+  notifyTilesChanged(store, x0, y0, x1, y1);
+}
+
+TileRowSpan getTileRowSpan(TileStore& store, int32_t x, int32_t y)
+{
+  TileChunkRaw& raw = getWritableTileChunk(store, getTileChunkSlot(store, x, y));
+  const uint32_t i = getTileIndexInChunk(x, y);
+
+  TileRowSpan span;
+  span.types = raw.hot.types + i;
+  span.flags = raw.hot.flags + i;
+  span.liquids = raw.cold.liquids + i;
+  span.attributes = raw.cold.attributes + i;
+  span.count = std::min(TILE_CHUNK_SIZE - (x & TILE_CHUNK_MASK), store.width - x);
+  return span;
+}
+
+TileRowView getTileRowView(const TileStore& store, int32_t x, int32_t y, TileRowBuffer& buffer)
+{
+  const TileChunk& chunk = getTileChunk(store, x, y);
+  const uint32_t i = getTileIndexInChunk(x, y);
+  const int32_t count = std::min(TILE_CHUNK_SIZE - (x & TILE_CHUNK_MASK), store.width - x);
+
+  if (chunk.unloaded)
+    loadTileChunk(store, getTileChunkSlot(store, x, y));
+  if (chunk.raw)
+  {
+    const TileChunkRaw& raw = *chunk.raw;
+    return { raw.hot.types + i, raw.hot.flags + i, raw.cold.liquids + i, raw.cold.attributes + i,
+             count };
+  }
+
+  for (int32_t k = 0; k < count; k++)
+  {
+    const TileRecord record = getPackedTileRecord(chunk.packed, i + k);
+    buffer.types[k] = record.type;
+    buffer.flags[k] = record.flags;
+    buffer.liquids[k] = record.liquid;
+    buffer.attributes[k] = record.attributes;
+  }
+  return { buffer.types, buffer.flags, buffer.liquids, buffer.attributes, count };
+}
+
+bool compressTileChunk(TileStore& store, uint32_t slot)
+{
+  TileChunk& chunk = store.chunks[slot];
+  if (!chunk.raw)
+    return !chunk.unloaded;
+
+  TileChunkEncoding packed;
+  if (!encodeTileChunk(*chunk.raw, packed))
+    return false;
+
+  prepareTileChunkWrite(store, slot);
+  chunk.raw.reset();
+  chunk.packed = std::move(packed);
+  return true;
+}
+
+void compressTileStore(TileStore& store)
+{
+  for (uint32_t slot = 0; slot < store.chunks.size(); slot++)
+    compressTileChunk(store, slot);
+}
+
+TileStoreMemoryReport getTileStoreMemoryReport(const TileStore& store)
+{
+  TileStoreMemoryReport report{};
+  report.residentBytes = store.chunks.capacity() * sizeof(TileChunk) +
+                         store.chunkSlots.capacity() * sizeof(uint32_t) +
+                         store.typeFlags.capacity();
+  report.uncompressedBytes = store.chunks.size() * sizeof(TileChunkRaw);
+
+  for (const TileChunk& chunk : store.chunks)
+  {
+    if (chunk.unloaded)
+    {
+      report.unloadedChunks++;
+      continue;
+    }
+    if (chunk.raw)
+    {
+      report.residentBytes += sizeof(TileChunkRaw);
+      report.rawChunks++;
+      continue;
+    }
+
+    const TileChunkEncoding& packed = chunk.packed;
+    report.residentBytes += packed.palette.capacity() * sizeof(TileRecord) +
+                            packed.indices.capacity() * sizeof(uint64_t) +
+                            packed.runEnds.capacity() * sizeof(uint16_t) +
+                            packed.runIndices.capacity();
+    report.uniformChunks += packed.format == TILE_CHUNK_UNIFORM;
+    report.paletteChunks += packed.format == TILE_CHUNK_PALETTE;
+    report.runChunks += packed.format == TILE_CHUNK_RUNS;
+  }
+
+  return report;
+}
+
+static void runTileCompressor(TileCompressor* compressor)
+{
+  while (true)
+  {
+    TileCompressJob job;
+    {
+      std::unique_lock<std::mutex> lock(compressor->mutex);
+      compressor->condition.wait(lock,
+                                 [&] { return compressor->quit || !compressor->requests.empty(); });
+      if (compressor->quit)
+        return;
+
+      job = std::move(compressor->requests.front());
+      compressor->requests.pop_front();
+    }
+
+    job.compressed = encodeTileChunk(*job.copy, job.packed);
+    job.copy.reset();
+
+    std::lock_guard<std::mutex> lock(compressor->mutex);
+    compressor->results.push_back(std::move(job));
+  }
+}
+
+void createTileCompressor(TileCompressor& compressor, uint32_t idleTicks,
+                          uint32_t maxJobsInFlight, uint32_t scanPerUpdate)
+{
+  compressor.idleTicks = idleTicks;
+  compressor.maxJobsInFlight = maxJobsInFlight;
+  compressor.scanPerUpdate = scanPerUpdate;
+  compressor.worker = std::thread(runTileCompressor, &compressor);
+}
+
+void destroyTileCompressor(TileCompressor& compressor)
+{
+  {
+    std::lock_guard<std::mutex> lock(compressor.mutex);
+    compressor.quit = true;
+  }
+  compressor.condition.notify_one();
+  if (compressor.worker.joinable())
+    compressor.worker.join();
+
+  compressor.requests.clear();
+  compressor.results.clear();
+}
+
+void updateTileCompressor(TileCompressor& compressor, TileStore& store)
+{
+  store.clock++;
+
+  std::deque<TileCompressJob> results;
+  {
+    std::lock_guard<std::mutex> lock(compressor.mutex);
+    results.swap(compressor.results);
+  }
+
+  for (TileCompressJob& job : results)
+  {
+    compressor.jobsInFlight--;
+
+    TileChunk& chunk = store.chunks[job.slot];
+    chunk.compressing = false;
+    // too many distinct tiles, wait for another idle period before trying again
+    if (!job.compressed)
+    {
+      chunk.lastWrite = store.clock;
+      continue;
+    }
+    // written while the worker was busy, the next scan will try again
+    if (!chunk.raw || chunk.version != job.version)
+      continue;
+    // swapping the representation under the snapshot reader would cost a copy, wait instead
+    if (store.snapshot && store.snapshotStates[job.slot].load(std::memory_order_acquire) !=
+                            2 * store.snapshotEpoch)
+    {
+      chunk.lastWrite = store.clock;
+      continue;
+    }
+
+    chunk.raw.reset();
+    chunk.packed = std::move(job.packed);
+  }
+
+  const uint32_t chunkCount = (uint32_t)store.chunks.size();
+  const uint32_t scan = std::min(compressor.scanPerUpdate, chunkCount);
+  bool queued = false;
+  for (uint32_t n = 0; n < scan && compressor.jobsInFlight < compressor.maxJobsInFlight; n++)
+  {
+    const uint32_t slot = compressor.scanCursor;
+    compressor.scanCursor = (compressor.scanCursor + 1) % chunkCount;
+
+    TileChunk& chunk = store.chunks[slot];
+    if (!chunk.raw || chunk.compressing || store.clock - chunk.lastWrite < compressor.idleTicks)
+      continue;
+
+    TileCompressJob job{};
+    job.slot = slot;
+    job.version = chunk.version;
+    job.copy.reset(new TileChunkRaw(*chunk.raw));
+
+    {
+      std::lock_guard<std::mutex> lock(compressor.mutex);
+      compressor.requests.push_back(std::move(job));
+    }
+    chunk.compressing = true;
+    compressor.jobsInFlight++;
+    queued = true;
+  }
+
+  if (queued)
+    compressor.condition.notify_one();
+}
@@ -0,0 +1,239 @@
+#include <Lynx/tile_updates.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <Lynx/random.h>
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static void markTileUpdateChunkStale(TileUpdater& updater, uint32_t chunk)
+{
+  if (updater.chunkStates[chunk] == TILE_UPDATE_CHUNK_STALE)
+    return;
+  updater.chunkStates[chunk] = TILE_UPDATE_CHUNK_STALE;
+  updater.staleChunks.push_back(chunk);
+}
+
+static void onTileUpdaterTilesChanged(void* userData, int32_t x0, int32_t y0, int32_t x1,
+                                      int32_t y1)
+{
+  TileUpdater& updater = *(TileUpdater*)userData;
+  const TileStore& store = *updater.store;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+      markTileUpdateChunkStale(updater, (uint32_t)(cy * store.chunksX + cx));
+  }
+}
+
+static void markAllTileUpdateChunksStale(TileUpdater& updater)
+{
+  for (uint32_t chunk = 0; chunk < (uint32_t)updater.chunkStates.size(); chunk++)
+    markTileUpdateChunkStale(updater, chunk);
+}
+
+void createTileUpdater(TileUpdater& updater, TileStore& store, JobSystem& jobs, uint64_t seed,
+                       double updatesPerTick)
+{
+  updater.store = &store;
+  updater.jobs = &jobs;
+  updater.seed = seed;
+  updater.tick = 0;
+  updater.updatesPerTick = updatesPerTick;
+  updater.handlers.clear();
+  updater.handlerIndices.assign(TILE_TYPE_COUNT, 0);
+  updater.chunkStates.assign(store.chunks.size(), TILE_UPDATE_CHUNK_IDLE);
+  updater.staleChunks.clear();
+  updater.chunkList.clear();
+  updater.threads.assign(getJobThreadCount(jobs), TileUpdateThread{});
+  updater.stats = {};
+  addTileChangeListener(store, onTileUpdaterTilesChanged, &updater);
+}
+
+void destroyTileUpdater(TileUpdater& updater)
+{
+  if (updater.store)
+    removeTileChangeListener(*updater.store, onTileUpdaterTilesChanged, &updater);
+  updater.store = nullptr;
+  updater.handlers.clear();
+  updater.chunkStates.clear();
+  updater.staleChunks.clear();
+  updater.chunkList.clear();
+  updater.threads.clear();
+}
+
+void setTileUpdateHandler(TileUpdater& updater, uint16_t type, TileUpdateFn fn, void* userData)
+{
+  uint32_t& index = updater.handlerIndices[type];
+  if (!index)
+  {
+    updater.handlers.push_back({ type, nullptr, nullptr, {} });
+    index = (uint32_t)updater.handlers.size();
+    // chunks holding type become updatable
+    markAllTileUpdateChunksStale(updater);
+  }
+  updater.handlers[index - 1].fn = fn;
+  updater.handlers[index - 1].userData = userData;
+}
+
+static bool holdsUpdatableType(const TileUpdater& updater, const TileChunk& chunk)
+{
+  if (chunk.raw)
+  {
+    for (uint32_t i = 0; i < (uint32_t)TILE_CHUNK_TILES; i++)
+    {
+      if (updater.handlerIndices[chunk.raw->hot.types[i]] &&
+          (chunk.raw->hot.flags[i] & TILE_ACTIVE))
+        return true;
+    }
+    return false;
+  }
+  for (const TileRecord& record : chunk.packed.palette)
+  {
+    if (updater.handlerIndices[record.type] && (record.flags & TILE_ACTIVE))
+      return true;
+  }
+  return false;
+}
+
+// Poisson by inversion, split into parts of mean 32 at most so exp(-mean) does not underflow.
+static uint32_t drawPoisson(RandomStream& stream, double mean)
+{
+  const uint32_t parts = (uint32_t)std::ceil(mean / 32.0);
+  const double partMean = mean / parts;
+  const double zero = std::exp(-partMean);
+  uint32_t count = 0;
+  for (uint32_t part = 0; part < parts; part++)
+  {
+    const double u = nextRandomFloat(stream);
+    double p = zero, sum = zero;
+    uint32_t k = 0;
+    while (u >= sum && p > 0.0)
+    {
+      k++;
+      p *= partMean / k;
+      sum += p;
+    }
+    count += k;
+  }
+  return count;
+}
+
+// Draws the tiles of chunk into the picks of thread. Returns the tiles drawn.
+static uint32_t drawTileUpdates(const TileUpdater& updater, uint32_t chunk, double rate,
+                                TileUpdateThread& thread)
+{
+  const TileStore& store = *updater.store;
+  const int32_t cx = (int32_t)chunk % store.chunksX, cy = (int32_t)chunk / store.chunksX;
+  const int32_t x0 = cx << TILE_CHUNK_SHIFT, y0 = cy << TILE_CHUNK_SHIFT;
+  const int32_t width = std::min(TILE_CHUNK_SIZE, store.width - x0);
+  const uint32_t tiles = (uint32_t)(width * std::min(TILE_CHUNK_SIZE, store.height - y0));
+
+  const TileChunk& stored = store.chunks[store.chunkSlots[chunk]];
+  if (stored.unloaded)
+    return 0;
+  RandomStream stream = createRandomStream(updater.seed, updater.pass, chunk, updater.tick);
+  const uint32_t count = drawPoisson(stream, rate * tiles);
+  for (uint32_t n = 0; n < count; n++)
+  {
+    const uint32_t pick = nextRandomBelow(stream, tiles);
+    const int32_t x = (int32_t)pick % width, y = (int32_t)pick / width;
+    const TileRecord record =
+      getStoredTileRecord(store, stored, (uint32_t)(y * TILE_CHUNK_SIZE + x));
+    const uint32_t handler = updater.handlerIndices[record.type];
+    if (handler && (record.flags & TILE_ACTIVE))
+      thread.picks.push_back({ x0 + x, y0 + y, handler - 1 });
+  }
+  return count;
+}
+
+const TileUpdateStats& updateRandomTiles(TileUpdater& updater)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  TileStore& store = *updater.store;
+  updater.stats = {};
+
+  // chunks not resident are not updated, they stay stale until they are loaded
+  uint32_t kept = 0;
+  for (uint32_t chunk : updater.staleChunks)
+  {
+    const TileChunk& stored = store.chunks[store.chunkSlots[chunk]];
+    if (stored.unloaded)
+    {
+      updater.staleChunks[kept++] = chunk;
+      continue;
+    }
+    const bool updatable = holdsUpdatableType(updater, stored);
+    updater.chunkStates[chunk] = updatable ? TILE_UPDATE_CHUNK_UPDATABLE : TILE_UPDATE_CHUNK_IDLE;
+
+    // stale chunks mostly come in increasing order, inserting them appends
+    std::vector<uint32_t>& list = updater.chunkList;
+    const auto entry = std::lower_bound(list.begin(), list.end(), chunk);
+    const bool listed = entry != list.end() && *entry == chunk;
+    if (updatable && !listed)
+      list.insert(entry, chunk);
+    else if (!updatable && listed)
+      list.erase(entry);
+  }
+  updater.staleChunks.resize(kept);
+
+  const std::vector<uint32_t>& list = updater.chunkList;
+  const uint32_t count = (uint32_t)list.size();
+  const double rate = updater.updatesPerTick / ((double)store.width * store.height);
+  for (TileUpdateThread& thread : updater.threads)
+    thread.picks.clear();
+  updater.pickThreads.resize(count);
+  updater.pickBegins.resize(count);
+  updater.pickEnds.resize(count);
+  std::vector<uint32_t> drawn(count);
+  runJobs(*updater.jobs, count,
+          [&](uint32_t index, uint32_t thread)
+          {
+            TileUpdateThread& picks = updater.threads[thread];
+            updater.pickThreads[index] = thread;
+            updater.pickBegins[index] = (uint32_t)picks.picks.size();
+            drawn[index] = drawTileUpdates(updater, list[index], rate, picks);
+            updater.pickEnds[index] = (uint32_t)picks.picks.size();
+          });
+
+  // batches in chunk order, whichever thread drew the chunk
+  for (uint32_t index = 0; index < count; index++)
+  {
+    const TileUpdateThread& thread = updater.threads[updater.pickThreads[index]];
+    for (uint32_t i = updater.pickBegins[index]; i < updater.pickEnds[index]; i++)
+    {
+      const TileUpdatePick& pick = thread.picks[i];
+      updater.handlers[pick.handler].batch.push_back({ pick.x, pick.y });
+    }
+    updater.stats.picks += drawn[index];
+  }
+  for (TileUpdateHandler& handler : updater.handlers)
+  {
+    if (handler.batch.empty())
+      continue;
+    updater.stats.updates += handler.batch.size();
+    if (handler.fn)
+      handler.fn(handler.userData, store, handler.type, handler.batch.data(),
+                 (uint32_t)handler.batch.size());
+    handler.batch.clear();
+  }
+
+  updater.stats.chunks = count;
+  updater.tick++;
+  updater.stats.nanoseconds = getSteadyNanoseconds() - start;
+  return updater.stats;
+}
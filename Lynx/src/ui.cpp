@@ -0,0 +1,326 @@
+#include <Lynx/ui.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// how many commands back a quad may be merged into
+constexpr const uint32_t UI_MERGE_WINDOW = 8;
+
+Ui createUi(const UiCreateInfo& createInfo, const SpriteBatch& batch)
+{
+  const VkDevice logicalDevice = createInfo.logicalDevice;
+
+  Ui ui;
+  ui.logicalDevice = logicalDevice;
+  ui.framesInFlight = createInfo.framesInFlight;
+  ui.whiteTexture = createInfo.whiteTexture;
+
+  // keeps segments 256 byte aligned, see createSpriteBatch
+  ui.maxQuads = (createInfo.maxQuads + 15) / 16 * 16;
+  ui.quadBuffer = createBuffer(
+    createInfo.physicalDevice, logicalDevice,
+    (VkDeviceSize)ui.maxQuads * sizeof(SpriteInstance) * ui.framesInFlight,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 };
+
+  VkDescriptorPoolCreateInfo poolCI{};
+  poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCI.maxSets = 1;
+  poolCI.poolSizeCount = 1;
+  poolCI.pPoolSizes = &poolSize;
+  if (vkCreateDescriptorPool(logicalDevice, &poolCI, nullptr, &ui.descriptorPool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create UI descriptor pool");
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = ui.descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &batch.instanceSetLayout;
+  if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &ui.quadSet) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate UI descriptor set");
+
+  VkDescriptorBufferInfo bufferInfo{ ui.quadBuffer.buffer, 0,
+                                     (VkDeviceSize)ui.maxQuads * sizeof(SpriteInstance) };
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = ui.quadSet;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+
+  ui.clipStack.reserve(16);
+  ui.quads.reserve(4096);
+  ui.quadCommands.reserve(4096);
+  ui.commands.reserve(256);
+
+  return ui;
+}
+
+void destroyUi(Ui& ui)
+{
+  vkDestroyDescriptorPool(ui.logicalDevice, ui.descriptorPool, nullptr);
+  destroyBuffer(ui.logicalDevice, ui.quadBuffer);
+
+  ui = {};
+}
+
+void uiBegin(Ui& ui, const UiInput& input, float width, float height)
+{
+  ui.input = input;
+  ui.width = width;
+  ui.height = height;
+
+  ui.clipStack.clear();
+  ui.clipStack.push_back({ 0, 0, (int32_t)std::ceil(width), (int32_t)std::ceil(height) });
+
+  ui.quads.clear();
+  ui.quadCommands.clear();
+  ui.commands.clear();
+}
+
+static bool sameCommandKey(const UiDrawCommand& command, uint32_t texture, const UiClipRect& clip)
+{
+  return command.texture == texture && command.clip.x == clip.x && command.clip.y == clip.y &&
+         command.clip.width == clip.width && command.clip.height == clip.height;
+}
+
+static bool overlaps(const float a[4], const float b[4])
+{
+  return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+// Assigns the quads appended since first to a draw command, or drops them if they are clipped
+// away entirely.
+static void commitQuads(Ui& ui, uint32_t texture, size_t first)
+{
+  const size_t last = ui.quads.size();
+  if (first == last)
+    return;
+
+  float bounds[4] = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+  for (size_t i = first; i < last; i++)
+  {
+    const SpriteInstance& quad = ui.quads[i];
+    bounds[0] = std::min(bounds[0], quad.position[0]);
+    bounds[1] = std::min(bounds[1], quad.position[1]);
+    bounds[2] = std::max(bounds[2], quad.position[0] + quad.size[0]);
+    bounds[3] = std::max(bounds[3], quad.position[1] + quad.size[1]);
+  }
+
+  const UiClipRect& clip = ui.clipStack.back();
+  const float clipBounds[4] = { (float)clip.x, (float)clip.y, (float)(clip.x + clip.width),
+                                (float)(clip.y + clip.height) };
+  if (!overlaps(bounds, clipBounds) || last > ui.maxQuads)
+  {
+    ui.quads.resize(first);
+    return;
+  }
+
+  // walk back over commands the new quads do not overlap, anything drawn before them can be
+  // reordered freely
+  uint32_t target = (uint32_t)ui.commands.size();
+  const uint32_t windowEnd =
+    ui.commands.size() > UI_MERGE_WINDOW ? (uint32_t)ui.commands.size() - UI_MERGE_WINDOW : 0;
+  for (uint32_t i = (uint32_t)ui.commands.size(); i-- > windowEnd;)
+  {
+    const UiDrawCommand& command = ui.commands[i];
+    if (sameCommandKey(command, texture, clip))
+    {
+      target = i;
+      break;
+    }
+    if (overlaps(command.bounds, bounds))
+      break;
+  }
+
+  if (target == ui.commands.size())
+  {
+    UiDrawCommand command{};
+    command.texture = texture;
+    command.clip = clip;
+    memcpy(command.bounds, bounds, sizeof(bounds));
+    ui.commands.push_back(command);
+  }
+  else
+  {
+    UiDrawCommand& command = ui.commands[target];
+    command.bounds[0] = std::min(command.bounds[0], bounds[0]);
+    command.bounds[1] = std::min(command.bounds[1], bounds[1]);
+    command.bounds[2] = std::max(command.bounds[2], bounds[2]);
+    command.bounds[3] = std::max(command.bounds[3], bounds[3]);
+  }
+
+  ui.commands[target].quadCount += (uint32_t)(last - first);
+  ui.quadCommands.resize(last, target);
+}
+
+void uiEnd(Ui& ui)
+{
+  // counting sort of the quads by command, stable so draw order within a command is kept
+  uint32_t offset = 0;
+  for (UiDrawCommand& command : ui.commands)
+  {
+    command.firstQuad = offset;
+    offset += command.quadCount;
+  }
+
+  ui.stream.resize(ui.quads.size());
+  for (UiDrawCommand& command : ui.commands)
+    command.quadCount = 0;
+  for (size_t i = 0; i < ui.quads.size(); i++)
+  {
+    UiDrawCommand& command = ui.commands[ui.quadCommands[i]];
+    ui.stream[command.firstQuad + command.quadCount++] = ui.quads[i];
+  }
+
+  ui.stats.quads = (uint32_t)ui.stream.size();
+  ui.stats.draws = (uint32_t)ui.commands.size();
+
+  const bool unchanged =
+    ui.segmentValid && ui.stream.size() == ui.uploadedStream.size() &&
+    ui.commands.size() == ui.uploadedCommands.size() &&
+    memcmp(ui.stream.data(), ui.uploadedStream.data(),
+           ui.stream.size() * sizeof(SpriteInstance)) == 0 &&
+    memcmp(ui.commands.data(), ui.uploadedCommands.data(),
+           ui.commands.size() * sizeof(UiDrawCommand)) == 0;
+  ui.stats.uploaded = !unchanged;
+  if (unchanged)
+    return;
+
+  // the segment of the previous upload may still be read by frames in flight, but the one after
+  // it was last used at least framesInFlight frames ago
+  ui.segment = ui.segmentValid ? (ui.segment + 1) % ui.framesInFlight : 0;
+  ui.segmentValid = true;
+
+  SpriteInstance* dst = (SpriteInstance*)ui.quadBuffer.mapped + (size_t)ui.segment * ui.maxQuads;
+  memcpy(dst, ui.stream.data(), ui.stream.size() * sizeof(SpriteInstance));
+
+  std::swap(ui.stream, ui.uploadedStream);
+  ui.uploadedCommands.assign(ui.commands.begin(), ui.commands.end());
+}
+
+void uiPushClip(Ui& ui, float x, float y, float width, float height)
+{
+  const UiClipRect& parent = ui.clipStack.back();
+
+  const int32_t x0 = std::max(parent.x, (int32_t)std::floor(x));
+  const int32_t y0 = std::max(parent.y, (int32_t)std::floor(y));
+  const int32_t x1 = std::min(parent.x + parent.width, (int32_t)std::ceil(x + width));
+  const int32_t y1 = std::min(parent.y + parent.height, (int32_t)std::ceil(y + height));
+
+  ui.clipStack.push_back({ x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0) });
+}
+
+void uiPopClip(Ui& ui)
+{
+  if (ui.clipStack.size() > 1)
+    ui.clipStack.pop_back();
+}
+
+void uiImage(Ui& ui, uint32_t texture, float x, float y, float width, float height,
+             const float uv[4], uint32_t color)
+{
+  const size_t first = ui.quads.size();
+
+  SpriteInstance& quad = ui.quads.emplace_back();
+  quad.position[0] = x;
+  quad.position[1] = y;
+  quad.size[0] = width;
+  quad.size[1] = height;
+  memcpy(quad.uv, uv, sizeof(quad.uv));
+  quad.color = color;
+  quad.flags = 0;
+  quad.padding[0] = quad.padding[1] = 0.0f;
+
+  commitQuads(ui, texture, first);
+}
+
+void uiRect(Ui& ui, float x, float y, float width, float height, uint32_t color)
+{
+  const float uv[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+  uiImage(ui, ui.whiteTexture, x, y, width, height, uv, color);
+}
+
+void uiText(Ui& ui, TextSystem& text, std::string_view string, float x, float y, float pixelSize,
+            uint32_t color)
+{
+  const TextLayout& layout = getTextLayout(text, string);
+
+  const size_t first = ui.quads.size();
+  ui.quads.resize(first + layout.glyphs.size());
+  writeTextSprites(text, layout, x, y, pixelSize, color, ui.quads.data() + first);
+
+  commitQuads(ui, text.spriteTexture, first);
+}
+
+bool uiHovered(const Ui& ui, float x, float y, float width, float height)
+{
+  const UiClipRect& clip = ui.clipStack.back();
+  const float mx = ui.input.mouseX;
+  const float my = ui.input.mouseY;
+
+  return mx >= x && mx < x + width && my >= y && my < y + height && mx >= clip.x &&
+         mx < clip.x + clip.width && my >= clip.y && my < clip.y + clip.height;
+}
+
+bool uiButton(Ui& ui, float x, float y, float width, float height, uint32_t color,
+              uint32_t hoverColor)
+{
+  const bool hovered = uiHovered(ui, x, y, width, height);
+  uiRect(ui, x, y, width, height, hovered ? hoverColor : color);
+
+  return hovered && ui.input.mousePressed;
+}
+
+void uiBar(Ui& ui, float x, float y, float width, float height, float fraction,
+           uint32_t backgroundColor, uint32_t fillColor)
+{
+  fraction = std::clamp(fraction, 0.0f, 1.0f);
+
+  uiRect(ui, x, y, width, height, backgroundColor);
+  if (fraction > 0.0f)
+    uiRect(ui, x, y, width * fraction, height, fillColor);
+}
+
+void recordUi(VkCommandBuffer commandBuffer, const Ui& ui, const SpriteBatch& batch)
+{
+  if (!ui.segmentValid || ui.uploadedCommands.empty())
+    return;
+
+  SpritePushConstants pc{ { 2.0f / ui.width, 2.0f / ui.height }, { -1.0f, -1.0f } };
+  const uint32_t dynamicOffset = ui.segment * ui.maxQuads * (uint32_t)sizeof(SpriteInstance);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipelineLayout, 0,
+                          1, &ui.quadSet, 1, &dynamicOffset);
+  vkCmdPushConstants(commandBuffer, batch.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     sizeof(pc), &pc);
+
+  uint32_t boundTexture = UINT32_MAX;
+  for (const UiDrawCommand& command : ui.uploadedCommands)
+  {
+    if (command.clip.width == 0 || command.clip.height == 0)
+      continue;
+
+    VkRect2D scissor{ { command.clip.x, command.clip.y },
+                      { (uint32_t)command.clip.width, (uint32_t)command.clip.height } };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    if (command.texture != boundTexture)
+    {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              batch.pipelineLayout, 1, 1, &batch.textureSets[command.texture], 0,
+                              nullptr);
+      boundTexture = command.texture;
+    }
+    vkCmdDraw(commandBuffer, 6, command.quadCount, 0, command.firstQuad);
+  }
+
+  VkRect2D scissor{ { 0, 0 }, { (uint32_t)std::ceil(ui.width), (uint32_t)std::ceil(ui.height) } };
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
@@ -0,0 +1,185 @@
+#include <Lynx/vk_utils.h>
+
+#include <stdexcept>
+#include <vector>
+
+uint32_t findMemoryType(const VkPhysicalDevice physicalDevice, uint32_t typeBits,
+                        VkMemoryPropertyFlags properties)
+{
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+  {
+    if ((typeBits & (1u << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+      return i;
+  }
+
+  throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+GpuBuffer createBuffer(const VkPhysicalDevice physicalDevice, const VkDevice logicalDevice,
+                       VkDeviceSize size, VkBufferUsageFlags usage,
+                       VkMemoryPropertyFlags properties)
+{
+  GpuBuffer buffer;
+  buffer.size = size;
+
+  VkBufferCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  ci.size = size;
+  ci.usage = usage;
+  ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(logicalDevice, &ci, nullptr, &buffer.buffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create buffer");
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(logicalDevice, buffer.buffer, &requirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex =
+    findMemoryType(physicalDevice, requirements.memoryTypeBits, properties);
+
+  if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &buffer.memory) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate buffer memory");
+
+  vkBindBufferMemory(logicalDevice, buffer.buffer, buffer.memory, 0);
+
+  if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    vkMapMemory(logicalDevice, buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped);
+
+  return buffer;
+}
+
+void destroyBuffer(const VkDevice logicalDevice, GpuBuffer& buffer)
+{
+  if (buffer.mapped)
+    vkUnmapMemory(logicalDevice, buffer.memory);
+
+  vkDestroyBuffer(logicalDevice, buffer.buffer, nullptr);
+  vkFreeMemory(logicalDevice, buffer.memory, nullptr);
+  buffer = {};
+}
+
+VkShaderModule createShaderModule(const VkDevice logicalDevice, const std::string& shaderByteCode)
+{
+  VkShaderModuleCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  ci.codeSize = shaderByteCode.size();
+
+  std::vector<char> vectorShaderByteCode(shaderByteCode.begin(), shaderByteCode.end());
+  ci.pCode = (const uint32_t*)vectorShaderByteCode.data();
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(logicalDevice, &ci, nullptr, &shaderModule) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create shader module!");
+
+  return shaderModule;
+}
+
+VkPipeline createComputePipeline(const VkDevice logicalDevice, VkShaderModule shaderModule,
+                                 VkPipelineLayout layout)
+{
+  VkComputePipelineCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  ci.stage.module = shaderModule;
+  ci.stage.pName = "main";
+  ci.layout = layout;
+
+  VkPipeline pipeline;
+  if (vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &ci, nullptr, &pipeline) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create compute pipeline!");
+
+  return pipeline;
+}
+
+VkPipeline buildGraphicsPipeline(const VkDevice logicalDevice, const GraphicsPipelineDesc& desc)
+{
+  VkPipelineShaderStageCreateInfo shaderStages[2]{};
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].module = desc.vertexShader;
+  shaderStages[0].pName = "main";
+  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[1].module = desc.fragmentShader;
+  shaderStages[1].pName = "main";
+
+  VkPipelineVertexInputStateCreateInfo emptyVertexInputCI{};
+  emptyVertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssemblyCI{};
+  inputAssemblyCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssemblyCI.topology = desc.topology;
+  inputAssemblyCI.primitiveRestartEnable = VK_FALSE;
+
+  VkPipelineViewportStateCreateInfo viewportStateCI{};
+  viewportStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportStateCI.viewportCount = 1;
+  viewportStateCI.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizerCI{};
+  rasterizerCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizerCI.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizerCI.lineWidth = 1.0f;
+  rasterizerCI.cullMode = VK_CULL_MODE_NONE;
+  rasterizerCI.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+  VkPipelineMultisampleStateCreateInfo multisamplingCI{};
+  multisamplingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisamplingCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisamplingCI.minSampleShading = 1.0f;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = desc.alphaBlend ? VK_TRUE : VK_FALSE;
+  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  colorBlendAttachment.dstColorBlendFactor =
+    desc.additiveBlend ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo colorBlendingCI{};
+  colorBlendingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlendingCI.logicOpEnable = VK_FALSE;
+  colorBlendingCI.attachmentCount = 1;
+  colorBlendingCI.pAttachments = &colorBlendAttachment;
+
+  VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+  VkPipelineDynamicStateCreateInfo dynamicStateCI{};
+  dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicStateCI.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
+  dynamicStateCI.pDynamicStates = dynamicStates;
+
+  VkGraphicsPipelineCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  ci.stageCount = 2;
+  ci.pStages = shaderStages;
+  ci.pVertexInputState = desc.vertexInput ? desc.vertexInput : &emptyVertexInputCI;
+  ci.pInputAssemblyState = &inputAssemblyCI;
+  ci.pViewportState = &viewportStateCI;
+  ci.pRasterizationState = &rasterizerCI;
+  ci.pMultisampleState = &multisamplingCI;
+  ci.pColorBlendState = &colorBlendingCI;
+  ci.pDynamicState = &dynamicStateCI;
+  ci.layout = desc.layout;
+  ci.renderPass = desc.renderPass;
+  ci.subpass = desc.subpass;
+
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &ci, nullptr, &pipeline) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create graphics pipeline!");
+
+  return pipeline;
+}
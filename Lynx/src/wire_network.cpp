@@ -0,0 +1,608 @@
+#include <Lynx/wire_network.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <numeric>
+
+constexpr const uint32_t WIRE_NO_COMPONENT = 0xffffffff;
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static void markWireChunkStale(WireNetwork& network, uint32_t chunk)
+{
+  if (network.chunks[chunk].stale)
+    return;
+  network.chunks[chunk].stale = true;
+  network.staleChunks.push_back(chunk);
+}
+
+static void onWireNetworkTilesChanged(void* userData, int32_t x0, int32_t y0, int32_t x1,
+                                      int32_t y1)
+{
+  WireNetwork& network = *(WireNetwork*)userData;
+  const TileStore& store = *network.store;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, store.width);
+  y1 = std::min(y1, store.height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  for (int32_t cy = y0 >> TILE_CHUNK_SHIFT; cy <= (y1 - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x0 >> TILE_CHUNK_SHIFT; cx <= (x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+      markWireChunkStale(network, (uint32_t)(cy * store.chunksX + cx));
+  }
+}
+
+static void markAllWireChunksStale(WireNetwork& network)
+{
+  for (uint32_t chunk = 0; chunk < (uint32_t)network.chunks.size(); chunk++)
+    markWireChunkStale(network, chunk);
+}
+
+void createWireNetwork(WireNetwork& network, TileStore& store, JobSystem& jobs)
+{
+  network.store = &store;
+  network.jobs = &jobs;
+  network.handlers.clear();
+  network.handlerIndices.assign(TILE_TYPE_COUNT, 0);
+  network.chunks.clear();
+  network.chunks.resize(store.chunks.size());
+  network.staleChunks.clear();
+  network.compileNeeded = true;
+  network.nets.clear();
+  network.netComponents.clear();
+  network.components.clear();
+  network.deadNets = 0;
+  network.deadComponents = 0;
+  network.deadNetComponents = 0;
+  network.triggers.clear();
+  network.netStamps.clear();
+  network.componentStamps.clear();
+  network.stamp = 0;
+  network.stats = {};
+  markAllWireChunksStale(network);
+  addTileChangeListener(store, onWireNetworkTilesChanged, &network);
+}
+
+void destroyWireNetwork(WireNetwork& network)
+{
+  if (network.store)
+    removeTileChangeListener(*network.store, onWireNetworkTilesChanged, &network);
+  network.store = nullptr;
+  network.handlers.clear();
+  network.chunks.clear();
+  network.staleChunks.clear();
+  network.nets.clear();
+  network.netComponents.clear();
+  network.components.clear();
+  network.triggers.clear();
+}
+
+void setWireHandler(WireNetwork& network, uint16_t type, WireHitFn fn, void* userData)
+{
+  uint32_t& index = network.handlerIndices[type];
+  if (!index)
+  {
+    network.handlers.push_back({ type, nullptr, nullptr, {} });
+    index = (uint32_t)network.handlers.size();
+    // tiles of type become components
+    markAllWireChunksStale(network);
+  }
+  network.handlers[index - 1].fn = fn;
+  network.handlers[index - 1].userData = userData;
+}
+
+void triggerWire(WireNetwork& network, int32_t x, int32_t y)
+{
+  if (isInTileStore(*network.store, x, y))
+    network.triggers.push_back({ x, y });
+}
+
+// Position of tile i in the tiles of chunk, -1 when it has no wire.
+static int32_t findWireTile(const WireChunk& chunk, uint32_t i)
+{
+  const auto it = std::lower_bound(chunk.tiles.begin(), chunk.tiles.end(), i,
+                                   [](const WireTile& tile, uint32_t index)
+                                   { return tile.index < index; });
+  if (it == chunk.tiles.end() || it->index != i)
+    return -1;
+  return (int32_t)(it - chunk.tiles.begin());
+}
+
+uint32_t getWireNet(const WireNetwork& network, int32_t x, int32_t y, uint32_t color)
+{
+  const TileStore& store = *network.store;
+  if (!isInTileStore(store, x, y) || color >= WIRE_COLOR_COUNT)
+    return WIRE_NO_NET;
+  const WireChunk& chunk =
+    network.chunks[(y >> TILE_CHUNK_SHIFT) * store.chunksX + (x >> TILE_CHUNK_SHIFT)];
+  const int32_t position = findWireTile(chunk, getTileIndexInChunk(x, y));
+  if (position < 0 || chunk.nets.size() != chunk.tiles.size() * WIRE_COLOR_COUNT)
+    return WIRE_NO_NET;
+  return chunk.nets[position * WIRE_COLOR_COUNT + color];
+}
+
+// Reads the wired tiles of chunk again. Returns whether they changed.
+static bool rescanWireChunk(WireNetwork& network, uint32_t chunk)
+{
+  const TileStore& store = *network.store;
+  const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+  const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+  std::vector<WireTile> tiles;
+  for (int32_t row = 0; row < TILE_CHUNK_SIZE; row++)
+  {
+    forEachTileRowView(store, y0 + row, x0, x0 + TILE_CHUNK_SIZE,
+                       [&](const TileRowView& view, int32_t x)
+                       {
+                         for (int32_t i = 0; i < view.count; i++)
+                         {
+                           const uint32_t attributes = view.attributes[i];
+                           const uint8_t wires =
+                             (uint8_t)((attributes >> TILE_WIRES_SHIFT) & TILE_WIRES_MASK);
+                           if (!wires)
+                             continue;
+                           const bool active = view.flags[i] & TILE_ACTIVE;
+                           WireTile tile;
+                           tile.index = (uint16_t)(row * TILE_CHUNK_SIZE + x - x0 + i);
+                           tile.wires = wires;
+                           tile.actuator = active && (attributes & TILE_ACTUATOR_BIT);
+                           tile.handler = active ? network.handlerIndices[view.types[i]] : 0;
+                           tiles.push_back(tile);
+                         }
+                       });
+  }
+
+  std::vector<WireTile>& old = network.chunks[chunk].tiles;
+  const bool changed =
+    tiles.size() != old.size() ||
+    !std::equal(tiles.begin(), tiles.end(), old.begin(),
+                [](const WireTile& a, const WireTile& b)
+                {
+                  return a.index == b.index && a.wires == b.wires && a.actuator == b.actuator &&
+                         a.handler == b.handler;
+                });
+  if (changed)
+    old = std::move(tiles);
+  return changed;
+}
+
+static uint32_t findWireRoot(std::vector<uint32_t>& parents, uint32_t node)
+{
+  while (parents[node] != node)
+  {
+    parents[node] = parents[parents[node]];
+    node = parents[node];
+  }
+  return node;
+}
+
+// Nets and components of every wired tile, in chunk order so the graph does not depend on the
+// order chunks were read in.
+static void compileWireNetwork(WireNetwork& network)
+{
+  const TileStore& store = *network.store;
+  const uint32_t chunkCount = (uint32_t)network.chunks.size();
+  std::vector<uint32_t> bases(chunkCount + 1, 0);
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+    bases[chunk + 1] = bases[chunk] + (uint32_t)network.chunks[chunk].tiles.size();
+
+  // a node per tile and color, joined with the node of the same color to the right and below
+  std::vector<uint32_t> parents(bases[chunkCount] * WIRE_COLOR_COUNT);
+  std::iota(parents.begin(), parents.end(), 0u);
+  const auto join = [&](uint32_t chunk, uint32_t position, int32_t x, int32_t y, uint8_t wires)
+  {
+    if (x >= store.width || y >= store.height)
+      return;
+    const uint32_t other = (uint32_t)((y >> TILE_CHUNK_SHIFT) * store.chunksX +
+                                      (x >> TILE_CHUNK_SHIFT));
+    const int32_t found = findWireTile(network.chunks[other], getTileIndexInChunk(x, y));
+    if (found < 0)
+      return;
+    const uint8_t shared = wires & network.chunks[other].tiles[found].wires;
+    for (uint32_t color = 0; color < WIRE_COLOR_COUNT; color++)
+    {
+      if (!(shared >> color & 1))
+        continue;
+      const uint32_t a =
+        findWireRoot(parents, (bases[chunk] + position) * WIRE_COLOR_COUNT + color);
+      const uint32_t b =
+        findWireRoot(parents, (bases[other] + (uint32_t)found) * WIRE_COLOR_COUNT + color);
+      parents[std::max(a, b)] = std::min(a, b);
+    }
+  };
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+  {
+    const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+    const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+    const std::vector<WireTile>& tiles = network.chunks[chunk].tiles;
+    for (uint32_t position = 0; position < (uint32_t)tiles.size(); position++)
+    {
+      const int32_t x = x0 + (tiles[position].index & TILE_CHUNK_MASK);
+      const int32_t y = y0 + (tiles[position].index >> TILE_CHUNK_SHIFT);
+      join(chunk, position, x + 1, y, tiles[position].wires);
+      join(chunk, position, x, y + 1, tiles[position].wires);
+    }
+  }
+
+  // roots become nets, wired tiles with a handler or an actuator components
+  std::vector<uint32_t> rootNets(parents.size(), WIRE_NO_NET);
+  std::vector<uint32_t> pairs;
+  network.nets.clear();
+  network.components.clear();
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+  {
+    WireChunk& wireChunk = network.chunks[chunk];
+    const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+    const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+    wireChunk.nets.assign(wireChunk.tiles.size() * WIRE_COLOR_COUNT, WIRE_NO_NET);
+    wireChunk.components.assign(wireChunk.tiles.size(), WIRE_NO_COMPONENT);
+    for (uint32_t position = 0; position < (uint32_t)wireChunk.tiles.size(); position++)
+    {
+      const WireTile& tile = wireChunk.tiles[position];
+      uint32_t component = WIRE_NO_COMPONENT;
+      if (tile.handler || tile.actuator)
+      {
+        component = (uint32_t)network.components.size();
+        network.components.push_back({ x0 + (tile.index & TILE_CHUNK_MASK),
+                                       y0 + (tile.index >> TILE_CHUNK_SHIFT), tile.handler,
+                                       tile.actuator != 0 });
+      }
+      wireChunk.components[position] = component;
+      for (uint32_t color = 0; color < WIRE_COLOR_COUNT; color++)
+      {
+        if (!(tile.wires >> color & 1))
+          continue;
+        const uint32_t root =
+          findWireRoot(parents, (bases[chunk] + position) * WIRE_COLOR_COUNT + color);
+        if (rootNets[root] == WIRE_NO_NET)
+        {
+          rootNets[root] = (uint32_t)network.nets.size();
+          network.nets.push_back({ 0, 0 });
+        }
+        const uint32_t net = rootNets[root];
+        wireChunk.nets[position * WIRE_COLOR_COUNT + color] = net;
+        if (component != WIRE_NO_COMPONENT)
+        {
+          network.nets[net].count++;
+          pairs.push_back(net);
+          pairs.push_back(component);
+        }
+      }
+    }
+  }
+
+  uint32_t first = 0;
+  for (WireNet& net : network.nets)
+  {
+    net.first = first;
+    first += net.count;
+    net.count = 0;
+  }
+  network.netComponents.resize(first);
+  for (size_t pair = 0; pair < pairs.size(); pair += 2)
+  {
+    WireNet& net = network.nets[pairs[pair]];
+    network.netComponents[net.first + net.count++] = pairs[pair + 1];
+  }
+  network.netStamps.assign(network.nets.size(), 0);
+  network.componentStamps.assign(network.components.size(), 0);
+  network.stamp = 0;
+  network.deadNets = 0;
+  network.deadComponents = 0;
+  network.deadNetComponents = 0;
+}
+
+// Wired tile of the chunk at (x, y), its position in the tiles of the chunk or -1.
+static int32_t findWireTileAt(const WireNetwork& network, int32_t x, int32_t y, uint32_t& chunk)
+{
+  const TileStore& store = *network.store;
+  if (!isInTileStore(store, x, y))
+    return -1;
+  chunk = (uint32_t)((y >> TILE_CHUNK_SHIFT) * store.chunksX + (x >> TILE_CHUNK_SHIFT));
+  return findWireTile(network.chunks[chunk], getTileIndexInChunk(x, y));
+}
+
+// Leaves net behind; its components stay in netComponents until the next full compile.
+static void killWireNet(WireNetwork& network, uint32_t net)
+{
+  WireNet& wireNet = network.nets[net];
+  if (wireNet.first == WIRE_NO_NET)
+    return;
+  network.deadNets++;
+  network.deadNetComponents += wireNet.count;
+  wireNet = { WIRE_NO_NET, 0 };
+}
+
+// Traces the nets reaching the changed chunks again. Their tiles get new components, and the
+// nets of their old tiles are replaced: every tile such a net keeps is reached from the changed
+// chunks or from a tile next to them that was on it, and nets that did not reach them keep
+// their numbers. The components of a traced net are in chunk order, as in a full compile.
+static void compileWireNetworkAround(WireNetwork& network, const std::vector<uint32_t>& changed)
+{
+  const TileStore& store = *network.store;
+  const uint32_t firstNet = (uint32_t)network.nets.size();
+  for (uint32_t chunk : changed)
+  {
+    WireChunk& wireChunk = network.chunks[chunk];
+    for (uint32_t net : wireChunk.nets)
+    {
+      if (net != WIRE_NO_NET)
+        killWireNet(network, net);
+    }
+    for (uint32_t component : wireChunk.components)
+      network.deadComponents += component != WIRE_NO_COMPONENT;
+
+    const int32_t x0 = (int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT;
+    const int32_t y0 = (int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT;
+    wireChunk.nets.assign(wireChunk.tiles.size() * WIRE_COLOR_COUNT, WIRE_NO_NET);
+    wireChunk.components.assign(wireChunk.tiles.size(), WIRE_NO_COMPONENT);
+    for (uint32_t position = 0; position < (uint32_t)wireChunk.tiles.size(); position++)
+    {
+      const WireTile& tile = wireChunk.tiles[position];
+      if (!tile.handler && !tile.actuator)
+        continue;
+      wireChunk.components[position] = (uint32_t)network.components.size();
+      network.components.push_back({ x0 + (tile.index & TILE_CHUNK_MASK),
+                                     y0 + (tile.index >> TILE_CHUNK_SHIFT), tile.handler,
+                                     tile.actuator != 0 });
+    }
+  }
+
+  // the tiles of the changed chunks, and the tiles next to them whose net was left behind
+  std::vector<uint32_t> seeds;
+  const auto addSeed = [&](uint32_t chunk, uint32_t position)
+  {
+    seeds.push_back(chunk);
+    seeds.push_back(position);
+  };
+  for (uint32_t chunk : changed)
+  {
+    for (uint32_t position = 0; position < (uint32_t)network.chunks[chunk].tiles.size();
+         position++)
+      addSeed(chunk, position);
+
+    const int32_t cx = (int32_t)(chunk % store.chunksX), cy = (int32_t)(chunk / store.chunksX);
+    const int32_t sides[4][4] = {
+      // neighbour dx, dy, and the column or row of it next to the chunk
+      { -1, 0, TILE_CHUNK_SIZE - 1, -1 },
+      { 1, 0, 0, -1 },
+      { 0, -1, -1, TILE_CHUNK_SIZE - 1 },
+      { 0, 1, -1, 0 },
+    };
+    for (const auto& side : sides)
+    {
+      const int32_t nx = cx + side[0], ny = cy + side[1];
+      if (nx < 0 || ny < 0 || nx >= store.chunksX || ny >= store.chunksY)
+        continue;
+      const uint32_t other = (uint32_t)(ny * store.chunksX + nx);
+      const WireChunk& otherChunk = network.chunks[other];
+      for (uint32_t position = 0; position < (uint32_t)otherChunk.tiles.size(); position++)
+      {
+        const uint32_t index = otherChunk.tiles[position].index;
+        if ((side[2] >= 0 && (int32_t)(index & TILE_CHUNK_MASK) != side[2]) ||
+            (side[3] >= 0 && (int32_t)(index >> TILE_CHUNK_SHIFT) != side[3]))
+          continue;
+        for (uint32_t color = 0; color < WIRE_COLOR_COUNT; color++)
+        {
+          const uint32_t net = otherChunk.nets[position * WIRE_COLOR_COUNT + color];
+          if (net != WIRE_NO_NET && net < firstNet && network.nets[net].first == WIRE_NO_NET)
+          {
+            addSeed(other, position);
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // flood each color from the seeds, every tile reached is on the new net of its seed
+  std::vector<std::array<uint32_t, 4>> members;
+  std::vector<uint32_t> pending;
+  const auto reach = [&](uint32_t chunk, uint32_t position, uint32_t color, uint32_t net)
+  {
+    WireChunk& wireChunk = network.chunks[chunk];
+    uint32_t& tileNet = wireChunk.nets[position * WIRE_COLOR_COUNT + color];
+    if (!(wireChunk.tiles[position].wires >> color & 1) ||
+        (tileNet != WIRE_NO_NET && tileNet >= firstNet))
+      return;
+    if (tileNet != WIRE_NO_NET)
+      killWireNet(network, tileNet);
+    tileNet = net;
+    if (wireChunk.components[position] != WIRE_NO_COMPONENT)
+      members.push_back({ net, chunk, position, wireChunk.components[position] });
+    pending.push_back(chunk);
+    pending.push_back(position);
+  };
+  for (size_t seed = 0; seed < seeds.size(); seed += 2)
+  {
+    for (uint32_t color = 0; color < WIRE_COLOR_COUNT; color++)
+    {
+      const uint32_t net = (uint32_t)network.nets.size();
+      reach(seeds[seed], seeds[seed + 1], color, net);
+      if (pending.empty())
+        continue;
+      network.nets.push_back({ 0, 0 });
+      while (!pending.empty())
+      {
+        const uint32_t position = pending.back();
+        pending.pop_back();
+        const uint32_t chunk = pending.back();
+        pending.pop_back();
+        const uint32_t index = network.chunks[chunk].tiles[position].index;
+        const int32_t x = ((int32_t)(chunk % store.chunksX) << TILE_CHUNK_SHIFT) +
+                          (int32_t)(index & TILE_CHUNK_MASK);
+        const int32_t y = ((int32_t)(chunk / store.chunksX) << TILE_CHUNK_SHIFT) +
+                          (int32_t)(index >> TILE_CHUNK_SHIFT);
+        const int32_t neighbours[4][2] = { { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } };
+        for (const auto& neighbour : neighbours)
+        {
+          uint32_t other = 0;
+          const int32_t found = findWireTileAt(network, neighbour[0], neighbour[1], other);
+          if (found >= 0)
+            reach(other, (uint32_t)found, color, net);
+        }
+      }
+    }
+  }
+
+  std::sort(members.begin(), members.end());
+  for (size_t i = 0; i < members.size(); i++)
+  {
+    WireNet& net = network.nets[members[i][0]];
+    if (!net.count)
+      net.first = (uint32_t)network.netComponents.size();
+    net.count++;
+    network.netComponents.push_back(members[i][3]);
+  }
+  network.netStamps.resize(network.nets.size(), 0);
+  network.componentStamps.resize(network.components.size(), 0);
+}
+
+// Reads stale chunks as jobs and compiles the graph around the ones whose wiring changed, in
+// full the first time, when many changed or when half of the graph was left behind. Unloaded
+// chunks stay stale until they are loaded.
+static void refreshWireNetwork(WireNetwork& network)
+{
+  const TileStore& store = *network.store;
+  std::vector<uint32_t> rescanned;
+  uint32_t kept = 0;
+  for (uint32_t chunk : network.staleChunks)
+  {
+    if (store.chunks[store.chunkSlots[chunk]].unloaded)
+      network.staleChunks[kept++] = chunk;
+    else
+      rescanned.push_back(chunk);
+  }
+  network.staleChunks.resize(kept);
+
+  std::vector<uint8_t> changes(rescanned.size(), 0);
+  runJobs(*network.jobs, (uint32_t)rescanned.size(), [&](uint32_t index, uint32_t)
+          { changes[index] = rescanWireChunk(network, rescanned[index]); });
+  std::vector<uint32_t> changed;
+  for (uint32_t index = 0; index < (uint32_t)rescanned.size(); index++)
+  {
+    network.chunks[rescanned[index]].stale = false;
+    if (changes[index])
+      changed.push_back(rescanned[index]);
+  }
+  network.stats.rescannedChunks = (uint32_t)rescanned.size();
+  network.stats.changedChunks = (uint32_t)changed.size();
+  if (!network.compileNeeded && changed.empty())
+    return;
+
+  const uint64_t start = getSteadyNanoseconds();
+  network.compileNeeded |= changed.size() * 4 > network.chunks.size();
+  if (!network.compileNeeded)
+  {
+    compileWireNetworkAround(network, changed);
+    network.compileNeeded = network.deadNets * 2 > network.nets.size() ||
+                            network.deadComponents * 2 > network.components.size() ||
+                            network.deadNetComponents * 2 > network.netComponents.size();
+  }
+  if (network.compileNeeded)
+  {
+    compileWireNetwork(network);
+    network.compileNeeded = false;
+    network.stats.compiled = true;
+  }
+  network.stats.compileNanoseconds = getSteadyNanoseconds() - start;
+}
+
+// Component at (x, y), WIRE_NO_COMPONENT for none.
+static uint32_t getWireComponent(const WireNetwork& network, int32_t x, int32_t y)
+{
+  const TileStore& store = *network.store;
+  const WireChunk& chunk =
+    network.chunks[(y >> TILE_CHUNK_SHIFT) * store.chunksX + (x >> TILE_CHUNK_SHIFT)];
+  const int32_t position = findWireTile(chunk, getTileIndexInChunk(x, y));
+  return position < 0 ? WIRE_NO_COMPONENT : chunk.components[position];
+}
+
+const WireNetworkStats& updateWireNetwork(WireNetwork& network)
+{
+  const uint64_t start = getSteadyNanoseconds();
+  TileStore& store = *network.store;
+  network.stats = {};
+  refreshWireNetwork(network);
+  network.stats.nets = (uint32_t)network.nets.size() - network.deadNets;
+  network.stats.components = (uint32_t)network.components.size() - network.deadComponents;
+
+  // signals sent while this tick runs wait for the next one
+  std::vector<WireHit> triggers;
+  triggers.swap(network.triggers);
+  network.stats.triggers = (uint32_t)triggers.size();
+  if (triggers.empty())
+  {
+    network.stats.nanoseconds = getSteadyNanoseconds() - start;
+    return network.stats;
+  }
+  if (++network.stamp == 0)
+  {
+    std::fill(network.netStamps.begin(), network.netStamps.end(), 0u);
+    std::fill(network.componentStamps.begin(), network.componentStamps.end(), 0u);
+    network.stamp = 1;
+  }
+  const uint32_t stamp = network.stamp;
+
+  // the tiles that triggered are not hit by their own signals
+  for (const WireHit& trigger : triggers)
+  {
+    const uint32_t component = getWireComponent(network, trigger.x, trigger.y);
+    if (component != WIRE_NO_COMPONENT)
+      network.componentStamps[component] = stamp;
+  }
+
+  std::vector<WireHit> actuators;
+  for (const WireHit& trigger : triggers)
+  {
+    for (uint32_t color = 0; color < WIRE_COLOR_COUNT; color++)
+    {
+      const uint32_t net = getWireNet(network, trigger.x, trigger.y, color);
+      if (net == WIRE_NO_NET || network.netStamps[net] == stamp)
+        continue;
+      network.netStamps[net] = stamp;
+      network.stats.signalledNets++;
+      const WireNet& wireNet = network.nets[net];
+      for (uint32_t i = wireNet.first; i < wireNet.first + wireNet.count; i++)
+      {
+        const uint32_t component = network.netComponents[i];
+        if (network.componentStamps[component] == stamp)
+          continue;
+        network.componentStamps[component] = stamp;
+        network.stats.hits++;
+        const WireComponent& hit = network.components[component];
+        if (hit.handler)
+          network.handlers[hit.handler - 1].batch.push_back({ hit.x, hit.y });
+        if (hit.actuator)
+          actuators.push_back({ hit.x, hit.y });
+      }
+    }
+  }
+
+  for (const WireHit& hit : actuators)
+  {
+    TileChunkRaw& raw = getWritableTileChunk(store, getTileChunkSlot(store, hit.x, hit.y));
+    raw.hot.flags[getTileIndexInChunk(hit.x, hit.y)] ^= TILE_ACTUATED;
+    notifyTilesChanged(store, hit.x, hit.y, hit.x + 1, hit.y + 1);
+  }
+  for (WireHandler& handler : network.handlers)
+  {
+    if (handler.batch.empty())
+      continue;
+    if (handler.fn)
+      handler.fn(handler.userData, store, handler.type, handler.batch.data(),
+                 (uint32_t)handler.batch.size());
+    handler.batch.clear();
+  }
+
+  network.stats.nanoseconds = getSteadyNanoseconds() - start;
+  return network.stats;
+}
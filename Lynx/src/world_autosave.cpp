@@ -0,0 +1,164 @@
+#include <Lynx/world_autosave.h>
+
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static void saveWorldSnapshot(WorldAutosave* autosave)
+{
+  const TileStore& store = *autosave->store;
+  const uint32_t chunkCount = (uint32_t)store.chunks.size();
+
+  std::vector<uint8_t> blob;
+  bool failed = false;
+  try
+  {
+    beginWorldFileWriter(autosave->writer, store.width, store.height, autosave->info);
+  }
+  catch (const std::exception& e)
+  {
+    autosave->error = e.what();
+    failed = true;
+  }
+
+  for (uint32_t slot = 0; slot < chunkCount; slot++)
+  {
+    // every chunk has to be read even after a failure, the snapshot only ends once they all were
+    readTileSnapshotChunk(store, autosave->snapshot, slot,
+                          [&](const TileChunk& chunk) { serializeWorldChunk(chunk, blob); });
+    if (failed)
+      continue;
+
+    try
+    {
+      writeWorldChunk(autosave->writer, slot, blob);
+    }
+    catch (const std::exception& e)
+    {
+      autosave->error = e.what();
+      failed = true;
+    }
+  }
+
+  if (!failed)
+  {
+    try
+    {
+      finishWorldFileWriter(autosave->writer, autosave->path);
+    }
+    catch (const std::exception& e)
+    {
+      autosave->error = e.what();
+    }
+  }
+
+  // the file can be as large as the world, no reason to hold on to it between saves
+  autosave->writer.out.clear();
+  autosave->writer.out.shrink_to_fit();
+}
+
+static void runWorldAutosave(WorldAutosave* autosave)
+{
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(autosave->mutex);
+      autosave->condition.wait(lock, [&] { return autosave->quit || autosave->requested; });
+      if (!autosave->requested)
+        return;
+      autosave->requested = false;
+    }
+
+    saveWorldSnapshot(autosave);
+
+    std::lock_guard<std::mutex> lock(autosave->mutex);
+    autosave->finished = true;
+  }
+}
+
+void createWorldAutosave(WorldAutosave& autosave, TileStore& store, const std::string& path)
+{
+  autosave.path = path;
+  autosave.store = &store;
+  // allocated up front so beginning a snapshot never has to
+  autosave.snapshot.copies.resize(store.chunks.size());
+  autosave.worker = std::thread(runWorldAutosave, &autosave);
+}
+
+void destroyWorldAutosave(WorldAutosave& autosave)
+{
+  // a requested save is still carried out so the snapshot can end
+  {
+    std::lock_guard<std::mutex> lock(autosave.mutex);
+    autosave.quit = true;
+  }
+  autosave.condition.notify_one();
+  if (autosave.worker.joinable())
+    autosave.worker.join();
+
+  updateWorldAutosave(autosave);
+  destroyWorldFileWriter(autosave.writer);
+  autosave.snapshot.copies.clear();
+}
+
+bool beginWorldAutosave(WorldAutosave& autosave, WorldFileSaveInfo&& info)
+{
+  if (autosave.saving)
+    return false;
+
+  const uint64_t start = getSteadyNanoseconds();
+  if (!beginTileSnapshot(*autosave.store, autosave.snapshot))
+    return false;
+
+  autosave.info = std::move(info);
+  autosave.error.clear();
+  autosave.saving = true;
+  autosave.saveStart = start;
+  {
+    std::lock_guard<std::mutex> lock(autosave.mutex);
+    autosave.requested = true;
+    autosave.finished = false;
+  }
+  autosave.condition.notify_one();
+
+  autosave.stats.pauseNanoseconds = getSteadyNanoseconds() - start;
+  return true;
+}
+
+bool updateWorldAutosave(WorldAutosave& autosave)
+{
+  if (!autosave.saving)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(autosave.mutex);
+    if (!autosave.finished)
+      return false;
+  }
+
+  endTileSnapshot(*autosave.store, autosave.snapshot);
+  autosave.saving = false;
+
+  autosave.stats.saveNanoseconds = getSteadyNanoseconds() - autosave.saveStart;
+  autosave.stats.copiedChunks = autosave.snapshot.copiedChunks;
+  if (autosave.error.empty())
+  {
+    autosave.stats.bytesWritten = autosave.writer.bytesWritten;
+    autosave.stats.saves++;
+  }
+  else
+    autosave.stats.failures++;
+  return true;
+}
+
+bool isWorldAutosaveInProgress(const WorldAutosave& autosave)
+{
+  return autosave.saving;
+}
@@ -0,0 +1,359 @@
+#include <Lynx/world_backup.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <xxHash/xxhash.h>
+
+struct WorldBackupObject
+{
+  WorldBackupObjectHeader header;
+  std::vector<uint8_t> stored;
+};
+
+struct WorldBackupManifest
+{
+  WorldBackupManifestHeader header;
+  std::vector<WorldBackupHash> chunks;
+};
+
+static WorldBackupHash hashWorldBackupObject(const WorldBackupObjectHeader& header,
+                                             const uint8_t* stored)
+{
+  // two independent 64 bit hashes, the header goes into the seeds
+  const uint64_t key = header.codec | (uint64_t)header.format << 8 | (uint64_t)header.size << 32;
+  WorldBackupHash hash;
+  hash.low = XXH64(stored, header.storedSize, key);
+  hash.high = XXH64(stored, header.storedSize, key ^ 0x9e3779b97f4a7c15ull);
+  return hash;
+}
+
+static std::string formatWorldBackupHash(const WorldBackupHash& hash)
+{
+  char text[33];
+  snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)hash.high,
+           (unsigned long long)hash.low);
+  return text;
+}
+
+static bool parseWorldBackupHash(const std::string& text, WorldBackupHash& hash)
+{
+  if (text.size() != 32 || text.find_first_not_of("0123456789abcdef") != std::string::npos)
+    return false;
+  hash.high = std::stoull(text.substr(0, 16), nullptr, 16);
+  hash.low = std::stoull(text.substr(16), nullptr, 16);
+  return true;
+}
+
+static std::filesystem::path getWorldBackupObjectPath(const WorldBackupStore& store,
+                                                      const WorldBackupHash& hash)
+{
+  const std::string name = formatWorldBackupHash(hash);
+  return std::filesystem::path(store.root) / "objects" / name.substr(0, 2) / name;
+}
+
+static std::filesystem::path getWorldBackupManifestPath(const WorldBackupStore& store,
+                                                        const std::string& name)
+{
+  if (name.empty() || name.find_first_of("/\\:") != std::string::npos || name[0] == '.')
+    throw std::runtime_error("getWorldBackupManifestPath: invalid backup name " + name);
+  return std::filesystem::path(store.root) / "manifests" / name;
+}
+
+// Synced before it is renamed into place, so an object or manifest present after a crash is
+// complete and later backups can share it.
+static void writeWorldBackupFile(const std::filesystem::path& path, const void* header,
+                                 size_t headerSize, const void* data, size_t size)
+{
+  writeSyncedFile(path.string(), header, headerSize, data, size);
+}
+
+static std::vector<uint8_t> readWorldBackupFile(const std::filesystem::path& path)
+{
+  std::vector<uint8_t> data;
+  FILE* file = fopen(path.string().c_str(), "rb");
+  if (!file)
+    throw std::runtime_error("readWorldBackupFile: failed to open " + path.string());
+
+  uint8_t buffer[1 << 16];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + read);
+  fclose(file);
+  return data;
+}
+
+static WorldBackupObject readWorldBackupObject(const WorldBackupStore& store,
+                                               const WorldBackupHash& hash)
+{
+  const std::vector<uint8_t> data = readWorldBackupFile(getWorldBackupObjectPath(store, hash));
+
+  WorldBackupObject object;
+  if (data.size() < sizeof(object.header))
+    throw std::runtime_error("readWorldBackupObject: truncated object");
+  memcpy(&object.header, data.data(), sizeof(object.header));
+  object.stored.assign(data.begin() + sizeof(object.header), data.end());
+
+  if (object.stored.size() != object.header.storedSize ||
+      !(hashWorldBackupObject(object.header, object.stored.data()) == hash))
+    throw std::runtime_error("readWorldBackupObject: corrupted object " +
+                             formatWorldBackupHash(hash));
+  return object;
+}
+
+static WorldBackupManifest readWorldBackupManifest(const std::filesystem::path& path)
+{
+  const std::vector<uint8_t> data = readWorldBackupFile(path);
+
+  WorldBackupManifest manifest;
+  if (data.size() < sizeof(manifest.header))
+    throw std::runtime_error("readWorldBackupManifest: truncated manifest");
+  memcpy(&manifest.header, data.data(), sizeof(manifest.header));
+  if (memcmp(manifest.header.magic, WORLD_BACKUP_MAGIC, sizeof(manifest.header.magic)) != 0 ||
+      manifest.header.version != WORLD_BACKUP_VERSION ||
+      data.size() !=
+        sizeof(manifest.header) + manifest.header.chunkCount * sizeof(WorldBackupHash))
+    throw std::runtime_error("readWorldBackupManifest: invalid manifest " + path.string());
+
+  manifest.chunks.resize(manifest.header.chunkCount);
+  memcpy(manifest.chunks.data(), data.data() + sizeof(manifest.header),
+         manifest.chunks.size() * sizeof(WorldBackupHash));
+  return manifest;
+}
+
+// Adds the object unless the store has it already. Returns the bytes written.
+static uint64_t addWorldBackupObject(WorldBackupStore& store, const WorldBackupObjectHeader& header,
+                                     const uint8_t* stored, WorldBackupHash& hash)
+{
+  hash = hashWorldBackupObject(header, stored);
+  if (store.objects.count(hash))
+    return 0;
+
+  writeWorldBackupFile(getWorldBackupObjectPath(store, hash), &header, sizeof(header), stored,
+                       header.storedSize);
+  store.objects.insert(hash);
+  return sizeof(header) + header.storedSize;
+}
+
+WorldBackupStore openWorldBackupStore(const std::string& root)
+{
+  WorldBackupStore store;
+  store.root = root;
+
+  const std::filesystem::path objects = std::filesystem::path(root) / "objects";
+  std::filesystem::create_directories(std::filesystem::path(root) / "manifests");
+  for (uint32_t prefix = 0; prefix < 256; prefix++)
+  {
+    char name[3];
+    snprintf(name, sizeof(name), "%02x", prefix);
+    std::filesystem::create_directories(objects / name);
+  }
+  // the directories are on disk before anything is renamed into them
+  syncDirectory(objects.string());
+  syncDirectory(root);
+
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(objects))
+  {
+    WorldBackupHash hash;
+    if (entry.is_regular_file() && parseWorldBackupHash(entry.path().filename().string(), hash))
+      store.objects.insert(hash);
+  }
+
+  return store;
+}
+
+WorldBackupStats backupWorldFile(WorldBackupStore& store, const std::string& worldPath,
+                                 const std::string& name)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const std::filesystem::path manifestPath = getWorldBackupManifestPath(store, name);
+
+  WorldBackupStats stats{};
+  WorldFile file = openWorldFile(worldPath);
+  WorldBackupManifest manifest;
+  try
+  {
+    const uint32_t chunkCount = (uint32_t)(file.header->chunksX * file.header->chunksY);
+
+    manifest.header = {};
+    memcpy(manifest.header.magic, WORLD_BACKUP_MAGIC, sizeof(manifest.header.magic));
+    manifest.header.version = WORLD_BACKUP_VERSION;
+    manifest.header.width = file.header->width;
+    manifest.header.height = file.header->height;
+    manifest.header.chunkCount = chunkCount;
+    manifest.header.createdTime = (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(
+                                    std::chrono::system_clock::now().time_since_epoch())
+                                    .count();
+
+    std::vector<uint8_t> saveInfo;
+    serializeWorldFileSaveInfo(readWorldFileSaveInfo(file), saveInfo);
+    WorldBackupObjectHeader header{};
+    header.codec = WORLD_CODEC_NONE;
+    header.format = WORLD_BACKUP_SAVE_INFO;
+    header.size = (uint32_t)saveInfo.size();
+    header.storedSize = header.size;
+    stats.bytesWritten +=
+      addWorldBackupObject(store, header, saveInfo.data(), manifest.header.saveInfo);
+    stats.bytesReferenced += sizeof(header) + header.storedSize;
+
+    manifest.chunks.resize(chunkCount);
+    for (uint32_t slot = 0; slot < chunkCount; slot++)
+    {
+      const WorldChunkEntry& entry = file.chunks[slot];
+      header.codec = entry.codec;
+      header.format = entry.format;
+      header.size = entry.size;
+      header.storedSize = entry.storedSize;
+
+      const uint64_t written = addWorldBackupObject(store, header, getStoredWorldChunk(file, slot),
+                                                    manifest.chunks[slot]);
+      stats.bytesWritten += written;
+      stats.newObjects += written > 0;
+      stats.bytesReferenced += sizeof(header) + header.storedSize;
+    }
+    stats.chunks = chunkCount;
+  }
+  catch (...)
+  {
+    closeWorldFile(file);
+    throw;
+  }
+  closeWorldFile(file);
+
+  // objects first, so a manifest never refers to an object that is not on disk
+  writeWorldBackupFile(manifestPath, &manifest.header, sizeof(manifest.header),
+                       manifest.chunks.data(), manifest.chunks.size() * sizeof(WorldBackupHash));
+  stats.bytesWritten += sizeof(manifest.header) + manifest.chunks.size() * sizeof(WorldBackupHash);
+
+  stats.nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  return stats;
+}
+
+std::vector<std::string> listWorldBackups(const WorldBackupStore& store)
+{
+  std::vector<std::pair<uint64_t, std::string>> backups;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(std::filesystem::path(store.root) / "manifests"))
+  {
+    if (!entry.is_regular_file() || entry.path().extension() == ".tmp")
+      continue;
+    backups.push_back({ readWorldBackupManifest(entry.path()).header.createdTime,
+                        entry.path().filename().string() });
+  }
+
+  std::sort(backups.begin(), backups.end());
+  std::vector<std::string> names;
+  for (const auto& backup : backups)
+    names.push_back(backup.second);
+  return names;
+}
+
+void restoreWorldBackup(const WorldBackupStore& store, const std::string& name,
+                        const std::string& worldPath)
+{
+  const WorldBackupManifest manifest =
+    readWorldBackupManifest(getWorldBackupManifestPath(store, name));
+
+  const WorldBackupObject saveInfoObject = readWorldBackupObject(store, manifest.header.saveInfo);
+  WorldFileSaveInfo info;
+  if (saveInfoObject.header.format != WORLD_BACKUP_SAVE_INFO ||
+      !deserializeWorldFileSaveInfo(saveInfoObject.stored.data(),
+                                    saveInfoObject.stored.data() + saveInfoObject.stored.size(),
+                                    info))
+    throw std::runtime_error("restoreWorldBackup: corrupted side tables");
+
+  WorldFileWriter writer;
+  try
+  {
+    beginWorldFileWriter(writer, manifest.header.width, manifest.header.height, info);
+    if (writer.directory.size() != manifest.chunks.size())
+      throw std::runtime_error("restoreWorldBackup: manifest does not match the world size");
+
+    // most chunks of a world are a few shared uniform ones, each object is read once
+    std::unordered_map<WorldBackupHash, WorldBackupObject, WorldBackupHashHasher> objects;
+    for (uint32_t slot = 0; slot < manifest.chunks.size(); slot++)
+    {
+      auto it = objects.find(manifest.chunks[slot]);
+      if (it == objects.end())
+        it = objects
+               .emplace(manifest.chunks[slot], readWorldBackupObject(store, manifest.chunks[slot]))
+               .first;
+
+      const WorldBackupObject& object = it->second;
+      WorldChunkEntry entry{};
+      entry.codec = object.header.codec;
+      entry.format = object.header.format;
+      entry.size = object.header.size;
+      entry.storedSize = object.header.storedSize;
+      writeStoredWorldChunk(writer, slot, entry, object.stored.data());
+
+      // unique chunks are not needed again
+      if (object.header.format != TILE_CHUNK_UNIFORM)
+        objects.erase(it);
+    }
+
+    finishWorldFileWriter(writer, worldPath);
+  }
+  catch (...)
+  {
+    destroyWorldFileWriter(writer);
+    throw;
+  }
+  destroyWorldFileWriter(writer);
+}
+
+void deleteWorldBackup(WorldBackupStore& store, const std::string& name)
+{
+  std::filesystem::remove(getWorldBackupManifestPath(store, name));
+}
+
+WorldBackupCollectStats collectWorldBackupGarbage(WorldBackupStore& store)
+{
+  WorldBackupCollectStats stats{};
+
+  std::unordered_set<WorldBackupHash, WorldBackupHashHasher> referenced;
+  for (const std::string& name : listWorldBackups(store))
+  {
+    const WorldBackupManifest manifest =
+      readWorldBackupManifest(getWorldBackupManifestPath(store, name));
+    referenced.insert(manifest.header.saveInfo);
+    referenced.insert(manifest.chunks.begin(), manifest.chunks.end());
+    stats.manifests++;
+  }
+
+  std::vector<std::filesystem::path> garbage;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(std::filesystem::path(store.root) / "objects"))
+  {
+    if (!entry.is_regular_file())
+      continue;
+
+    // leftovers of interrupted writes are garbage too
+    WorldBackupHash hash;
+    if (parseWorldBackupHash(entry.path().filename().string(), hash) && referenced.count(hash))
+    {
+      stats.objectsKept++;
+      continue;
+    }
+    garbage.push_back(entry.path());
+    stats.bytesRemoved += entry.file_size();
+  }
+
+  for (const std::filesystem::path& path : garbage)
+  {
+    WorldBackupHash hash;
+    if (parseWorldBackupHash(path.filename().string(), hash))
+      store.objects.erase(hash);
+    std::filesystem::remove(path);
+    stats.objectsRemoved++;
+  }
+
+  return stats;
+}
@@ -0,0 +1,288 @@
+#include <Lynx/world_carve.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+struct CarveTileRange
+{
+  int32_t x0, y0, x1, y1;
+};
+
+// Tiles whose centers may be inside the stroke, [x0, x1] x [y0, y1].
+static CarveTileRange getCarveStrokeTiles(const CarveStroke& stroke)
+{
+  const float r = std::max(stroke.radius, 0.0f);
+  return { (int32_t)std::ceil(std::min(stroke.x0, stroke.x1) - r - 0.5f),
+           (int32_t)std::ceil(std::min(stroke.y0, stroke.y1) - r - 0.5f),
+           (int32_t)std::floor(std::max(stroke.x0, stroke.x1) + r - 0.5f),
+           (int32_t)std::floor(std::max(stroke.y0, stroke.y1) + r - 0.5f) };
+}
+
+// Narrows [min, max] to the x with c * x + k in [lo, hi].
+static bool intersectCarveLinear(float c, float k, float lo, float hi, float& min, float& max)
+{
+  if (c == 0.0f)
+    return k >= lo && k <= hi;
+  float a = (lo - k) / c, b = (hi - k) / c;
+  if (a > b)
+    std::swap(a, b);
+  min = std::max(min, a);
+  max = std::min(max, b);
+  return min <= max;
+}
+
+static bool getCarveDiscSpan(float cx, float cy, float r, float py, float& min, float& max)
+{
+  const float dy = py - cy;
+  if (dy * dy > r * r)
+    return false;
+  const float h = std::sqrt(r * r - dy * dy);
+  min = cx - h;
+  max = cx + h;
+  return true;
+}
+
+// Part of the row at py inside the stroke. Shapes are convex, so it is one interval; a capsule
+// is the union of its end discs and the band between them, which overlap.
+static bool getCarveStrokeSpan(const CarveStroke& stroke, float py, float& min, float& max)
+{
+  const float r = stroke.radius;
+  bool found = getCarveDiscSpan(stroke.x0, stroke.y0, r, py, min, max);
+  if (stroke.shape == CARVE_DISC)
+    return found;
+
+  float a, b;
+  if (getCarveDiscSpan(stroke.x1, stroke.y1, r, py, a, b))
+  {
+    min = found ? std::min(min, a) : a;
+    max = found ? std::max(max, b) : b;
+    found = true;
+  }
+
+  const float dx = stroke.x1 - stroke.x0, dy = stroke.y1 - stroke.y0;
+  const float length2 = dx * dx + dy * dy;
+  if (length2 <= 0.0f)
+    return found;
+
+  // along the segment within [0, length2], across it within the radius
+  const float ry = py - stroke.y0;
+  const float across = r * std::sqrt(length2);
+  a = -INFINITY;
+  b = INFINITY;
+  if (intersectCarveLinear(dx, -stroke.x0 * dx + ry * dy, 0.0f, length2, a, b) &&
+      intersectCarveLinear(dy, -stroke.x0 * dy - ry * dx, -across, across, a, b))
+  {
+    min = found ? std::min(min, a) : a;
+    max = found ? std::max(max, b) : b;
+    found = true;
+  }
+  return found;
+}
+
+static void applyCarveRow(const WorldGenContext& context, const CarveStroke& stroke, int32_t y,
+                          int32_t x0, int32_t x1)
+{
+  const uint8_t typeFlags = context.store->typeFlags[stroke.type];
+  for (int32_t x = x0; x <= x1;)
+  {
+    TileChunkRaw& raw = getWorldGenChunk(context, x, y);
+    const int32_t end = std::min(x1 + 1, (x | TILE_CHUNK_MASK) + 1);
+    const uint32_t first = getTileIndexInChunk(x, y);
+    const uint32_t last = first + (uint32_t)(end - x);
+    uint16_t* types = raw.hot.types;
+    uint8_t* flags = raw.hot.flags;
+    switch (stroke.op)
+    {
+    case CARVE_REMOVE:
+      for (uint32_t i = first; i < last; i++)
+      {
+        types[i] = 0;
+        flags[i] &= ~(TILE_ACTIVE | TILE_TYPE_FLAGS);
+      }
+      break;
+    case CARVE_FILL:
+      for (uint32_t i = first; i < last; i++)
+      {
+        types[i] = stroke.type;
+        flags[i] = (flags[i] & ~TILE_TYPE_FLAGS) | TILE_ACTIVE | typeFlags;
+      }
+      break;
+    case CARVE_REPLACE:
+      for (uint32_t i = first; i < last; i++)
+      {
+        if (!(flags[i] & TILE_ACTIVE))
+          continue;
+        types[i] = stroke.type;
+        flags[i] = (flags[i] & ~TILE_TYPE_FLAGS) | typeFlags;
+      }
+      break;
+    }
+    x = end;
+  }
+}
+
+// Applies the strokes of bin clipped to [x0, x1) x [y0, y1).
+static void applyCarveBin(const WorldGenContext& context, const WorldCarve& carve,
+                          const std::vector<uint32_t>& bin, int32_t x0, int32_t y0, int32_t x1,
+                          int32_t y1)
+{
+  for (uint32_t s : bin)
+  {
+    const CarveStroke& stroke = carve.strokes[s];
+    const CarveTileRange tiles = getCarveStrokeTiles(stroke);
+    const int32_t rowStart = std::max(tiles.y0, y0), rowEnd = std::min(tiles.y1, y1 - 1);
+    for (int32_t y = rowStart; y <= rowEnd; y++)
+    {
+      float min, max;
+      if (!getCarveStrokeSpan(stroke, (float)y + 0.5f, min, max))
+        continue;
+      // the span does not depend on the region, so every region cuts the same tiles
+      const int32_t first = std::max((int32_t)std::ceil(min - 0.5f), x0);
+      const int32_t last = std::min((int32_t)std::floor(max - 0.5f), x1 - 1);
+      if (first <= last)
+        applyCarveRow(context, stroke, y, first, last);
+    }
+  }
+}
+
+void addCarveWalk(WorldCarve& carve, const CarveWalk& walk, RandomStream& random)
+{
+  float x = walk.x, y = walk.y;
+  float dx = walk.directionX, dy = walk.directionY;
+  float length = std::sqrt(dx * dx + dy * dy);
+  if (length <= 0.0f)
+  {
+    dx = 0.0f;
+    dy = 1.0f;
+    length = 1.0f;
+  }
+  dx *= walk.speed / length;
+  dy *= walk.speed / length;
+
+  for (int32_t step = 0; step < walk.steps; step++)
+  {
+    const float radius = walk.radius * (float)(walk.steps - step) / (float)walk.steps;
+    if (radius < 0.5f)
+      break;
+
+    const float ndx = dx + (nextRandomFloat(random) * 2.0f - 1.0f) * walk.drift;
+    const float ndy = dy + (nextRandomFloat(random) * 2.0f - 1.0f) * walk.drift;
+    length = std::sqrt(ndx * ndx + ndy * ndy);
+    if (length > 0.0f)
+    {
+      dx = ndx * walk.speed / length;
+      dy = ndy * walk.speed / length;
+    }
+
+    addCarveSegment(carve, walk.op, walk.type, x, y, x + dx, y + dy, radius);
+    x += dx;
+    y += dy;
+  }
+}
+
+void binWorldCarve(WorldCarve& carve, const TileStore& store, int32_t regionSize)
+{
+  if (regionSize <= 0)
+    throw std::runtime_error("binWorldCarve: region size must be positive");
+
+  carve.regionSize = (regionSize + TILE_CHUNK_MASK) & ~TILE_CHUNK_MASK;
+  carve.regionsX = (store.width + carve.regionSize - 1) / carve.regionSize;
+  carve.regionsY = (store.height + carve.regionSize - 1) / carve.regionSize;
+  carve.bins.assign((size_t)carve.regionsX * carve.regionsY, {});
+  carve.x0 = store.width;
+  carve.y0 = store.height;
+  carve.x1 = 0;
+  carve.y1 = 0;
+
+  for (uint32_t s = 0; s < (uint32_t)carve.strokes.size(); s++)
+  {
+    CarveTileRange tiles = getCarveStrokeTiles(carve.strokes[s]);
+    tiles.x0 = std::max(tiles.x0, 0);
+    tiles.y0 = std::max(tiles.y0, 0);
+    tiles.x1 = std::min(tiles.x1, store.width - 1);
+    tiles.y1 = std::min(tiles.y1, store.height - 1);
+    if (tiles.x1 < tiles.x0 || tiles.y1 < tiles.y0)
+      continue;
+
+    carve.x0 = std::min(carve.x0, tiles.x0);
+    carve.y0 = std::min(carve.y0, tiles.y0);
+    carve.x1 = std::max(carve.x1, tiles.x1 + 1);
+    carve.y1 = std::max(carve.y1, tiles.y1 + 1);
+    for (int32_t ry = tiles.y0 / carve.regionSize; ry <= tiles.y1 / carve.regionSize; ry++)
+    {
+      for (int32_t rx = tiles.x0 / carve.regionSize; rx <= tiles.x1 / carve.regionSize; rx++)
+        carve.bins[ry * carve.regionsX + rx].push_back(s);
+    }
+  }
+
+  if (carve.x1 <= carve.x0)
+    carve.x0 = carve.y0 = carve.x1 = carve.y1 = 0;
+}
+
+void applyWorldCarve(const WorldGenContext& context, const WorldCarve& carve)
+{
+  if (carve.bins.empty() && !carve.strokes.empty())
+    throw std::runtime_error("applyWorldCarve: strokes were not binned");
+  if (context.x1 <= context.x0 || context.y1 <= context.y0 || carve.bins.empty())
+    return;
+
+  // usually a single region, unless the pass regions differ from the carve's
+  const int32_t size = carve.regionSize;
+  for (int32_t ry = context.y0 / size; ry <= (context.y1 - 1) / size; ry++)
+  {
+    for (int32_t rx = context.x0 / size; rx <= (context.x1 - 1) / size; rx++)
+    {
+      const std::vector<uint32_t>& bin = carve.bins[ry * carve.regionsX + rx];
+      if (bin.empty())
+        continue;
+      applyCarveBin(context, carve, bin, std::max(rx * size, context.x0),
+                    std::max(ry * size, context.y0), std::min((rx + 1) * size, context.x1),
+                    std::min((ry + 1) * size, context.y1));
+    }
+  }
+}
+
+void carveWorld(TileStore& store, JobSystem& jobs, const WorldCarve& carve)
+{
+  if (store.unloadedChunks > 0 || store.snapshot)
+    throw std::runtime_error("carveWorld: store has unloaded chunks or a snapshot");
+  if (carve.bins.empty() && !carve.strokes.empty())
+    throw std::runtime_error("carveWorld: strokes were not binned");
+
+  std::vector<uint32_t> regions;
+  for (uint32_t r = 0; r < (uint32_t)carve.bins.size(); r++)
+  {
+    if (!carve.bins[r].empty())
+      regions.push_back(r);
+  }
+  if (regions.empty())
+    return;
+
+  runJobs(jobs, (uint32_t)regions.size(), [&](uint32_t index, uint32_t thread) {
+    const int32_t size = carve.regionSize;
+    const int32_t rx = (int32_t)regions[index] % carve.regionsX;
+    const int32_t ry = (int32_t)regions[index] / carve.regionsX;
+
+    WorldGenContext context{};
+    context.store = &store;
+    context.x0 = rx * size;
+    context.y0 = ry * size;
+    context.x1 = std::min((rx + 1) * size, store.width);
+    context.y1 = std::min((ry + 1) * size, store.height);
+    context.thread = thread;
+
+    // regions are whole chunks, no two jobs decompress the same one
+    for (int32_t cy = context.y0 >> TILE_CHUNK_SHIFT; cy <= (context.y1 - 1) >> TILE_CHUNK_SHIFT;
+         cy++)
+    {
+      for (int32_t cx = context.x0 >> TILE_CHUNK_SHIFT;
+           cx <= (context.x1 - 1) >> TILE_CHUNK_SHIFT; cx++)
+        getWritableTileChunk(store, store.chunkSlots[cy * store.chunksX + cx]);
+    }
+    applyCarveBin(context, carve, carve.bins[regions[index]], context.x0, context.y0,
+                  context.x1, context.y1);
+  });
+
+  notifyTilesChanged(store, carve.x0, carve.y0, carve.x1, carve.y1);
+}
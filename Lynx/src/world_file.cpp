@@ -0,0 +1,830 @@
+#include <Lynx/world_file.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <zstd.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now() - start)
+    .count();
+}
+
+static void appendBytes(std::vector<uint8_t>& out, const void* data, size_t size)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void writeAt(std::vector<uint8_t>& out, uint64_t offset, const T& value)
+{
+  memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+static uint64_t alignFileOffset(std::vector<uint8_t>& out, uint64_t alignment)
+{
+  out.resize((out.size() + alignment - 1) & ~(alignment - 1), 0);
+  return out.size();
+}
+
+static void serializeTileChunk(const TileChunk& chunk, std::vector<uint8_t>& blob)
+{
+  blob.clear();
+
+  // raw chunks are saved compressed when they can be, the loaded world starts out small
+  TileChunkEncoding encoded;
+  const TileChunkEncoding* packed = &chunk.packed;
+  if (chunk.raw)
+  {
+    if (!encodeTileChunk(*chunk.raw, encoded))
+    {
+      WorldChunkBlobHeader header{};
+      header.format = TILE_CHUNK_RAW;
+      appendBytes(blob, &header, sizeof(header));
+      appendBytes(blob, chunk.raw.get(), sizeof(TileChunkRaw));
+      return;
+    }
+    packed = &encoded;
+  }
+
+  WorldChunkBlobHeader header{};
+  header.format = packed->format;
+  header.bitsPerIndex = packed->bitsPerIndex;
+  header.paletteSize = (uint16_t)packed->palette.size();
+  header.runCount = (uint16_t)packed->runEnds.size();
+  header.indexWords = (uint16_t)packed->indices.size();
+
+  appendBytes(blob, &header, sizeof(header));
+
+  appendBytes(blob, packed->palette.data(), packed->palette.size() * sizeof(TileRecord));
+  appendBytes(blob, packed->indices.data(), packed->indices.size() * sizeof(uint64_t));
+  appendBytes(blob, packed->runEnds.data(), packed->runEnds.size() * sizeof(uint16_t));
+  appendBytes(blob, packed->runIndices.data(), packed->runIndices.size());
+}
+
+static void writeSideTables(std::vector<uint8_t>& out, const WorldFileHeader& header,
+                            const std::vector<WorldSideTable>& tables)
+{
+  std::vector<WorldSideTableEntry> entries(tables.size());
+
+  for (size_t t = 0; t < tables.size(); t++)
+  {
+    const WorldSideTable& table = tables[t];
+
+    std::vector<uint32_t> order(table.records.size());
+    std::vector<WorldRecordEntry> index(table.records.size());
+    uint64_t dataSize = 0;
+    for (uint32_t r = 0; r < order.size(); r++)
+    {
+      const WorldRecord& record = table.records[r];
+      if (record.x < 0 || record.y < 0 || record.x >= header.width || record.y >= header.height)
+        throw std::runtime_error("saveWorldFile: side table record outside of the world");
+
+      order[r] = r;
+      index[r].chunk = (uint32_t)((record.y >> TILE_CHUNK_SHIFT) * header.chunksX +
+                                  (record.x >> TILE_CHUNK_SHIFT));
+      index[r].x = record.x;
+      index[r].y = record.y;
+      index[r].size = (uint32_t)record.data.size();
+    }
+
+    // by chunk so a chunk's records are one range, then by position for lookups of one tile
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      const WorldRecordEntry& ea = index[a];
+      const WorldRecordEntry& eb = index[b];
+      if (ea.chunk != eb.chunk)
+        return ea.chunk < eb.chunk;
+      return ea.y != eb.y ? ea.y < eb.y : ea.x < eb.x;
+    });
+
+    WorldSideTableEntry& entry = entries[t];
+    entry.tag = table.tag;
+    entry.recordCount = (uint32_t)order.size();
+    entry.indexOffset = alignFileOffset(out, 8);
+    out.resize(out.size() + order.size() * sizeof(WorldRecordEntry));
+
+    entry.dataOffset = alignFileOffset(out, 8);
+    for (uint32_t r = 0; r < order.size(); r++)
+    {
+      WorldRecordEntry record = index[order[r]];
+      record.offset = dataSize;
+      writeAt(out, entry.indexOffset + r * sizeof(WorldRecordEntry), record);
+
+      const std::vector<uint8_t>& data = table.records[order[r]].data;
+      appendBytes(out, data.data(), data.size());
+      dataSize += data.size();
+    }
+    entry.dataSize = dataSize;
+  }
+
+  for (size_t t = 0; t < entries.size(); t++)
+    writeAt(out, header.sideTableDirectoryOffset + t * sizeof(WorldSideTableEntry), entries[t]);
+}
+
+void beginWorldFileWriter(WorldFileWriter& writer, int32_t width, int32_t height,
+                          const WorldFileSaveInfo& info)
+{
+  const int32_t chunksX = (width + TILE_CHUNK_MASK) >> TILE_CHUNK_SHIFT;
+  const int32_t chunksY = (height + TILE_CHUNK_MASK) >> TILE_CHUNK_SHIFT;
+  const uint32_t chunkCount = (uint32_t)(chunksX * chunksY);
+
+  WorldFileHeader& header = writer.header;
+  header = {};
+  memcpy(header.magic, WORLD_FILE_MAGIC, sizeof(header.magic));
+  header.version = WORLD_FILE_VERSION;
+  header.chunkSize = TILE_CHUNK_SIZE;
+  header.width = width;
+  header.height = height;
+  header.chunksX = chunksX;
+  header.chunksY = chunksY;
+  header.spawnX = info.spawnX;
+  header.spawnY = info.spawnY;
+  header.sideTableCount = (uint32_t)info.sideTables.size();
+  header.chunkDirectoryOffset = sizeof(WorldFileHeader);
+  header.sideTableDirectoryOffset =
+    header.chunkDirectoryOffset + chunkCount * sizeof(WorldChunkEntry);
+
+  writer.out.assign(header.sideTableDirectoryOffset +
+                      info.sideTables.size() * sizeof(WorldSideTableEntry),
+                    0);
+  writeSideTables(writer.out, header, info.sideTables);
+  writer.directory.assign(chunkCount, {});
+  writer.nextSlot = 0;
+
+  if (!writer.compressor)
+  {
+    writer.compressor = ZSTD_createCCtx();
+    if (!writer.compressor)
+      throw std::runtime_error("beginWorldFileWriter: failed to create compression context");
+  }
+  ZSTD_CCtx* compressor = (ZSTD_CCtx*)writer.compressor;
+  ZSTD_CCtx_setParameter(compressor, ZSTD_c_compressionLevel, info.compressionLevel);
+  ZSTD_CCtx_setParameter(compressor, ZSTD_c_checksumFlag, 1);
+}
+
+void serializeWorldChunk(const TileChunk& chunk, std::vector<uint8_t>& blob)
+{
+  serializeTileChunk(chunk, blob);
+}
+
+void storeWorldChunk(void* compressor, const std::vector<uint8_t>& blob, WorldChunkEntry& entry,
+                     std::vector<uint8_t>& stored)
+{
+  entry.format = blob[0];
+  entry.size = (uint32_t)blob.size();
+
+  stored.resize(ZSTD_compressBound(blob.size()));
+  const size_t compressedSize = ZSTD_compress2((ZSTD_CCtx*)compressor, stored.data(),
+                                               stored.size(), blob.data(), blob.size());
+  if (ZSTD_isError(compressedSize))
+    throw std::runtime_error("storeWorldChunk: failed to compress a chunk");
+
+  // uniform chunks are a handful of bytes, smaller than a zstd frame header
+  if (compressedSize < blob.size())
+  {
+    entry.codec = WORLD_CODEC_ZSTD;
+    stored.resize(compressedSize);
+  }
+  else
+  {
+    entry.codec = WORLD_CODEC_NONE;
+    stored.assign(blob.begin(), blob.end());
+  }
+  entry.storedSize = (uint32_t)stored.size();
+}
+
+void writeStoredWorldChunk(WorldFileWriter& writer, uint32_t slot, const WorldChunkEntry& entry,
+                           const uint8_t* stored)
+{
+  if (slot != writer.nextSlot || slot >= writer.directory.size())
+    throw std::runtime_error("writeStoredWorldChunk: chunks must be written in slot order");
+  writer.nextSlot++;
+
+  WorldChunkEntry& written = writer.directory[slot];
+  written = entry;
+  written.offset = alignFileOffset(writer.out, 8);
+  appendBytes(writer.out, stored, entry.storedSize);
+}
+
+void writeWorldChunk(WorldFileWriter& writer, uint32_t slot, const std::vector<uint8_t>& blob)
+{
+  WorldChunkEntry entry{};
+  storeWorldChunk(writer.compressor, blob, entry, writer.compressed);
+  writeStoredWorldChunk(writer, slot, entry, writer.compressed.data());
+}
+
+static bool syncWorldFileData(FILE* file)
+{
+  if (fflush(file) != 0)
+    return false;
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
+void syncDirectory(const std::string& directory)
+{
+#ifndef _WIN32
+  const int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+    throw std::runtime_error("syncDirectory: failed to open " + directory);
+  const bool synced = fsync(fd) == 0;
+  close(fd);
+  if (!synced)
+    throw std::runtime_error("syncDirectory: failed to sync " + directory);
+#else
+  // renames are written through instead
+  (void)directory;
+#endif
+}
+
+// Renames from over to and waits until the rename itself is on disk.
+static void replaceWorldFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+  if (!MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    throw std::runtime_error("replaceWorldFile: failed to rename " + from);
+#else
+  std::filesystem::rename(from, to);
+  syncDirectory(std::filesystem::path(to).parent_path().string());
+#endif
+}
+
+void writeSyncedFile(const std::string& path, const void* header, size_t headerSize,
+                     const void* data, size_t size)
+{
+  const std::string temporaryPath = path + ".tmp";
+  FILE* file = fopen(temporaryPath.c_str(), "wb");
+  if (!file)
+    throw std::runtime_error("writeSyncedFile: failed to open " + temporaryPath);
+  const bool written = fwrite(header, 1, headerSize, file) == headerSize &&
+                       (size == 0 || fwrite(data, 1, size, file) == size) &&
+                       syncWorldFileData(file);
+  const bool closed = fclose(file) == 0;
+  if (!written || !closed)
+    throw std::runtime_error("writeSyncedFile: failed to write " + temporaryPath);
+
+  replaceWorldFile(temporaryPath, path);
+}
+
+void finishWorldFileWriter(WorldFileWriter& writer, const std::string& path)
+{
+  if (writer.nextSlot != writer.directory.size())
+    throw std::runtime_error("finishWorldFileWriter: chunks missing");
+
+  WorldFileHeader& header = writer.header;
+  std::vector<uint8_t>& out = writer.out;
+  header.fileSize = out.size();
+  writeAt(out, 0, header);
+  memcpy(out.data() + header.chunkDirectoryOffset, writer.directory.data(),
+         writer.directory.size() * sizeof(WorldChunkEntry));
+
+  // the file is on disk before it replaces the old one and the rename is on disk before this
+  // returns, so journals compacted into it can be deleted right after
+  writeSyncedFile(path, out.data(), out.size(), nullptr, 0);
+  writer.bytesWritten = out.size();
+}
+
+void destroyWorldFileWriter(WorldFileWriter& writer)
+{
+  ZSTD_freeCCtx((ZSTD_CCtx*)writer.compressor);
+  writer.compressor = nullptr;
+  writer.out.clear();
+  writer.out.shrink_to_fit();
+  writer.directory.clear();
+}
+
+void saveWorldFile(const std::string& path, const TileStore& store, const WorldFileSaveInfo& info)
+{
+  WorldFileWriter writer;
+  try
+  {
+    beginWorldFileWriter(writer, store.width, store.height, info);
+
+    // the chunk table is in Morton order already, which keeps neighbouring chunks close in the
+    // file
+    std::vector<uint8_t> blob;
+    for (uint32_t slot = 0; slot < store.chunks.size(); slot++)
+    {
+      // a store loaded from a world file may still have chunks on disk
+      loadTileChunk(store, slot);
+      serializeTileChunk(store.chunks[slot], blob);
+      writeWorldChunk(writer, slot, blob);
+    }
+
+    finishWorldFileWriter(writer, path);
+  }
+  catch (...)
+  {
+    destroyWorldFileWriter(writer);
+    throw;
+  }
+  destroyWorldFileWriter(writer);
+}
+
+static void unmapWorldFile(WorldFile& file)
+{
+#ifdef _WIN32
+  if (file.data)
+    UnmapViewOfFile(file.data);
+  if (file.mappingHandle)
+    CloseHandle((HANDLE)file.mappingHandle);
+  if (file.fileHandle && file.fileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle((HANDLE)file.fileHandle);
+  file.mappingHandle = nullptr;
+  file.fileHandle = nullptr;
+#else
+  if (file.data)
+    munmap((void*)file.data, file.size);
+  if (file.fileDescriptor >= 0)
+    close(file.fileDescriptor);
+  file.fileDescriptor = -1;
+#endif
+  file.data = nullptr;
+  file.size = 0;
+}
+
+static void mapWorldFile(WorldFile& file, const std::string& path)
+{
+#ifdef _WIN32
+  file.fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (file.fileHandle == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("openWorldFile: failed to open " + path);
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx((HANDLE)file.fileHandle, &size) || size.QuadPart == 0)
+  {
+    unmapWorldFile(file);
+    throw std::runtime_error("openWorldFile: failed to read the size of " + path);
+  }
+  file.size = (uint64_t)size.QuadPart;
+
+  file.mappingHandle =
+    CreateFileMappingA((HANDLE)file.fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (file.mappingHandle)
+    file.data = (const uint8_t*)MapViewOfFile((HANDLE)file.mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+  file.fileDescriptor = open(path.c_str(), O_RDONLY);
+  if (file.fileDescriptor < 0)
+    throw std::runtime_error("openWorldFile: failed to open " + path);
+
+  struct stat status;
+  if (fstat(file.fileDescriptor, &status) != 0 || status.st_size == 0)
+  {
+    unmapWorldFile(file);
+    throw std::runtime_error("openWorldFile: failed to read the size of " + path);
+  }
+  file.size = (uint64_t)status.st_size;
+
+  void* data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fileDescriptor, 0);
+  if (data != MAP_FAILED)
+  {
+    file.data = (const uint8_t*)data;
+    // chunks are read in whatever order the game touches them
+    madvise(data, file.size, MADV_RANDOM);
+  }
+#endif
+
+  if (!file.data)
+  {
+    unmapWorldFile(file);
+    throw std::runtime_error("openWorldFile: failed to map " + path);
+  }
+}
+
+static bool isInWorldFile(const WorldFile& file, uint64_t offset, uint64_t size)
+{
+  return offset <= file.size && size <= file.size - offset;
+}
+
+// Sets the directory pointers once they are known to be inside the file.
+static void validateWorldFile(WorldFile& file)
+{
+  if (file.size < sizeof(WorldFileHeader))
+    throw std::runtime_error("openWorldFile: file too small");
+
+  const WorldFileHeader& header = *file.header;
+  if (memcmp(header.magic, WORLD_FILE_MAGIC, sizeof(header.magic)) != 0)
+    throw std::runtime_error("openWorldFile: not a world file");
+  if (header.version != WORLD_FILE_VERSION)
+    throw std::runtime_error("openWorldFile: unsupported version");
+  if (header.chunkSize != TILE_CHUNK_SIZE || header.width <= 0 || header.height <= 0 ||
+      header.chunksX != (header.width + TILE_CHUNK_MASK) >> TILE_CHUNK_SHIFT ||
+      header.chunksY != (header.height + TILE_CHUNK_MASK) >> TILE_CHUNK_SHIFT)
+    throw std::runtime_error("openWorldFile: invalid world size");
+  if (header.fileSize != file.size)
+    throw std::runtime_error("openWorldFile: truncated file");
+
+  const uint64_t chunkCount = (uint64_t)header.chunksX * header.chunksY;
+  if (!isInWorldFile(file, header.chunkDirectoryOffset, chunkCount * sizeof(WorldChunkEntry)) ||
+      !isInWorldFile(file, header.sideTableDirectoryOffset,
+                     (uint64_t)header.sideTableCount * sizeof(WorldSideTableEntry)))
+    throw std::runtime_error("openWorldFile: invalid directory");
+  file.chunks = (const WorldChunkEntry*)(file.data + header.chunkDirectoryOffset);
+  file.sideTables = (const WorldSideTableEntry*)(file.data + header.sideTableDirectoryOffset);
+
+  // chunk blobs are checked when they are loaded, side tables are small enough to check now
+  for (uint32_t t = 0; t < header.sideTableCount; t++)
+  {
+    const WorldSideTableEntry& table = file.sideTables[t];
+    if (!isInWorldFile(file, table.indexOffset,
+                       (uint64_t)table.recordCount * sizeof(WorldRecordEntry)) ||
+        !isInWorldFile(file, table.dataOffset, table.dataSize))
+      throw std::runtime_error("openWorldFile: invalid side table");
+
+    const WorldRecordEntry* records = (const WorldRecordEntry*)(file.data + table.indexOffset);
+    for (uint32_t r = 0; r < table.recordCount; r++)
+    {
+      if (records[r].chunk >= chunkCount || records[r].offset > table.dataSize ||
+          records[r].size > table.dataSize - records[r].offset)
+        throw std::runtime_error("openWorldFile: invalid side table record");
+    }
+  }
+}
+
+WorldFile openWorldFile(const std::string& path)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  WorldFile file;
+  mapWorldFile(file, path);
+  file.header = (const WorldFileHeader*)file.data;
+  try
+  {
+    validateWorldFile(file);
+  }
+  catch (...)
+  {
+    unmapWorldFile(file);
+    throw;
+  }
+
+  file.decompressor = ZSTD_createDCtx();
+  if (!file.decompressor)
+  {
+    unmapWorldFile(file);
+    throw std::runtime_error("openWorldFile: failed to create decompression context");
+  }
+
+  file.stats.openNanoseconds = nanosecondsSince(start);
+  return file;
+}
+
+void closeWorldFile(WorldFile& file)
+{
+  unmapWorldFile(file);
+  ZSTD_freeDCtx((ZSTD_DCtx*)file.decompressor);
+  file.decompressor = nullptr;
+  file.header = nullptr;
+  file.chunks = nullptr;
+  file.sideTables = nullptr;
+  file.scratch.clear();
+}
+
+static void loadWorldChunkCallback(void* userData, TileStore& store, uint32_t slot)
+{
+  loadWorldChunk(*(WorldFile*)userData, store, slot);
+}
+
+TileStore createTileStoreFromWorldFile(WorldFile& file)
+{
+  TileStore store = createTileStore(file.header->width, file.header->height);
+  setTileChunkLoader(store, loadWorldChunkCallback, &file);
+  return store;
+}
+
+template <typename T>
+static const uint8_t* readArray(const uint8_t* in, const uint8_t* end, std::vector<T>& out,
+                                size_t count)
+{
+  if (!in || (size_t)(end - in) < count * sizeof(T))
+    return nullptr;
+  out.resize(count);
+  if (count > 0)
+    memcpy(out.data(), in, count * sizeof(T));
+  return in + count * sizeof(T);
+}
+
+void decodeWorldChunk(const WorldChunkEntry& entry, const uint8_t* stored, void* decompressor,
+                      std::vector<uint8_t>& scratch, TileChunkEncoding& packed,
+                      std::unique_ptr<TileChunkRaw>& raw)
+{
+  if (entry.size > sizeof(WorldChunkBlobHeader) + sizeof(TileChunkRaw) ||
+      entry.size < sizeof(WorldChunkBlobHeader))
+    throw std::runtime_error("decodeWorldChunk: invalid chunk entry");
+
+  const uint8_t* blob = stored;
+  if (entry.codec == WORLD_CODEC_ZSTD)
+  {
+    scratch.resize(sizeof(WorldChunkBlobHeader) + sizeof(TileChunkRaw));
+    const size_t size = ZSTD_decompressDCtx((ZSTD_DCtx*)decompressor, scratch.data(),
+                                            scratch.size(), stored, entry.storedSize);
+    if (ZSTD_isError(size) || size != entry.size)
+      throw std::runtime_error("decodeWorldChunk: corrupted chunk");
+    blob = scratch.data();
+  }
+  else if (entry.codec != WORLD_CODEC_NONE || entry.storedSize != entry.size)
+    throw std::runtime_error("decodeWorldChunk: unknown codec");
+
+  WorldChunkBlobHeader header;
+  memcpy(&header, blob, sizeof(header));
+  const uint8_t* in = blob + sizeof(header);
+  const uint8_t* end = blob + entry.size;
+
+  packed = {};
+  raw.reset();
+  packed.format = (TileChunkFormat)header.format;
+  packed.bitsPerIndex = header.bitsPerIndex;
+
+  if (packed.format == TILE_CHUNK_RAW)
+  {
+    if ((size_t)(end - in) != sizeof(TileChunkRaw))
+      throw std::runtime_error("decodeWorldChunk: corrupted chunk");
+    // the mapping gives no alignment guarantee beyond the blob's
+    raw.reset(new TileChunkRaw);
+    memcpy(raw.get(), in, sizeof(TileChunkRaw));
+    return;
+  }
+
+  in = readArray(in, end, packed.palette, header.paletteSize);
+  in = readArray(in, end, packed.indices, header.indexWords);
+  in = readArray(in, end, packed.runEnds, header.runCount);
+  in = readArray(in, end, packed.runIndices, header.runCount);
+
+  const bool valid =
+    in == end && !packed.palette.empty() && packed.palette.size() <= TILE_CHUNK_MAX_PALETTE &&
+    (packed.format == TILE_CHUNK_UNIFORM ||
+     (packed.format == TILE_CHUNK_PALETTE && packed.bitsPerIndex >= 1 &&
+      packed.bitsPerIndex <= 8 &&
+      packed.indices.size() * (64 / packed.bitsPerIndex) >= (size_t)TILE_CHUNK_TILES) ||
+     (packed.format == TILE_CHUNK_RUNS && !packed.runEnds.empty() &&
+      packed.runEnds.back() == TILE_CHUNK_TILES - 1));
+  if (!valid)
+    throw std::runtime_error("decodeWorldChunk: corrupted chunk");
+
+  // uncompressed blobs carry no checksum, run ends out of order or past the chunk would write
+  // out of bounds when the chunk is decoded, indices past the palette would read out of bounds
+  for (size_t run = 0; run < packed.runEnds.size(); run++)
+  {
+    if (packed.runEnds[run] >= TILE_CHUNK_TILES ||
+        (run > 0 && packed.runEnds[run] <= packed.runEnds[run - 1]))
+      throw std::runtime_error("decodeWorldChunk: corrupted chunk");
+  }
+  uint32_t maxIndex = 0;
+  for (uint8_t runIndex : packed.runIndices)
+    maxIndex = std::max<uint32_t>(maxIndex, runIndex);
+  if (packed.format == TILE_CHUNK_PALETTE)
+  {
+    for (uint32_t i = 0; i < TILE_CHUNK_TILES; i++)
+    {
+      const uint32_t perWord = 64 / packed.bitsPerIndex;
+      const uint64_t word = packed.indices[i / perWord];
+      maxIndex = std::max<uint32_t>(
+        maxIndex, (uint32_t)((word >> (i % perWord * packed.bitsPerIndex)) &
+                             ((1ull << packed.bitsPerIndex) - 1)));
+    }
+  }
+  if (maxIndex >= packed.palette.size())
+    throw std::runtime_error("decodeWorldChunk: corrupted chunk");
+}
+
+void installWorldChunk(TileStore& store, uint32_t slot, const WorldChunkEntry& entry,
+                       const uint8_t* stored, void* decompressor, std::vector<uint8_t>& scratch)
+{
+  TileChunkEncoding packed;
+  std::unique_ptr<TileChunkRaw> raw;
+  decodeWorldChunk(entry, stored, decompressor, scratch, packed, raw);
+  installTileChunk(store, slot, std::move(packed), raw.get());
+}
+
+const uint8_t* getStoredWorldChunk(const WorldFile& file, uint32_t slot)
+{
+  const WorldChunkEntry& entry = file.chunks[slot];
+  if (!isInWorldFile(file, entry.offset, entry.storedSize))
+    throw std::runtime_error("getStoredWorldChunk: invalid chunk entry");
+  return file.data + entry.offset;
+}
+
+void loadWorldChunk(WorldFile& file, TileStore& store, uint32_t slot)
+{
+  if (!store.chunks[slot].unloaded)
+    return;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  const WorldChunkEntry& entry = file.chunks[slot];
+  installWorldChunk(store, slot, entry, getStoredWorldChunk(file, slot), file.decompressor,
+                    file.scratch);
+
+  file.stats.chunksLoaded++;
+  file.stats.bytesDecompressed += entry.size;
+  file.stats.loadNanoseconds += nanosecondsSince(start);
+}
+
+void loadWorldChunksAround(WorldFile& file, TileStore& store, int32_t x, int32_t y,
+                           int32_t radius)
+{
+  const int32_t cx0 = std::max(x - radius, 0) >> TILE_CHUNK_SHIFT;
+  const int32_t cy0 = std::max(y - radius, 0) >> TILE_CHUNK_SHIFT;
+  const int32_t cx1 = std::min(x + radius, store.width - 1) >> TILE_CHUNK_SHIFT;
+  const int32_t cy1 = std::min(y + radius, store.height - 1) >> TILE_CHUNK_SHIFT;
+
+  for (int32_t cy = cy0; cy <= cy1; cy++)
+  {
+    for (int32_t cx = cx0; cx <= cx1; cx++)
+      loadWorldChunk(file, store, store.chunkSlots[cy * store.chunksX + cx]);
+  }
+}
+
+uint32_t loadRemainingWorldChunks(WorldFile& file, TileStore& store, uint32_t maxChunks)
+{
+  // slots are in file order, so this reads the mapping front to back
+  uint32_t unloaded = 0;
+  for (uint32_t slot = 0; slot < store.chunks.size(); slot++)
+  {
+    if (!store.chunks[slot].unloaded)
+      continue;
+    if (maxChunks > 0)
+    {
+      loadWorldChunk(file, store, slot);
+      maxChunks--;
+      continue;
+    }
+    unloaded++;
+  }
+  return unloaded;
+}
+
+static const WorldSideTableEntry* findWorldSideTable(const WorldFile& file, uint32_t tag)
+{
+  for (uint32_t t = 0; t < file.header->sideTableCount; t++)
+  {
+    if (file.sideTables[t].tag == tag)
+      return &file.sideTables[t];
+  }
+  return nullptr;
+}
+
+static WorldRecordView getWorldRecordView(const WorldFile& file, const WorldSideTableEntry& table,
+                                          const WorldRecordEntry& record)
+{
+  return { record.x, record.y, file.data + table.dataOffset + record.offset, record.size };
+}
+
+void findWorldRecords(const WorldFile& file, uint32_t tag, int32_t cx, int32_t cy,
+                      std::vector<WorldRecordView>& records)
+{
+  records.clear();
+  const WorldSideTableEntry* table = findWorldSideTable(file, tag);
+  if (!table || cx < 0 || cy < 0 || cx >= file.header->chunksX || cy >= file.header->chunksY)
+    return;
+
+  const uint32_t chunk = (uint32_t)(cy * file.header->chunksX + cx);
+  const WorldRecordEntry* begin = (const WorldRecordEntry*)(file.data + table->indexOffset);
+  const WorldRecordEntry* end = begin + table->recordCount;
+  const WorldRecordEntry* first = std::lower_bound(
+    begin, end, chunk, [](const WorldRecordEntry& e, uint32_t c) { return e.chunk < c; });
+
+  for (const WorldRecordEntry* record = first; record != end && record->chunk == chunk; record++)
+    records.push_back(getWorldRecordView(file, *table, *record));
+}
+
+bool findWorldRecord(const WorldFile& file, uint32_t tag, int32_t x, int32_t y,
+                     WorldRecordView& record)
+{
+  const WorldSideTableEntry* table = findWorldSideTable(file, tag);
+  if (!table || x < 0 || y < 0 || x >= file.header->width || y >= file.header->height)
+    return false;
+
+  const WorldRecordEntry key{ (uint32_t)((y >> TILE_CHUNK_SHIFT) * file.header->chunksX +
+                                         (x >> TILE_CHUNK_SHIFT)),
+                              x, y, 0, 0 };
+  const WorldRecordEntry* begin = (const WorldRecordEntry*)(file.data + table->indexOffset);
+  const WorldRecordEntry* end = begin + table->recordCount;
+  const WorldRecordEntry* found =
+    std::lower_bound(begin, end, key, [](const WorldRecordEntry& a, const WorldRecordEntry& b) {
+      if (a.chunk != b.chunk)
+        return a.chunk < b.chunk;
+      return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+  if (found == end || found->chunk != key.chunk || found->x != x || found->y != y)
+    return false;
+
+  record = getWorldRecordView(file, *table, *found);
+  return true;
+}
+
+WorldFileSaveInfo readWorldFileSaveInfo(const WorldFile& file)
+{
+  WorldFileSaveInfo info;
+  info.spawnX = file.header->spawnX;
+  info.spawnY = file.header->spawnY;
+  info.sideTables.resize(file.header->sideTableCount);
+
+  for (uint32_t t = 0; t < file.header->sideTableCount; t++)
+  {
+    const WorldSideTableEntry& entry = file.sideTables[t];
+    const WorldRecordEntry* records = (const WorldRecordEntry*)(file.data + entry.indexOffset);
+
+    WorldSideTable& table = info.sideTables[t];
+    table.tag = entry.tag;
+    table.records.resize(entry.recordCount);
+    for (uint32_t r = 0; r < entry.recordCount; r++)
+    {
+      const uint8_t* data = file.data + entry.dataOffset + records[r].offset;
+      table.records[r].x = records[r].x;
+      table.records[r].y = records[r].y;
+      table.records[r].data.assign(data, data + records[r].size);
+    }
+  }
+
+  return info;
+}
+
+void serializeWorldFileSaveInfo(const WorldFileSaveInfo& info, std::vector<uint8_t>& out)
+{
+  out.clear();
+  const uint32_t tableCount = (uint32_t)info.sideTables.size();
+  appendBytes(out, &info.spawnX, sizeof(info.spawnX));
+  appendBytes(out, &info.spawnY, sizeof(info.spawnY));
+  appendBytes(out, &info.compressionLevel, sizeof(info.compressionLevel));
+  appendBytes(out, &tableCount, sizeof(tableCount));
+
+  for (const WorldSideTable& table : info.sideTables)
+  {
+    const uint32_t recordCount = (uint32_t)table.records.size();
+    appendBytes(out, &table.tag, sizeof(table.tag));
+    appendBytes(out, &recordCount, sizeof(recordCount));
+    for (const WorldRecord& record : table.records)
+    {
+      const uint32_t size = (uint32_t)record.data.size();
+      appendBytes(out, &record.x, sizeof(record.x));
+      appendBytes(out, &record.y, sizeof(record.y));
+      appendBytes(out, &size, sizeof(size));
+      appendBytes(out, record.data.data(), size);
+    }
+  }
+}
+
+template <typename T>
+static bool readValue(const uint8_t*& in, const uint8_t* end, T& value)
+{
+  if ((size_t)(end - in) < sizeof(T))
+    return false;
+  memcpy(&value, in, sizeof(T));
+  in += sizeof(T);
+  return true;
+}
+
+bool deserializeWorldFileSaveInfo(const uint8_t* in, const uint8_t* end, WorldFileSaveInfo& info)
+{
+  uint32_t tableCount = 0;
+  if (!readValue(in, end, info.spawnX) || !readValue(in, end, info.spawnY) ||
+      !readValue(in, end, info.compressionLevel) || !readValue(in, end, tableCount))
+    return false;
+
+  info.sideTables.clear();
+  for (uint32_t t = 0; t < tableCount; t++)
+  {
+    WorldSideTable table;
+    uint32_t recordCount = 0;
+    if (!readValue(in, end, table.tag) || !readValue(in, end, recordCount))
+      return false;
+
+    for (uint32_t r = 0; r < recordCount; r++)
+    {
+      WorldRecord record;
+      uint32_t size = 0;
+      if (!readValue(in, end, record.x) || !readValue(in, end, record.y) ||
+          !readValue(in, end, size) || (size_t)(end - in) < size)
+        return false;
+      record.data.assign(in, in + size);
+      in += size;
+      table.records.push_back(std::move(record));
+    }
+    info.sideTables.push_back(std::move(table));
+  }
+  return in == end;
+}
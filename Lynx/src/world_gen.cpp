@@ -0,0 +1,312 @@
+#include <Lynx/world_gen.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+struct WorldGenRegion
+{
+  int32_t x0, y0, x1, y1;
+};
+
+struct WorldGenRun
+{
+  const WorldGenPass* pass = nullptr;
+  WorldGenContext context{};
+  // regions of every phase, phases run one after the other
+  std::vector<std::vector<WorldGenRegion>> phases;
+  uint32_t phase = 0;
+
+  uint32_t dependencies = 0;
+  std::vector<uint32_t> dependents;
+
+  JobBatch batch;
+  std::atomic<uint64_t> jobNanoseconds{ 0 };
+  WorldGenPassStats stats{};
+};
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static WorldGenRegion getWorldGenPassArea(const TileStore& store, const WorldGenPass& pass)
+{
+  if (pass.x1 <= pass.x0 || pass.y1 <= pass.y0)
+    return { 0, 0, store.width, store.height };
+  return { std::max(pass.x0, 0), std::max(pass.y0, 0), std::min(pass.x1, store.width),
+           std::min(pass.y1, store.height) };
+}
+
+static bool doWorldGenPassesConflict(const TileStore& store, const WorldGenPass& a,
+                                     const WorldGenPass& b)
+{
+  const uint32_t layers = (a.writes & (b.reads | b.writes)) | (a.reads & b.writes);
+  if (layers & ~WORLDGEN_TILE_LAYERS)
+    return true;
+  if (!layers)
+    return false;
+
+  // the areas with what the passes read around them
+  const WorldGenRegion areaA = getWorldGenPassArea(store, a);
+  const WorldGenRegion areaB = getWorldGenPassArea(store, b);
+  return areaA.x0 - a.margin < areaB.x1 + b.margin && areaB.x0 - b.margin < areaA.x1 + a.margin &&
+         areaA.y0 - a.margin < areaB.y1 + b.margin && areaB.y0 - b.margin < areaA.y1 + a.margin;
+}
+
+static void splitWorldGenPass(const TileStore& store, WorldGenRun& run)
+{
+  const WorldGenPass& pass = *run.pass;
+  const WorldGenRegion area = getWorldGenPassArea(store, pass);
+  if (area.x1 <= area.x0 || area.y1 <= area.y0)
+    return;
+
+  if (pass.regionSize <= 0)
+  {
+    run.phases.push_back({ area });
+    return;
+  }
+  if (pass.margin > pass.regionSize)
+    throw std::runtime_error(std::string("generateWorld: margin of pass ") + pass.name +
+                             " is larger than its regions");
+
+  // regions are aligned to the world rather than the area so they never share a chunk
+  const int32_t size = (pass.regionSize + TILE_CHUNK_MASK) & ~TILE_CHUNK_MASK;
+  run.phases.resize(pass.margin > 0 ? 4 : 1);
+  for (int32_t ry = area.y0 / size; ry <= (area.y1 - 1) / size; ry++)
+  {
+    for (int32_t rx = area.x0 / size; rx <= (area.x1 - 1) / size; rx++)
+    {
+      const WorldGenRegion region = { std::max(rx * size, area.x0), std::max(ry * size, area.y0),
+                                      std::min((rx + 1) * size, area.x1),
+                                      std::min((ry + 1) * size, area.y1) };
+      run.phases[pass.margin > 0 ? (rx & 1) + 2 * (ry & 1) : 0].push_back(region);
+    }
+  }
+
+  run.phases.erase(std::remove_if(run.phases.begin(), run.phases.end(),
+                                  [](const std::vector<WorldGenRegion>& p) { return p.empty(); }),
+                   run.phases.end());
+}
+
+static void runWorldGenRegion(WorldGenRun& run, const WorldGenRegion& region, uint32_t thread)
+{
+  const uint64_t start = getSteadyNanoseconds();
+
+  WorldGenContext context = run.context;
+  context.x0 = region.x0;
+  context.y0 = region.y0;
+  context.x1 = region.x1;
+  context.y1 = region.y1;
+  context.thread = thread;
+  run.pass->fn(context);
+
+  run.jobNanoseconds.fetch_add(getSteadyNanoseconds() - start, std::memory_order_relaxed);
+}
+
+static void runWorldGenJob(void* userData, uint32_t index, uint32_t thread)
+{
+  WorldGenRun& run = *(WorldGenRun*)userData;
+  runWorldGenRegion(run, run.phases[run.phase][index], thread);
+}
+
+static void submitWorldGenPhase(JobSystem& jobs, WorldGenRun& run)
+{
+  submitJobs(jobs, run.batch, runWorldGenJob, &run, (uint32_t)run.phases[run.phase].size());
+}
+
+static void scheduleWorldGenPasses(JobSystem& jobs, WorldGenRun* runs, uint32_t passCount,
+                                   uint64_t start)
+{
+  std::vector<uint32_t> ready;
+  std::vector<uint32_t> running;
+  std::vector<JobBatch*> waiting;
+  for (uint32_t p = 0; p < passCount; p++)
+  {
+    if (runs[p].dependencies == 0)
+      ready.push_back(p);
+  }
+
+  auto finishPass = [&](WorldGenRun& run) {
+    run.stats.nanoseconds = getSteadyNanoseconds() - start - run.stats.startNanoseconds;
+    for (uint32_t dependent : run.dependents)
+    {
+      if (--runs[dependent].dependencies == 0)
+        ready.push_back(dependent);
+    }
+  };
+
+  uint32_t finished = 0;
+  try
+  {
+    while (finished < passCount)
+    {
+      while (!ready.empty())
+      {
+        WorldGenRun& run = runs[ready.back()];
+        ready.pop_back();
+        run.stats.startNanoseconds = getSteadyNanoseconds() - start;
+        if (run.phases.empty())
+        {
+          finishPass(run);
+          finished++;
+          continue;
+        }
+        submitWorldGenPhase(jobs, run);
+        running.push_back((uint32_t)(&run - runs));
+      }
+      if (running.empty())
+        continue;
+
+      // a finished pass may let others start, so this returns as soon as any one is done
+      waiting.clear();
+      for (uint32_t p : running)
+        waiting.push_back(&runs[p].batch);
+      waitForAnyJobs(jobs, waiting.data(), (uint32_t)waiting.size());
+
+      for (size_t r = 0; r < running.size();)
+      {
+        WorldGenRun& run = runs[running[r]];
+        if (!isJobBatchFinished(jobs, run.batch))
+        {
+          r++;
+          continue;
+        }
+
+        // returns at once, throws what the jobs threw
+        waitForJobs(jobs, run.batch);
+        if (++run.phase < run.phases.size())
+        {
+          submitWorldGenPhase(jobs, run);
+          r++;
+          continue;
+        }
+
+        finishPass(run);
+        finished++;
+        running.erase(running.begin() + r);
+      }
+    }
+  }
+  catch (...)
+  {
+    // the runs go away with this frame, nothing may still be queued
+    for (uint32_t p : running)
+    {
+      try
+      {
+        waitForJobs(jobs, runs[p].batch);
+      }
+      catch (const std::exception&)
+      {
+      }
+    }
+    throw;
+  }
+}
+
+WorldGenStats generateWorld(TileStore& store, JobSystem& jobs,
+                            const std::vector<WorldGenPass>& passes, uint64_t seed,
+                            void* userData, bool parallel)
+{
+  if (store.unloadedChunks > 0 || store.snapshot)
+    throw std::runtime_error("generateWorld: store has unloaded chunks or a snapshot");
+
+  const uint64_t start = getSteadyNanoseconds();
+  const uint32_t passCount = (uint32_t)passes.size();
+  const uint32_t chunkCount = (uint32_t)store.chunks.size();
+
+  std::unique_ptr<WorldGenRun[]> runs(new WorldGenRun[passCount]);
+  for (uint32_t p = 0; p < passCount; p++)
+  {
+    WorldGenRun& run = runs[p];
+    run.pass = &passes[p];
+    run.context.store = &store;
+    run.context.userData = userData;
+    run.context.seed = seed;
+    run.context.pass = p;
+    splitWorldGenPass(store, run);
+
+    for (uint32_t earlier = 0; earlier < p; earlier++)
+    {
+      if (!doWorldGenPassesConflict(store, passes[earlier], passes[p]))
+        continue;
+      runs[earlier].dependents.push_back(p);
+      run.dependencies++;
+    }
+  }
+
+  // passes write raw chunks directly, chunks of different regions are never the same
+  if (parallel)
+    runJobs(jobs, chunkCount, [&](uint32_t slot, uint32_t) { getWritableTileChunk(store, slot); });
+  else
+  {
+    for (uint32_t slot = 0; slot < chunkCount; slot++)
+      getWritableTileChunk(store, slot);
+  }
+
+  if (parallel)
+    scheduleWorldGenPasses(jobs, runs.get(), passCount, start);
+  else
+  {
+    const uint32_t thread = getJobThreadCount(jobs) - 1;
+    for (uint32_t p = 0; p < passCount; p++)
+    {
+      WorldGenRun& run = runs[p];
+      run.stats.startNanoseconds = getSteadyNanoseconds() - start;
+      for (const std::vector<WorldGenRegion>& phase : run.phases)
+      {
+        for (const WorldGenRegion& region : phase)
+          runWorldGenRegion(run, region, thread);
+      }
+      run.stats.nanoseconds = getSteadyNanoseconds() - start - run.stats.startNanoseconds;
+    }
+  }
+
+  WorldGenStats stats{};
+  for (uint32_t p = 0; p < passCount; p++)
+  {
+    WorldGenPassStats& pass = runs[p].stats;
+    pass.name = passes[p].name;
+    for (const std::vector<WorldGenRegion>& phase : runs[p].phases)
+      pass.jobs += (uint32_t)phase.size();
+    pass.jobNanoseconds = runs[p].jobNanoseconds.load(std::memory_order_relaxed);
+    stats.passes.push_back(pass);
+  }
+
+  const uint64_t compressStart = getSteadyNanoseconds();
+  if (parallel)
+    runJobs(jobs, chunkCount, [&](uint32_t slot, uint32_t) { compressTileChunk(store, slot); });
+  else
+    compressTileStore(store);
+  stats.compressNanoseconds = getSteadyNanoseconds() - compressStart;
+
+  notifyTilesChanged(store, 0, 0, store.width, store.height);
+  stats.nanoseconds = getSteadyNanoseconds() - start;
+  return stats;
+}
+
+std::string formatWorldGenStats(const WorldGenStats& stats)
+{
+  std::string text;
+  char line[160];
+  uint64_t jobNanoseconds = 0;
+  for (const WorldGenPassStats& pass : stats.passes)
+  {
+    snprintf(line, sizeof(line), "%-24s %5u jobs  at %9.2f ms  took %9.2f ms  busy %9.2f ms\n",
+             pass.name, pass.jobs, pass.startNanoseconds / 1e6, pass.nanoseconds / 1e6,
+             pass.jobNanoseconds / 1e6);
+    text += line;
+    jobNanoseconds += pass.jobNanoseconds;
+  }
+  snprintf(line, sizeof(line), "%-24s %9.2f ms\n%-24s %9.2f ms, %.2f ms of passes on one thread\n",
+           "compress", stats.compressNanoseconds / 1e6, "total", stats.nanoseconds / 1e6,
+           jobNanoseconds / 1e6);
+  text += line;
+  return text;
+}
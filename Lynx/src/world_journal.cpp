@@ -0,0 +1,578 @@
+#include <Lynx/world_journal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+
+#include <zstd.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+struct WorldJournalPath
+{
+  uint32_t generation;
+  std::string path;
+};
+
+static uint32_t hashBytes(const void* data, size_t size, uint32_t hash = 2166136261u)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ bytes[i]) * 16777619u;
+  return hash;
+}
+
+static uint32_t getRecordChecksum(WorldJournalRecord record, const uint8_t* payload)
+{
+  record.checksum = 0;
+  return hashBytes(payload, record.storedSize, hashBytes(&record, sizeof(record)));
+}
+
+static std::string getWorldJournalPath(const std::string& worldPath, uint32_t generation)
+{
+  return worldPath + ".journal." + std::to_string(generation);
+}
+
+// Journals of the world, oldest first.
+static std::vector<WorldJournalPath> listWorldJournals(const std::string& worldPath)
+{
+  const std::filesystem::path world(worldPath);
+  const std::filesystem::path directory =
+    world.has_parent_path() ? world.parent_path() : std::filesystem::path(".");
+  const std::string prefix = world.filename().string() + ".journal.";
+
+  std::vector<WorldJournalPath> journals;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+  {
+    const std::string name = entry.path().filename().string();
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0)
+      continue;
+
+    const std::string suffix = name.substr(prefix.size());
+    if (suffix.find_first_not_of("0123456789") != std::string::npos || suffix.size() > 9)
+      continue;
+    journals.push_back({ (uint32_t)std::stoul(suffix), entry.path().string() });
+  }
+
+  std::sort(journals.begin(), journals.end(),
+            [](const WorldJournalPath& a, const WorldJournalPath& b) {
+              return a.generation < b.generation;
+            });
+  return journals;
+}
+
+static std::vector<uint8_t> readWholeFile(const std::string& path)
+{
+  std::vector<uint8_t> data;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return data;
+
+  uint8_t buffer[1 << 16];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + read);
+  fclose(file);
+  return data;
+}
+
+// Calls fn(const WorldJournalRecord& record, const uint8_t* payload) for every record of every
+// committed batch of the journal, in order. Stops at the first record that is torn or corrupted.
+template <typename F>
+static uint32_t readWorldJournal(const std::vector<uint8_t>& data, int32_t width, int32_t height,
+                                 F&& fn)
+{
+  WorldJournalHeader header;
+  if (data.size() < sizeof(header))
+    return 0;
+  memcpy(&header, data.data(), sizeof(header));
+  if (memcmp(header.magic, WORLD_JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != WORLD_JOURNAL_VERSION || header.width != width ||
+      header.height != height)
+    throw std::runtime_error("readWorldJournal: journal does not belong to the world");
+
+  // offsets of the records of the batch being read, applied once its commit is found
+  std::vector<size_t> pending;
+  uint32_t batches = 0;
+  size_t offset = sizeof(header);
+  while (data.size() - offset >= sizeof(WorldJournalRecord))
+  {
+    WorldJournalRecord record;
+    memcpy(&record, data.data() + offset, sizeof(record));
+    const uint8_t* payload = data.data() + offset + sizeof(record);
+    if (record.storedSize > data.size() - offset - sizeof(record) ||
+        getRecordChecksum(record, payload) != record.checksum)
+      break;
+
+    if (record.type == WORLD_JOURNAL_COMMIT)
+    {
+      for (size_t recordOffset : pending)
+      {
+        WorldJournalRecord committed;
+        memcpy(&committed, data.data() + recordOffset, sizeof(committed));
+        fn((const WorldJournalRecord&)committed, data.data() + recordOffset + sizeof(committed));
+      }
+      pending.clear();
+      batches++;
+    }
+    else
+      pending.push_back(offset);
+
+    offset += sizeof(record) + record.storedSize;
+  }
+  return batches;
+}
+
+static WorldFileSaveInfo readSaveInfoRecord(const WorldJournalRecord& record,
+                                            const uint8_t* payload, void* decompressor)
+{
+  std::vector<uint8_t> decompressed;
+  const uint8_t* data = payload;
+  if (record.codec == WORLD_CODEC_ZSTD)
+  {
+    decompressed.resize(record.size);
+    const size_t size = ZSTD_decompressDCtx((ZSTD_DCtx*)decompressor, decompressed.data(),
+                                            decompressed.size(), payload, record.storedSize);
+    if (ZSTD_isError(size) || size != record.size)
+      throw std::runtime_error("readWorldJournal: corrupted side tables");
+    data = decompressed.data();
+  }
+
+  WorldFileSaveInfo info;
+  if (!deserializeWorldFileSaveInfo(data, data + record.size, info))
+    throw std::runtime_error("readWorldJournal: corrupted side tables");
+  return info;
+}
+
+static WorldChunkEntry getRecordChunkEntry(const WorldJournalRecord& record)
+{
+  WorldChunkEntry entry{};
+  entry.codec = record.codec;
+  entry.format = record.format;
+  entry.size = record.size;
+  entry.storedSize = record.storedSize;
+  return entry;
+}
+
+WorldJournalReplay replayWorldJournals(const std::string& worldPath, TileStore& store)
+{
+  WorldJournalReplay replay{};
+  ZSTD_DCtx* decompressor = ZSTD_createDCtx();
+  std::vector<uint8_t> scratch;
+
+  try
+  {
+    for (const WorldJournalPath& journal : listWorldJournals(worldPath))
+    {
+      const std::vector<uint8_t> data = readWholeFile(journal.path);
+      replay.batches += readWorldJournal(
+        data, store.width, store.height,
+        [&](const WorldJournalRecord& record, const uint8_t* payload) {
+          if (record.type == WORLD_JOURNAL_SAVE_INFO)
+          {
+            replay.saveInfo = readSaveInfoRecord(record, payload, decompressor);
+            replay.hasSaveInfo = true;
+            return;
+          }
+          if (record.slot >= store.chunks.size())
+            throw std::runtime_error("replayWorldJournals: chunk outside of the world");
+          installWorldChunk(store, record.slot, getRecordChunkEntry(record), payload,
+                            decompressor, scratch);
+          replay.chunks++;
+        });
+    }
+  }
+  catch (...)
+  {
+    ZSTD_freeDCtx(decompressor);
+    throw;
+  }
+
+  ZSTD_freeDCtx(decompressor);
+  return replay;
+}
+
+static void syncJournalFile(FILE* file)
+{
+  if (fflush(file) != 0)
+    throw std::runtime_error("syncJournalFile: failed to flush");
+#ifdef _WIN32
+  if (_commit(_fileno(file)) != 0)
+#else
+  if (fsync(fileno(file)) != 0)
+#endif
+    throw std::runtime_error("syncJournalFile: failed to sync");
+}
+
+static void appendJournalRecord(WorldJournal& journal, WorldJournalRecord record,
+                                const uint8_t* payload)
+{
+  record.checksum = getRecordChecksum(record, payload);
+  if (fwrite(&record, sizeof(record), 1, journal.file) != 1 ||
+      (record.storedSize > 0 && fwrite(payload, record.storedSize, 1, journal.file) != 1))
+    throw std::runtime_error("appendJournalRecord: failed to write");
+
+  std::lock_guard<std::mutex> lock(journal.mutex);
+  journal.stats.bytesWritten += sizeof(record) + record.storedSize;
+  journal.stats.journalBytes += sizeof(record) + record.storedSize;
+}
+
+static void openJournalFile(WorldJournal& journal)
+{
+  const std::string path = getWorldJournalPath(journal.worldPath, journal.generation);
+  journal.file = fopen(path.c_str(), "wb");
+  if (!journal.file)
+    throw std::runtime_error("openJournalFile: failed to open " + path);
+
+  WorldJournalHeader header{};
+  memcpy(header.magic, WORLD_JOURNAL_MAGIC, sizeof(header.magic));
+  header.version = WORLD_JOURNAL_VERSION;
+  header.generation = journal.generation;
+  header.width = journal.store->width;
+  header.height = journal.store->height;
+  if (fwrite(&header, sizeof(header), 1, journal.file) != 1)
+    throw std::runtime_error("openJournalFile: failed to write " + path);
+
+  std::lock_guard<std::mutex> lock(journal.mutex);
+  journal.stats.journalBytes = sizeof(header);
+}
+
+static void closeJournalFile(WorldJournal& journal)
+{
+  if (!journal.file)
+    return;
+  syncJournalFile(journal.file);
+  fclose(journal.file);
+  journal.file = nullptr;
+}
+
+static void writeJournalBatch(WorldJournal& journal, WorldJournalBatch& batch)
+{
+  if (!journal.file)
+    openJournalFile(journal);
+
+  WorldJournalRecord record{};
+  record.sequence = batch.sequence;
+
+  for (size_t i = 0; i < batch.slots.size(); i++)
+  {
+    serializeWorldChunk(batch.chunks[i], journal.blob);
+    WorldChunkEntry entry{};
+    storeWorldChunk(journal.compressor, journal.blob, entry, journal.stored);
+
+    record.type = WORLD_JOURNAL_CHUNK;
+    record.codec = entry.codec;
+    record.format = entry.format;
+    record.slot = batch.slots[i];
+    record.size = entry.size;
+    record.storedSize = entry.storedSize;
+    appendJournalRecord(journal, record, journal.stored.data());
+  }
+
+  if (batch.hasSaveInfo)
+  {
+    serializeWorldFileSaveInfo(batch.saveInfo, journal.blob);
+    journal.stored.resize(ZSTD_compressBound(journal.blob.size()));
+    const size_t size =
+      ZSTD_compress2((ZSTD_CCtx*)journal.compressor, journal.stored.data(), journal.stored.size(),
+                     journal.blob.data(), journal.blob.size());
+    if (ZSTD_isError(size))
+      throw std::runtime_error("writeJournalBatch: failed to compress side tables");
+
+    record.type = WORLD_JOURNAL_SAVE_INFO;
+    record.codec = WORLD_CODEC_ZSTD;
+    record.format = 0;
+    record.slot = 0;
+    record.size = (uint32_t)journal.blob.size();
+    record.storedSize = (uint32_t)size;
+    appendJournalRecord(journal, record, journal.stored.data());
+
+    journal.latestSaveInfo = std::move(batch.saveInfo);
+    journal.hasLatestSaveInfo = true;
+  }
+
+  record = {};
+  record.type = WORLD_JOURNAL_COMMIT;
+  record.sequence = batch.sequence;
+  appendJournalRecord(journal, record, nullptr);
+  syncJournalFile(journal.file);
+
+  std::lock_guard<std::mutex> lock(journal.mutex);
+  journal.stats.batches++;
+  journal.stats.chunksWritten += (uint32_t)batch.slots.size();
+  journal.stats.syncs++;
+}
+
+// Folds every journal up to the current generation into the world file. Appends go to the next
+// generation meanwhile, which is why a crash at any point leaves a consistent world behind: the
+// old journals are only deleted once the new world file replaced the old one, and replaying them
+// onto the new one again changes nothing.
+static void compactWorldJournals(WorldJournal& journal)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  closeJournalFile(journal);
+  const uint32_t compacted = journal.generation;
+  journal.generation++;
+
+  WorldFile base = openWorldFile(journal.worldPath);
+  WorldFileWriter writer;
+  ZSTD_DCtx* decompressor = ZSTD_createDCtx();
+  std::vector<WorldJournalPath> journals;
+  try
+  {
+    const uint32_t chunkCount = (uint32_t)(base.header->chunksX * base.header->chunksY);
+
+    // latest stored copy of every chunk written since the world file was saved
+    std::vector<int32_t> latest(chunkCount, -1);
+    std::vector<WorldChunkEntry> entries;
+    std::vector<std::vector<uint8_t>> chunks;
+
+    WorldFileSaveInfo info;
+    bool hasInfo = false;
+
+    journals = listWorldJournals(journal.worldPath);
+    journals.erase(std::remove_if(journals.begin(), journals.end(),
+                                  [&](const WorldJournalPath& path) {
+                                    return path.generation > compacted;
+                                  }),
+                   journals.end());
+    for (const WorldJournalPath& path : journals)
+    {
+      const std::vector<uint8_t> data = readWholeFile(path.path);
+      readWorldJournal(data, base.header->width, base.header->height,
+                       [&](const WorldJournalRecord& record, const uint8_t* payload) {
+                         if (record.type == WORLD_JOURNAL_SAVE_INFO)
+                         {
+                           info = readSaveInfoRecord(record, payload, decompressor);
+                           hasInfo = true;
+                           return;
+                         }
+                         if (record.slot >= chunkCount)
+                           return;
+                         if (latest[record.slot] < 0)
+                         {
+                           latest[record.slot] = (int32_t)entries.size();
+                           entries.emplace_back();
+                           chunks.emplace_back();
+                         }
+                         entries[latest[record.slot]] = getRecordChunkEntry(record);
+                         chunks[latest[record.slot]].assign(payload,
+                                                            payload + record.storedSize);
+                       });
+    }
+
+    if (journal.hasLatestSaveInfo)
+      info = journal.latestSaveInfo;
+    else if (!hasInfo)
+      info = readWorldFileSaveInfo(base);
+
+    beginWorldFileWriter(writer, base.header->width, base.header->height, info);
+    for (uint32_t slot = 0; slot < chunkCount; slot++)
+    {
+      if (latest[slot] >= 0)
+        writeStoredWorldChunk(writer, slot, entries[latest[slot]], chunks[latest[slot]].data());
+      else
+        writeStoredWorldChunk(writer, slot, base.chunks[slot], getStoredWorldChunk(base, slot));
+    }
+  }
+  catch (...)
+  {
+    ZSTD_freeDCtx(decompressor);
+    closeWorldFile(base);
+    destroyWorldFileWriter(writer);
+    throw;
+  }
+  ZSTD_freeDCtx(decompressor);
+
+  // the writer holds a copy of everything it needs, and the file can only be replaced unmapped
+  // on some systems
+  closeWorldFile(base);
+  try
+  {
+    finishWorldFileWriter(writer, journal.worldPath);
+  }
+  catch (...)
+  {
+    destroyWorldFileWriter(writer);
+    throw;
+  }
+  destroyWorldFileWriter(writer);
+
+  // the new world and its rename are on disk, the journals have nothing left to replay
+  for (const WorldJournalPath& path : journals)
+  {
+    std::error_code error;
+    std::filesystem::remove(path.path, error);
+  }
+
+  std::lock_guard<std::mutex> lock(journal.mutex);
+  journal.stats.compactions++;
+  journal.stats.lastCompactionNanoseconds =
+    (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static void runWorldJournal(WorldJournal* journal)
+{
+  while (true)
+  {
+    WorldJournalBatch batch;
+    {
+      std::unique_lock<std::mutex> lock(journal->mutex);
+      journal->condition.wait(lock, [&] { return journal->quit || !journal->batches.empty(); });
+      if (journal->batches.empty())
+        return;
+
+      batch = std::move(journal->batches.front());
+      journal->batches.pop_front();
+      if (!journal->error.empty())
+        continue;
+    }
+
+    try
+    {
+      writeJournalBatch(*journal, batch);
+
+      uint64_t journalBytes;
+      {
+        std::lock_guard<std::mutex> lock(journal->mutex);
+        journalBytes = journal->stats.journalBytes;
+      }
+      if (batch.compact || journalBytes >= journal->compactBytes)
+        compactWorldJournals(*journal);
+    }
+    catch (const std::exception& e)
+    {
+      std::lock_guard<std::mutex> lock(journal->mutex);
+      journal->error = e.what();
+    }
+  }
+}
+
+void createWorldJournal(WorldJournal& journal, TileStore& store, const std::string& worldPath,
+                        uint32_t syncInterval, uint64_t compactBytes)
+{
+  if (!std::filesystem::exists(worldPath))
+    throw std::runtime_error("createWorldJournal: no world file at " + worldPath);
+
+  journal.worldPath = worldPath;
+  journal.store = &store;
+  journal.syncInterval = syncInterval;
+  journal.compactBytes = compactBytes;
+
+  // replayed journals stay until the next compaction, new batches go to a new generation
+  const std::vector<WorldJournalPath> journals = listWorldJournals(worldPath);
+  journal.generation = journals.empty() ? 0 : journals.back().generation + 1;
+
+  journal.versions.resize(store.chunks.size());
+  for (uint32_t slot = 0; slot < store.chunks.size(); slot++)
+    journal.versions[slot] = store.chunks[slot].version;
+
+  journal.compressor = ZSTD_createCCtx();
+  if (!journal.compressor)
+    throw std::runtime_error("createWorldJournal: failed to create compression context");
+  ZSTD_CCtx_setParameter((ZSTD_CCtx*)journal.compressor, ZSTD_c_compressionLevel, 3);
+  ZSTD_CCtx_setParameter((ZSTD_CCtx*)journal.compressor, ZSTD_c_checksumFlag, 1);
+
+  journal.worker = std::thread(runWorldJournal, &journal);
+}
+
+void destroyWorldJournal(WorldJournal& journal)
+{
+  flushWorldJournal(journal);
+
+  {
+    std::lock_guard<std::mutex> lock(journal.mutex);
+    journal.quit = true;
+  }
+  journal.condition.notify_all();
+  if (journal.worker.joinable())
+    journal.worker.join();
+
+  try
+  {
+    closeJournalFile(journal);
+  }
+  catch (const std::exception& e)
+  {
+    journal.error = e.what();
+  }
+  ZSTD_freeCCtx((ZSTD_CCtx*)journal.compressor);
+  journal.compressor = nullptr;
+  journal.batches.clear();
+}
+
+void setWorldJournalSaveInfo(WorldJournal& journal, WorldFileSaveInfo&& info)
+{
+  journal.saveInfo = std::move(info);
+  journal.hasSaveInfo = true;
+}
+
+void updateWorldJournal(WorldJournal& journal)
+{
+  if (++journal.ticksSinceSync < journal.syncInterval)
+    return;
+  flushWorldJournal(journal);
+}
+
+void flushWorldJournal(WorldJournal& journal, bool compact)
+{
+  journal.ticksSinceSync = 0;
+
+  TileStore& store = *journal.store;
+  WorldJournalBatch batch{};
+  batch.sequence = journal.sequence++;
+  batch.compact = compact;
+
+  // a version comparison per chunk finds every write, whichever path it took
+  for (uint32_t slot = 0; slot < store.chunks.size(); slot++)
+  {
+    const TileChunk& chunk = store.chunks[slot];
+    if (chunk.version == journal.versions[slot])
+      continue;
+    journal.versions[slot] = chunk.version;
+
+    batch.slots.push_back(slot);
+    batch.chunks.emplace_back();
+    TileChunk& copy = batch.chunks.back();
+    if (chunk.raw)
+      copy.raw.reset(new TileChunkRaw(*chunk.raw));
+    else
+      copy.packed = chunk.packed;
+  }
+
+  if (journal.hasSaveInfo)
+  {
+    batch.hasSaveInfo = true;
+    batch.saveInfo = std::move(journal.saveInfo);
+    journal.saveInfo = {};
+    journal.hasSaveInfo = false;
+  }
+
+  if (batch.slots.empty() && !batch.hasSaveInfo && !compact)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(journal.mutex);
+    journal.batches.push_back(std::move(batch));
+  }
+  journal.condition.notify_all();
+}
+
+WorldJournalStats getWorldJournalStats(WorldJournal& journal, std::string* error)
+{
+  std::lock_guard<std::mutex> lock(journal.mutex);
+  if (error)
+    *error = journal.error;
+  return journal.stats;
+}
@@ -0,0 +1,308 @@
+#include <Lynx/world_loader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+#include <zstd.h>
+
+static uint64_t getSteadyNanoseconds()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// chunks within radius tiles of (x, y), nearest first
+static void getWorldChunksAround(const TileStore& store, int32_t x, int32_t y, int32_t radius,
+                                 std::vector<uint32_t>& slots)
+{
+  slots.clear();
+  if (radius < 0)
+    return;
+
+  const int32_t cx0 = std::max(x - radius, 0) >> TILE_CHUNK_SHIFT;
+  const int32_t cy0 = std::max(y - radius, 0) >> TILE_CHUNK_SHIFT;
+  const int32_t cx1 = std::min(x + radius, store.width - 1) >> TILE_CHUNK_SHIFT;
+  const int32_t cy1 = std::min(y + radius, store.height - 1) >> TILE_CHUNK_SHIFT;
+
+  std::vector<std::pair<int64_t, uint32_t>> chunks;
+  for (int32_t cy = cy0; cy <= cy1; cy++)
+  {
+    for (int32_t cx = cx0; cx <= cx1; cx++)
+    {
+      const int64_t dx = (int64_t)(cx << TILE_CHUNK_SHIFT) + TILE_CHUNK_SIZE / 2 - x;
+      const int64_t dy = (int64_t)(cy << TILE_CHUNK_SHIFT) + TILE_CHUNK_SIZE / 2 - y;
+      chunks.push_back({ dx * dx + dy * dy, store.chunkSlots[cy * store.chunksX + cx] });
+    }
+  }
+
+  std::sort(chunks.begin(), chunks.end());
+  for (const auto& chunk : chunks)
+    slots.push_back(chunk.second);
+}
+
+static uint32_t claimWorldChunk(WorldLoader& loader)
+{
+  {
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    while (!loader.urgent.empty())
+    {
+      const uint32_t slot = loader.urgent.front();
+      loader.urgent.pop_front();
+      if (!loader.claimed[slot].exchange(1, std::memory_order_relaxed))
+        return slot;
+    }
+  }
+
+  uint32_t index;
+  while ((index = loader.nextOrder.fetch_add(1, std::memory_order_relaxed)) < loader.order.size())
+  {
+    const uint32_t slot = loader.order[index];
+    if (!loader.claimed[slot].exchange(1, std::memory_order_relaxed))
+      return slot;
+  }
+  return UINT32_MAX;
+}
+
+// Decodes one chunk with the decompressor of thread. Returns false if none is left.
+static bool decodeNextWorldChunk(WorldLoader& loader, uint32_t thread, WorldLoadedChunk& chunk)
+{
+  chunk.slot = claimWorldChunk(loader);
+  if (chunk.slot == UINT32_MAX)
+    return false;
+
+  // the file is only read, the mapping and the directory are safe to share
+  const WorldFile& file = *loader.file;
+  const WorldChunkEntry& entry = file.chunks[chunk.slot];
+  decodeWorldChunk(entry, getStoredWorldChunk(file, chunk.slot), loader.decompressors[thread],
+                   loader.scratch[thread], chunk.packed, chunk.raw);
+  return true;
+}
+
+// Every job decodes whichever chunk is claimed next, not the one of its index.
+static void decodeWorldChunkJob(void* userData, uint32_t, uint32_t thread)
+{
+  WorldLoader& loader = *(WorldLoader*)userData;
+
+  WorldLoadedChunk chunk;
+  if (!decodeNextWorldChunk(loader, thread, chunk))
+    return;
+
+  const uint32_t size = loader.file->chunks[chunk.slot].size;
+  {
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    loader.loaded.push_back(std::move(chunk));
+    loader.chunksDecoded++;
+    loader.bytesDecompressed += size;
+  }
+  loader.condition.notify_one();
+}
+
+static void installLoadedWorldChunk(WorldLoader& loader, WorldLoadedChunk& chunk)
+{
+  TileStore& store = *loader.store;
+  if (!store.chunks[chunk.slot].unloaded)
+  {
+    loader.stats.chunksDiscarded++;
+    return;
+  }
+  installTileChunk(store, chunk.slot, std::move(chunk.packed), chunk.raw.get());
+}
+
+static void updateWorldLoadProgress(WorldLoader& loader)
+{
+  const TileStore& store = *loader.store;
+  const uint64_t elapsed = getSteadyNanoseconds() - loader.start;
+
+  if (!loader.playableReached)
+  {
+    std::erase_if(loader.playable, [&](uint32_t slot) { return !store.chunks[slot].unloaded; });
+    if (loader.playable.empty())
+    {
+      loader.playableReached = true;
+      loader.stats.firstPlayableNanoseconds = elapsed;
+    }
+  }
+
+  if (!loader.fullyLoaded && store.unloadedChunks == 0)
+  {
+    loader.fullyLoaded = true;
+    loader.stats.fullyLoadedNanoseconds = elapsed;
+  }
+}
+
+void createWorldLoader(WorldLoader& loader, WorldFile& file, TileStore& store, JobSystem& jobs,
+                       int32_t playableRadius, const std::vector<WorldLoadFocus>& players)
+{
+  if (store.width != file.header->width || store.height != file.header->height)
+    throw std::runtime_error("createWorldLoader: store does not match the world file");
+
+  loader.start = getSteadyNanoseconds();
+  loader.file = &file;
+  loader.store = &store;
+  loader.jobs = &jobs;
+  loader.playableRadius = playableRadius;
+
+  std::vector<WorldLoadFocus> focus = players;
+  focus.insert(focus.begin(), { file.header->spawnX, file.header->spawnY });
+
+  const uint32_t chunkCount = (uint32_t)store.chunks.size();
+  loader.claimed.reset(new std::atomic<uint8_t>[chunkCount]);
+
+  // ordered by the distance to the nearest focus, in chunks
+  std::vector<std::pair<int64_t, uint32_t>> chunks;
+  for (int32_t cy = 0; cy < store.chunksY; cy++)
+  {
+    for (int32_t cx = 0; cx < store.chunksX; cx++)
+    {
+      const uint32_t slot = store.chunkSlots[cy * store.chunksX + cx];
+      loader.claimed[slot].store(!store.chunks[slot].unloaded, std::memory_order_relaxed);
+      if (!store.chunks[slot].unloaded)
+        continue;
+
+      int64_t distance = INT64_MAX;
+      for (const WorldLoadFocus& f : focus)
+      {
+        const int64_t dx = cx - (f.x >> TILE_CHUNK_SHIFT);
+        const int64_t dy = cy - (f.y >> TILE_CHUNK_SHIFT);
+        distance = std::min(distance, dx * dx + dy * dy);
+      }
+      chunks.push_back({ distance, slot });
+    }
+  }
+  std::sort(chunks.begin(), chunks.end());
+  loader.order.reserve(chunks.size());
+  for (const auto& chunk : chunks)
+    loader.order.push_back(chunk.second);
+
+  std::vector<uint32_t> around;
+  for (const WorldLoadFocus& f : focus)
+  {
+    getWorldChunksAround(store, f.x, f.y, playableRadius, around);
+    for (uint32_t slot : around)
+    {
+      if (store.chunks[slot].unloaded)
+        loader.playable.push_back(slot);
+    }
+  }
+  std::sort(loader.playable.begin(), loader.playable.end());
+  loader.playable.erase(std::unique(loader.playable.begin(), loader.playable.end()),
+                        loader.playable.end());
+
+  const uint32_t threadCount = getJobThreadCount(jobs);
+  loader.scratch.resize(threadCount);
+  for (uint32_t thread = 0; thread < threadCount; thread++)
+  {
+    loader.decompressors.push_back(ZSTD_createDCtx());
+    if (!loader.decompressors.back())
+    {
+      for (void* decompressor : loader.decompressors)
+        ZSTD_freeDCtx((ZSTD_DCtx*)decompressor);
+      loader.decompressors.clear();
+      throw std::runtime_error("createWorldLoader: failed to create decompression context");
+    }
+  }
+
+  submitJobs(jobs, loader.batch, decodeWorldChunkJob, &loader, (uint32_t)loader.order.size());
+  updateWorldLoadProgress(loader);
+}
+
+void destroyWorldLoader(WorldLoader& loader)
+{
+  if (!loader.jobs)
+    return;
+
+  // a chunk that failed to decode stays unloaded, the store reports it once it is touched
+  try
+  {
+    waitForJobs(*loader.jobs, loader.batch);
+  }
+  catch (const std::exception&)
+  {
+  }
+  updateWorldLoader(loader);
+
+  for (void* decompressor : loader.decompressors)
+    ZSTD_freeDCtx((ZSTD_DCtx*)decompressor);
+  loader.decompressors.clear();
+  loader.scratch.clear();
+  loader.order.clear();
+  loader.claimed.reset();
+  loader.jobs = nullptr;
+}
+
+bool updateWorldLoader(WorldLoader& loader)
+{
+  if (loader.fullyLoaded)
+    return true;
+
+  loader.installing.clear();
+  {
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    std::swap(loader.installing, loader.loaded);
+    loader.stats.chunksDecoded = loader.chunksDecoded;
+    loader.stats.bytesDecompressed = loader.bytesDecompressed;
+  }
+  for (WorldLoadedChunk& chunk : loader.installing)
+    installLoadedWorldChunk(loader, chunk);
+
+  updateWorldLoadProgress(loader);
+  return loader.fullyLoaded;
+}
+
+void waitForWorldPlayable(WorldLoader& loader)
+{
+  const uint32_t thread = getJobThreadCount(*loader.jobs) - 1;
+  WorldLoadedChunk chunk;
+  while (!updateWorldLoader(loader) && !loader.playableReached)
+  {
+    // the workers run the same claims, so this thread helps with the nearest chunks too
+    if (decodeNextWorldChunk(loader, thread, chunk))
+    {
+      {
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.chunksDecoded++;
+        loader.bytesDecompressed += loader.file->chunks[chunk.slot].size;
+      }
+      installLoadedWorldChunk(loader, chunk);
+      continue;
+    }
+
+    // everything is claimed, a chunk that failed to decode would never arrive
+    if (isJobBatchFinished(*loader.jobs, loader.batch))
+    {
+      waitForJobs(*loader.jobs, loader.batch);
+      updateWorldLoader(loader);
+      if (!loader.playableReached)
+        throw std::runtime_error("waitForWorldPlayable: chunks of the playable area are missing");
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(loader.mutex);
+    loader.condition.wait_for(lock, std::chrono::milliseconds(1),
+                              [&] { return !loader.loaded.empty(); });
+  }
+}
+
+bool isWorldPlayable(const WorldLoader& loader)
+{
+  return loader.playableReached;
+}
+
+void prioritizeWorldLoad(WorldLoader& loader, int32_t x, int32_t y, int32_t radius)
+{
+  if (loader.fullyLoaded || !loader.claimed)
+    return;
+
+  std::vector<uint32_t> slots;
+  getWorldChunksAround(*loader.store, x, y, radius, slots);
+
+  std::lock_guard<std::mutex> lock(loader.mutex);
+  for (uint32_t slot : slots)
+  {
+    if (!loader.claimed[slot].load(std::memory_order_relaxed))
+      loader.urgent.push_back(slot);
+  }
+}
@@ -0,0 +1,799 @@
+#include <Lynx/world_map.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+constexpr const uint32_t WORLD_MAP_PAGE_BYTES = WORLD_MAP_BLOCK_TEXELS * 4;
+
+struct WorldMapPushConstants
+{
+  float origin[2];
+  float extent[2];
+  uint32_t level;
+  uint32_t levelCount;
+  uint32_t width;
+  uint32_t height;
+  uint32_t pagesPerRow;
+};
+
+// Indices never straddle two words, so a block with 5 bit indices packs 12 of them per word.
+static uint32_t getBlockIndex(const WorldMapBlock& block, uint32_t i)
+{
+  if (block.bitsPerIndex == 0)
+    return 0;
+
+  const uint32_t perWord = 64 / block.bitsPerIndex;
+  const uint64_t mask = (1ull << block.bitsPerIndex) - 1;
+  return (uint32_t)((block.indices[i / perWord] >> (i % perWord * block.bitsPerIndex)) & mask);
+}
+
+static void setBlockIndex(WorldMapBlock& block, uint32_t i, uint32_t index)
+{
+  const uint32_t perWord = 64 / block.bitsPerIndex;
+  const uint32_t shift = i % perWord * block.bitsPerIndex;
+  const uint64_t mask = ((1ull << block.bitsPerIndex) - 1) << shift;
+
+  uint64_t& word = block.indices[i / perWord];
+  word = (word & ~mask) | ((uint64_t)index << shift);
+}
+
+static uint32_t bitsForPaletteSize(size_t size)
+{
+  uint32_t bits = 0;
+  while ((1ull << bits) < size)
+    bits++;
+  return bits;
+}
+
+// Rewrites the indices with a new width, remapping them through remap when given.
+static void repackBlock(WorldMapBlock& block, uint32_t bits, const uint32_t* remap)
+{
+  WorldMapBlock packed;
+  packed.bitsPerIndex = bits;
+  if (bits > 0)
+  {
+    const uint32_t perWord = 64 / bits;
+    packed.indices.assign((WORLD_MAP_BLOCK_TEXELS + perWord - 1) / perWord, 0);
+    for (uint32_t i = 0; i < WORLD_MAP_BLOCK_TEXELS; i++)
+    {
+      const uint32_t index = getBlockIndex(block, i);
+      setBlockIndex(packed, i, remap ? remap[index] : index);
+    }
+  }
+
+  block.indices = std::move(packed.indices);
+  block.bitsPerIndex = bits;
+}
+
+// Drops palette colors no tile uses anymore. Returns true if any was dropped.
+static bool compactBlock(WorldMapBlock& block)
+{
+  std::vector<uint32_t> used(block.palette.size(), 0);
+  for (uint32_t i = 0; i < WORLD_MAP_BLOCK_TEXELS; i++)
+    used[getBlockIndex(block, i)]++;
+  used[0] = 1;
+
+  std::vector<uint32_t> remap(block.palette.size());
+  std::vector<uint32_t> palette;
+  for (size_t i = 0; i < block.palette.size(); i++)
+  {
+    if (!used[i])
+      continue;
+    remap[i] = (uint32_t)palette.size();
+    palette.push_back(block.palette[i]);
+  }
+
+  if (palette.size() == block.palette.size())
+    return false;
+
+  repackBlock(block, bitsForPaletteSize(palette.size()), remap.data());
+  block.palette = std::move(palette);
+  return true;
+}
+
+static uint32_t getBlockColor(const WorldMapBlock& block, uint32_t i)
+{
+  return block.palette.empty() ? 0 : block.palette[getBlockIndex(block, i)];
+}
+
+static void setBlockColor(WorldMapBlock& block, uint32_t i, uint32_t color)
+{
+  if (block.palette.empty())
+    block.palette.push_back(0);
+
+  uint32_t index = 0;
+  while (index < block.palette.size() && block.palette[index] != color)
+    index++;
+
+  if (index == block.palette.size())
+  {
+    if (index == (1u << block.bitsPerIndex) && compactBlock(block))
+      index = (uint32_t)block.palette.size();
+    if (index == (1u << block.bitsPerIndex))
+      repackBlock(block, block.bitsPerIndex + 1, nullptr);
+    block.palette.push_back(color);
+  }
+
+  setBlockIndex(block, i, index);
+}
+
+static void decodeBlock(const WorldMapBlock& block, uint32_t* texels)
+{
+  if (block.palette.empty())
+  {
+    memset(texels, 0, WORLD_MAP_PAGE_BYTES);
+    return;
+  }
+
+  for (uint32_t i = 0; i < WORLD_MAP_BLOCK_TEXELS; i++)
+    texels[i] = block.palette[getBlockIndex(block, i)];
+}
+
+static void markBlockDirty(WorldMapLevel& level, uint32_t block)
+{
+  if (level.dirty[block])
+    return;
+
+  level.dirty[block] = 1;
+  level.dirtyList.push_back(block);
+}
+
+static void createWorldMapAtlas(WorldMap& map, const VkPhysicalDevice physicalDevice,
+                                uint32_t atlasSize)
+{
+  const VkDevice logicalDevice = map.logicalDevice;
+
+  VkImageCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ci.imageType = VK_IMAGE_TYPE_2D;
+  ci.format = VK_FORMAT_R8G8B8A8_UNORM;
+  ci.extent = { atlasSize, atlasSize, 1 };
+  ci.mipLevels = 1;
+  ci.arrayLayers = 1;
+  ci.samples = VK_SAMPLE_COUNT_1_BIT;
+  ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ci.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if (vkCreateImage(logicalDevice, &ci, nullptr, &map.atlas) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create world map atlas");
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(logicalDevice, map.atlas, &requirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &map.atlasMemory) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate world map atlas memory");
+
+  vkBindImageMemory(logicalDevice, map.atlas, map.atlasMemory, 0);
+
+  VkImageViewCreateInfo viewCI{};
+  viewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewCI.image = map.atlas;
+  viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewCI.format = ci.format;
+  viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  if (vkCreateImageView(logicalDevice, &viewCI, nullptr, &map.atlasView) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create world map atlas view");
+
+  VkSamplerCreateInfo samplerCI{};
+  samplerCI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCI.magFilter = VK_FILTER_NEAREST;
+  samplerCI.minFilter = VK_FILTER_NEAREST;
+  samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (vkCreateSampler(logicalDevice, &samplerCI, nullptr, &map.sampler) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create world map sampler");
+}
+
+static void createWorldMapPipeline(WorldMap& map, const WorldMapCreateInfo& createInfo)
+{
+  const VkDevice logicalDevice = map.logicalDevice;
+
+  VkDescriptorSetLayoutBinding bindings[2]{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutCI{};
+  layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutCI.bindingCount = 2;
+  layoutCI.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(logicalDevice, &layoutCI, nullptr, &map.descriptorSetLayout) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create world map descriptor set layout");
+
+  VkDescriptorPoolSize poolSizes[] = {
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+  };
+
+  VkDescriptorPoolCreateInfo poolCI{};
+  poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCI.maxSets = 1;
+  poolCI.poolSizeCount = 2;
+  poolCI.pPoolSizes = poolSizes;
+  if (vkCreateDescriptorPool(logicalDevice, &poolCI, nullptr, &map.descriptorPool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create world map descriptor pool");
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = map.descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &map.descriptorSetLayout;
+  if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &map.descriptorSet) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate world map descriptor set");
+
+  VkDescriptorImageInfo imageInfo{ map.sampler, map.atlasView,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+  VkDescriptorBufferInfo bufferInfo{ map.pageTableBuffer.buffer, 0,
+                                     map.pageTable.size() * sizeof(uint32_t) };
+
+  VkWriteDescriptorSet writes[2]{};
+  writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[0].dstSet = map.descriptorSet;
+  writes[0].dstBinding = 0;
+  writes[0].descriptorCount = 1;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[0].pImageInfo = &imageInfo;
+  writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[1].dstSet = map.descriptorSet;
+  writes[1].dstBinding = 1;
+  writes[1].descriptorCount = 1;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  writes[1].pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(logicalDevice, 2, writes, 0, nullptr);
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.size = sizeof(WorldMapPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+  pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutCI.setLayoutCount = 1;
+  pipelineLayoutCI.pSetLayouts = &map.descriptorSetLayout;
+  pipelineLayoutCI.pushConstantRangeCount = 1;
+  pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &map.pipelineLayout) !=
+      VK_SUCCESS)
+    throw std::runtime_error("Failed to create world map pipeline layout");
+
+  VkShaderModule vertexModule = createShaderModule(logicalDevice, createInfo.vertexShader);
+  VkShaderModule fragmentModule = createShaderModule(logicalDevice, createInfo.fragmentShader);
+
+  GraphicsPipelineDesc desc;
+  desc.vertexShader = vertexModule;
+  desc.fragmentShader = fragmentModule;
+  desc.layout = map.pipelineLayout;
+  desc.renderPass = createInfo.renderPass;
+  map.pipeline = buildGraphicsPipeline(logicalDevice, desc);
+
+  vkDestroyShaderModule(logicalDevice, fragmentModule, nullptr);
+  vkDestroyShaderModule(logicalDevice, vertexModule, nullptr);
+}
+
+WorldMap createWorldMap(const WorldMapCreateInfo& createInfo)
+{
+  if (createInfo.width == 0 || createInfo.height == 0 || !createInfo.tileColor)
+    throw std::runtime_error("createWorldMap: invalid create info");
+
+  WorldMap map;
+  map.logicalDevice = createInfo.logicalDevice;
+  map.width = createInfo.width;
+  map.height = createInfo.height;
+  map.tileColor = createInfo.tileColor;
+  map.userData = createInfo.userData;
+  map.maxUploadsPerFrame = createInfo.maxUploadsPerFrame;
+  map.framesInFlight = createInfo.framesInFlight;
+
+  // halve until a single block covers the world
+  uint32_t pageTableSize = 0;
+  for (uint32_t level = 0; level < WORLD_MAP_MAX_LEVELS; level++)
+  {
+    const uint32_t blockTiles = WORLD_MAP_BLOCK_SIZE << level;
+
+    WorldMapLevel& l = map.levels.emplace_back();
+    l.blocksX = (map.width + blockTiles - 1) / blockTiles;
+    l.blocksY = (map.height + blockTiles - 1) / blockTiles;
+    l.pageTableOffset = pageTableSize;
+    l.dirty.assign(l.blocksX * l.blocksY, 0);
+    if (level > 0)
+      l.texels.resize(l.blocksX * l.blocksY);
+    pageTableSize += l.blocksX * l.blocksY;
+
+    if (l.blocksX == 1 && l.blocksY == 1)
+      break;
+  }
+  map.blocks.resize(map.levels[0].blocksX * map.levels[0].blocksY);
+
+  map.pagesPerRow = createInfo.atlasSize / WORLD_MAP_BLOCK_SIZE;
+  const uint32_t pageCount = map.pagesPerRow * map.pagesPerRow;
+  map.pages.resize(pageCount);
+  for (uint32_t i = pageCount; i-- > 0;)
+    map.freePages.push_back(i);
+
+  map.blockPages.assign(pageTableSize, WORLD_MAP_NO_PAGE);
+  map.pageTable.assign(pageTableSize, WORLD_MAP_NO_PAGE);
+  map.queued.assign(pageTableSize, 0);
+
+  // pin the coarsest levels that fit in a quarter of the atlas
+  uint32_t pinnedBlocks = 0;
+  map.pinnedLevel = (uint32_t)map.levels.size();
+  while (map.pinnedLevel > 0)
+  {
+    const WorldMapLevel& l = map.levels[map.pinnedLevel - 1];
+    if (pinnedBlocks + l.blocksX * l.blocksY > pageCount / 4)
+      break;
+    pinnedBlocks += l.blocksX * l.blocksY;
+    map.pinnedLevel--;
+  }
+
+  createWorldMapAtlas(map, createInfo.physicalDevice, createInfo.atlasSize);
+
+  map.staging = createBuffer(
+    createInfo.physicalDevice, map.logicalDevice,
+    (VkDeviceSize)map.maxUploadsPerFrame * WORLD_MAP_PAGE_BYTES * map.framesInFlight,
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  map.pageTableSegmentSize = (pageTableSize * sizeof(uint32_t) + 255) / 256 * 256;
+  map.pageTableBuffer = createBuffer(
+    createInfo.physicalDevice, map.logicalDevice, map.pageTableSegmentSize * map.framesInFlight,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  // forces every segment to be written on its first use
+  map.segmentVersions.assign(map.framesInFlight, ~0ull);
+
+  createWorldMapPipeline(map, createInfo);
+
+  return map;
+}
+
+void destroyWorldMap(WorldMap& map)
+{
+  const VkDevice logicalDevice = map.logicalDevice;
+
+  vkDestroyPipeline(logicalDevice, map.pipeline, nullptr);
+  vkDestroyPipelineLayout(logicalDevice, map.pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(logicalDevice, map.descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(logicalDevice, map.descriptorSetLayout, nullptr);
+
+  destroyBuffer(logicalDevice, map.pageTableBuffer);
+  destroyBuffer(logicalDevice, map.staging);
+
+  vkDestroySampler(logicalDevice, map.sampler, nullptr);
+  vkDestroyImageView(logicalDevice, map.atlasView, nullptr);
+  vkDestroyImage(logicalDevice, map.atlas, nullptr);
+  vkFreeMemory(logicalDevice, map.atlasMemory, nullptr);
+
+  map = {};
+}
+
+void revealWorldMap(WorldMap& map, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, (int32_t)map.width);
+  y1 = std::min(y1, (int32_t)map.height);
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  WorldMapLevel& level = map.levels[0];
+  for (int32_t by = y0 >> WORLD_MAP_BLOCK_SHIFT; by <= (y1 - 1) >> WORLD_MAP_BLOCK_SHIFT; by++)
+  {
+    for (int32_t bx = x0 >> WORLD_MAP_BLOCK_SHIFT; bx <= (x1 - 1) >> WORLD_MAP_BLOCK_SHIFT; bx++)
+    {
+      const uint32_t blockIndex = by * level.blocksX + bx;
+      WorldMapBlock& block = map.blocks[blockIndex];
+
+      const int32_t baseX = bx << WORLD_MAP_BLOCK_SHIFT;
+      const int32_t baseY = by << WORLD_MAP_BLOCK_SHIFT;
+      const int32_t tx0 = std::max(x0, baseX);
+      const int32_t ty0 = std::max(y0, baseY);
+      const int32_t tx1 = std::min(x1, baseX + (int32_t)WORLD_MAP_BLOCK_SIZE);
+      const int32_t ty1 = std::min(y1, baseY + (int32_t)WORLD_MAP_BLOCK_SIZE);
+
+      bool changed = false;
+      for (int32_t y = ty0; y < ty1; y++)
+      {
+        for (int32_t x = tx0; x < tx1; x++)
+        {
+          const uint32_t i = (y - baseY) * WORLD_MAP_BLOCK_SIZE + (x - baseX);
+          if (getBlockColor(block, i) != 0)
+            continue;
+
+          setBlockColor(block, i, map.tileColor(map.userData, x, y) | 0xff000000);
+          changed = true;
+        }
+      }
+
+      if (changed)
+        markBlockDirty(level, blockIndex);
+    }
+  }
+}
+
+void revealWorldMapCircle(WorldMap& map, int32_t centerX, int32_t centerY, int32_t radius)
+{
+  for (int32_t dy = -radius; dy <= radius; dy++)
+  {
+    const int32_t half = (int32_t)std::sqrt((float)(radius * radius - dy * dy));
+    revealWorldMap(map, centerX - half, centerY + dy, centerX + half + 1, centerY + dy + 1);
+  }
+}
+
+void onWorldMapTileChanged(WorldMap& map, int32_t x, int32_t y)
+{
+  if (x < 0 || y < 0 || x >= (int32_t)map.width || y >= (int32_t)map.height)
+    return;
+
+  const uint32_t blockIndex =
+    (y >> WORLD_MAP_BLOCK_SHIFT) * map.levels[0].blocksX + (x >> WORLD_MAP_BLOCK_SHIFT);
+  WorldMapBlock& block = map.blocks[blockIndex];
+  const uint32_t i = (y & (WORLD_MAP_BLOCK_SIZE - 1)) * WORLD_MAP_BLOCK_SIZE +
+                     (x & (WORLD_MAP_BLOCK_SIZE - 1));
+
+  const uint32_t previous = getBlockColor(block, i);
+  if (previous == 0)
+    return;
+
+  const uint32_t color = map.tileColor(map.userData, x, y) | 0xff000000;
+  if (color == previous)
+    return;
+
+  setBlockColor(block, i, color);
+  markBlockDirty(map.levels[0], blockIndex);
+}
+
+uint32_t getWorldMapColor(const WorldMap& map, int32_t x, int32_t y)
+{
+  if (x < 0 || y < 0 || x >= (int32_t)map.width || y >= (int32_t)map.height)
+    return 0;
+
+  const WorldMapBlock& block =
+    map.blocks[(y >> WORLD_MAP_BLOCK_SHIFT) * map.levels[0].blocksX + (x >> WORLD_MAP_BLOCK_SHIFT)];
+  return getBlockColor(block, (y & (WORLD_MAP_BLOCK_SIZE - 1)) * WORLD_MAP_BLOCK_SIZE +
+                                (x & (WORLD_MAP_BLOCK_SIZE - 1)));
+}
+
+static bool hasBlockData(const WorldMap& map, uint32_t level, uint32_t block)
+{
+  if (level == 0)
+    return !map.blocks[block].palette.empty();
+  return !map.levels[level].texels[block].empty();
+}
+
+// Averages the 2x2 children of a block, weighting colors by how much of them is revealed.
+static void rebuildMipBlock(WorldMap& map, uint32_t level, uint32_t bx, uint32_t by,
+                            uint32_t* scratch)
+{
+  const WorldMapLevel& child = map.levels[level - 1];
+  WorldMapLevel& parent = map.levels[level];
+  std::vector<uint32_t>& texels = parent.texels[by * parent.blocksX + bx];
+  texels.assign(WORLD_MAP_BLOCK_TEXELS, 0);
+
+  constexpr uint32_t HALF = WORLD_MAP_BLOCK_SIZE / 2;
+  for (uint32_t cy = 0; cy < 2; cy++)
+  {
+    for (uint32_t cx = 0; cx < 2; cx++)
+    {
+      const uint32_t childX = bx * 2 + cx;
+      const uint32_t childY = by * 2 + cy;
+      if (childX >= child.blocksX || childY >= child.blocksY)
+        continue;
+
+      const uint32_t childIndex = childY * child.blocksX + childX;
+      if (!hasBlockData(map, level - 1, childIndex))
+        continue;
+
+      const uint32_t* src = scratch;
+      if (level == 1)
+        decodeBlock(map.blocks[childIndex], scratch);
+      else
+        src = child.texels[childIndex].data();
+
+      for (uint32_t y = 0; y < HALF; y++)
+      {
+        for (uint32_t x = 0; x < HALF; x++)
+        {
+          uint32_t sum[4] = {};
+          for (uint32_t s = 0; s < 4; s++)
+          {
+            const uint32_t texel = src[(y * 2 + s / 2) * WORLD_MAP_BLOCK_SIZE + x * 2 + s % 2];
+            const uint32_t alpha = texel >> 24;
+            sum[0] += (texel & 0xff) * alpha;
+            sum[1] += (texel >> 8 & 0xff) * alpha;
+            sum[2] += (texel >> 16 & 0xff) * alpha;
+            sum[3] += alpha;
+          }
+          if (sum[3] == 0)
+            continue;
+
+          const uint32_t color = (sum[0] / sum[3]) | (sum[1] / sum[3]) << 8 |
+                                 (sum[2] / sum[3]) << 16 | (sum[3] / 4) << 24;
+          texels[(cy * HALF + y) * WORLD_MAP_BLOCK_SIZE + cx * HALF + x] = color;
+        }
+      }
+    }
+  }
+}
+
+static void queueUpload(WorldMap& map, uint32_t entry)
+{
+  if (map.queued[entry])
+    return;
+
+  map.queued[entry] = 1;
+  map.uploadQueue.push_back(entry);
+}
+
+// Gives the block a page, evicting the one that was not seen for the longest time when the atlas
+// is full.
+static void makeResident(WorldMap& map, uint32_t level, uint32_t block)
+{
+  const uint32_t entry = map.levels[level].pageTableOffset + block;
+  if (map.blockPages[entry] != WORLD_MAP_NO_PAGE)
+  {
+    map.pages[map.blockPages[entry]].lastUsed = map.frame;
+    return;
+  }
+  if (!hasBlockData(map, level, block))
+    return;
+
+  uint32_t page = WORLD_MAP_NO_PAGE;
+  if (!map.freePages.empty())
+  {
+    page = map.freePages.back();
+    map.freePages.pop_back();
+  }
+  else
+  {
+    uint64_t oldest = map.frame;
+    for (uint32_t i = 0; i < map.pages.size(); i++)
+    {
+      const WorldMapPage& candidate = map.pages[i];
+      if (!candidate.pinned && candidate.lastUsed < oldest)
+      {
+        oldest = candidate.lastUsed;
+        page = i;
+      }
+    }
+    if (page == WORLD_MAP_NO_PAGE)
+      return;
+
+    // the copy into the page is recorded after every earlier draw reading it, so only the page
+    // table has to forget it
+    const uint32_t evicted = map.pages[page].entry;
+    map.blockPages[evicted] = WORLD_MAP_NO_PAGE;
+    if (map.pageTable[evicted] != WORLD_MAP_NO_PAGE)
+    {
+      map.pageTable[evicted] = WORLD_MAP_NO_PAGE;
+      map.pageTableVersion++;
+    }
+  }
+
+  map.pages[page] = { entry, map.frame, level >= map.pinnedLevel };
+  map.blockPages[entry] = page;
+  queueUpload(map, entry);
+}
+
+void updateWorldMap(WorldMap& map, uint32_t level, float x0, float y0, float x1, float y1)
+{
+  map.frame++;
+
+  for (uint32_t l = 0; l < map.levels.size(); l++)
+  {
+    WorldMapLevel& current = map.levels[l];
+    if (current.dirtyList.empty())
+      continue;
+
+    if (l > 0 && map.scratch.empty())
+      map.scratch.resize(WORLD_MAP_BLOCK_TEXELS);
+
+    for (uint32_t block : current.dirtyList)
+    {
+      current.dirty[block] = 0;
+
+      const uint32_t bx = block % current.blocksX;
+      const uint32_t by = block / current.blocksX;
+      if (l > 0)
+        rebuildMipBlock(map, l, bx, by, map.scratch.data());
+
+      const uint32_t entry = current.pageTableOffset + block;
+      if (l >= map.pinnedLevel)
+        makeResident(map, l, block);
+      if (map.blockPages[entry] != WORLD_MAP_NO_PAGE)
+        queueUpload(map, entry);
+
+      if (l + 1 < map.levels.size())
+      {
+        WorldMapLevel& parent = map.levels[l + 1];
+        markBlockDirty(parent, (by / 2) * parent.blocksX + bx / 2);
+      }
+    }
+    current.dirtyList.clear();
+  }
+
+  level = std::min(level, (uint32_t)map.levels.size() - 1);
+  if (level >= map.pinnedLevel)
+    return;
+
+  const WorldMapLevel& view = map.levels[level];
+  const float blockTiles = (float)(WORLD_MAP_BLOCK_SIZE << level);
+  const int32_t bx0 = std::max((int32_t)std::floor(x0 / blockTiles), 0);
+  const int32_t by0 = std::max((int32_t)std::floor(y0 / blockTiles), 0);
+  const int32_t bx1 = std::min((int32_t)std::ceil(x1 / blockTiles), (int32_t)view.blocksX);
+  const int32_t by1 = std::min((int32_t)std::ceil(y1 / blockTiles), (int32_t)view.blocksY);
+  for (int32_t by = by0; by < by1; by++)
+    for (int32_t bx = bx0; bx < bx1; bx++)
+      makeResident(map, level, by * view.blocksX + bx);
+}
+
+uint32_t chooseWorldMapLevel(const WorldMap& map, float tilesPerPixel)
+{
+  uint32_t level = 0;
+  while (level + 1 < map.levels.size() && (float)(2u << level) <= tilesPerPixel)
+    level++;
+  return level;
+}
+
+static void transitionAtlas(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout,
+                            VkImageLayout newLayout)
+{
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+  VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  if (newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+  {
+    srcStage = oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+                                                      : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    barrier.srcAccessMask = oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? 0
+                                                                   : VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  }
+
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// Level and block of a page table entry.
+static void decodeEntry(const WorldMap& map, uint32_t entry, uint32_t& level, uint32_t& block)
+{
+  level = 0;
+  while (level + 1 < map.levels.size() && map.levels[level + 1].pageTableOffset <= entry)
+    level++;
+  block = entry - map.levels[level].pageTableOffset;
+}
+
+void recordWorldMapUploads(VkCommandBuffer commandBuffer, WorldMap& map, uint32_t frameIndex)
+{
+  frameIndex %= map.framesInFlight;
+
+  if (!map.atlasInitialized)
+  {
+    transitionAtlas(commandBuffer, map.atlas, VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    map.atlasInitialized = true;
+  }
+
+  VkBufferImageCopy regions[64];
+  uint32_t regionCount = 0;
+  const uint32_t maxUploads = std::min(map.maxUploadsPerFrame, 64u);
+  const VkDeviceSize stagingOffset =
+    (VkDeviceSize)frameIndex * map.maxUploadsPerFrame * WORLD_MAP_PAGE_BYTES;
+
+  size_t consumed = 0;
+  for (; consumed < map.uploadQueue.size() && regionCount < maxUploads; consumed++)
+  {
+    const uint32_t entry = map.uploadQueue[consumed];
+    map.queued[entry] = 0;
+
+    const uint32_t page = map.blockPages[entry];
+    if (page == WORLD_MAP_NO_PAGE)
+      continue;
+
+    uint32_t level, block;
+    decodeEntry(map, entry, level, block);
+
+    const VkDeviceSize offset = stagingOffset + (VkDeviceSize)regionCount * WORLD_MAP_PAGE_BYTES;
+    uint32_t* texels = (uint32_t*)((char*)map.staging.mapped + offset);
+    if (level == 0)
+      decodeBlock(map.blocks[block], texels);
+    else
+      memcpy(texels, map.levels[level].texels[block].data(), WORLD_MAP_PAGE_BYTES);
+
+    VkBufferImageCopy& region = regions[regionCount++];
+    region = {};
+    region.bufferOffset = offset;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageOffset = { (int32_t)(page % map.pagesPerRow * WORLD_MAP_BLOCK_SIZE),
+                           (int32_t)(page / map.pagesPerRow * WORLD_MAP_BLOCK_SIZE), 0 };
+    region.imageExtent = { WORLD_MAP_BLOCK_SIZE, WORLD_MAP_BLOCK_SIZE, 1 };
+
+    if (map.pageTable[entry] != page)
+    {
+      map.pageTable[entry] = page;
+      map.pageTableVersion++;
+    }
+  }
+  map.uploadQueue.erase(map.uploadQueue.begin(), map.uploadQueue.begin() + consumed);
+
+  if (regionCount > 0)
+  {
+    transitionAtlas(commandBuffer, map.atlas, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdCopyBufferToImage(commandBuffer, map.staging.buffer, map.atlas,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions);
+    transitionAtlas(commandBuffer, map.atlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+
+  if (map.segmentVersions[frameIndex] != map.pageTableVersion)
+  {
+    memcpy((char*)map.pageTableBuffer.mapped + frameIndex * map.pageTableSegmentSize,
+           map.pageTable.data(), map.pageTable.size() * sizeof(uint32_t));
+    map.segmentVersions[frameIndex] = map.pageTableVersion;
+  }
+}
+
+void recordWorldMapDraw(VkCommandBuffer commandBuffer, const WorldMap& map, uint32_t frameIndex,
+                        uint32_t level, float x0, float y0, float x1, float y1)
+{
+  WorldMapPushConstants pc{};
+  pc.origin[0] = x0;
+  pc.origin[1] = y0;
+  pc.extent[0] = x1 - x0;
+  pc.extent[1] = y1 - y0;
+  pc.level = std::min(level, (uint32_t)map.levels.size() - 1);
+  pc.levelCount = (uint32_t)map.levels.size();
+  pc.width = map.width;
+  pc.height = map.height;
+  pc.pagesPerRow = map.pagesPerRow;
+
+  const uint32_t dynamicOffset =
+    (uint32_t)((frameIndex % map.framesInFlight) * map.pageTableSegmentSize);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, map.pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, map.pipelineLayout, 0, 1,
+                          &map.descriptorSet, 1, &dynamicOffset);
+  vkCmdPushConstants(commandBuffer, map.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                     sizeof(pc), &pc);
+  vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+uint64_t getWorldMapMemoryBytes(const WorldMap& map)
+{
+  uint64_t bytes = map.blocks.size() * sizeof(WorldMapBlock);
+  for (const WorldMapBlock& block : map.blocks)
+    bytes += block.palette.capacity() * sizeof(uint32_t) +
+             block.indices.capacity() * sizeof(uint64_t);
+
+  for (const WorldMapLevel& level : map.levels)
+    for (const std::vector<uint32_t>& texels : level.texels)
+      bytes += sizeof(texels) + texels.capacity() * sizeof(uint32_t);
+
+  return bytes;
+}
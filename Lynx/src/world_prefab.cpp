@@ -0,0 +1,210 @@
+#include <Lynx/world_prefab.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static bool isPrefabTileSolid(uint8_t flags)
+{
+  return (flags & (TILE_ACTIVE | TILE_SOLID | TILE_ACTUATED)) == (TILE_ACTIVE | TILE_SOLID);
+}
+
+// 64 bits of a mask row from bit x on, clear past the end of the row.
+static uint64_t getTileSolidBits(const uint64_t* row, uint32_t wordsPerRow, int32_t x)
+{
+  const uint32_t word = (uint32_t)x >> 6;
+  const uint32_t shift = (uint32_t)x & 63;
+  uint64_t bits = word < wordsPerRow ? row[word] >> shift : 0;
+  if (shift && word + 1 < wordsPerRow)
+    bits |= row[word + 1] << (64 - shift);
+  return bits;
+}
+
+static void setTileSolidBit(TileSolidMask& mask, int32_t x, int32_t y, bool solid)
+{
+  uint64_t& word = mask.bits[(size_t)y * mask.wordsPerRow + ((uint32_t)x >> 6)];
+  const uint64_t bit = 1ull << (x & 63);
+  word = solid ? word | bit : word & ~bit;
+}
+
+PrefabTemplate compilePrefab(const TileStore& store, const std::vector<std::string>& rows,
+                             const std::vector<PrefabLegend>& legend)
+{
+  const PrefabLegend* symbols[256] = {};
+  for (const PrefabLegend& entry : legend)
+    symbols[(uint8_t)entry.symbol] = &entry;
+
+  PrefabTemplate prefab;
+  prefab.height = (int32_t)rows.size();
+  prefab.width = rows.empty() ? 0 : (int32_t)rows[0].size();
+  prefab.wordsPerRow = (uint32_t)(prefab.width + 63) / 64;
+  prefab.emptyMask.assign((size_t)prefab.wordsPerRow * prefab.height, 0);
+  prefab.solidMask.assign((size_t)prefab.wordsPerRow * prefab.height, 0);
+
+  for (int32_t y = 0; y < prefab.height; y++)
+  {
+    if ((int32_t)rows[y].size() != prefab.width)
+      throw std::runtime_error("compilePrefab: rows differ in length");
+
+    PrefabRun* run = nullptr;
+    for (int32_t x = 0; x < prefab.width; x++)
+    {
+      const PrefabLegend* entry = symbols[(uint8_t)rows[y][x]];
+      if (!entry)
+        throw std::runtime_error(std::string("compilePrefab: unknown symbol '") + rows[y][x] + "'");
+
+      const uint64_t bit = 1ull << (x & 63);
+      const size_t word = (size_t)y * prefab.wordsPerRow + x / 64;
+      if (entry->requirement == PREFAB_EMPTY)
+        prefab.emptyMask[word] |= bit;
+      else if (entry->requirement == PREFAB_SOLID)
+        prefab.solidMask[word] |= bit;
+
+      if (!entry->stamp)
+      {
+        run = nullptr;
+        continue;
+      }
+      if (!run)
+      {
+        prefab.runs.push_back({ x, y, 0, (uint32_t)prefab.types.size() });
+        run = &prefab.runs.back();
+      }
+      run->count++;
+
+      const Tile& tile = entry->tile;
+      uint8_t flags = tile.flags & ~(TILE_ACTIVE | TILE_TYPE_FLAGS);
+      if (tile.type != 0 || (tile.flags & TILE_ACTIVE))
+        flags |= TILE_ACTIVE | store.typeFlags[tile.type];
+      prefab.types.push_back(tile.type);
+      prefab.flags.push_back(flags);
+      prefab.liquids.push_back(tile.liquid);
+      prefab.attributes.push_back(packTileAttributes(tile));
+    }
+  }
+  return prefab;
+}
+
+void buildTileSolidMask(const TileStore& store, TileSolidMask& mask)
+{
+  mask.width = store.width;
+  mask.height = store.height;
+  mask.wordsPerRow = (uint32_t)(store.width + 63) / 64;
+  mask.bits.assign((size_t)mask.wordsPerRow * mask.height, 0);
+  updateTileSolidMask(store, mask, 0, 0, store.width, store.height);
+}
+
+void updateTileSolidMask(const TileStore& store, TileSolidMask& mask, int32_t x0, int32_t y0,
+                         int32_t x1, int32_t y1)
+{
+  y0 = std::max(y0, 0);
+  y1 = std::min(y1, store.height);
+  for (int32_t y = y0; y < y1; y++)
+  {
+    forEachTileRowView(store, y, x0, x1, [&](const TileRowView& view, int32_t x) {
+      for (int32_t i = 0; i < view.count; i++)
+        setTileSolidBit(mask, x + i, y, isPrefabTileSolid(view.flags[i]));
+    });
+  }
+}
+
+bool canPlacePrefab(const TileSolidMask& mask, const PrefabTemplate& prefab, int32_t x, int32_t y)
+{
+  if (x < 0 || y < 0 || x + prefab.width > mask.width || y + prefab.height > mask.height)
+    return false;
+
+  for (int32_t row = 0; row < prefab.height; row++)
+  {
+    const uint64_t* world = mask.bits.data() + (size_t)(y + row) * mask.wordsPerRow;
+    const size_t first = (size_t)row * prefab.wordsPerRow;
+    for (uint32_t w = 0; w < prefab.wordsPerRow; w++)
+    {
+      const uint64_t solid = getTileSolidBits(world, mask.wordsPerRow, x + (int32_t)w * 64);
+      if ((solid & prefab.emptyMask[first + w]) ||
+          (~solid & prefab.solidMask[first + w]))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool findPrefabPlacement(const TileSolidMask& mask, const PrefabTemplate& prefab,
+                         RandomStream& random, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                         uint32_t attempts, int32_t& x, int32_t& y)
+{
+  if (x1 <= x0 || y1 <= y0)
+    return false;
+
+  for (uint32_t attempt = 0; attempt < attempts; attempt++)
+  {
+    const int32_t px = nextRandomRange(random, x0, x1 - 1);
+    const int32_t py = nextRandomRange(random, y0, y1 - 1);
+    if (canPlacePrefab(mask, prefab, px, py))
+    {
+      x = px;
+      y = py;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Copies the runs into the raw chunks of store, a copy per field and chunk a run crosses.
+static void copyPrefabRuns(TileStore& store, const PrefabTemplate& prefab, int32_t x, int32_t y,
+                           TileSolidMask* mask)
+{
+  for (const PrefabRun& run : prefab.runs)
+  {
+    const int32_t ty = y + run.y;
+    int32_t tx = x + run.x;
+    uint32_t source = run.first;
+    int32_t remaining = run.count;
+    while (remaining > 0)
+    {
+      TileChunkRaw& raw = *store.chunks[getTileChunkSlot(store, tx, ty)].raw;
+      const uint32_t i = getTileIndexInChunk(tx, ty);
+      const int32_t count = std::min(remaining, TILE_CHUNK_SIZE - (tx & TILE_CHUNK_MASK));
+      memcpy(raw.hot.types + i, prefab.types.data() + source, count * sizeof(uint16_t));
+      memcpy(raw.hot.flags + i, prefab.flags.data() + source, count * sizeof(uint8_t));
+      memcpy(raw.cold.liquids + i, prefab.liquids.data() + source, count * sizeof(uint8_t));
+      memcpy(raw.cold.attributes + i, prefab.attributes.data() + source,
+             count * sizeof(uint32_t));
+
+      if (mask)
+      {
+        for (int32_t k = 0; k < count; k++)
+          setTileSolidBit(*mask, tx + k, ty, isPrefabTileSolid(prefab.flags[source + k]));
+      }
+      tx += count;
+      source += count;
+      remaining -= count;
+    }
+  }
+}
+
+void stampPrefab(TileStore& store, const PrefabTemplate& prefab, int32_t x, int32_t y,
+                 TileSolidMask* mask)
+{
+  if (x < 0 || y < 0 || x + prefab.width > store.width || y + prefab.height > store.height)
+    throw std::runtime_error("stampPrefab: template does not fit in the world");
+  if (prefab.runs.empty())
+    return;
+
+  for (int32_t cy = y >> TILE_CHUNK_SHIFT; cy <= (y + prefab.height - 1) >> TILE_CHUNK_SHIFT; cy++)
+  {
+    for (int32_t cx = x >> TILE_CHUNK_SHIFT; cx <= (x + prefab.width - 1) >> TILE_CHUNK_SHIFT;
+         cx++)
+      getWritableTileChunk(store, store.chunkSlots[cy * store.chunksX + cx]);
+  }
+  copyPrefabRuns(store, prefab, x, y, mask);
+  notifyTilesChanged(store, x, y, x + prefab.width, y + prefab.height);
+}
+
+void stampWorldGenPrefab(const WorldGenContext& context, const PrefabTemplate& prefab, int32_t x,
+                         int32_t y, TileSolidMask* mask)
+{
+  if (x < context.x0 || y < context.y0 || x + prefab.width > context.x1 ||
+      y + prefab.height > context.y1)
+    throw std::runtime_error("stampWorldGenPrefab: template is outside the region of the job");
+  copyPrefabRuns(*context.store, prefab, x, y, mask);
+}
@@ -18,6 +18,9 @@ for %%F in ("%SRC_DIR%\*.*") do (
     echo !FILENAME! | findstr /i "\.fragment\." >nul
     if !errorlevel! equ 0 set "STAGE=frag"
 
+    echo !FILENAME! | findstr /i "\.compute\." >nul
+    if !errorlevel! equ 0 set "STAGE=comp"
+
     if defined STAGE (
         glslc -fshader-stage=!STAGE! "%%F" -o "%BIN_DIR%\!FILENAME!.spv"
     ) else (
@@ -0,0 +1,40 @@
+#version 460
+
+struct BackgroundInstance
+{
+  vec2 scroll;
+  vec2 uvScale;
+  vec2 size;
+  float offsetY;
+  float alpha;
+  uint layer;
+  uint padding0;
+  uint padding1;
+  uint padding2;
+};
+
+layout(set = 0, binding = 0) uniform sampler2DArray backgrounds;
+
+layout(std430, set = 0, binding = 1) readonly buffer Instances
+{
+  BackgroundInstance instances[];
+};
+
+layout(location = 0) in vec2 oLayerPosition;
+layout(location = 1) flat in uint oInstance;
+layout(location = 0) out vec4 oColor;
+
+void main()
+{
+  BackgroundInstance instance = instances[oInstance];
+
+  vec2 uv = oLayerPosition / instance.size;
+  if (uv.y < 0.0 || uv.y >= 1.0)
+    discard;
+
+  // layers repeat horizontally
+  uv.x = fract(uv.x);
+
+  vec4 color = texture(backgrounds, vec3(uv * instance.uvScale, float(instance.layer)));
+  oColor = vec4(color.rgb, color.a * instance.alpha);
+}
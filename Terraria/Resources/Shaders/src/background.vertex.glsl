@@ -0,0 +1,45 @@
+#version 460
+
+struct BackgroundInstance
+{
+  vec2 scroll;
+  vec2 uvScale;
+  vec2 size;
+  float offsetY;
+  float alpha;
+  uint layer;
+  uint padding0;
+  uint padding1;
+  uint padding2;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Instances
+{
+  BackgroundInstance instances[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+  vec2 camera;
+  vec2 viewSize;
+}
+pc;
+
+layout(location = 0) out vec2 oLayerPosition;
+layout(location = 1) flat out uint oInstance;
+
+const vec2 corners[6] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 1.0, 1.0 },
+                          { 0.0, 0.0 }, { 1.0, 1.0 }, { 0.0, 1.0 } };
+
+void main()
+{
+  BackgroundInstance instance = instances[gl_InstanceIndex];
+  vec2 screen = corners[gl_VertexIndex] * pc.viewSize;
+
+  gl_Position = vec4(corners[gl_VertexIndex] * 2.0 - 1.0, 0.0, 1.0);
+
+  // position inside the layer in texture pixels, the layer moves scroll times as fast as the
+  // camera
+  oLayerPosition = screen + pc.camera * instance.scroll - vec2(0.0, instance.offsetY);
+  oInstance = gl_InstanceIndex;
+}
@@ -0,0 +1,39 @@
+#version 460
+
+layout(location = 0) in vec2 oUv;
+layout(location = 0) out vec4 oColor;
+
+// fraction of full daylight reaching each tile after propagation, independent of time of day
+layout(set = 0, binding = 0) uniform sampler2D skyLight;
+// torches, glowing tiles and other emitters
+layout(set = 0, binding = 1) uniform sampler2D blockLight;
+
+// first light-blocking tile of every world column, uploaded by the dirty range of the heightmap
+layout(std430, set = 0, binding = 2) readonly buffer ColumnTops
+{
+  int columnTops[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+  vec4 skyColor;
+  float dayBrightness;
+  int viewOriginX;
+  int viewOriginY;
+  int columnCount;
+}
+pc;
+
+void main()
+{
+  ivec2 lightSize = textureSize(skyLight, 0);
+  ivec2 tile = ivec2(oUv * vec2(lightSize));
+
+  // the light map starts at viewOriginX, the column buffer at the left edge of the world
+  int column = clamp(pc.viewOriginX + tile.x, 0, pc.columnCount - 1);
+  float direct = (pc.viewOriginY + tile.y) < columnTops[column] ? 1.0 : 0.0;
+  float sky = max(texture(skyLight, oUv).r, direct);
+
+  vec3 light = texture(blockLight, oUv).rgb + pc.skyColor.rgb * (sky * pc.dayBrightness);
+  oColor = vec4(min(light, vec3(1.0)), 1.0);
+}
@@ -0,0 +1,12 @@
+#version 460
+
+layout(location = 0) in vec4 oColor;
+layout(location = 1) in vec2 oLocal;
+layout(location = 0) out vec4 oFragColor;
+
+void main()
+{
+  // soft round dust
+  float falloff = clamp(1.0 - dot(oLocal, oLocal), 0.0, 1.0);
+  oFragColor = vec4(oColor.rgb, oColor.a * falloff);
+}
@@ -0,0 +1,53 @@
+#version 460
+
+layout(std430, set = 0, binding = 0) readonly buffer Positions { vec2 positions[]; };
+layout(std430, set = 0, binding = 2) readonly buffer Lives { vec2 lives[]; };
+layout(std430, set = 0, binding = 3) readonly buffer Styles { uvec2 styles[]; };
+
+layout(push_constant) uniform PushConstants
+{
+  vec2 viewScale;
+  vec2 viewOffset;
+  float dt;
+  float gravity;
+  int tileOriginX;
+  int tileOriginY;
+  uint capacity;
+  uint particleHead;
+  uint emitCount;
+  uint emitParticleCount;
+  uint seed;
+}
+pc;
+
+layout(location = 0) out vec4 oColor;
+layout(location = 1) out vec2 oLocal;
+
+const vec2 corners[6] = { { -1.0, -1.0 }, { 1.0, -1.0 }, { 1.0, 1.0 },
+                          { -1.0, -1.0 }, { 1.0, 1.0 },  { -1.0, 1.0 } };
+
+void main()
+{
+  uint slot = gl_InstanceIndex;
+  vec2 life = lives[slot];
+
+  // dead slots collapse to a degenerate triangle outside the view
+  if (life.x <= 0.0)
+  {
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    oColor = vec4(0.0);
+    oLocal = vec2(0.0);
+    return;
+  }
+
+  uvec2 style = styles[slot];
+  float size = unpackHalf2x16(style.y & 0xffffu).x;
+  vec2 corner = corners[gl_VertexIndex];
+  vec2 world = positions[slot] + corner * (size * 0.5);
+
+  gl_Position = vec4(world * pc.viewScale + pc.viewOffset, 0.0, 1.0);
+
+  oColor = unpackUnorm4x8(style.x);
+  oColor.a *= clamp(life.x / max(life.y, 1e-4), 0.0, 1.0);
+  oLocal = corner;
+}
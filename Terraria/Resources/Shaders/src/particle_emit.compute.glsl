@@ -0,0 +1,86 @@
+#version 460
+
+layout(local_size_x = 256) in;
+
+struct EmitRequest
+{
+  vec2 position;
+  vec2 velocity;
+  float positionSpread;
+  float velocitySpread;
+  float life;
+  float size;
+  uint color;
+  uint count;
+  uint firstParticle;
+  uint flags;
+};
+
+layout(std430, set = 0, binding = 0) writeonly buffer Positions { vec2 positions[]; };
+layout(std430, set = 0, binding = 1) writeonly buffer Velocities { vec2 velocities[]; };
+layout(std430, set = 0, binding = 2) writeonly buffer Lives { vec2 lives[]; };
+layout(std430, set = 0, binding = 3) writeonly buffer Styles { uvec2 styles[]; };
+layout(std430, set = 0, binding = 4) readonly buffer EmitRequests { EmitRequest requests[]; };
+
+layout(push_constant) uniform PushConstants
+{
+  vec2 viewScale;
+  vec2 viewOffset;
+  float dt;
+  float gravity;
+  int tileOriginX;
+  int tileOriginY;
+  uint capacity;
+  uint particleHead;
+  uint emitCount;
+  uint emitParticleCount;
+  uint seed;
+}
+pc;
+
+uint hash(uint x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+vec2 randomInDisc(inout uint state)
+{
+  state = hash(state);
+  float angle = float(state) * (6.2831853 / 4294967296.0);
+  state = hash(state);
+  float radius = sqrt(float(state) / 4294967296.0);
+  return vec2(cos(angle), sin(angle)) * radius;
+}
+
+void main()
+{
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= pc.emitParticleCount)
+    return;
+
+  // last request whose first particle is not after this one
+  uint lo = 0;
+  uint hi = pc.emitCount - 1;
+  while (lo < hi)
+  {
+    uint mid = (lo + hi + 1) >> 1;
+    if (requests[mid].firstParticle <= index)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  EmitRequest request = requests[lo];
+
+  uint state = hash(index ^ hash(pc.seed));
+  uint slot = (pc.particleHead + index) % pc.capacity;
+
+  positions[slot] = request.position + randomInDisc(state) * request.positionSpread;
+  velocities[slot] = request.velocity + randomInDisc(state) * request.velocitySpread;
+  lives[slot] = vec2(request.life, request.life);
+  styles[slot] = uvec2(request.color, packHalf2x16(vec2(request.size, 0.0)) | (request.flags << 16));
+}
@@ -0,0 +1,88 @@
+#version 460
+
+layout(local_size_x = 256) in;
+
+layout(std430, set = 0, binding = 0) buffer Positions { vec2 positions[]; };
+layout(std430, set = 0, binding = 1) buffer Velocities { vec2 velocities[]; };
+layout(std430, set = 0, binding = 2) buffer Lives { vec2 lives[]; };
+layout(std430, set = 0, binding = 3) readonly buffer Styles { uvec2 styles[]; };
+
+// tile types around the camera, texel (0, 0) is tile (tileOriginX, tileOriginY)
+layout(set = 0, binding = 5) uniform usampler2D tileIds;
+layout(std430, set = 0, binding = 6) readonly buffer SolidTiles { uint solidTiles[]; };
+
+layout(push_constant) uniform PushConstants
+{
+  vec2 viewScale;
+  vec2 viewOffset;
+  float dt;
+  float gravity;
+  int tileOriginX;
+  int tileOriginY;
+  uint capacity;
+  uint particleHead;
+  uint emitCount;
+  uint emitParticleCount;
+  uint seed;
+}
+pc;
+
+const float TILE_SIZE = 16.0;
+// fraction of velocity left after a second, 0.98 per frame at 60 fps
+const float DRAG = 0.3;
+const float BOUNCE = 0.3;
+const uint PARTICLE_COLLIDE = 1u;
+const uint PARTICLE_NO_GRAVITY = 2u;
+
+bool isSolid(vec2 position)
+{
+  ivec2 texel = ivec2(floor(position / TILE_SIZE)) - ivec2(pc.tileOriginX, pc.tileOriginY);
+  if (any(lessThan(texel, ivec2(0))) || any(greaterThanEqual(texel, textureSize(tileIds, 0))))
+    return false;
+
+  uint type = texelFetch(tileIds, texel, 0).r;
+  return (solidTiles[type >> 5] & (1u << (type & 31u))) != 0u;
+}
+
+void main()
+{
+  uint slot = gl_GlobalInvocationID.x;
+  if (slot >= pc.capacity)
+    return;
+
+  vec2 life = lives[slot];
+  if (life.x <= 0.0)
+    return;
+
+  life.x -= pc.dt;
+  lives[slot] = life;
+  if (life.x <= 0.0)
+    return;
+
+  uint flags = styles[slot].y >> 16;
+  vec2 position = positions[slot];
+  vec2 velocity = velocities[slot];
+
+  if ((flags & PARTICLE_NO_GRAVITY) == 0u)
+    velocity.y += pc.gravity * pc.dt;
+  velocity *= pow(DRAG, pc.dt);
+
+  vec2 next = position + velocity * pc.dt;
+  if ((flags & PARTICLE_COLLIDE) != 0u)
+  {
+    // resolve each axis on its own so particles slide along floors and walls
+    if (isSolid(vec2(next.x, position.y)))
+    {
+      velocity.x *= -BOUNCE;
+      next.x = position.x;
+    }
+    if (isSolid(vec2(next.x, next.y)))
+    {
+      velocity.y *= -BOUNCE;
+      next.y = position.y;
+    }
+  }
+
+  positions[slot] = next;
+  velocities[slot] = velocity;
+}
@@ -0,0 +1,24 @@
+#version 460
+
+const uint SPRITE_SDF = 1;
+
+layout(set = 1, binding = 0) uniform sampler2D spriteTexture;
+
+layout(location = 0) in vec2 oUv;
+layout(location = 1) in vec4 oColor;
+layout(location = 2) flat in uint oFlags;
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+  if ((oFlags & SPRITE_SDF) != 0)
+  {
+    // the field is stored with 0.5 on the edge, smooth over about one screen pixel at any scale
+    float distance = texture(spriteTexture, oUv).r;
+    float width = max(fwidth(distance) * 0.5, 1.0 / 255.0);
+    outColor = vec4(oColor.rgb, oColor.a * smoothstep(0.5 - width, 0.5 + width, distance));
+    return;
+  }
+
+  outColor = texture(spriteTexture, oUv) * oColor;
+}
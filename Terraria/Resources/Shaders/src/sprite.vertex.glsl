@@ -0,0 +1,43 @@
+#version 460
+
+struct SpriteInstance
+{
+  vec2 position;
+  vec2 size;
+  vec4 uv;
+  uint color;
+  uint flags;
+  uint padding0;
+  uint padding1;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances
+{
+  SpriteInstance instances[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+  vec2 viewScale;
+  vec2 viewOffset;
+}
+pc;
+
+layout(location = 0) out vec2 oUv;
+layout(location = 1) out vec4 oColor;
+layout(location = 2) flat out uint oFlags;
+
+const vec2 corners[6] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 1.0, 1.0 },
+                          { 0.0, 0.0 }, { 1.0, 1.0 }, { 0.0, 1.0 } };
+
+void main()
+{
+  SpriteInstance instance = instances[gl_InstanceIndex];
+  vec2 corner = corners[gl_VertexIndex];
+
+  gl_Position = vec4((instance.position + corner * instance.size) * pc.viewScale + pc.viewOffset,
+                     0.0, 1.0);
+  oUv = mix(instance.uv.xy, instance.uv.zw, corner);
+  oColor = unpackUnorm4x8(instance.color);
+  oFlags = instance.flags;
+}
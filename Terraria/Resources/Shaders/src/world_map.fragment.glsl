@@ -0,0 +1,64 @@
+#version 460
+
+const uint BLOCK_SHIFT = 6;
+const uint BLOCK_SIZE = 1 << BLOCK_SHIFT;
+const uint NO_PAGE = 0xffffffff;
+
+layout(set = 0, binding = 0) uniform sampler2D atlas;
+
+layout(std430, set = 0, binding = 1) readonly buffer PageTable
+{
+  uint pages[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+  vec2 origin;
+  vec2 extent;
+  uint level;
+  uint levelCount;
+  uint width;
+  uint height;
+  uint pagesPerRow;
+}
+pc;
+
+layout(location = 0) in vec2 oUv;
+layout(location = 0) out vec4 oColor;
+
+void main()
+{
+  vec2 tile = pc.origin + oUv * pc.extent;
+  if (tile.x < 0.0 || tile.y < 0.0 || tile.x >= float(pc.width) || tile.y >= float(pc.height))
+    discard;
+
+  uvec2 tileCoord = uvec2(tile);
+  uint offset = 0;
+  for (uint level = 0; level < pc.levelCount; level++)
+  {
+    uint blockTiles = BLOCK_SIZE << level;
+    uint blocksX = (pc.width + blockTiles - 1) / blockTiles;
+    uint blocksY = (pc.height + blockTiles - 1) / blockTiles;
+
+    // missing blocks fall back to the next coarser level
+    if (level >= pc.level)
+    {
+      uvec2 texel = tileCoord >> level;
+      uvec2 block = texel >> BLOCK_SHIFT;
+      uint page = pages[offset + block.y * blocksX + block.x];
+      if (page != NO_PAGE)
+      {
+        uvec2 pageOrigin = uvec2(page % pc.pagesPerRow, page / pc.pagesPerRow) * BLOCK_SIZE;
+        vec4 color = texelFetch(atlas, ivec2(pageOrigin + (texel & (BLOCK_SIZE - 1))), 0);
+        if (color.a == 0.0)
+          discard;
+        oColor = color;
+        return;
+      }
+    }
+
+    offset += blocksX * blocksY;
+  }
+
+  discard;
+}
@@ -7,6 +7,8 @@
 
 #include <Volk/volk.h>
 
+#include <Lynx/vk_utils.h>
+
 #include "swapchain.h"
 #include "vk_core.h"
 #include "utils.h"
@@ -182,22 +184,6 @@ static VkDevice createLogicalDevice(VulkanCoreObjects& vulkanCoreObjects)
   return logicalDevice;
 }
 
-VkShaderModule createShaderModule(const VkDevice logicalDevice, const std::string& shaderByteCode)
-{
-  VkShaderModuleCreateInfo ci{};
-  ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  ci.codeSize = shaderByteCode.size();
-
-  std::vector<char> vectorShaderByteCode(shaderByteCode.begin(), shaderByteCode.end());
-  ci.pCode = (const uint32_t*)vectorShaderByteCode.data();
-
-  VkShaderModule shaderModule;
-  if (vkCreateShaderModule(logicalDevice, &ci, nullptr, &shaderModule) != VK_SUCCESS)
-    throw std::runtime_error("Failed to create shader module!");
-
-  return shaderModule;
-}
-
 static VkPipelineLayout createGraphicsPipeline(const VkDevice logicalDevice,
                                                const VkExtent2D swapChainExtent)
 {